@@ -2,10 +2,26 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__linux__)
+#include <time.h>
+#endif
 
 #include "NFC_reader.h"
+#include "NFC_reader_debug.h"
 #include "pn532.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#if NFC_READER_BENCH_EN && !NFC_READER_EMULATOR_EN
+#error "Mikrobenchmarky (NFC_READER_BENCH_EN) bezi nad emulovanou kartou, zapnete NFC_READER_EMULATOR_EN"
+#endif
 
 #define OFFSETDATA_ULTRALIGHT 8 // Offset paměti na mifare ultralight NFC tagu
 #define OFFSETDATA_CLASSIC 1    // Offset paměti na mifare classic NFC tagu
@@ -14,1693 +30,7112 @@
 #define MAXERRORREADING 5       // Maximalní počet opakování
 #define TIMEOUTCHECKCARD 1000   // Timeout pro dotaz na přitomnost karty
 #define MAXTIMEOUT 5000         // Timeout pro zapis/čtení
-
-#define NFC_READER_ALL_DEBUG_EN 1 // Všechno debugovaní
-#define NFC_READER_DEBUG_EN 1     // Lehké debugování
-
-/*!
-Zajištění výpisu všeho debugování
-*/
-#ifdef NFC_READER_ALL_DEBUG_EN
-#define NFC_READER_ALL_DEBUG(tag, fmt, ...)                      \
-  do                                                             \
-  {                                                              \
-    if (tag && *tag)                                             \
-    {                                                            \
-      printf("\x1B[31m[%s]DA:\x1B[0m " fmt, tag, ##__VA_ARGS__); \
-      fflush(stdout);                                            \
-    }                                                            \
-    else                                                         \
-    {                                                            \
-      printf(fmt, ##__VA_ARGS__);                                \
-    }                                                            \
-  } while (0)
-#else
-#define NFC_READER_ALL_DEBUG(fmt, ...)
+#define NFC_CACHE_BLOCKS 4      // Počet 16B bloků v cache relace
+#define NFC_PREFETCH_STACK 4096 // Velikost zásobníku úlohy předčítání
+#define NFC_PREFETCH_PRIORITY 5 // Priorita úlohy předčítání
+#define NFC_EMULATOR_SIZE 1024  // Velikost paměti emulované karty (Mifare Classic 1K, NTAG216)
+#define NFC_UL_READ_CNT 0x39    // Přečtení čítače Ultralight EV1/NTAG21x
+#define NFC_UL_INCR_CNT 0xA5    // Zvýšení čítače Ultralight EV1
+#define NFC_UL_COUNTER_MAX 0xFFFFFF // Čítače jsou 24bitové
+#define NFC_UL_GET_VERSION 0x60 // Verze Ultralight EV1/NTAG21x (starší Ultralight ji nezná)
+#define NFC_CAPABILITY_CACHE 8  // Počet karet v cache zjištěných typů
+#define NFC_TRACE_RESYNC 8      // O kolik rámců dopředu se při přehrávání hledá operace, která neodpovídá pořadí záznamu
+#define NFC_CLASSIC_DECREMENT 0xC0 // Snížení hodnotového bloku Mifare Classic
+#define NFC_CLASSIC_INCREMENT 0xC1 // Zvýšení hodnotového bloku Mifare Classic
+#define NFC_CLASSIC_TRANSFER 0xB0  // Zápis výsledku snížení/zvýšení do hodnotového bloku
+#define NFC_ISODEP_CHUNK 240       // Max. délka dat v jednom APDU READ/UPDATE BINARY (rámec PN532 má max. 255 B)
+#define NFC_ISODEP_FILE 0xE104     // Výchozí soubor s daty na ISO-DEP kartě (NDEF soubor NTAG 424/DESFire)
+#define NFC_ISODEP_SW_OK 0x9000    // Stavové slovo úspěšně provedeného APDU
+#define NFC_FELICA_POLLING 0x00    // FeliCa Polling
+#define NFC_FELICA_READ 0x06       // FeliCa Read Without Encryption
+#define NFC_FELICA_WRITE 0x08      // FeliCa Write Without Encryption
+#define NFC_RFCONFIGURATION 0x32   // Nastavení RF části PN532
+#define NFC_RFCFG_FIELD 0x01       // RFConfiguration - RF pole a Auto RFCA
+#define NFC_RFCFG_TIMINGS 0x02     // RFConfiguration - timeouty ATR_RES a odpovědi karty
+#define NFC_RFCFG_RETRIES 0x05     // RFConfiguration - počty pokusů ATR, PSL a InListPassiveTarget
+#define NFC_RF_RETRIES_PASSIVE 0x05 // Výchozí počet pokusů InListPassiveTarget (PN532 0xFF - hledá do timeoutu)
+#define NFC_FIRMWARE_MAGIC 0x504E3533 // "PN53" - platná uložená verze firmware
+#define NFC_RECOVERY_TIMEOUT 50    // Timeout rychlé aktivace známé karty po chybě v ms
+#define NFC_RECOVERY_TRIES 2       // Počet rychlých aktivací, než se operace vzdá
+#define NFC_REMOVAL_POLL_MS 100    // Prodleva mezi dotazy na odebrání karty při hromadném zápisu
+#ifndef NFC_REMOVAL_TIMEOUT
+#define NFC_REMOVAL_TIMEOUT 10000  // Jak dlouho se čeká na odebrání zapsané karty v ms (testy ho zkracují)
 #endif
+#define NFC_HOST_TO_PN532 0xD4     // TFI rámce příkazu
+#define NFC_PN532_TO_HOST 0xD5     // TFI rámce odpovědi
+#define NFC_GETFIRMWAREVERSION 0x02 // Verze firmware PN532
+#define NFC_SAMCONFIGURATION 0x14  // Nastavení SAM (normální režim)
+#define NFC_INDATAEXCHANGE 0x40    // Výměna dat s vybranou kartou
+#define NFC_EXCHANGE_TIMEOUT 1000  // Timeout InDataExchange v ms (jako ovladač pn532)
+#define NFC_CLASSIC_AUTH_A 0x60    // Autentizace Mifare Classic klíčem A
+#define NFC_CLASSIC_AUTH_B 0x61    // Autentizace Mifare Classic klíčem B
+#define NFC_CLASSIC_READ 0x30      // Čtení bloku Mifare Classic / 4 stran Ultralight
+#define NFC_CLASSIC_WRITE 0xA0     // Zápis bloku Mifare Classic
+#define NFC_UL_WRITE 0xA2          // Zápis strany Ultralight
+
+/*!
+Možnost tisknout nazev
+*/
+#define _STRINGIFY(s) #s
+#define STRINGIFY(s) _STRINGIFY(s)
+
+/*!
+Jeden 16B blok dat v cache relace
+*/
+typedef struct
+{
+  size_t Block;
+  bool Valid;
+  uint32_t LastUse;
+  uint8_t Data[PAGESIZE_CLASSIC];
+} TNFCCacheBlock;
+
+/*!
+Relace s přiloženou kartou - UID, stav autentizace a cache bloků
+*/
+typedef struct
+{
+  pn532_t *NFC;
+  bool Active;
+  uint8_t sUid[NFC_UID_MAXSIZE];
+  uint8_t sUidLength;
+  uint8_t TagType;
+  int16_t AuthSector;
+  uint32_t UseCounter;
+  TNFCCacheBlock Cache[NFC_CACHE_BLOCKS];
+} TNFCSession;
+
+static TNFCSession NFC_Session = {.NFC = NULL, .Active = false, .AuthSector = -1};
+
+static TNFCStats NFC_Stats = {.VerifyPolicy = NFC_VERIFY_FULL};
+static TNFCRFConfig NFC_RFConfig = {.MaxRetriesPassive = NFC_RF_RETRIES_PASSIVE, .MaxRetriesAtr = 0xFF, .MaxRetriesPsl = 0x01, .AtrTimeout = 0x0B, .RetryTimeout = 0x0A, .AutoRfca = true};
+static TNFCTransport NFC_TransportConfig;
+static const TNFCTransport *NFC_Transport = NULL; // NULL - ovladač pn532 (SPI na GPIO ESP-IDF)
+static int NFC_IrqPin = -1;       // GPIO výstupu IRQ PN532 (-1 - připravenost se zjišťuje dotazy na stav)
+static SemaphoreHandle_t NFC_IrqSemaphore = NULL;
+static uint32_t NFC_CommandCpu = 0; // Čas CPU na začátku právě prováděného příkazu
+
+/*!
+Verze firmware PN53x zjištěná při posledním startu - přežije softwarový restart i deep sleep,
+po zapnutí napájení je obsah náhodný (proto Magic)
+*/
+typedef struct
+{
+  uint32_t Magic;
+  uint32_t Version;
+} TNFCFirmwareCache;
+
+static RTC_NOINIT_ATTR TNFCFirmwareCache NFC_FirmwareCache;
+
+/*!
+Klíče sektorů Mifare Classic - kandidáti pro každý sektor, naposledy úspěšný se zkouší první
+*/
+static const TNFCKey NFC_DefaultKey = {.Key = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, .KeyNumber = 1, .Diversify = false};
+static TNFCKey NFC_SectorKeys[NFC_CLASSIC_SECTORS][NFC_KEY_CANDIDATES];
+static uint8_t NFC_SectorKeyCount[NFC_CLASSIC_SECTORS]; // 0 - jen vychozi klic FF..FF
+static uint8_t NFC_SectorLastGood[NFC_CLASSIC_SECTORS];
+static TNFCKeyDiversify NFC_KeyDiversify = NULL;
+static void *NFC_KeyDiversifyContext = NULL;
+
+/*!
+Odvozené klíče jedné karty - diverzifikace se počítá jen jednou pro kartu, sektor a kandidáta
+*/
+typedef struct
+{
+  uint8_t sUid[NFC_UID_MAXSIZE];
+  uint8_t sUidLength;
+  uint8_t Derived[NFC_CLASSIC_SECTORS]; // Bit kandidata - klic je odvozen
+  uint8_t Key[NFC_CLASSIC_SECTORS][NFC_KEY_CANDIDATES][NFC_KEY_SIZE];
+} TNFCKeyCache;
+
+static TNFCKeyCache NFC_KeyCache = {.sUidLength = 0};
+static int8_t NFC_DrinkCounter = -1; // Čítač tagu pro NumOfDrinks (-1 - NumOfDrinks je v hlavičce)
+static uint8_t NFC_BudgetBlock = 0;  // Hodnotový blok Mifare Classic pro ActualBudget (0 - ActualBudget je v hlavičce)
+static uint8_t NFC_RingBlock = 0;    // První 16B blok kruhu transakcí od začátku dat
+static uint8_t NFC_RingBlocks = 0;   // Počet bloků kruhu transakcí (0 - NumOfDrinks/ActualBudget jen v hlavičce)
+static uint8_t NFC_TagBackend = NFC_TAG_UNKNOWN; // Vynucený typ tagu (NFC_TAG_UNKNOWN - typ podle ATQA/SAK)
+static uint16_t NFC_IsoDepFile = NFC_ISODEP_FILE;
+static const uint8_t NFC_IsoDepAid[] = {0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01}; // Aplikace NDEF (ISO 7816-4)
+static TNFCFelicaConfig NFC_Felica = {.ServiceCode = 0x0009, .ReadBlocks = 4, .WriteBlocks = 1, .Baud424 = true};
+
+/*!
+Odpověď posledního výběru karty ISO14443A
+*/
+typedef struct
+{
+  bool Valid; // false - ATQA/SAK neni znamy (FeliCa, starsi zaznam)
+  uint16_t Atqa;
+  uint8_t Sak;
+} TNFCTarget;
+
+static TNFCTarget NFC_Target = {.Valid = false};
+
+/*!
+Zjištěný typ karty podle UID
+*/
+typedef struct
+{
+  uint8_t sUid[NFC_UID_MAXSIZE];
+  uint8_t sUidLength;
+  uint8_t TagType;
+  bool Counter; // Karta umi READ_CNT/INCR_CNT (Ultralight EV1)
+  uint32_t LastUse;
+} TNFCCapability;
+
+static TNFCCapability NFC_Capability[NFC_CAPABILITY_CACHE];
+static uint32_t NFC_CapabilityUse = 0;
+
+/*!
+Stav předčítání kroků na pozadí
+*/
+typedef struct
+{
+  pn532_t *NFC;
+  TCardInfo *CardInfo;
+  size_t NumOfStructure;
+  uint8_t Depth;
+  uint8_t Error;
+  TaskHandle_t Task;
+  SemaphoreHandle_t Done;
+} TNFCPrefetch;
+
+static TNFCPrefetch NFC_Prefetch = {.Task = NULL, .Done = NULL};
+
+/*!
+Publikované snímky karty pro ostatní úlohy - úloha čtečky zapisuje do druhého bufferu, než který je
+publikovaný, a čítač se v průběhu zápisu zvýší na liché a po zápisu na sudé číslo (publikuje se
+buffer (čítač / 2) % 2). Čtenáři nikdy neblokují čtečku, čtení se opakuje jen, když čtečka během
+kopírování publikovala dvakrát.
+*/
+static TNFCCardSnapshot NFC_Snapshots[2];
+static uint32_t NFC_SnapshotSeq = 0;
 
+#if NFC_READER_EMULATOR_EN
 /*!
-Zajištění výpisu lehkého debugování
-*/
-#ifdef NFC_READER_DEBUG_EN
-#define NFC_READER_DEBUG(tag, fmt, ...)                         \
-  do                                                            \
-  {                                                             \
-    if (tag && *tag)                                            \
-    {                                                           \
-      printf("\x1B[36m[%s]D:\x1B[0m " fmt, tag, ##__VA_ARGS__); \
-      fflush(stdout);                                           \
-    }                                                           \
-    else                                                        \
-    {                                                           \
-      printf(fmt, ##__VA_ARGS__);                               \
-    }                                                           \
-  } while (0)
+Emulovaná karta - operace se čtečkou se místo PN532 provádí nad pamětí karty
+*/
+typedef struct
+{
+  bool Active;
+  uint8_t TagType;
+  uint8_t sUid[NFC_UID_MAXSIZE];
+  uint8_t sUidLength;
+  uint8_t Memory[NFC_EMULATOR_SIZE];
+  uint32_t Counter[3];
+  int32_t Transfer;     // Vnitřní registr Mifare Classic pro hodnotové operace
+  uint8_t IsoDepSelect; // Výběr ISO-DEP karty (0 - nic, 1 - aplikace, 2 - soubor)
+} TNFCEmulator;
+
+static TNFCEmulator NFC_Emulator = {.Active = false};
+
+#define NFC_EMULATOR_ACTIVE (NFC_Emulator.Active)
+// Operace se provede nad emulovanou kartou, pokud je emulace spustena, jinak na ctecce
+#define NFC_EMULATED(aEmulator, aDriver) (NFC_Emulator.Active ? (aEmulator) : (aDriver))
 #else
-#define NFC_READER_DEBUG(fmt, ...)
+#define NFC_EMULATOR_ACTIVE false
+#define NFC_EMULATED(aEmulator, aDriver) (aDriver)
 #endif
 
 /*!
-Možnost tisknout nazev
+Zřetězení příkazů - hostitelská práce pro další příkaz (složení dat, adresa bloku) se odloží a spustí,
+jakmile PN532 potvrdí aktuální příkaz a zpracovává ho na RF. Práce nesmí posílat příkazy PN532.
 */
-#define _STRINGIFY(s) #s
-#define STRINGIFY(s) _STRINGIFY(s)
+static void (*NFC_PipelineWork)(void *aContext) = NULL;
+static void *NFC_PipelineContext = NULL;
+static const void *NFC_PipelineBuffer = NULL; // Buffer, se kterým odložená práce pracuje
+
+/*!
+Příprava zápisu jednoho bloku (Classic 16 B) nebo strany (Ultralight 4 B) z TCardInfo
+*/
+typedef struct
+{
+  TCardInfo *CardInfo;
+  size_t Block;  // Číslo bloku nebo strany od začátku dat
+  uint8_t Size;  // PAGESIZE_CLASSIC nebo PAGESIZE_ULTRALIGHT
+  uint8_t Index; // Index bloku na Mifare Classic čipu nebo číslo strany Ultralight
+  uint8_t Data[PAGESIZE_CLASSIC];
+} TNFCWriteStep;
+
+/*!
+Odložené kopírování přečtených dat z cache relace
+*/
+typedef struct
+{
+  const uint8_t *Source;
+  uint8_t *Target;
+  size_t Length;
+} TNFCCopyStep;
+
+#if NFC_READER_FAULTS_EN
+#define NFC_FAULT_NONE 0
+#define NFC_FAULT_FAIL 1
+#define NFC_FAULT_TORN 2
+
+/*!
+Stav vkládání chyb
+*/
+typedef struct
+{
+  bool Active;
+  TNFCFaultProfile Profile;
+  uint32_t Random;
+  uint32_t Blocks;
+  int64_t RemovedUntil;
+} TNFCFaults;
+
+static TNFCFaults NFC_Faults = {.Active = false};
 
 /**************************************************************************/
 /*!
-    @brief  Inicializace PN532 desky
+    @brief  Rozhodne, jestli se má do operace vložit chyba podle profilu
 
-    @param  aNFC      Pointer na NFC strukturu
-    @param  clk       CLK GPIO Výstup
-    @param  miso      MISO GPIO Výstup
-    @param  mosi      MOSI GPIO Výstup
-    @param  ss        SS GPIO Výstup
+    @param  aOp      Operace (NFC_TRACE_...)
 
-    @returns 0 - NFC ctecka se nainicializovala, 1 - Nelze najít NFC čtečku PN53x
+    @returns NFC_FAULT_NONE - Bez chyby, NFC_FAULT_FAIL - Operace selze, NFC_FAULT_TORN - Zapis se potrha
 */
 /**************************************************************************/
-uint8_t NFC_Reader_Init(pn532_t *aNFC, uint8_t aClk, uint8_t aMiso, uint8_t aMosi, uint8_t aSs)
+static uint8_t NFC_FaultCheck(uint8_t aOp)
 {
-  static const char *TAGin = "NFC_Reader_Init";
-  NFC_READER_DEBUG(TAGin, "Inicializuji NFC ctecku.\n");
-  pn532_spi_init(aNFC, aClk, aMiso, aMosi, aSs);
-  pn532_begin(aNFC);
-  uint32_t versiondata = pn532_getFirmwareVersion(aNFC);
-  if (!versiondata)
+  if (!NFC_Faults.Active)
+    return NFC_FAULT_NONE;
+  int64_t iTed = esp_timer_get_time();
+  if (iTed < NFC_Faults.RemovedUntil)
+    return NFC_FAULT_FAIL;
+  if (aOp != NFC_TRACE_SELECT && aOp != NFC_TRACE_REACTIVATE && NFC_Faults.Profile.RemoveAfterBlocks != 0 && ++NFC_Faults.Blocks == NFC_Faults.Profile.RemoveAfterBlocks)
   {
-    NFC_READER_DEBUG(TAGin, "Nelze najít PN53x desku.\n");
-    return 1;
+    NFC_Faults.RemovedUntil = iTed + (int64_t)NFC_Faults.Profile.RemoveMs * 1000;
+    return NFC_FAULT_FAIL;
+  }
+
+  // xorshift32
+  NFC_Faults.Random ^= NFC_Faults.Random << 13;
+  NFC_Faults.Random ^= NFC_Faults.Random >> 17;
+  NFC_Faults.Random ^= NFC_Faults.Random << 5;
+  uint16_t iNahoda = NFC_Faults.Random % 1000;
+
+  if (NFC_Faults.Profile.SlowPermille > 0 && iNahoda < NFC_Faults.Profile.SlowPermille)
+  {
+    vTaskDelay(pdMS_TO_TICKS(NFC_Faults.Profile.SlowDelayMs));
+  }
+  switch (aOp)
+  {
+  case NFC_TRACE_AUTH:
+    return iNahoda < NFC_Faults.Profile.AuthFailPermille ? NFC_FAULT_FAIL : NFC_FAULT_NONE;
+  case NFC_TRACE_CLASSIC_READ:
+  case NFC_TRACE_UL_READ:
+  case NFC_TRACE_EXCHANGE:
+    return iNahoda < NFC_Faults.Profile.ReadFailPermille ? NFC_FAULT_FAIL : NFC_FAULT_NONE;
+  case NFC_TRACE_CLASSIC_WRITE:
+  case NFC_TRACE_UL_WRITE:
+    if (iNahoda < NFC_Faults.Profile.WriteFailPermille)
+      return NFC_FAULT_FAIL;
+    if (iNahoda < NFC_Faults.Profile.WriteFailPermille + NFC_Faults.Profile.TornWritePermille)
+      return NFC_FAULT_TORN;
+    return NFC_FAULT_NONE;
+  default:
+    return NFC_FAULT_NONE;
   }
-  NFC_READER_DEBUG(TAGin, "Našla se deska PN5 %lu.\n", (versiondata >> 24) & 0xFF);
-  NFC_READER_ALL_DEBUG(TAGin, "Firmware ver. %lu.%lu. \n", (versiondata >> 16) & 0xFF, (versiondata >> 8) & 0xFF);
-  pn532_SAMConfig(aNFC);
-  return 0;
 }
+#else
+#define NFC_FaultCheck(aOp) 0
+#define NFC_FAULT_FAIL 1
+#define NFC_FAULT_TORN 2
+#endif
 
 /**************************************************************************/
 /*!
-    @brief  Vypis vsech hodnot co mají být na NFC tagu
+    @brief  Připraví data zápisu podle vložené chyby (potrhaný zápis zapíše jen první polovinu dat)
 
-    @param  aCardInfo      Pointer na TCardInfo strukturu
+    @param  aData      Data k zápisu
+    @param  aLength      Délka dat
+    @param  aBuffer      Pomocný buffer o délce aLength
+    @param  aFault      Vložená chyba
 
+    @returns Pointer na data, ktera se opravdu zapisou
 */
 /**************************************************************************/
-void NFC_Print(TCardInfo aCardInfo)
+static uint8_t *NFC_FaultWriteData(uint8_t *aData, size_t aLength, uint8_t *aBuffer, uint8_t aFault)
 {
-  static const char *TAGin = "NFC_Print";
-  printf("\nInfo tagu: ");
-  for (int i = 0; i < TRecipeInfo_Size; ++i)
-  {
-    printf("%d ", *(((uint8_t *)&aCardInfo.sRecipeInfo) + i));
-  }
-  if (aCardInfo.sRecipeInfo.RecipeSteps > 0 && aCardInfo.sRecipeStep != NULL)
+  if (aFault != NFC_FAULT_TORN)
+    return aData;
+  memcpy(aBuffer, aData, aLength / 2);
+  memset(aBuffer + aLength / 2, 0, aLength - aLength / 2);
+  return aBuffer;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zakódování hodnoty do formátu hodnotového bloku Mifare Classic (hodnota, negace, hodnota, 4x adresa)
+
+    @param  aValue      Hodnota
+    @param  aBlock      Adresa bloku
+    @param  aData       Buffer o velikosti PAGESIZE_CLASSIC
+*/
+/**************************************************************************/
+static void NFC_EncodeValueBlock(int32_t aValue, uint8_t aBlock, uint8_t *aData)
+{
+  uint32_t iHodnota = (uint32_t)aValue;
+  for (size_t i = 0; i < 4; ++i)
   {
-    printf("\nKroky Receptu:");
-    for (int j = 0; j < aCardInfo.sRecipeInfo.RecipeSteps; j++)
-    {
-      printf("\n%d: ", j);
-      for (int i = 0; i < TRecipeStep_Size; i++)
-      {
-        printf("%d ", *(((uint8_t *)aCardInfo.sRecipeStep) + j * TRecipeStep_Size + i));
-      }
-    }
+    aData[i] = aData[i + 8] = (iHodnota >> (8 * i)) & 0xFF;
+    aData[i + 4] = ~aData[i];
   }
-  printf("\n");
-  fflush(stdout);
+  aData[12] = aData[14] = aBlock;
+  aData[13] = aData[15] = ~aBlock;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Zapsaní jedné struktury paměti do NFC tagu
+    @brief  Dekódování hodnotového bloku Mifare Classic s kontrolou redundance
 
-    @param  aNFC      Pointer na NFC strukturu
-    @param  aCardInfo      aCardInfo struktura
-    @param  NumOfStructure Číslo struktury(0- info, 1-end - recipe)
+    @param  aData       Data bloku
+    @param  aValue      Pointer, do kterého se uloží hodnota
 
-    @returns 0 - Data se na NFC tag zapsala, 1 - NumOfStructure je mimo rozsah, 2 - Data se nezapsala, 3 - Nelze autentizovat NFC tag, 4 - jiná chyba
+    @returns true - Blok je platny hodnotovy blok, false - Blok neni hodnotovy blok
 */
 /**************************************************************************/
-uint8_t NFC_WriteStruct(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructure)
+static bool NFC_DecodeValueBlock(const uint8_t *aData, int32_t *aValue)
 {
-  static const char *TAGin = "NFC_WriteStruct";
-  NFC_READER_ALL_DEBUG(TAGin, "Zapisuji na kartu jednu struktu\n");
-  uint8_t Error;
-  for (size_t i = 0; i < MAXERRORREADING; ++i)
-  {
-    Error = NFC_WriteStructRange(aNFC, aCardInfo, NumOfStructure, NumOfStructure);
-    if (Error == 0 || Error == 1)
-      break;
-  }
-  switch (Error)
+  for (size_t i = 0; i < 4; ++i)
   {
-  case 0:
-    NFC_READER_ALL_DEBUG(TAGin, "Data do struktury %d se uspesne zapsala.\n", NumOfStructure);
-    return 0;
-    break;
-  case 1:
-    NFC_READER_ALL_DEBUG(TAGin, "NumOfStructure %d je mimo rozsah.\n", NumOfStructure);
-    return 1;
-    break;
-  case 2:
-    NFC_READER_ALL_DEBUG(TAGin, "Data se nezapsala.\n");
-    return 2;
-    break;
-  case 3:
-    NFC_READER_ALL_DEBUG(TAGin, "Nelze autentizovat NFC tag.\n");
-    return 3;
-    break;
-  default:
-    NFC_READER_ALL_DEBUG(TAGin, "Jina chyba.\n");
-    return 4;
-    break;
+    if (aData[i] != aData[i + 8] || (aData[i] ^ aData[i + 4]) != 0xFF)
+      return false;
   }
-  return 4;
+  if (aData[12] != aData[14] || aData[13] != aData[15] || (aData[12] ^ aData[13]) != 0xFF)
+    return false;
+  *aValue = (int32_t)(aData[0] | (aData[1] << 8) | (aData[2] << 16) | ((uint32_t)aData[3] << 24));
+  return true;
 }
 
+#if NFC_READER_EMULATOR_EN
 /**************************************************************************/
 /*!
-    @brief  Zapsaní rozsahu struktur paměti do NFC tagu
+    @brief  Čtení/zápis paměti emulované karty
 
-    @param  aNFC      Pointer na NFC strukturu
-    @param  aCardInfo      aCardInfo struktura
-    @param  NumOfStructure Číslo struktury(0- info, 1-end - recipe)
+    @param  aOffset      Pozice v paměti karty
+    @param  aData      Data
+    @param  aLength      Délka dat
+    @param  aWrite      true - zápis, false - čtení
 
-    @returns 0 - Data se na NFC tag zapsala, 1 - NumOfStructure je mimo rozsah, 2 - Data se nezapsala, 3 - Nelze autentizovat NFC tag, 4 - Posledni struktura je mensi jak prvni struktura
+    @returns 1 - Operace probehla, 0 - Mimo pamet karty
 */
 /**************************************************************************/
-uint8_t NFC_WriteStructRange(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd)
+static uint8_t NFC_EmulatorAccess(size_t aOffset, uint8_t *aData, size_t aLength, bool aWrite)
 {
-  static const char *TAGin = "NFC_WriteStructRange";
-  NFC_READER_DEBUG(TAGin, "Zapisuji na kartu\n");
+  if (aOffset + aLength > NFC_EMULATOR_SIZE)
+    return 0;
+  if (aWrite)
+    memcpy(NFC_Emulator.Memory + aOffset, aData, aLength);
+  else
+    memcpy(aData, NFC_Emulator.Memory + aOffset, aLength);
+  return 1;
+}
 
-  if (NumOfStructureStart > NumOfStructureEnd)
+/**************************************************************************/
+/*!
+    @brief  Zpracování APDU emulovanou ISO-DEP kartou (SELECT, READ BINARY, UPDATE BINARY nad pamětí karty)
+
+    @param  aSend      APDU
+    @param  aSendLength      Délka APDU
+    @param  aResponse      Buffer odpovědi
+    @param  aResponseLength      Délka bufferu odpovědi, po návratu délka odpovědi včetně stavového slova
+
+    @returns true - Karta odpovedela, false - Prikaz neni APDU
+*/
+/**************************************************************************/
+static bool NFC_EmulatorApdu(uint8_t *aSend, uint8_t aSendLength, uint8_t *aResponse, uint8_t *aResponseLength)
+{
+  if (aSendLength < 4 || *aResponseLength < 2)
+    return false;
+  uint16_t iSw = 0x6D00; // Nepodporovana instrukce
+  size_t iDelka = 0;
+  size_t iLc = aSendLength > 5 ? aSend[4] : 0;
+  size_t iPozice = (aSend[2] << 8) | aSend[3];
+  if (5 + iLc > aSendLength && aSendLength > 5)
   {
-    NFC_READER_ALL_DEBUG(TAGin, "Posledni struktura je mensi jak prvni struktura!\n");
-    return 4;
+    iSw = 0x6700;
   }
-
-  if (NumOfStructureStart > aCardInfo->sRecipeInfo.RecipeSteps || NumOfStructureEnd > aCardInfo->sRecipeInfo.RecipeSteps)
+  else if (aSend[1] == 0xA4)
   {
-    NFC_READER_ALL_DEBUG(TAGin, "Index je mimo rozsah!!\n");
-    return 1;
+    iSw = 0x6A82; // Soubor nenalezen
+    if (aSend[2] == 0x04 && iLc == sizeof(NFC_IsoDepAid) && memcmp(aSend + 5, NFC_IsoDepAid, iLc) == 0)
+    {
+      NFC_Emulator.IsoDepSelect = 1;
+      iSw = NFC_ISODEP_SW_OK;
+    }
+    else if (aSend[2] == 0x00 && iLc == 2 && NFC_Emulator.IsoDepSelect != 0 && ((aSend[5] << 8) | aSend[6]) == NFC_IsoDepFile)
+    {
+      NFC_Emulator.IsoDepSelect = 2;
+      iSw = NFC_ISODEP_SW_OK;
+    }
   }
-  NFC_READER_DEBUG(TAGin, "Od indexu: %d do %d.\n", NumOfStructureStart, NumOfStructureEnd);
+  else if (aSend[1] == 0xB0 || aSend[1] == 0xD6)
+  {
+    iSw = 0x6B00; // Mimo soubor
+    if (NFC_Emulator.IsoDepSelect != 2)
+    {
+      iSw = 0x6986;
+    }
+    else if (aSend[1] == 0xB0 && aSendLength == 5)
+    {
+      iDelka = aSend[4] == 0 ? 256 : aSend[4];
+      if (iDelka + 2 <= *aResponseLength && NFC_EmulatorAccess(iPozice, aResponse, iDelka, false))
+        iSw = NFC_ISODEP_SW_OK;
+      else
+        iDelka = 0;
+    }
+    else if (aSend[1] == 0xD6 && iLc > 0 && NFC_EmulatorAccess(iPozice, aSend + 5, iLc, true))
+    {
+      iSw = NFC_ISODEP_SW_OK;
+    }
+  }
+  aResponse[iDelka] = iSw >> 8;
+  aResponse[iDelka + 1] = iSw & 0xFF;
+  *aResponseLength = iDelka + 2;
+  return true;
+}
 
-  size_t zacatek = 0;
-  size_t konec = TRecipeInfo_Size - 1;
+/**************************************************************************/
+/*!
+    @brief  Zpracování příkazu FeliCa emulovanou kartou (Read/Write Without Encryption s limity FeliCa Lite-S)
 
-  if (NumOfStructureStart > 0)
+    @param  aSend      Rámec FeliCa (první byte je délka)
+    @param  aSendLength      Délka rámce
+    @param  aResponse      Buffer odpovědi
+    @param  aResponseLength      Délka bufferu odpovědi, po návratu délka odpovědi
+
+    @returns true - Karta odpovedela, false - Karta prikaz nepodporuje
+*/
+/**************************************************************************/
+static bool NFC_EmulatorFelica(uint8_t *aSend, uint8_t aSendLength, uint8_t *aResponse, uint8_t *aResponseLength)
+{
+  // LEN, prikaz, IDm, pocet sluzeb, sluzba, pocet bloku, seznam bloku
+  if (aSendLength < 14 || aSend[0] != aSendLength || (aSend[1] != NFC_FELICA_READ && aSend[1] != NFC_FELICA_WRITE) ||
+      memcmp(aSend + 2, NFC_Emulator.sUid, 8) != 0)
+    return false;
+  bool iZapis = aSend[1] == NFC_FELICA_WRITE;
+  size_t iPocet = aSend[13];
+  size_t iDelka = iZapis ? 14 + iPocet * (2 + PAGESIZE_CLASSIC) : 14 + iPocet * 2;
+  uint8_t iStav = 0x00;
+  if (aSend[10] != 1 || (aSend[11] | (aSend[12] << 8)) != 0x0009)
+    iStav = 0xA6; // Neplatna sluzba
+  else if (iPocet == 0 || iPocet > (iZapis ? 1 : 4) || aSendLength != iDelka)
+    iStav = 0xA2; // Neplatny pocet bloku
+  for (size_t i = 0; i < iPocet && iStav == 0x00; ++i)
   {
-    zacatek = TRecipeInfo_Size + (NumOfStructureStart - 1) * TRecipeStep_Size;
+    uint8_t *iBlok = aSend + 14 + 2 * iPocet + i * PAGESIZE_CLASSIC;
+    if (aSend[14 + 2 * i] != 0x80 ||
+        !NFC_EmulatorAccess(aSend[15 + 2 * i] * PAGESIZE_CLASSIC, iZapis ? iBlok : aResponse + 13 + i * PAGESIZE_CLASSIC, PAGESIZE_CLASSIC, iZapis))
+      iStav = 0xA8; // Neplatny blok
   }
-  if (NumOfStructureEnd > 0)
+  if ((iZapis ? 12 : 13 + iPocet * PAGESIZE_CLASSIC) > *aResponseLength)
+    return false;
+  aResponse[1] = aSend[1] + 1;
+  memcpy(aResponse + 2, NFC_Emulator.sUid, 8);
+  aResponse[10] = iStav == 0x00 ? 0x00 : 0xFF;
+  aResponse[11] = iStav;
+  *aResponseLength = iZapis || iStav != 0x00 ? 12 : 13 + iPocet * PAGESIZE_CLASSIC;
+  if (!iZapis && iStav == 0x00)
+    aResponse[12] = iPocet;
+  aResponse[0] = *aResponseLength;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Výměna dat s emulovanou kartou (čítače Ultralight EV1)
+
+    @param  aSend      Příkaz
+    @param  aSendLength      Délka příkazu
+    @param  aResponse      Buffer odpovědi
+    @param  aResponseLength      Délka bufferu odpovědi, po návratu délka odpovědi
+
+    @returns true - Karta prikaz provedla, false - Karta prikaz nepodporuje
+*/
+/**************************************************************************/
+static bool NFC_EmulatorExchange(uint8_t *aSend, uint8_t aSendLength, uint8_t *aResponse, uint8_t *aResponseLength)
+{
+  if (NFC_Emulator.TagType == NFC_TAG_ISODEP)
+    return NFC_EmulatorApdu(aSend, aSendLength, aResponse, aResponseLength);
+  if (NFC_Emulator.TagType == NFC_TAG_FELICA)
+    return NFC_EmulatorFelica(aSend, aSendLength, aResponse, aResponseLength);
+  if (NFC_Emulator.TagType == NFC_TAG_ULTRALIGHT && aSendLength == 1 && aSend[0] == NFC_UL_GET_VERSION && *aResponseLength >= 8)
   {
-    konec = TRecipeInfo_Size + (NumOfStructureStart - 1) * TRecipeStep_Size + TRecipeStep_Size * (NumOfStructureEnd - NumOfStructureStart + 1) - 1;
+    // Ultralight EV1 MF0UL21 - hlavicka, NXP, typ, podtyp, verze, velikost, protokol
+    static const uint8_t iVerze[8] = {0x00, 0x04, 0x03, 0x01, 0x01, 0x00, 0x0E, 0x03};
+    memcpy(aResponse, iVerze, sizeof(iVerze));
+    *aResponseLength = sizeof(iVerze);
+    return true;
   }
-
-  uint16_t CheckSumNew = NFC_GetCheckSum(*aCardInfo);
-  if (CheckSumNew != aCardInfo->sRecipeInfo.CheckSum)
+  if (NFC_Emulator.TagType == NFC_TAG_CLASSIC && aSendLength >= 2 && aSend[1] < NFC_EMULATOR_SIZE / PAGESIZE_CLASSIC)
   {
-    aCardInfo->sRecipeInfo.CheckSum = CheckSumNew;
-    NFC_READER_ALL_DEBUG(TAGin, "CheckSum se lisi, novy checksum: %d\n", CheckSumNew);
-    if (NumOfStructureStart != 0)
+    uint8_t *iBlok = NFC_Emulator.Memory + aSend[1] * PAGESIZE_CLASSIC;
+    int32_t iHodnota;
+    *aResponseLength = 0;
+    if ((aSend[0] == NFC_CLASSIC_DECREMENT || aSend[0] == NFC_CLASSIC_INCREMENT) && aSendLength >= 6 && NFC_DecodeValueBlock(iBlok, &iHodnota))
     {
-      NFC_READER_ALL_DEBUG(TAGin, "Pridavam do zapisu SRecipeInfo strukturu.\n");
-      NFC_WriteStruct(aNFC, aCardInfo, 0);
+      int32_t iZmena = aSend[2] | (aSend[3] << 8) | (aSend[4] << 16) | ((uint32_t)aSend[5] << 24);
+      NFC_Emulator.Transfer = aSend[0] == NFC_CLASSIC_DECREMENT ? iHodnota - iZmena : iHodnota + iZmena;
+      return true;
+    }
+    if (aSend[0] == NFC_CLASSIC_TRANSFER)
+    {
+      NFC_EncodeValueBlock(NFC_Emulator.Transfer, aSend[1], iBlok);
+      return true;
     }
+    return false;
   }
-  else
+  if (NFC_Emulator.TagType != NFC_TAG_ULTRALIGHT || aSendLength < 2 || aSend[1] > 2)
+    return false;
+  uint32_t *iCitac = &NFC_Emulator.Counter[aSend[1]];
+  if (aSend[0] == NFC_UL_READ_CNT && *aResponseLength >= 3)
   {
-    NFC_READER_ALL_DEBUG(TAGin, "CheckSum sedi.\n");
+    aResponse[0] = *iCitac & 0xFF;
+    aResponse[1] = (*iCitac >> 8) & 0xFF;
+    aResponse[2] = (*iCitac >> 16) & 0xFF;
+    *aResponseLength = 3;
+    return true;
   }
-
-  NFC_READER_ALL_DEBUG(TAGin, "Zacatek zapisu: %d, Konec: %d\n", zacatek, konec);
-
-  uint8_t iuid[] = {0, 0, 0, 0, 0, 0, 0}; // Buffer to store the returned UID
-  uint8_t iuidLength;
-  uint8_t PrilozenaKarta = pn532_readPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT);
-  if (PrilozenaKarta == 1)
+  if (aSend[0] == NFC_UL_INCR_CNT && aSendLength >= 6)
   {
-    // NFC MIFARE CLASSIC
-    if (iuidLength == 4)
-    {
+    uint32_t iPridat = aSend[2] | (aSend[3] << 8) | ((uint32_t)aSend[4] << 16);
+    if (iPridat > NFC_UL_COUNTER_MAX - *iCitac)
+      return false;
+    *iCitac += iPridat;
+    *aResponseLength = 0;
+    return true;
+  }
+  return false;
+}
+#endif
 
-      NFC_READER_ALL_DEBUG(TAGin, "NFC classic\n");
+static TNFCTrace *NFC_Trace = NULL;
+static TNFCSpans *NFC_Spans = NULL;
 
-      uint8_t iData[PAGESIZE_CLASSIC];
-      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
-      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
-      for (int i = PrvniBunka; i <= PosledniBunka; ++i)
-      {
-        NFC_READER_ALL_DEBUG(TAGin, "Bunka c.%d:", i);
-        for (size_t k = 0; k < PAGESIZE_CLASSIC; k++)
-        {
+/**************************************************************************/
+/*!
+    @brief  Zahájení úseku časové osy (úsek se ukončí automaticky na konci bloku, viz NFC_SPAN)
 
-          if (i * PAGESIZE_CLASSIC + k < TRecipeInfo_Size)
-          {
-            iData[k] = *(((uint8_t *)&(aCardInfo->sRecipeInfo)) + i * PAGESIZE_CLASSIC + k);
-            NFC_READER_ALL_DEBUG("", "%d ", *(((uint8_t *)&(aCardInfo->sRecipeInfo)) + i * PAGESIZE_CLASSIC + k));
-          }
-          else if (i * PAGESIZE_CLASSIC + k < TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size)
-          {
-            NFC_READER_ALL_DEBUG("", "%d ", *(((uint8_t *)aCardInfo->sRecipeStep) + i * PAGESIZE_CLASSIC + k - TRecipeInfo_Size));
-            iData[k] = *(((uint8_t *)aCardInfo->sRecipeStep) + i * PAGESIZE_CLASSIC + k - TRecipeInfo_Size);
-          }
-          else
-          {
-            iData[k] = 0;
-            NFC_READER_ALL_DEBUG("", "%d ", 0);
-          }
-        }
-        NFC_READER_ALL_DEBUG("", "\n");
+    @param  aName      Název úseku (statický řetězec), NULL - úsek se nezaznamená
 
-        // write
-        size_t index = NFC_GetMifareClassicIndex(i);
-        uint8_t keyuniversal[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-        uint8_t autorizovano = pn532_mifareclassic_AuthenticateBlock(aNFC, iuid, iuidLength, index, 1, keyuniversal);
-        NFC_READER_ALL_DEBUG(TAGin, "autorizovano: %d\n", autorizovano);
-        if (autorizovano)
-        {
-          NFC_READER_ALL_DEBUG("", "data: %d na index: %d\n", i, index);
-          uint8_t Zapsano = pn532_mifareclassic_WriteDataBlock(aNFC, index, iData);
-          NFC_READER_ALL_DEBUG("", "Navratova hodnota: %d\n", Zapsano);
-        }
-        else
-        {
-          NFC_READER_ALL_DEBUG(TAGin, "\nNelze autentifikovat.");
-          return 3;
-        }
-      }
-    }
-    else if ((iuidLength == 7))
-    { // NFC MIFARE ULTRALIGHT
-      uint8_t iData[PAGESIZE_ULTRALIGHT];
-      size_t PrvniBunka = zacatek / PAGESIZE_ULTRALIGHT;
-      size_t PosledniBunka = konec / PAGESIZE_ULTRALIGHT;
-      for (int i = PrvniBunka; i <= PosledniBunka; ++i)
-      {
-        NFC_READER_ALL_DEBUG(TAGin, "Bunka c.%d:", i);
-        for (size_t k = 0; k < PAGESIZE_ULTRALIGHT; k++)
-        {
-
-          if (i * PAGESIZE_ULTRALIGHT + k < TRecipeInfo_Size)
-          {
-            iData[k] = *(((uint8_t *)&(aCardInfo->sRecipeInfo)) + i * PAGESIZE_ULTRALIGHT + k);
-            NFC_READER_ALL_DEBUG("", "%d ", *(((uint8_t *)&(aCardInfo->sRecipeInfo)) + i * PAGESIZE_ULTRALIGHT + k));
-          }
-          else if (i * PAGESIZE_ULTRALIGHT + k < TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size)
-          {
-            NFC_READER_ALL_DEBUG("", "%d ", *(((uint8_t *)aCardInfo->sRecipeStep) + i * PAGESIZE_ULTRALIGHT + k - TRecipeInfo_Size));
-            iData[k] = *(((uint8_t *)aCardInfo->sRecipeStep) + i * PAGESIZE_ULTRALIGHT + k - TRecipeInfo_Size);
-          }
-          else
-          {
-            iData[k] = 0;
-            NFC_READER_ALL_DEBUG("", "%d ", 0);
-          }
-        }
-        NFC_READER_ALL_DEBUG("", "\n");
-        uint8_t Zapsano = pn532_mifareultralight_WritePage(aNFC, i + OFFSETDATA_ULTRALIGHT, iData);
-        NFC_READER_ALL_DEBUG(TAGin, "Zapsano na %d stranu\n", i + OFFSETDATA_ULTRALIGHT);
-      }
-    }
+    @returns Index úseku v bufferu, SIZE_MAX - úsek se nezaznamenává
+*/
+/**************************************************************************/
+static inline size_t NFC_SpanBegin(const char *aName)
+{
+  TNFCSpans *iSpans = NFC_Spans;
+  if (iSpans == NULL || aName == NULL)
+    return SIZE_MAX;
+  size_t iIndex = __atomic_fetch_add(&iSpans->Count, 1, __ATOMIC_RELAXED);
+  if (iIndex >= iSpans->Capacity)
+    return SIZE_MAX;
+  TNFCSpan *iSpan = &iSpans->sSpan[iIndex];
+  iSpan->Name = aName;
+  iSpan->Duration = UINT32_MAX;
+  iSpan->Thread = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+  iSpan->Start = (uint32_t)(esp_timer_get_time() - iSpans->StartTime);
+  return iIndex;
+}
 
-    printf("\n");
-  }
-  else
-  {
-    NFC_READER_DEBUG(TAGin, "Na kartu nelze zapsat\n");
-    return 2;
-  }
+/**************************************************************************/
+/*!
+    @brief  Ukončení úseku časové osy
 
-  return 0;
+    @param  aIndex      Pointer na index úseku z NFC_SpanBegin
+*/
+/**************************************************************************/
+static inline void NFC_SpanEnd(size_t *aIndex)
+{
+  TNFCSpans *iSpans = NFC_Spans;
+  if (*aIndex == SIZE_MAX || iSpans == NULL)
+    return;
+  TNFCSpan *iSpan = &iSpans->sSpan[*aIndex];
+  iSpan->Duration = (uint32_t)(esp_timer_get_time() - iSpans->StartTime) - iSpan->Start;
 }
 
+// Úsek časové osy od místa použití do konce bloku
+#define NFC_SPAN(aName) size_t iSpan __attribute__((cleanup(NFC_SpanEnd), unused)) = NFC_SpanBegin(aName)
+// Úsek časové osy pro opakovaný pokus (první pokus se nezaznamenává)
+#define NFC_SPAN_RETRY(i) NFC_SPAN((i) > 0 ? "retry" : NULL)
+
+#if NFC_READER_EMULATOR_EN
 /**************************************************************************/
 /*!
-    @brief  Zapsaní všech struktur paměti do NFC tagu
+    @brief  Při přehrávání záznamu vrátí rámec se stejnou operací a argumentem (u výběru karty jen operací).
+            Když další rámec neodpovídá (záznam z jiné verze knihovny s jiným pořadím nebo počtem operací),
+            hledá se odpovídající rámec až NFC_TRACE_RESYNC rámců dopředu a přeskočené rámce se započítají.
 
-    @param  aNFC      Pointer na NFC strukturu
-    @param  aCardInfo      aCardInfo struktura
+    @param  aOp      Operace (NFC_TRACE_...)
+    @param  aArg      Argument operace (blok, strana, timeout)
+    @param  aFrame      Pointer, do kterého se uloží rámec záznamu (NULL, pokud se rámec nenašel)
 
-    @returns 0 - Data se na NFC tag zapsala, 2 - Data se nezapsala, 3 - Nelze autentizovat NFC tag, 4 - jina chyba
+    @returns true - Operace se prehrava ze zaznamu, false - Operace se provede na ctecce
 */
 /**************************************************************************/
-uint8_t NFC_WriteAllData(pn532_t *aNFC, TCardInfo *aCardInfo)
+static bool NFC_TraceReplay(uint8_t aOp, uint16_t aArg, TNFCTraceFrame **aFrame)
 {
-  static const char *TAGin = "NFC_WriteAllData";
-  NFC_READER_ALL_DEBUG(TAGin, "Zapisuji na kartu vsechna data\n");
-  uint8_t Error;
-  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  if (NFC_Trace == NULL || NFC_Trace->Mode != NFC_TRACE_REPLAY)
+    return false;
+  *aFrame = NULL;
+  size_t iKonec = NFC_Trace->Position + NFC_TRACE_RESYNC + 1 < NFC_Trace->Count ? NFC_Trace->Position + NFC_TRACE_RESYNC + 1 : NFC_Trace->Count;
+  size_t iPozice = NFC_Trace->Position;
+  for (; iPozice < iKonec; ++iPozice)
   {
-    Error = NFC_WriteStructRange(aNFC, aCardInfo, 0, aCardInfo->sRecipeInfo.RecipeSteps);
-    if (Error == 0)
+    TNFCTraceFrame *iFrame = &NFC_Trace->sFrame[iPozice];
+    if (iFrame->Op == aOp && (aOp == NFC_TRACE_SELECT || aOp == NFC_TRACE_REACTIVATE || iFrame->Arg == aArg))
       break;
   }
-  switch (Error)
+  if (iPozice >= iKonec)
   {
-  case 0:
-    NFC_READER_ALL_DEBUG(TAGin, "Vsechna data do struktury se uspesne zapsala.\n");
-    return 0;
-    break;
-  case 2:
-    NFC_READER_ALL_DEBUG(TAGin, "Data se nezapsala.\n");
-    return 2;
-    break;
-  case 3:
-    NFC_READER_ALL_DEBUG(TAGin, "Nelze autentizovat NFC tag.\n");
-    return 3;
-    break;
-  default:
-    NFC_READER_ALL_DEBUG(TAGin, "Jina chyba.\n");
-    return 4;
-    break;
+    ++NFC_Trace->Mismatches;
+    return true;
   }
-  return 4;
+  NFC_Trace->Skipped += iPozice - NFC_Trace->Position;
+  NFC_Trace->Position = iPozice + 1;
+  *aFrame = &NFC_Trace->sFrame[iPozice];
+  if (NFC_Trace->ReplayTiming && (*aFrame)->Duration >= 1000)
+  {
+    vTaskDelay(pdMS_TO_TICKS((*aFrame)->Duration / 1000));
+  }
+  return true;
 }
+#else
+#define NFC_TraceReplay(aOp, aArg, aFrame) false
+#endif
 
 /**************************************************************************/
 /*!
-    @brief  Převod i pozice na pozici na Mifare Classic čipu na DATA paměťové místa
-
-    @param  i      Původní pozice
-
-    @returns Přepočítaná pozice
+    @brief  Uložení provedené operace do záznamu
+
+    @param  aOp      Operace (NFC_TRACE_...)
+    @param  aArg      Argument operace (blok, strana, timeout)
+    @param  aData      Data operace (max 16 B)
+    @param  aLength      Délka dat
+    @param  aResult      Návratová hodnota operace
+    @param  aStart      Čas začátku operace v us
 */
 /**************************************************************************/
-uint8_t NFC_GetMifareClassicIndex(size_t i)
+static void NFC_TraceRecord(uint8_t aOp, uint16_t aArg, const uint8_t *aData, size_t aLength, uint8_t aResult, int64_t aStart)
 {
-  size_t number = 1 + OFFSETDATA_CLASSIC;
-  for (int k = 0; k < i; ++k)
+  if (NFC_Trace == NULL || NFC_Trace->Mode != NFC_TRACE_RECORD)
+    return;
+  if (NFC_Trace->Count >= NFC_Trace->Capacity)
   {
-    ++number;
-    if (number % 4 == 0)
-    {
-      ++number;
-    }
+    ++NFC_Trace->Dropped;
+    return;
   }
+  TNFCTraceFrame *iFrame = &NFC_Trace->sFrame[NFC_Trace->Count++];
+  memset(iFrame, 0, sizeof(*iFrame));
+  iFrame->Op = aOp;
+  iFrame->Result = aResult;
+  iFrame->Arg = aArg;
+  iFrame->Start = aStart - NFC_Trace->StartTime;
+  iFrame->Duration = esp_timer_get_time() - aStart;
+  memcpy(iFrame->Data, aData, aLength > sizeof(iFrame->Data) ? sizeof(iFrame->Data) : aLength);
+}
 
-  return number - 1;
+/**************************************************************************/
+/*!
+    @brief  Přerušení od výstupu IRQ PN532 (sestupná hrana - ACK nebo odpověď je připravena)
+
+    @param  aArg      Nepoužito
+*/
+/**************************************************************************/
+static void IRAM_ATTR NFC_IrqHandler(void *aArg)
+{
+  (void)aArg;
+  BaseType_t iProbudit = pdFALSE;
+  xSemaphoreGiveFromISR(NFC_IrqSemaphore, &iProbudit);
+  portYIELD_FROM_ISR(iProbudit);
 }
 
 /**************************************************************************/
 /*!
-    @brief  Nacteni vsech dat z NFC tagu do struktury aCardInfo
+    @brief  Čas CPU úlohy čtečky v us, přetéká po 32 bitech (rozdíl dvou hodnot je platný)
 
-    @param  aNFC      Pointer na NFC strukturu
-    @param  aCardInfo      aCardInfo struktura
+    @returns    Cas CPU v us, 0 - Cas CPU neni k dispozici
+*/
+/**************************************************************************/
+static uint32_t NFC_CpuTimeUs(void)
+{
+#if defined(__linux__)
+  struct timespec iCas;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &iCas);
+  return (uint32_t)((int64_t)iCas.tv_sec * 1000000 + iCas.tv_nsec / 1000);
+#elif configGENERATE_RUN_TIME_STATS
+  // Citac behu ulohy FreeRTOS (ESP-IDF ho pocita v us z esp_timer), pricita se pri kazdem prepnuti ulohy
+  return ulTaskGetRunTimeCounter(NULL);
+#else
+  // Bez CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS cas ulohy FreeRTOS nemeri, CommandCpuUs zustane 0
+  return 0;
+#endif
+}
 
-    @returns 0 - Data byla nahrána, 1 - Data nelze nacist/nebyla prilozena karta, 2- Nelze autentizovat NFC Tag, 3 - Nebyla nactena struktura TRecipeInfo, 4 - Nelze Alokovat pole, 5 - Nebylo vytvoreno pole pro data ,20 - Neocekavana chyba
+/**************************************************************************/
+/*!
+    @brief  Začátek měření příkazu PN532 pro statistiky (Commands, CommandTimeUs, CommandCpuUs)
+
+    @returns    Cas zacatku prikazu v us
 */
 /**************************************************************************/
-uint8_t NFC_LoadAllData(pn532_t *aNFC, TCardInfo *aCardInfo)
+static int64_t NFC_CommandStart(void)
 {
-  static const char *TAGin = "NFC_WriteAllData";
-  NFC_READER_DEBUG(TAGin, "Nacitam vsechny data z NFC Tagu\n");
-  if (aCardInfo->TRecipeStepArrayCreated)
-  {
-    NFC_READER_ALL_DEBUG(TAGin, "Uvolnuji pole\n");
-    NFC_DeAllocTRecipeStepArray(aCardInfo);
-  }
-  uint8_t Error = 0;
-  for (int i = 0; i < MAXERRORREADING; ++i)
-  {
-    NFC_InitTCardInfo(aCardInfo);
-    Error = NFC_LoadTRecipeInfoStructure(aNFC, aCardInfo);
-    if (Error == 0)
-    {
-      break;
-    }
-    NFC_READER_DEBUG(TAGin, "Pokousim se znovu nacist TRecipeInfo strukturu.\n");
-  }
-  switch (Error)
-  {
-  case 0:
-    break;
-  case 2:
-    NFC_READER_DEBUG(TAGin, "Data nelze nacist/nebyla prilozena karta.\n");
-    return 1;
-    break;
-  case 3:
-    NFC_READER_DEBUG(TAGin, "Nelze autentizovat NFC Tag.\n");
-    return 2;
-    break;
-  default:
-    NFC_READER_DEBUG(TAGin, "Neocekavana chyba.\n");
-    return 20;
-    break;
-  }
+  NFC_CommandCpu = NFC_CpuTimeUs();
+  return esp_timer_get_time();
+}
 
-  for (int i = 0; i < MAXERRORREADING; ++i)
-  {
-    Error = NFC_AllocTRecipeStepArray(aCardInfo);
-    if (Error == 0)
-    {
-      break;
-    }
-    NFC_DeAllocTRecipeStepArray(aCardInfo);
-    NFC_READER_DEBUG(TAGin, "Pokousim se znovu nacist strukturu.\n");
-  }
-  switch (Error)
-  {
-  case 0:
-    break;
-  case 2:
-    NFC_READER_DEBUG(TAGin, "Nebyla nactena struktura TRecipeInfo.\n");
-    return 3;
-    break;
-  case 3:
-    NFC_READER_DEBUG(TAGin, "Nelze Alokovat pole.\n");
-    return 4;
-    break;
-  default:
-    NFC_READER_DEBUG(TAGin, "Neocekavana chyba.\n");
-    return 20;
-    break;
-  }
+/**************************************************************************/
+/*!
+    @brief  Konec měření příkazu PN532, příkazy emulované karty se nepočítají
 
-  for (int i = 0; i < MAXERRORREADING; ++i)
-  {
-    Error = NFC_LoadTRecipeSteps(aNFC, aCardInfo);
-    if (Error == 0)
-    {
-      break;
-    }
-    NFC_READER_DEBUG(TAGin, "Pokousim se znovu nacist TRecipeSteps strukturu.\n");
-  }
-  switch (Error)
-  {
-  case 0:
-    break;
-  case 2:
-    NFC_READER_DEBUG(TAGin, "Data nelze nacist/nebyla prilozena karta.\n");
-    return 1;
-    break;
-  case 3:
-    NFC_READER_DEBUG(TAGin, "Nelze autentizovat NFC Tag.\n");
-    return 2;
-    break;
-  case 4:
-    NFC_READER_DEBUG(TAGin, "Nebylo vytvoreno pole struktur.\n");
-    return 5;
-    break;
-  default:
-    NFC_READER_DEBUG(TAGin, "Neocekavana chyba.\n");
-    return 20;
-    break;
-  }
-  return 0;
+    @param  aStart      Čas začátku příkazu v us (NFC_CommandStart)
+*/
+/**************************************************************************/
+static void NFC_CommandEnd(int64_t aStart)
+{
+  if (NFC_EMULATOR_ACTIVE)
+    return;
+  ++NFC_Stats.Commands;
+  NFC_Stats.CommandTimeUs += esp_timer_get_time() - aStart;
+  NFC_Stats.CommandCpuUs += (uint32_t)(NFC_CpuTimeUs() - NFC_CommandCpu);
 }
 
 /**************************************************************************/
 /*!
-    @brief  Přečtení struktury TRecipeInfo z NFC tagu
+    @brief  Čekání na odpověď PN532 - s nastaveným IRQ (NFC_SetIrqPin) úloha spí do přerušení,
+            jinak se stav čtečky dotazuje ovladačem pn532. Když přerušení nepřijde, stav se ověří dotazem.
 
     @param  aNFC      Pointer na NFC strukturu
-    @param  aCardInfo      aCardInfo struktura
-
+    @param  aTimeout      Timeout v ms
 
-    @returns 0 - Data se z NFC tag precetla, 2 - Data se neprecetla/nebyla prilozena karta, 3 - Nelze autentizovat NFC tag
+    @returns true - Odpoved je pripravena, false - Timeout
 */
 /**************************************************************************/
-uint8_t NFC_LoadTRecipeInfoStructure(pn532_t *aNFC, TCardInfo *aCardInfo)
+static bool NFC_WaitReady(pn532_t *aNFC, uint16_t aTimeout)
 {
-  static const char *TAGin = "NFC_GetTRecipeInfoStructure";
-  NFC_READER_DEBUG(TAGin, "Nacitam strukturu TRecipeInfo.\n");
-  uint8_t iuid[] = {0, 0, 0, 0, 0, 0, 0}; // Buffer to store the returned UID
-  uint8_t iuidLength;
+  if (NFC_IrqPin < 0)
+    return pn532_waitready(aNFC, aTimeout);
+  ++NFC_Stats.IrqWaits;
+  // Preruseni od ACK se zahodi, pripravena odpoved drzi IRQ v nule i bez nove hrany
+  xSemaphoreTake(NFC_IrqSemaphore, 0);
+  bool iPripraven = gpio_get_level(NFC_IrqPin) == 0 || xSemaphoreTake(NFC_IrqSemaphore, pdMS_TO_TICKS(aTimeout)) == pdTRUE;
+  if (iPripraven)
+    return true;
+  ++NFC_Stats.IrqTimeouts;
+  return pn532_waitready(aNFC, 1);
+}
 
-  uint8_t PrilozenaKarta = pn532_readPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT);
-  if (PrilozenaKarta == 1)
-  {
-    NFC_READER_ALL_DEBUG(TAGin, "Karta byla prilozena.\n");
-    if (iuidLength == 4)
-    {
-      NFC_READER_ALL_DEBUG(TAGin, "NFC classic\n");
-      size_t konec = TRecipeInfo_Size - 1;
-      uint8_t iData[PAGESIZE_CLASSIC];
-      size_t PosledniBunka = (TRecipeInfo_Size - 1) / PAGESIZE_CLASSIC;
-      for (int i = 0; i <= PosledniBunka; ++i)
-      {
-        size_t index = NFC_GetMifareClassicIndex(i);
+/**************************************************************************/
+/*!
+    @brief  Spuštění odložené práce zřetězení
 
-        uint8_t keyuniversal[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-        uint8_t autorizovano = pn532_mifareclassic_AuthenticateBlock(aNFC, iuid, iuidLength, index, 1, keyuniversal);
-        NFC_READER_ALL_DEBUG("", "Autorizovano: %d\n", autorizovano);
-        if (autorizovano)
-        {
-          uint8_t success = pn532_mifareclassic_ReadDataBlock(aNFC, index, iData);
-          if (success)
-          {
-            // Data seems to have been read ... spit it out
-            NFC_READER_ALL_DEBUG(TAGin, "Ctu Block %d: ", i);
-            for (int k = 0; k < PAGESIZE_CLASSIC; ++k)
-            {
-              NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
-            }
-            NFC_READER_ALL_DEBUG("", "\n");
+    @param  aInFlight      true - PN532 právě zpracovává příkaz (práce se překrývá s RF)
+*/
+/**************************************************************************/
+static void NFC_PipelineFlush(bool aInFlight)
+{
+  if (NFC_PipelineWork == NULL)
+    return;
+  void (*iPrace)(void *) = NFC_PipelineWork;
+  NFC_PipelineWork = NULL;
+  NFC_PipelineBuffer = NULL;
+  if (aInFlight)
+    ++NFC_Stats.PipelineOverlaps;
+  iPrace(NFC_PipelineContext);
+}
 
-            for (int k = 0; k < PAGESIZE_CLASSIC; ++k)
-            {
-              if (k + i * PAGESIZE_CLASSIC < TRecipeInfo_Size)
-              {
+/**************************************************************************/
+/*!
+    @brief  Odložení hostitelské práce na dobu zpracování dalšího příkazu PN532, předchozí odložená práce se dokončí
 
-                *(((uint8_t *)&aCardInfo->sRecipeInfo) + k + i * PAGESIZE_CLASSIC) = iData[k];
-                // NFC_READER_ALL_DEBUG("", "%d: %d, ", k, *(((uint8_t *)&aCardInfo->sRecipeInfo) + k + i * PAGESIZE_CLASSIC));
-              }
-              else
-              {
+    @param  aWork      Práce (nesmí posílat příkazy PN532)
+    @param  aContext      Parametr práce
+    @param  aBuffer      Buffer, se kterým práce pracuje (NFC_PipelineRelease), může být NULL
+*/
+/**************************************************************************/
+static void NFC_PipelineSet(void (*aWork)(void *), void *aContext, const void *aBuffer)
+{
+  NFC_PipelineFlush(false);
+  NFC_PipelineWork = aWork;
+  NFC_PipelineContext = aContext;
+  NFC_PipelineBuffer = aBuffer;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Dokončení odložené práce před přepsáním bufferu, se kterým pracuje
+
+    @param  aBuffer      Buffer, který se bude přepisovat
+*/
+/**************************************************************************/
+static void NFC_PipelineRelease(const void *aBuffer)
+{
+  if (NFC_PipelineWork != NULL && NFC_PipelineBuffer == aBuffer)
+    NFC_PipelineFlush(false);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zahození odložené práce po chybě operace
+*/
+/**************************************************************************/
+static void NFC_PipelineCancel(void)
+{
+  NFC_PipelineWork = NULL;
+  NFC_PipelineBuffer = NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Volá přenos (TNFCTransport.Exchange) po potvrzení příkazu, kdy PN532 příkaz zpracovává -
+            spustí se odložená příprava dalšího příkazu
+*/
+/**************************************************************************/
+void NFC_TransportAcked(void)
+{
+  NFC_PipelineFlush(true);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Kontrola rámce odpovědi PN532 (preambule, LEN/LCS, TFI, kód odpovědi, DCS)
+
+    @param  aFrame      Rámec odpovědi od preambule
+    @param  aLength      Počet přečtených bytů rámce
+    @param  aCommand      Kód příkazu
+
+    @returns true - Ramec je platny, false - Neplatny nebo neuplny ramec
+*/
+/**************************************************************************/
+static bool NFC_FrameCheck(const uint8_t *aFrame, size_t aLength, uint8_t aCommand)
+{
+  static const char *TAGin = "NFC_FrameCheck";
+  // b0..2 preambule a start, b3 LEN, b4 LCS, b5 TFI, b6 kod odpovedi, b(5 + LEN) DCS
+  if (aLength < 8 || aFrame[0] != 0x00 || aFrame[1] != 0x00 || aFrame[2] != 0xFF || (uint8_t)(aFrame[3] + aFrame[4]) != 0 ||
+      aFrame[3] < 2 || aLength < aFrame[3] + 6u || aFrame[5] != NFC_PN532_TO_HOST || aFrame[6] != (uint8_t)(aCommand + 1))
+  {
+    NFC_READER_DEBUG(TAGin, "Prikaz %02X: neplatny ramec odpovedi.\n", aCommand);
+    return false;
+  }
+  uint8_t iSoucet = 0;
+  for (size_t i = 0; i <= aFrame[3]; ++i)
+  {
+    iSoucet += aFrame[5 + i];
+  }
+  if (iSoucet != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Prikaz %02X: chybny kontrolni soucet odpovedi.\n", aCommand);
+    return false;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Výměna jednoho příkazu s PN532 přes nastavený přenos - rámec se složí a odpověď zkontroluje v knihovně
+
+    @param  aCommand      Příkaz PN532 (kód příkazu a parametry)
+    @param  aLength      Délka příkazu
+    @param  aResponse      Buffer na rámec odpovědi od preambule (jako pn532_readdata)
+    @param  aResponseSize      Velikost bufferu, nevyužitá část se vynuluje
+    @param  aTimeout      Timeout v ms
+
+    @returns true - Odpoved je platna, false - Chyba prenosu nebo neplatny ramec
+*/
+/**************************************************************************/
+static bool NFC_TransportCommand(const uint8_t *aCommand, uint8_t aLength, uint8_t *aResponse, size_t aResponseSize, uint16_t aTimeout)
+{
+  static const char *TAGin = "NFC_TransportCommand";
+  uint8_t iRamec[NFC_FRAME_MAXSIZE] = {0x00, 0x00, 0xFF, aLength + 1, (uint8_t)(~(aLength + 1) + 1), NFC_HOST_TO_PN532};
+  uint8_t iSoucet = NFC_HOST_TO_PN532;
+  for (size_t i = 0; i < aLength; ++i)
+  {
+    iRamec[6 + i] = aCommand[i];
+    iSoucet += aCommand[i];
+  }
+  iRamec[6 + aLength] = ~iSoucet + 1;
+  iRamec[7 + aLength] = 0x00;
+
+  uint8_t iOdpoved[NFC_FRAME_MAXSIZE];
+  // Prenos cte jen ocekavanou delku ramce (buffer volajiciho a postambule), delsi ramec docte podle LEN
+  size_t iPrijato = aResponseSize + 1 < sizeof(iOdpoved) ? aResponseSize + 1 : sizeof(iOdpoved);
+  int64_t iStart = esp_timer_get_time();
+  bool iResult = NFC_Transport->Exchange(NFC_Transport->Context, iRamec, aLength + 8, iOdpoved, &iPrijato, aTimeout);
+  uint32_t iDoba = (uint32_t)(esp_timer_get_time() - iStart);
+  ++NFC_Stats.TransportExchanges;
+  NFC_Stats.TransportTimeUs += iDoba;
+  if (iDoba > NFC_Stats.TransportMaxUs)
+    NFC_Stats.TransportMaxUs = iDoba;
+  if (!iResult)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Prikaz %02X: chyba prenosu %s.\n", aCommand[0], NFC_Transport->Name);
+    return false;
+  }
+  if (!NFC_FrameCheck(iOdpoved, iPrijato, aCommand[0]))
+    return false;
+  size_t iDelka = iOdpoved[3] + 7u < aResponseSize ? iOdpoved[3] + 7u : aResponseSize;
+  memcpy(aResponse, iOdpoved, iDelka);
+  memset(aResponse + iDelka, 0, aResponseSize - iDelka);
+  return true;
+}
+
+/*!
+Ovladač čtečky - s nastaveným přenosem (NFC_Reader_InitTransport) se příkazy PN532 skládají v knihovně,
+jinak jdou přes ovladač pn532 (SPI na GPIO ESP-IDF)
+*/
+static bool NFC_Command(pn532_t *aNFC, uint8_t *aCommand, uint8_t aLength, uint8_t *aResponse, size_t aResponseSize, uint16_t aTimeout)
+{
+  if (NFC_Transport != NULL)
+    return NFC_TransportCommand(aCommand, aLength, aResponse, aResponseSize, aTimeout);
+  if (!pn532_sendCommandCheckAck(aNFC, aCommand, aLength, aTimeout))
+    return false;
+  NFC_PipelineFlush(true);
+  if (!NFC_WaitReady(aNFC, aTimeout))
+    return false;
+  // Ovladac pn532 cte ramce jen s kratkou delkou a nekontroluje je, ramec se zkontroluje stejne jako u prenosu
+  uint8_t iDelka = aResponseSize < UINT8_MAX ? aResponseSize : UINT8_MAX;
+  pn532_readdata(aNFC, aResponse, iDelka);
+  if (!NFC_FrameCheck(aResponse, iDelka, aCommand[0]))
+    return false;
+  // Za platnym ramcem muze byt z cteni bez pripravenych dat cokoli
+  if (aResponse[3] + 7u < aResponseSize)
+    memset(aResponse + aResponse[3] + 7u, 0, aResponseSize - (aResponse[3] + 7u));
+  return true;
+}
+
+/*!
+Přerušení hledání karty po timeoutu hostitele - bez ACK by PN532 hledal dál a další příkaz by odmítl.
+Ovladač pn532 samostatný ACK rámec skládat neumí, knihovna ho pošle po SPI ovladače jako zápis dat.
+*/
+static void NFC_CommandAbort(pn532_t *aNFC)
+{
+  static const uint8_t Ack[] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+  if (NFC_Transport != NULL)
+  {
+    if (NFC_Transport->Abort != NULL)
+      NFC_Transport->Abort(NFC_Transport->Context);
+    return;
+  }
+  gpio_set_level(aNFC->_ss, 0);
+  vTaskDelay(pdMS_TO_TICKS(2)); // PN532 se po stazeni SS probouzi
+  pn532_spi_write(aNFC, PN532_SPI_DATAWRITE);
+  for (size_t i = 0; i < sizeof(Ack); ++i)
+  {
+    pn532_spi_write(aNFC, Ack[i]);
+  }
+  gpio_set_level(aNFC->_ss, 1);
+}
+
+static bool NFC_DrvDataExchange(pn532_t *aNFC, uint8_t *aSend, uint8_t aSendLength, uint8_t *aResponse, uint8_t *aResponseLength)
+{
+  // InDataExchange se sklada v knihovne i pro ovladac pn532, aby se na dobu RF dala odlozit priprava dalsiho prikazu
+  if (aSendLength > NFC_FRAME_MAXSIZE - 10)
+    return false;
+  uint8_t iPrikaz[NFC_FRAME_MAXSIZE] = {NFC_INDATAEXCHANGE, aNFC->_inListedTag};
+  memcpy(iPrikaz + 2, aSend, aSendLength);
+  // b7 stav, b8.. data odpovedi karty, DCS a postambule - cte se jen ocekavana delka odpovedi
+  uint8_t iOdpoved[NFC_FRAME_MAXSIZE];
+  size_t iOcekavano = 8u + *aResponseLength + 2u < sizeof(iOdpoved) ? 8u + *aResponseLength + 2u : sizeof(iOdpoved);
+  if (!NFC_Command(aNFC, iPrikaz, aSendLength + 2, iOdpoved, iOcekavano, NFC_EXCHANGE_TIMEOUT) || iOdpoved[3] < 3 ||
+      (iOdpoved[7] & 0x3F) != 0)
+    return false;
+  uint8_t iDelka = iOdpoved[3] - 3;
+  if (iDelka > *aResponseLength)
+    iDelka = *aResponseLength;
+  memcpy(aResponse, iOdpoved + 8, iDelka);
+  *aResponseLength = iDelka;
+  return true;
+}
+
+static bool NFC_DrvSAMConfig(pn532_t *aNFC)
+{
+  if (NFC_Transport == NULL)
+    return pn532_SAMConfig(aNFC);
+  // Normalni rezim, timeout 1 s, pouziti IRQ
+  uint8_t iPrikaz[] = {NFC_SAMCONFIGURATION, 0x01, 0x14, 0x01};
+  uint8_t iOdpoved[8];
+  return NFC_TransportCommand(iPrikaz, sizeof(iPrikaz), iOdpoved, sizeof(iOdpoved), TIMEOUTCHECKCARD);
+}
+
+static uint32_t NFC_DrvGetFirmwareVersion(pn532_t *aNFC)
+{
+  if (NFC_Transport == NULL)
+    return pn532_getFirmwareVersion(aNFC);
+  uint8_t iPrikaz[] = {NFC_GETFIRMWAREVERSION};
+  // b7 IC, b8 verze, b9 revize, b10 podporovane protokoly
+  uint8_t iOdpoved[12];
+  if (!NFC_TransportCommand(iPrikaz, sizeof(iPrikaz), iOdpoved, sizeof(iOdpoved), TIMEOUTCHECKCARD))
+    return 0;
+  return ((uint32_t)iOdpoved[7] << 24) | ((uint32_t)iOdpoved[8] << 16) | ((uint32_t)iOdpoved[9] << 8) | iOdpoved[10];
+}
+
+static uint8_t NFC_DrvClassicAuthenticateBlock(pn532_t *aNFC, uint8_t *aUid, uint8_t aUidLength, uint32_t aBlock, uint8_t aKeyNumber, uint8_t *aKey)
+{
+  (void)aUidLength; // Autentizace pouziva posledni 4 B UID, ktere knihovna predava vzdy
+  uint8_t iPrikaz[2 + NFC_KEY_SIZE + 4] = {aKeyNumber ? NFC_CLASSIC_AUTH_B : NFC_CLASSIC_AUTH_A, aBlock};
+  memcpy(iPrikaz + 2, aKey, NFC_KEY_SIZE);
+  memcpy(iPrikaz + 2 + NFC_KEY_SIZE, aUid, 4);
+  uint8_t iDelka = 0;
+  return NFC_DrvDataExchange(aNFC, iPrikaz, sizeof(iPrikaz), NULL, &iDelka);
+}
+
+static uint8_t NFC_DrvClassicReadDataBlock(pn532_t *aNFC, uint8_t aBlock, uint8_t *aData)
+{
+  uint8_t iPrikaz[2] = {NFC_CLASSIC_READ, aBlock};
+  uint8_t iDelka = PAGESIZE_CLASSIC;
+  return NFC_DrvDataExchange(aNFC, iPrikaz, sizeof(iPrikaz), aData, &iDelka) && iDelka == PAGESIZE_CLASSIC;
+}
+
+static uint8_t NFC_DrvClassicWriteDataBlock(pn532_t *aNFC, uint8_t aBlock, uint8_t *aData)
+{
+  uint8_t iPrikaz[2 + PAGESIZE_CLASSIC] = {NFC_CLASSIC_WRITE, aBlock};
+  memcpy(iPrikaz + 2, aData, PAGESIZE_CLASSIC);
+  uint8_t iDelka = 0;
+  return NFC_DrvDataExchange(aNFC, iPrikaz, sizeof(iPrikaz), NULL, &iDelka);
+}
+
+static uint8_t NFC_DrvUltralightReadPage(pn532_t *aNFC, uint8_t aPage, uint8_t *aData)
+{
+  // READ vraci 4 strany (16 B) od zadane strany
+  uint8_t iPrikaz[2] = {NFC_CLASSIC_READ, aPage};
+  uint8_t iDelka = PAGESIZE_CLASSIC;
+  return NFC_DrvDataExchange(aNFC, iPrikaz, sizeof(iPrikaz), aData, &iDelka) && iDelka == PAGESIZE_CLASSIC;
+}
+
+static uint8_t NFC_DrvUltralightWritePage(pn532_t *aNFC, uint8_t aPage, uint8_t *aData)
+{
+  uint8_t iPrikaz[2 + PAGESIZE_ULTRALIGHT] = {NFC_UL_WRITE, aPage};
+  memcpy(iPrikaz + 2, aData, PAGESIZE_ULTRALIGHT);
+  uint8_t iDelka = 0;
+  return NFC_DrvDataExchange(aNFC, iPrikaz, sizeof(iPrikaz), NULL, &iDelka);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Vyhledání FeliCa karty (InListPassiveTarget s příkazem Polling), ovladač PN532 FeliCa neobsluhuje
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aIdm      Buffer o velikosti alespoň 8 B, do kterého se uloží IDm karty
+    @param  aIdmLength      Pointer, do kterého se uloží délka IDm
+    @param  aTimeout      Timeout v ms
+
+    @returns true - Karta se nasla, false - Karta nebyla prilozena
+*/
+/**************************************************************************/
+static bool NFC_FelicaPolling(pn532_t *aNFC, uint8_t *aIdm, uint8_t *aIdmLength, uint16_t aTimeout)
+{
+  // InListPassiveTarget, 1 karta, 212/424 kbps, Polling pro vsechny systemy bez dalsich dat, 1 casovy slot
+  uint8_t iPrikaz[] = {0x4A, 0x01, NFC_Felica.Baud424 ? 0x02 : 0x01, NFC_FELICA_POLLING, 0xFF, 0xFF, 0x00, 0x00};
+  // b0..6 hlavicka ramce, b7 pocet karet, b8 cislo karty, b9 delka odpovedi, b10 kod odpovedi, b11..18 IDm,
+  // b19..26 PMm, b27..28 kod systemu, DCS a postambule
+  uint8_t iOdpoved[31];
+  if (!NFC_Command(aNFC, iPrikaz, sizeof(iPrikaz), iOdpoved, sizeof(iOdpoved), aTimeout))
+  {
+    NFC_CommandAbort(aNFC);
+    return false;
+  }
+  if (iOdpoved[7] != 1 || iOdpoved[10] != NFC_FELICA_POLLING + 1)
+    return false;
+  aNFC->_inListedTag = iOdpoved[8];
+  memcpy(aIdm, iOdpoved + 11, 8);
+  *aIdmLength = 8;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Výběr karty ISO14443A (InListPassiveTarget) s uložením ATQA a SAK do NFC_Target,
+            pn532_readPassiveTargetID je nevrací. Se známým UID se aktivuje jen tato karta bez antikolize.
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardBaudRate      Přenosová rychlost (PN532_MIFARE_ISO14443A)
+    @param  aKnownUid      UID karty, která se má aktivovat (NULL - libovolná karta)
+    @param  aKnownUidLength      Délka známého UID (4 nebo 7)
+    @param  aUid      Buffer o velikosti NFC_UID_MAXSIZE, do kterého se uloží UID
+    @param  aUidLength      Pointer, do kterého se uloží délka UID
+    @param  aTimeout      Timeout v ms
+
+    @returns true - Karta se vybrala, false - Karta nebyla prilozena
+*/
+/**************************************************************************/
+static bool NFC_Iso14443aSelect(pn532_t *aNFC, uint8_t aCardBaudRate, const uint8_t *aKnownUid, uint8_t aKnownUidLength, uint8_t *aUid,
+                                uint8_t *aUidLength, uint16_t aTimeout)
+{
+  uint8_t iPrikaz[3 + 1 + NFC_UID_MAXSIZE] = {0x4A, 0x01, aCardBaudRate};
+  uint8_t iDelka = 3;
+  if (aKnownUid != NULL)
+  {
+    // UID s dvojitou delkou se zadava i s kaskadovym znakem CT
+    if (aKnownUidLength == 7)
+      iPrikaz[iDelka++] = 0x88;
+    memcpy(iPrikaz + iDelka, aKnownUid, aKnownUidLength);
+    iDelka += aKnownUidLength;
+  }
+  // b0..6 hlavicka ramce, b7 pocet karet, b8 cislo karty, b9..10 ATQA, b11 SAK, b12 delka UID, b13.. UID,
+  // u karet ISO14443-4 ATS (PN532 ho zada s FSD 64 B), DCS a postambule
+  uint8_t iOdpoved[13 + NFC_UID_MAXSIZE + 64 + 2];
+  if (!NFC_Command(aNFC, iPrikaz, iDelka, iOdpoved, sizeof(iOdpoved), aTimeout))
+  {
+    NFC_CommandAbort(aNFC);
+    return false;
+  }
+  if (iOdpoved[7] != 1 || iOdpoved[12] == 0 || iOdpoved[12] > NFC_UID_MAXSIZE)
+    return false;
+  NFC_Target.Atqa = (iOdpoved[9] << 8) | iOdpoved[10];
+  NFC_Target.Sak = iOdpoved[11];
+  NFC_Target.Valid = true;
+  aNFC->_inListedTag = iOdpoved[8];
+  memcpy(aUid, iOdpoved + 13, iOdpoved[12]);
+  *aUidLength = iOdpoved[12];
+  return true;
+}
+
+/*!
+Obalové funkce ovladače PN532 - všechny operace se čtečkou jdou přes ně, aby je šlo zaznamenat, přehrát,
+emulovat a vkládat do nich chyby
+*/
+static bool NFC_HwReadPassiveTargetID(pn532_t *aNFC, uint8_t aCardBaudRate, uint8_t *aUid, uint8_t *aUidLength, uint16_t aTimeout)
+{
+  NFC_SPAN(__func__);
+  TNFCTraceFrame *iFrame;
+  NFC_Target.Valid = false;
+  if (NFC_FaultCheck(NFC_TRACE_SELECT) == NFC_FAULT_FAIL)
+    return false;
+  if (NFC_TraceReplay(NFC_TRACE_SELECT, aTimeout, &iFrame))
+  {
+    if (iFrame == NULL || !iFrame->Result)
+      return false;
+    *aUidLength = iFrame->Data[15];
+    memcpy(aUid, iFrame->Data, *aUidLength);
+    NFC_Target.Atqa = (iFrame->Data[12] << 8) | iFrame->Data[13];
+    NFC_Target.Sak = iFrame->Data[14];
+    NFC_Target.Valid = NFC_Target.Atqa != 0;
+    return true;
+  }
+  int64_t iStart = NFC_CommandStart();
+  bool iResult;
+#if NFC_READER_EMULATOR_EN
+  if (NFC_Emulator.Active)
+  {
+    memcpy(aUid, NFC_Emulator.sUid, NFC_Emulator.sUidLength);
+    *aUidLength = NFC_Emulator.sUidLength;
+    NFC_Emulator.IsoDepSelect = 0;
+    // FeliCa karta odpovida jen na Polling, ostatni jen na vyber ISO14443A
+    iResult = (NFC_Emulator.TagType == NFC_TAG_FELICA) == (NFC_TagBackend == NFC_TAG_FELICA);
+    NFC_Target.Valid = NFC_Emulator.TagType != NFC_TAG_FELICA;
+    NFC_Target.Atqa = NFC_Emulator.TagType == NFC_TAG_CLASSIC ? 0x0004 : (NFC_Emulator.TagType == NFC_TAG_ISODEP ? 0x0344 : 0x0044);
+    NFC_Target.Sak = NFC_Emulator.TagType == NFC_TAG_CLASSIC ? 0x08 : (NFC_Emulator.TagType == NFC_TAG_ISODEP ? 0x20 : 0x00);
+  }
+  else
+#endif
+  if (NFC_TagBackend == NFC_TAG_FELICA)
+  {
+    iResult = NFC_FelicaPolling(aNFC, aUid, aUidLength, aTimeout);
+  }
+  else
+  {
+    iResult = NFC_Iso14443aSelect(aNFC, aCardBaudRate, NULL, 0, aUid, aUidLength, aTimeout);
+  }
+  uint8_t iData[16] = {0};
+  if (iResult)
+  {
+    memcpy(iData, aUid, *aUidLength);
+    if (NFC_Target.Valid)
+    {
+      iData[12] = NFC_Target.Atqa >> 8;
+      iData[13] = NFC_Target.Atqa & 0xFF;
+      iData[14] = NFC_Target.Sak;
+    }
+    iData[15] = *aUidLength;
+  }
+  NFC_CommandEnd(iStart);
+  NFC_TraceRecord(NFC_TRACE_SELECT, aTimeout, iData, sizeof(iData), iResult, iStart);
+  return iResult;
+}
+
+static bool NFC_HwReactivate(pn532_t *aNFC, const uint8_t *aUid, uint8_t aUidLength, uint16_t aTimeout)
+{
+  NFC_SPAN(__func__);
+  TNFCTraceFrame *iFrame;
+  if (NFC_FaultCheck(NFC_TRACE_REACTIVATE) == NFC_FAULT_FAIL)
+    return false;
+  if (NFC_TraceReplay(NFC_TRACE_REACTIVATE, aTimeout, &iFrame))
+    return iFrame != NULL && iFrame->Result;
+  int64_t iStart = NFC_CommandStart();
+  bool iResult;
+  uint8_t iuid[NFC_UID_MAXSIZE];
+  uint8_t iuidLength = 0;
+#if NFC_READER_EMULATOR_EN
+  if (NFC_Emulator.Active)
+  {
+    NFC_Emulator.IsoDepSelect = 0;
+    iResult = (NFC_Emulator.TagType == NFC_TAG_FELICA) == (NFC_TagBackend == NFC_TAG_FELICA);
+    memcpy(iuid, NFC_Emulator.sUid, NFC_Emulator.sUidLength);
+    iuidLength = NFC_Emulator.sUidLength;
+  }
+  else
+#endif
+  if (NFC_TagBackend == NFC_TAG_FELICA)
+  {
+    iResult = NFC_FelicaPolling(aNFC, iuid, &iuidLength, aTimeout);
+  }
+  else
+  {
+    iResult = NFC_Iso14443aSelect(aNFC, PN532_MIFARE_ISO14443A, aUid, aUidLength, iuid, &iuidLength, aTimeout);
+  }
+  iResult = iResult && iuidLength == aUidLength && memcmp(iuid, aUid, aUidLength) == 0;
+  uint8_t iData[16] = {0};
+  memcpy(iData, aUid, aUidLength);
+  iData[15] = aUidLength;
+  NFC_CommandEnd(iStart);
+  NFC_TraceRecord(NFC_TRACE_REACTIVATE, aTimeout, iData, sizeof(iData), iResult, iStart);
+  return iResult;
+}
+
+static uint8_t NFC_HwClassicAuthenticateBlock(pn532_t *aNFC, uint8_t *aUid, uint8_t aUidLength, uint32_t aBlock, uint8_t aKeyNumber, uint8_t *aKey)
+{
+  NFC_SPAN(__func__);
+  TNFCTraceFrame *iFrame;
+  if (NFC_FaultCheck(NFC_TRACE_AUTH) == NFC_FAULT_FAIL)
+    return 0;
+  if (NFC_TraceReplay(NFC_TRACE_AUTH, aBlock, &iFrame))
+    return iFrame != NULL ? iFrame->Result : 0;
+  int64_t iStart = NFC_CommandStart();
+  if (aUidLength == 7)
+  {
+    // Mifare Classic EV1 se 7B UID se autentizuje poslednimi 4 byty UID
+    aUid += 3;
+    aUidLength = 4;
+  }
+  uint8_t iResult = NFC_EMULATED(NFC_Emulator.TagType == NFC_TAG_CLASSIC, NFC_DrvClassicAuthenticateBlock(aNFC, aUid, aUidLength, aBlock, aKeyNumber, aKey));
+  NFC_CommandEnd(iStart);
+  NFC_TraceRecord(NFC_TRACE_AUTH, aBlock, aKey, 6, iResult, iStart);
+  return iResult;
+}
+
+static uint8_t NFC_HwClassicReadDataBlock(pn532_t *aNFC, uint8_t aBlock, uint8_t *aData)
+{
+  NFC_SPAN(__func__);
+  TNFCTraceFrame *iFrame;
+  if (NFC_FaultCheck(NFC_TRACE_CLASSIC_READ) == NFC_FAULT_FAIL)
+    return 0;
+  if (NFC_TraceReplay(NFC_TRACE_CLASSIC_READ, aBlock, &iFrame))
+  {
+    if (iFrame == NULL)
+      return 0;
+    memcpy(aData, iFrame->Data, PAGESIZE_CLASSIC);
+    return iFrame->Result;
+  }
+  int64_t iStart = NFC_CommandStart();
+  uint8_t iResult = NFC_EMULATED(NFC_EmulatorAccess(aBlock * PAGESIZE_CLASSIC, aData, PAGESIZE_CLASSIC, false), NFC_DrvClassicReadDataBlock(aNFC, aBlock, aData));
+  NFC_CommandEnd(iStart);
+  NFC_TraceRecord(NFC_TRACE_CLASSIC_READ, aBlock, aData, PAGESIZE_CLASSIC, iResult, iStart);
+  return iResult;
+}
+
+static uint8_t NFC_HwClassicWriteDataBlock(pn532_t *aNFC, uint8_t aBlock, uint8_t *aData)
+{
+  NFC_SPAN(__func__);
+  TNFCTraceFrame *iFrame;
+  uint8_t iFault = NFC_FaultCheck(NFC_TRACE_CLASSIC_WRITE);
+  if (iFault == NFC_FAULT_FAIL)
+    return 0;
+  if (NFC_TraceReplay(NFC_TRACE_CLASSIC_WRITE, aBlock, &iFrame))
+    return iFrame != NULL ? iFrame->Result : 0;
+  uint8_t iBuffer[PAGESIZE_CLASSIC];
+  aData = NFC_FaultWriteData(aData, PAGESIZE_CLASSIC, iBuffer, iFault);
+  int64_t iStart = NFC_CommandStart();
+  uint8_t iResult = NFC_EMULATED(NFC_EmulatorAccess(aBlock * PAGESIZE_CLASSIC, aData, PAGESIZE_CLASSIC, true), NFC_DrvClassicWriteDataBlock(aNFC, aBlock, aData));
+  NFC_CommandEnd(iStart);
+  NFC_TraceRecord(NFC_TRACE_CLASSIC_WRITE, aBlock, aData, PAGESIZE_CLASSIC, iResult, iStart);
+  return iResult;
+}
+
+static uint8_t NFC_HwUltralightReadPage(pn532_t *aNFC, uint8_t aPage, uint8_t *aData)
+{
+  NFC_SPAN(__func__);
+  TNFCTraceFrame *iFrame;
+  if (NFC_FaultCheck(NFC_TRACE_UL_READ) == NFC_FAULT_FAIL)
+    return 0;
+  if (NFC_TraceReplay(NFC_TRACE_UL_READ, aPage, &iFrame))
+  {
+    if (iFrame == NULL)
+      return 0;
+    memcpy(aData, iFrame->Data, PAGESIZE_CLASSIC);
+    return iFrame->Result;
+  }
+  int64_t iStart = NFC_CommandStart();
+  uint8_t iResult = NFC_EMULATED(NFC_EmulatorAccess(aPage * PAGESIZE_ULTRALIGHT, aData, PAGESIZE_CLASSIC, false), NFC_DrvUltralightReadPage(aNFC, aPage, aData));
+  NFC_CommandEnd(iStart);
+  NFC_TraceRecord(NFC_TRACE_UL_READ, aPage, aData, PAGESIZE_CLASSIC, iResult, iStart);
+  return iResult;
+}
+
+static uint8_t NFC_HwUltralightWritePage(pn532_t *aNFC, uint8_t aPage, uint8_t *aData)
+{
+  NFC_SPAN(__func__);
+  TNFCTraceFrame *iFrame;
+  uint8_t iFault = NFC_FaultCheck(NFC_TRACE_UL_WRITE);
+  if (iFault == NFC_FAULT_FAIL)
+    return 0;
+  if (NFC_TraceReplay(NFC_TRACE_UL_WRITE, aPage, &iFrame))
+    return iFrame != NULL ? iFrame->Result : 0;
+  uint8_t iBuffer[PAGESIZE_ULTRALIGHT];
+  aData = NFC_FaultWriteData(aData, PAGESIZE_ULTRALIGHT, iBuffer, iFault);
+  int64_t iStart = NFC_CommandStart();
+  uint8_t iResult = NFC_EMULATED(NFC_EmulatorAccess(aPage * PAGESIZE_ULTRALIGHT, aData, PAGESIZE_ULTRALIGHT, true), NFC_DrvUltralightWritePage(aNFC, aPage, aData));
+  NFC_CommandEnd(iStart);
+  NFC_TraceRecord(NFC_TRACE_UL_WRITE, aPage, aData, PAGESIZE_ULTRALIGHT, iResult, iStart);
+  return iResult;
+}
+
+static bool NFC_HwInDataExchange(pn532_t *aNFC, uint8_t *aSend, uint8_t aSendLength, uint8_t *aResponse, uint8_t *aResponseLength)
+{
+  NFC_SPAN(__func__);
+  TNFCTraceFrame *iFrame;
+  uint16_t iPrikaz = aSend[0] | (aSendLength > 1 ? aSend[1] << 8 : 0);
+  if (NFC_FaultCheck(NFC_TRACE_EXCHANGE) == NFC_FAULT_FAIL)
+    return false;
+  if (NFC_TraceReplay(NFC_TRACE_EXCHANGE, iPrikaz, &iFrame))
+  {
+    if (iFrame == NULL || iFrame->Result == 0 || iFrame->Result - 1 > *aResponseLength)
+      return false;
+    *aResponseLength = iFrame->Result - 1;
+    for (size_t i = 0; i < *aResponseLength; i += sizeof(iFrame->Data))
+    {
+      if (i > 0 && (!NFC_TraceReplay(NFC_TRACE_EXCHANGE_DATA, i, &iFrame) || iFrame == NULL))
+        return false;
+      memcpy(aResponse + i, iFrame->Data, *aResponseLength - i < sizeof(iFrame->Data) ? *aResponseLength - i : sizeof(iFrame->Data));
+    }
+    return true;
+  }
+  int64_t iStart = NFC_CommandStart();
+  bool iResult = NFC_EMULATED(NFC_EmulatorExchange(aSend, aSendLength, aResponse, aResponseLength), NFC_DrvDataExchange(aNFC, aSend, aSendLength, aResponse, aResponseLength));
+  NFC_CommandEnd(iStart);
+  NFC_TraceRecord(NFC_TRACE_EXCHANGE, iPrikaz, aResponse, iResult ? *aResponseLength : 0, iResult ? *aResponseLength + 1 : 0, iStart);
+  // Delsi odpoved (ISO-DEP) se uklada do dalsich ramcu
+  for (size_t i = sizeof(iFrame->Data); iResult && i < *aResponseLength; i += sizeof(iFrame->Data))
+  {
+    NFC_TraceRecord(NFC_TRACE_EXCHANGE_DATA, i, aResponse + i, *aResponseLength - i, 1, iStart);
+  }
+  return iResult;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Rychlé obnovení spojení se známou kartou po chybě (výpadek pole, CRC) - karta se aktivuje
+            přímo podle UID s krátkým timeoutem bez antikolize, aby operace mohla pokračovat od chybného bloku
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID
+
+    @returns true - Karta je znovu aktivni, false - Karta byla odebrana
+*/
+/**************************************************************************/
+static bool NFC_Recover(pn532_t *aNFC, const uint8_t *aUid, uint8_t aUidLength)
+{
+  static const char *TAGin = "NFC_Recover";
+  int64_t iStart = esp_timer_get_time();
+  NFC_Session.AuthSector = -1;
+  for (size_t i = 0; i < NFC_RECOVERY_TRIES; ++i)
+  {
+    if (NFC_HwReactivate(aNFC, aUid, aUidLength, NFC_RECOVERY_TIMEOUT))
+    {
+      ++NFC_Stats.Recoveries;
+      NFC_Stats.RecoveryTimeUs += esp_timer_get_time() - iStart;
+      NFC_READER_ALL_DEBUG(TAGin, "Karta znovu aktivovana.\n");
+      return true;
+    }
+  }
+  ++NFC_Stats.RecoveryFailures;
+  NFC_Stats.RecoveryTimeUs += esp_timer_get_time() - iStart;
+  NFC_READER_ALL_DEBUG(TAGin, "Karta neodpovida.\n");
+  return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sektor Mifare Classic 1K/4K, do kterého patří blok
+
+    @param  aBlock      Index bloku na Mifare Classic čipu
+
+    @returns Číslo sektoru
+*/
+/**************************************************************************/
+static uint8_t NFC_ClassicSector(size_t aBlock)
+{
+  return aBlock < 128 ? aBlock / 4 : 32 + (aBlock - 128) / 16;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Klíč kandidáta pro sektor karty - diverzifikovaný klíč se vezme z cache karty,
+            odvozuje se jen při prvním použití
+
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID
+    @param  aSector      Sektor
+    @param  aCandidate      Index kandidáta
+    @param  aKey      Buffer o velikosti NFC_KEY_SIZE, do kterého se uloží klíč
+    @param  aKeyNumber      Pointer, do kterého se uloží typ klíče (0 - A, 1 - B)
+
+    @returns true - Klic je k dispozici, false - Klic nelze odvodit
+*/
+/**************************************************************************/
+static bool NFC_GetClassicKey(const uint8_t *aUid, uint8_t aUidLength, uint8_t aSector, uint8_t aCandidate, uint8_t *aKey, uint8_t *aKeyNumber)
+{
+  if (NFC_SectorKeyCount[aSector] == 0)
+  {
+    memcpy(aKey, NFC_DefaultKey.Key, NFC_KEY_SIZE);
+    *aKeyNumber = NFC_DefaultKey.KeyNumber;
+    return true;
+  }
+  const TNFCKey *iKandidat = &NFC_SectorKeys[aSector][aCandidate];
+  *aKeyNumber = iKandidat->KeyNumber;
+  if (!iKandidat->Diversify)
+  {
+    memcpy(aKey, iKandidat->Key, NFC_KEY_SIZE);
+    return true;
+  }
+  if (NFC_KeyCache.sUidLength != aUidLength || memcmp(NFC_KeyCache.sUid, aUid, aUidLength) != 0)
+  {
+    memset(NFC_KeyCache.Derived, 0, sizeof(NFC_KeyCache.Derived));
+    memcpy(NFC_KeyCache.sUid, aUid, aUidLength);
+    NFC_KeyCache.sUidLength = aUidLength;
+  }
+  uint8_t *iOdvozeny = NFC_KeyCache.Key[aSector][aCandidate];
+  if (!(NFC_KeyCache.Derived[aSector] & (1 << aCandidate)))
+  {
+    if (NFC_KeyDiversify == NULL || !NFC_KeyDiversify(aUid, aUidLength, aSector, iKandidat->Key, iOdvozeny, NFC_KeyDiversifyContext))
+      return false;
+    NFC_KeyCache.Derived[aSector] |= 1 << aCandidate;
+    ++NFC_Stats.KeyDerivations;
+  }
+  memcpy(aKey, iOdvozeny, NFC_KEY_SIZE);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Autentizace bloku Mifare Classic klíči sektoru (NFC_SetSectorKeys) - nejdřív naposledy úspěšný
+            kandidát, po neúspěchu se karta (v HALT) rychle znovu aktivuje a zkusí se další kandidát
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID
+    @param  aBlock      Index bloku na Mifare Classic čipu
+
+    @returns 1 - Blok je autentizovan, 0 - Zadny klic nepasuje
+*/
+/**************************************************************************/
+static uint8_t NFC_ClassicAuthenticate(pn532_t *aNFC, uint8_t *aUid, uint8_t aUidLength, size_t aBlock)
+{
+  uint8_t iSektor = NFC_ClassicSector(aBlock);
+  uint8_t iPocet = NFC_SectorKeyCount[iSektor] == 0 ? 1 : NFC_SectorKeyCount[iSektor];
+  uint8_t iPrvni = NFC_SectorLastGood[iSektor] < iPocet ? NFC_SectorLastGood[iSektor] : 0;
+  bool iSelhalo = false;
+  for (uint8_t i = 0; i < iPocet; ++i)
+  {
+    uint8_t iKandidat = (iPrvni + i) % iPocet;
+    uint8_t iKlic[NFC_KEY_SIZE];
+    uint8_t iTypKlice;
+    if (!NFC_GetClassicKey(aUid, aUidLength, iSektor, iKandidat, iKlic, &iTypKlice))
+      continue;
+    if (iSelhalo && !NFC_Recover(aNFC, aUid, aUidLength))
+      return 0;
+    if (NFC_HwClassicAuthenticateBlock(aNFC, aUid, aUidLength, aBlock, iTypKlice, iKlic))
+    {
+      NFC_SectorLastGood[iSektor] = iKandidat;
+      return 1;
+    }
+    ++NFC_Stats.KeyMisses;
+    iSelhalo = true;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Čtení nebo zápis autentizovaného bloku Mifare Classic, po chybě se karta rychle znovu aktivuje,
+            autentizuje a operace se opakuje se stejným blokem
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID
+    @param  aBlock      Index bloku na Mifare Classic čipu
+    @param  aData      Data bloku (16 B)
+    @param  aWrite      true - zápis, false - čtení
+
+    @returns 1 - Operace probehla, 0 - Blok nelze precist/zapsat
+*/
+/**************************************************************************/
+static uint8_t NFC_ClassicBlockRecover(pn532_t *aNFC, uint8_t *aUid, uint8_t aUidLength, uint8_t aBlock, uint8_t *aData, bool aWrite)
+{
+  for (size_t i = 0;; ++i)
+  {
+    if (aWrite ? NFC_HwClassicWriteDataBlock(aNFC, aBlock, aData) : NFC_HwClassicReadDataBlock(aNFC, aBlock, aData))
+      return 1;
+    if (i >= NFC_RECOVERY_TRIES || !NFC_Recover(aNFC, aUid, aUidLength) || !NFC_ClassicAuthenticate(aNFC, aUid, aUidLength, aBlock))
+      return 0;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Čtení nebo zápis strany Mifare Ultralight, po chybě se karta rychle znovu aktivuje a operace se opakuje
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID
+    @param  aPage      Číslo strany
+    @param  aData      Data (čtení 16 B, zápis 4 B)
+    @param  aWrite      true - zápis, false - čtení
+
+    @returns 1 - Operace probehla, 0 - Stranu nelze precist/zapsat
+*/
+/**************************************************************************/
+static uint8_t NFC_UltralightPageRecover(pn532_t *aNFC, uint8_t *aUid, uint8_t aUidLength, uint8_t aPage, uint8_t *aData, bool aWrite)
+{
+  for (size_t i = 0;; ++i)
+  {
+    if (aWrite ? NFC_HwUltralightWritePage(aNFC, aPage, aData) : NFC_HwUltralightReadPage(aNFC, aPage, aData))
+      return 1;
+    if (i >= NFC_RECOVERY_TRIES || !NFC_Recover(aNFC, aUid, aUidLength))
+      return 0;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení 24bitového čítače Ultralight EV1/NTAG21x (READ_CNT)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCounter      Číslo čítače (0 - 2)
+    @param  aValue      Pointer, do kterého se uloží hodnota čítače
+
+    @returns true - Citac se precetl, false - Tag citac nema nebo nelze cist
+*/
+/**************************************************************************/
+static bool NFC_ReadCounter(pn532_t *aNFC, uint8_t aCounter, uint32_t *aValue)
+{
+  uint8_t iPrikaz[2] = {NFC_UL_READ_CNT, aCounter};
+  uint8_t iOdpoved[16];
+  uint8_t iDelka = sizeof(iOdpoved);
+  if (!NFC_HwInDataExchange(aNFC, iPrikaz, sizeof(iPrikaz), iOdpoved, &iDelka) || iDelka < 3)
+    return false;
+  *aValue = iOdpoved[0] | (iOdpoved[1] << 8) | ((uint32_t)iOdpoved[2] << 16);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zvýšení 24bitového čítače Ultralight EV1 (INCR_CNT) - operace je odolná proti odtržení karty
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCounter      Číslo čítače (0 - 2)
+    @param  aIncrement      O kolik se čítač zvýší
+
+    @returns true - Karta zvyseni potvrdila, false - Zvyseni se nepotvrdilo
+*/
+/**************************************************************************/
+static bool NFC_IncrementCounter(pn532_t *aNFC, uint8_t aCounter, uint32_t aIncrement)
+{
+  uint8_t iPrikaz[6] = {NFC_UL_INCR_CNT, aCounter, aIncrement & 0xFF, (aIncrement >> 8) & 0xFF, (aIncrement >> 16) & 0xFF, 0};
+  uint8_t iOdpoved[16];
+  uint8_t iDelka = sizeof(iOdpoved);
+  return NFC_HwInDataExchange(aNFC, iPrikaz, sizeof(iPrikaz), iOdpoved, &iDelka);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Vyhledání karty v cache zjištěných typů
+
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID
+
+    @returns Pointer na zaznam karty, NULL - Karta neni v cache
+*/
+/**************************************************************************/
+static TNFCCapability *NFC_CapabilityFind(const uint8_t *aUid, uint8_t aUidLength)
+{
+  for (size_t i = 0; i < NFC_CAPABILITY_CACHE; ++i)
+  {
+    if (NFC_Capability[i].LastUse != 0 && NFC_Capability[i].sUidLength == aUidLength && memcmp(NFC_Capability[i].sUid, aUid, aUidLength) == 0)
+      return &NFC_Capability[i];
+  }
+  return NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zjistí, jestli karta umí čítače Ultralight EV1 (neznámá karta se zkusí)
+
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID
+
+    @returns true - Karta citace ma nebo neni znama, false - Karta citace nema
+*/
+/**************************************************************************/
+static bool NFC_HasCounter(const uint8_t *aUid, uint8_t aUidLength)
+{
+  TNFCCapability *iZaznam = NFC_CapabilityFind(aUid, aUidLength);
+  return iZaznam == NULL || iZaznam->Counter;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Určení typu právě vybrané karty - vynucený typ (NFC_SetTagBackend), jinak z ATQA/SAK výběru,
+            rodina Ultralight/NTAG se upřesní příkazem GET_VERSION. Typ se uloží do cache podle UID,
+            při dalším výběru stejné karty se už nezjišťuje. Bez ATQA/SAK (starší záznam) podle délky UID.
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID
+
+    @returns Typ tagu (NFC_TAG_...), NFC_TAG_UNKNOWN - Nepodporovana karta
+*/
+/**************************************************************************/
+static uint8_t NFC_DetectTagType(pn532_t *aNFC, uint8_t *aUid, uint8_t aUidLength)
+{
+  static const char *TAGin = "NFC_DetectTagType";
+  if (NFC_TagBackend != NFC_TAG_UNKNOWN)
+    return NFC_TagBackend;
+  TNFCCapability *iZaznam = NFC_CapabilityFind(aUid, aUidLength);
+  if (iZaznam != NULL)
+  {
+    iZaznam->LastUse = ++NFC_CapabilityUse;
+    return iZaznam->TagType;
+  }
+  if (!NFC_Target.Valid)
+  {
+    if (aUidLength == 4)
+      return NFC_TAG_CLASSIC;
+    if (aUidLength == 7)
+      return NFC_TAG_ULTRALIGHT;
+    return NFC_TAG_UNKNOWN;
+  }
+
+  uint8_t iTyp = NFC_TAG_UNKNOWN;
+  bool iCitac = false;
+  if (NFC_Target.Sak & 0x08)
+  {
+    // Mifare Classic 1K/4K/Mini vcetne 7B UID a SmartMX s emulaci Classic
+    iTyp = NFC_TAG_CLASSIC;
+  }
+  else if (NFC_Target.Sak & 0x20)
+  {
+    iTyp = NFC_TAG_ISODEP;
+  }
+  else if (NFC_Target.Sak == 0x00 && aUidLength == 7)
+  {
+    iTyp = NFC_TAG_ULTRALIGHT;
+    uint8_t iPrikaz[1] = {NFC_UL_GET_VERSION};
+    uint8_t iVerze[16];
+    uint8_t iDelka = sizeof(iVerze);
+    if (NFC_HwInDataExchange(aNFC, iPrikaz, sizeof(iPrikaz), iVerze, &iDelka) && iDelka >= 8 && iVerze[1] == 0x04)
+    {
+      // Citace se zvysuji jen na Ultralight EV1, NTAG21x ma jen citac cteni NFC
+      iCitac = iVerze[2] == 0x03;
+      NFC_READER_ALL_DEBUG(TAGin, "GET_VERSION: typ %02X, velikost %02X.\n", iVerze[2], iVerze[6]);
+    }
+    else
+    {
+      // Ultralight a Ultralight C GET_VERSION neznaji a prejdou do stavu IDLE
+      uint8_t iuid[NFC_UID_MAXSIZE];
+      uint8_t iuidLength;
+      NFC_HwReadPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT);
+    }
+  }
+  NFC_READER_DEBUG(TAGin, "ATQA %04X, SAK %02X - typ tagu %d.\n", NFC_Target.Atqa, NFC_Target.Sak, iTyp);
+
+  iZaznam = &NFC_Capability[0];
+  for (size_t i = 1; i < NFC_CAPABILITY_CACHE; ++i)
+  {
+    if (NFC_Capability[i].LastUse < iZaznam->LastUse)
+      iZaznam = &NFC_Capability[i];
+  }
+  memcpy(iZaznam->sUid, aUid, aUidLength);
+  iZaznam->sUidLength = aUidLength;
+  iZaznam->TagType = iTyp;
+  iZaznam->Counter = iCitac;
+  iZaznam->LastUse = ++NFC_CapabilityUse;
+  return iTyp;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Odeslání APDU na ISO-DEP kartu, PN532 rozdělí dlouhý rámec na řetězené bloky sám
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aApdu      APDU
+    @param  aLength      Délka APDU
+    @param  aResponse      Buffer odpovědi (včetně místa pro stavové slovo)
+    @param  aResponseLength      Délka bufferu, po návratu délka dat odpovědi bez stavového slova
+
+    @returns 0 - Karta prikaz provedla, 2 - Karta neodpovedela nebo vratila chybu
+*/
+/**************************************************************************/
+static uint8_t NFC_IsoDepTransfer(pn532_t *aNFC, uint8_t *aApdu, uint8_t aLength, uint8_t *aResponse, uint8_t *aResponseLength)
+{
+  static const char *TAGin = "NFC_IsoDepTransfer";
+  if (!NFC_HwInDataExchange(aNFC, aApdu, aLength, aResponse, aResponseLength) || *aResponseLength < 2)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Karta neodpovedela na APDU %02X.\n", aApdu[1]);
+    return 2;
+  }
+  uint16_t iSw = (aResponse[*aResponseLength - 2] << 8) | aResponse[*aResponseLength - 1];
+  if (iSw != NFC_ISODEP_SW_OK)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "APDU %02X skoncilo chybou %04X.\n", aApdu[1], iSw);
+    return 2;
+  }
+  *aResponseLength -= 2;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Výběr aplikace NDEF a souboru s daty na ISO-DEP kartě (po každém výběru karty)
+
+    @param  aNFC      Pointer na NFC strukturu
+
+    @returns 0 - Soubor je vybran, 2 - Aplikaci nebo soubor nelze vybrat
+*/
+/**************************************************************************/
+static uint8_t NFC_IsoDepSelect(pn532_t *aNFC)
+{
+  static const char *TAGin = "NFC_IsoDepSelect";
+  uint8_t iOdpoved[32];
+  uint8_t iDelka = sizeof(iOdpoved);
+  uint8_t iAplikace[5 + sizeof(NFC_IsoDepAid) + 1] = {0x00, 0xA4, 0x04, 0x00, sizeof(NFC_IsoDepAid)};
+  memcpy(iAplikace + 5, NFC_IsoDepAid, sizeof(NFC_IsoDepAid));
+  if (NFC_IsoDepTransfer(aNFC, iAplikace, sizeof(iAplikace), iOdpoved, &iDelka) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze vybrat aplikaci NDEF.\n");
+    return 2;
+  }
+  uint8_t iSoubor[7] = {0x00, 0xA4, 0x00, 0x0C, 0x02, NFC_IsoDepFile >> 8, NFC_IsoDepFile & 0xFF};
+  iDelka = sizeof(iOdpoved);
+  if (NFC_IsoDepTransfer(aNFC, iSoubor, sizeof(iSoubor), iOdpoved, &iDelka) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze vybrat soubor %04X.\n", NFC_IsoDepFile);
+    return 2;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení dat z vybraného souboru ISO-DEP karty (READ BINARY po NFC_ISODEP_CHUNK bytech)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aOffset     Pozice prvního bytu od začátku dat
+    @param  aLength     Počet bytů
+    @param  aData       Výstupní buffer
+
+    @returns 0 - Data se precetla, 2 - Data nelze precist
+*/
+/**************************************************************************/
+static uint8_t NFC_IsoDepRead(pn532_t *aNFC, size_t aOffset, size_t aLength, uint8_t *aData)
+{
+  static const char *TAGin = "NFC_IsoDepRead";
+  uint8_t iOdpoved[NFC_ISODEP_CHUNK + 2];
+  size_t Precteno = 0;
+  while (Precteno < aLength)
+  {
+    size_t iPozice = aOffset + Precteno;
+    uint8_t iDelka = aLength - Precteno > NFC_ISODEP_CHUNK ? NFC_ISODEP_CHUNK : aLength - Precteno;
+    uint8_t iApdu[5] = {0x00, 0xB0, (iPozice >> 8) & 0x7F, iPozice & 0xFF, iDelka};
+    uint8_t iPrijato = sizeof(iOdpoved);
+    if (NFC_IsoDepTransfer(aNFC, iApdu, sizeof(iApdu), iOdpoved, &iPrijato) != 0 || iPrijato != iDelka)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Nelze precist %d B od pozice %zu.\n", iDelka, iPozice);
+      return 2;
+    }
+    memcpy(aData + Precteno, iOdpoved, iDelka);
+    Precteno += iDelka;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zápis dat do vybraného souboru ISO-DEP karty (UPDATE BINARY po NFC_ISODEP_CHUNK bytech)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aOffset     Pozice prvního bytu od začátku dat
+    @param  aLength     Počet bytů
+    @param  aData       Data k zápisu
+
+    @returns 0 - Data se zapsala, 2 - Data se nezapsala
+*/
+/**************************************************************************/
+static uint8_t NFC_IsoDepWrite(pn532_t *aNFC, size_t aOffset, size_t aLength, const uint8_t *aData)
+{
+  static const char *TAGin = "NFC_IsoDepWrite";
+  uint8_t iApdu[5 + NFC_ISODEP_CHUNK];
+  uint8_t iOdpoved[16];
+  size_t Zapsano = 0;
+  while (Zapsano < aLength)
+  {
+    size_t iPozice = aOffset + Zapsano;
+    uint8_t iDelka = aLength - Zapsano > NFC_ISODEP_CHUNK ? NFC_ISODEP_CHUNK : aLength - Zapsano;
+    iApdu[0] = 0x00;
+    iApdu[1] = 0xD6;
+    iApdu[2] = (iPozice >> 8) & 0x7F;
+    iApdu[3] = iPozice & 0xFF;
+    iApdu[4] = iDelka;
+    memcpy(iApdu + 5, aData + Zapsano, iDelka);
+    uint8_t iPrijato = sizeof(iOdpoved);
+    if (NFC_IsoDepTransfer(aNFC, iApdu, 5 + iDelka, iOdpoved, &iPrijato) != 0)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Nelze zapsat %d B od pozice %zu.\n", iDelka, iPozice);
+      return 2;
+    }
+    Zapsano += iDelka;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení 16B bloků FeliCa karty (Read Without Encryption po NFC_Felica.ReadBlocks blocích)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aIdm      IDm karty
+    @param  aBlock      Číslo prvního bloku ve službě
+    @param  aBlocks     Počet bloků
+    @param  aData       Výstupní buffer o velikosti aBlocks * PAGESIZE_CLASSIC
+
+    @returns 0 - Bloky se precetly, 2 - Bloky nelze precist
+*/
+/**************************************************************************/
+static uint8_t NFC_FelicaReadBlocks(pn532_t *aNFC, const uint8_t *aIdm, size_t aBlock, size_t aBlocks, uint8_t *aData)
+{
+  static const char *TAGin = "NFC_FelicaReadBlocks";
+  uint8_t iPrikaz[14 + 2 * NFC_FELICA_MAX_BLOCKS];
+  uint8_t iOdpoved[13 + NFC_FELICA_MAX_BLOCKS * PAGESIZE_CLASSIC];
+  size_t iMax = NFC_Felica.ReadBlocks;
+  for (size_t i = 0; i < aBlocks; i += iMax)
+  {
+    size_t iPocet = aBlocks - i < iMax ? aBlocks - i : iMax;
+    iPrikaz[0] = 14 + 2 * iPocet;
+    iPrikaz[1] = NFC_FELICA_READ;
+    memcpy(iPrikaz + 2, aIdm, 8);
+    iPrikaz[10] = 1;
+    iPrikaz[11] = NFC_Felica.ServiceCode & 0xFF;
+    iPrikaz[12] = NFC_Felica.ServiceCode >> 8;
+    iPrikaz[13] = iPocet;
+    for (size_t k = 0; k < iPocet; ++k)
+    {
+      iPrikaz[14 + 2 * k] = 0x80; // 2B prvek seznamu bloku, sluzba 0
+      iPrikaz[15 + 2 * k] = aBlock + i + k;
+    }
+    uint8_t iDelka = sizeof(iOdpoved);
+    if (!NFC_HwInDataExchange(aNFC, iPrikaz, iPrikaz[0], iOdpoved, &iDelka) || iDelka < 12 || iOdpoved[1] != NFC_FELICA_READ + 1 ||
+        iOdpoved[10] != 0x00 || iDelka < 13 + iPocet * PAGESIZE_CLASSIC || iOdpoved[12] != iPocet)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Nelze precist bloky %zu - %zu (stav %02X %02X).\n", aBlock + i, aBlock + i + iPocet - 1,
+                           iDelka >= 12 ? iOdpoved[10] : 0, iDelka >= 12 ? iOdpoved[11] : 0);
+      return 2;
+    }
+    memcpy(aData + i * PAGESIZE_CLASSIC, iOdpoved + 13, iPocet * PAGESIZE_CLASSIC);
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zápis 16B bloků na FeliCa kartu (Write Without Encryption po NFC_Felica.WriteBlocks blocích)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aIdm      IDm karty
+    @param  aBlock      Číslo prvního bloku ve službě
+    @param  aBlocks     Počet bloků
+    @param  aData       Data o velikosti aBlocks * PAGESIZE_CLASSIC
+
+    @returns 0 - Bloky se zapsaly, 2 - Bloky se nezapsaly
+*/
+/**************************************************************************/
+static uint8_t NFC_FelicaWriteBlocks(pn532_t *aNFC, const uint8_t *aIdm, size_t aBlock, size_t aBlocks, const uint8_t *aData)
+{
+  static const char *TAGin = "NFC_FelicaWriteBlocks";
+  uint8_t iPrikaz[14 + (2 + PAGESIZE_CLASSIC) * NFC_FELICA_MAX_BLOCKS];
+  uint8_t iOdpoved[16];
+  size_t iMax = NFC_Felica.WriteBlocks;
+  for (size_t i = 0; i < aBlocks; i += iMax)
+  {
+    size_t iPocet = aBlocks - i < iMax ? aBlocks - i : iMax;
+    iPrikaz[0] = 14 + (2 + PAGESIZE_CLASSIC) * iPocet;
+    iPrikaz[1] = NFC_FELICA_WRITE;
+    memcpy(iPrikaz + 2, aIdm, 8);
+    iPrikaz[10] = 1;
+    iPrikaz[11] = NFC_Felica.ServiceCode & 0xFF;
+    iPrikaz[12] = NFC_Felica.ServiceCode >> 8;
+    iPrikaz[13] = iPocet;
+    for (size_t k = 0; k < iPocet; ++k)
+    {
+      iPrikaz[14 + 2 * k] = 0x80;
+      iPrikaz[15 + 2 * k] = aBlock + i + k;
+    }
+    memcpy(iPrikaz + 14 + 2 * iPocet, aData + i * PAGESIZE_CLASSIC, iPocet * PAGESIZE_CLASSIC);
+    uint8_t iDelka = sizeof(iOdpoved);
+    if (!NFC_HwInDataExchange(aNFC, iPrikaz, iPrikaz[0], iOdpoved, &iDelka) || iDelka < 12 || iOdpoved[1] != NFC_FELICA_WRITE + 1 ||
+        iOdpoved[10] != 0x00)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Nelze zapsat bloky %zu - %zu (stav %02X %02X).\n", aBlock + i, aBlock + i + iPocet - 1,
+                           iDelka >= 12 ? iOdpoved[10] : 0, iDelka >= 12 ? iOdpoved[11] : 0);
+      return 2;
+    }
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení rozsahu bytů dat z FeliCa karty
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aIdm      IDm karty
+    @param  aOffset     Pozice prvního bytu od začátku dat
+    @param  aLength     Počet bytů
+    @param  aData       Výstupní buffer
+
+    @returns 0 - Data se precetla, 2 - Data nelze precist
+*/
+/**************************************************************************/
+static uint8_t NFC_FelicaReadBytes(pn532_t *aNFC, const uint8_t *aIdm, size_t aOffset, size_t aLength, uint8_t *aData)
+{
+  uint8_t iData[NFC_FELICA_MAX_BLOCKS * PAGESIZE_CLASSIC];
+  size_t Precteno = 0;
+  while (Precteno < aLength)
+  {
+    size_t iBlok = (aOffset + Precteno) / PAGESIZE_CLASSIC;
+    size_t Posun = (aOffset + Precteno) % PAGESIZE_CLASSIC;
+    size_t iPocet = (Posun + aLength - Precteno + PAGESIZE_CLASSIC - 1) / PAGESIZE_CLASSIC;
+    if (iPocet > NFC_Felica.ReadBlocks)
+      iPocet = NFC_Felica.ReadBlocks;
+    if (NFC_FelicaReadBlocks(aNFC, aIdm, iBlok, iPocet, iData) != 0)
+      return 2;
+    size_t Delka = iPocet * PAGESIZE_CLASSIC - Posun;
+    if (Delka > aLength - Precteno)
+      Delka = aLength - Precteno;
+    memcpy(aData + Precteno, iData + Posun, Delka);
+    Precteno += Delka;
+  }
+  return 0;
+}
+
+static void NFC_SessionInvalidateCache(void);
+static void NFC_GetCardInfoBlock(TCardInfo *aCardInfo, size_t aBlock, uint8_t *aData);
+static void NFC_PrepareWriteStep(void *aStep);
+static uint8_t NFC_LoadMissingTRecipeSteps(pn532_t *aNFC, TCardInfo *aCardInfo);
+static uint8_t NFC_VerifyWrite(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd);
+static uint8_t NFC_CompareBytes(pn532_t *aNFC, TCardInfo *aCardInfo, size_t aFrom, size_t aTo, size_t *aBlock);
+static uint8_t NFC_SessionEnsure(pn532_t *aNFC, TCardInfo *aCardInfo);
+static void NFC_SessionAttach(pn532_t *aNFC, const uint8_t *aUid, uint8_t aUidLength, uint8_t aTagType);
+static uint8_t NFC_SessionFoldTransactions(TCardInfo *aCardInfo);
+static uint8_t NFC_MarkTransactionHeader(pn532_t *aNFC, TCardInfo *aCardInfo);
+static bool NFC_IsDirectory(const uint8_t *aData);
+static bool NFC_IsTRecipeStepLoaded(TCardInfo *aCardInfo, size_t NumOfStructure);
+
+/**************************************************************************/
+/*!
+    @brief  Nastavení jedné položky RFConfiguration
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aItem      Položka (NFC_RFCFG_...)
+    @param  aData      Hodnoty položky
+    @param  aLength      Počet hodnot (max. 3)
+
+    @returns true - Ctecka nastaveni potvrdila, false - Chyba komunikace
+*/
+/**************************************************************************/
+static bool NFC_RFConfiguration(pn532_t *aNFC, uint8_t aItem, const uint8_t *aData, uint8_t aLength)
+{
+  uint8_t iPrikaz[5] = {NFC_RFCONFIGURATION, aItem};
+  memcpy(iPrikaz + 2, aData, aLength);
+  uint8_t iOdpoved[8];
+  if (!NFC_Command(aNFC, iPrikaz, 2 + aLength, iOdpoved, sizeof(iOdpoved), TIMEOUTCHECKCARD))
+    return false;
+  return iOdpoved[6] == NFC_RFCONFIGURATION + 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zapsání profilu NFC_RFConfig do čtečky
+
+    @param  aNFC      Pointer na NFC strukturu
+
+    @returns true - Profil se nastavil, false - Chyba komunikace
+*/
+/**************************************************************************/
+static bool NFC_RFConfigApply(pn532_t *aNFC)
+{
+  static const char *TAGin = "NFC_RFConfigApply";
+  uint8_t iPole[1] = {NFC_RFConfig.AutoRfca ? 0x02 : 0x00}; // Pole zapina PN532 samo pri prikazech In*
+  uint8_t iCasy[3] = {0x00, NFC_RFConfig.AtrTimeout, NFC_RFConfig.RetryTimeout};
+  uint8_t iPokusy[3] = {NFC_RFConfig.MaxRetriesAtr, NFC_RFConfig.MaxRetriesPsl, NFC_RFConfig.MaxRetriesPassive};
+  if (!NFC_RFConfiguration(aNFC, NFC_RFCFG_FIELD, iPole, sizeof(iPole)) || !NFC_RFConfiguration(aNFC, NFC_RFCFG_TIMINGS, iCasy, sizeof(iCasy)) ||
+      !NFC_RFConfiguration(aNFC, NFC_RFCFG_RETRIES, iPokusy, sizeof(iPokusy)))
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze nastavit RFConfiguration.\n");
+    return false;
+  }
+  NFC_READER_ALL_DEBUG(TAGin, "Pokusy %d, timeouty %02X/%02X.\n", NFC_RFConfig.MaxRetriesPassive, NFC_RFConfig.AtrTimeout, NFC_RFConfig.RetryTimeout);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Nastavení PN532 po otevření sběrnice. Po softwarovém restartu nebo probuzení z deep sleep se verze
+            firmware nezjišťuje znovu (uložená v RTC paměti), čtečka se jen nastaví. Nastaví se RF profil
+            (NFC_SetRFConfig) a doba inicializace se uloží do statistik (InitTimeUs, BootToReadyUs).
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aStart      Čas začátku inicializace v us
+
+    @returns 0 - NFC ctecka se nainicializovala, 1 - Nelze najít NFC čtečku PN53x, 3 - Ctecka neprijala RF profil
+*/
+/**************************************************************************/
+static uint8_t NFC_ReaderStart(pn532_t *aNFC, int64_t aStart)
+{
+  static const char *TAGin = "NFC_ReaderStart";
+  esp_reset_reason_t iDuvod = esp_reset_reason();
+  bool iTeplyStart = NFC_FirmwareCache.Magic == NFC_FIRMWARE_MAGIC && iDuvod != ESP_RST_POWERON && iDuvod != ESP_RST_BROWNOUT &&
+                     iDuvod != ESP_RST_UNKNOWN;
+  // SAMConfig zaroven overi, ze deska odpovida
+  iTeplyStart = iTeplyStart && NFC_DrvSAMConfig(aNFC);
+  uint32_t versiondata = NFC_FirmwareCache.Version;
+  if (!iTeplyStart)
+  {
+    NFC_FirmwareCache.Magic = 0;
+    versiondata = NFC_DrvGetFirmwareVersion(aNFC);
+    if (!versiondata)
+    {
+      NFC_READER_DEBUG(TAGin, "Nelze najít PN53x desku.\n");
+      return 1;
+    }
+    NFC_DrvSAMConfig(aNFC);
+    NFC_FirmwareCache.Version = versiondata;
+    NFC_FirmwareCache.Magic = NFC_FIRMWARE_MAGIC;
+  }
+  NFC_READER_DEBUG(TAGin, "Našla se deska PN5 %lu%s.\n", (unsigned long)(versiondata >> 24) & 0xFF, iTeplyStart ? " (ulozena verze)" : "");
+  NFC_READER_ALL_DEBUG(TAGin, "Firmware ver. %lu.%lu. \n", (unsigned long)(versiondata >> 16) & 0xFF, (unsigned long)(versiondata >> 8) & 0xFF);
+  if (!NFC_RFConfigApply(aNFC))
+  {
+    NFC_READER_DEBUG(TAGin, "Ctecka neprijala RF profil.\n");
+    return 3;
+  }
+  int64_t iKonec = esp_timer_get_time();
+  NFC_Stats.FirmwareVersion = versiondata;
+  NFC_Stats.WarmStart = iTeplyStart;
+  NFC_Stats.InitTimeUs = (uint32_t)(iKonec - aStart);
+  NFC_Stats.BootToReadyUs = iKonec;
+  NFC_READER_DEBUG(TAGin, "Ctecka pripravena za %lu us (od startu %llu us).\n", (unsigned long)NFC_Stats.InitTimeUs, (unsigned long long)iKonec);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Inicializace PN532 desky na SPI přes GPIO (ovladač pn532)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  clk       CLK GPIO Výstup
+    @param  miso      MISO GPIO Výstup
+    @param  mosi      MOSI GPIO Výstup
+    @param  ss        SS GPIO Výstup
+
+    @returns 0 - NFC ctecka se nainicializovala, 1 - Nelze najít NFC čtečku PN53x, 3 - Ctecka neprijala RF profil
+*/
+/**************************************************************************/
+uint8_t NFC_Reader_Init(pn532_t *aNFC, uint8_t aClk, uint8_t aMiso, uint8_t aMosi, uint8_t aSs)
+{
+  static const char *TAGin = "NFC_Reader_Init";
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Inicializuji NFC ctecku.\n");
+  int64_t iStart = esp_timer_get_time();
+  NFC_Transport = NULL;
+  pn532_spi_init(aNFC, aClk, aMiso, aMosi, aSs);
+  pn532_begin(aNFC);
+  return NFC_ReaderStart(aNFC, iStart);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Inicializace PN532 desky přes vlastní přenos (SPI, I2C, HSU, testovací) - rámce příkazů
+            skládá knihovna a přenos je jen předá čtečce, ovladač pn532 se nepoužije
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aTransport      Přenos (zkopíruje se, Context musí platit po celou dobu používání)
+
+    @returns 0 - NFC ctecka se nainicializovala, 1 - Nelze najít NFC čtečku PN53x, 2 - Neplatny prenos,
+             3 - Ctecka neprijala RF profil
+*/
+/**************************************************************************/
+uint8_t NFC_Reader_InitTransport(pn532_t *aNFC, const TNFCTransport *aTransport)
+{
+  static const char *TAGin = "NFC_Reader_InitTransport";
+  NFC_PrefetchWait();
+  if (aTransport == NULL || aTransport->Exchange == NULL)
+  {
+    NFC_READER_DEBUG(TAGin, "Neplatny prenos.\n");
+    return 2;
+  }
+  NFC_READER_DEBUG(TAGin, "Inicializuji NFC ctecku (%s).\n", aTransport->Name != NULL ? aTransport->Name : "?");
+  int64_t iStart = esp_timer_get_time();
+  NFC_SessionClose();
+  NFC_TransportConfig = *aTransport;
+  NFC_Transport = &NFC_TransportConfig;
+  memset(aNFC, 0, sizeof(*aNFC));
+  return NFC_ReaderStart(aNFC, iStart);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Vypis vsech hodnot co mají být na NFC tagu
+
+    @param  aCardInfo      Pointer na TCardInfo strukturu
+
+*/
+/**************************************************************************/
+void NFC_Print(TCardInfo aCardInfo)
+{
+  NFC_PrefetchWait();
+  printf("\nInfo tagu: ");
+  for (size_t i = 0; i < TRecipeInfo_Size; ++i)
+  {
+    printf("%d ", *(((uint8_t *)&aCardInfo.sRecipeInfo) + i));
+  }
+  if (aCardInfo.sRecipeInfo.RecipeSteps > 0 && aCardInfo.sRecipeStep != NULL)
+  {
+    printf("\nKroky Receptu:");
+    for (int j = 0; j < aCardInfo.sRecipeInfo.RecipeSteps; j++)
+    {
+      printf("\n%d: ", j);
+      for (size_t i = 0; i < TRecipeStep_Size; i++)
+      {
+        printf("%d ", *(((uint8_t *)aCardInfo.sRecipeStep) + j * TRecipeStep_Size + i));
+      }
+    }
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zapsaní jedné struktury paměti do NFC tagu
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+    @param  NumOfStructure Číslo struktury(0- info, 1-end - recipe)
+
+    @returns 0 - Data se na NFC tag zapsala, 1 - NumOfStructure je mimo rozsah, 2 - Data se nezapsala, 3 - Nelze autentizovat NFC tag, 4 - jiná chyba, 5 - Nepodporovany typ karty,
+             6 - Recept je nacten ze zaznamu karty s adresarem
+*/
+/**************************************************************************/
+uint8_t NFC_WriteStruct(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructure)
+{
+  static const char *TAGin = "NFC_WriteStruct";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_ALL_DEBUG(TAGin, "Zapisuji na kartu jednu struktu\n");
+  if (aCardInfo->RecordBlock != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Recept je ze zaznamu karty s adresarem (NFC_WriteRecord).\n");
+    return 6;
+  }
+  uint8_t Error;
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    Error = NFC_WriteStructRange(aNFC, aCardInfo, NumOfStructure, NumOfStructure);
+    if (Error == 0 || Error == 1 || Error == 5)
+      break;
+  }
+  switch (Error)
+  {
+  case 0:
+    NFC_READER_ALL_DEBUG(TAGin, "Data do struktury %d se uspesne zapsala.\n", NumOfStructure);
+    return 0;
+    break;
+  case 1:
+    NFC_READER_ALL_DEBUG(TAGin, "NumOfStructure %d je mimo rozsah.\n", NumOfStructure);
+    return 1;
+    break;
+  case 2:
+    NFC_READER_ALL_DEBUG(TAGin, "Data se nezapsala.\n");
+    return 2;
+    break;
+  case 3:
+    NFC_READER_ALL_DEBUG(TAGin, "Nelze autentizovat NFC tag.\n");
+    return 3;
+    break;
+  case 5:
+    NFC_READER_ALL_DEBUG(TAGin, "Nepodporovany typ karty.\n");
+    return 5;
+    break;
+  default:
+    NFC_READER_ALL_DEBUG(TAGin, "Jina chyba.\n");
+    return 4;
+    break;
+  }
+  return 4;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zapsaní rozsahu struktur paměti do NFC tagu
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+    @param  NumOfStructure Číslo struktury(0- info, 1-end - recipe)
+
+    @returns 0 - Data se na NFC tag zapsala, 1 - NumOfStructure je mimo rozsah, 2 - Data se nezapsala, 3 - Nelze autentizovat NFC tag, 4 - Posledni struktura je mensi jak prvni struktura, 5 - Nepodporovany typ karty,
+             6 - Recept je nacten ze zaznamu karty s adresarem (zapisuje se pres NFC_WriteRecord)
+*/
+/**************************************************************************/
+uint8_t NFC_WriteStructRange(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd)
+{
+  static const char *TAGin = "NFC_WriteStructRange";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Zapisuji na kartu\n");
+  if (aCardInfo->RecordBlock != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Recept je ze zaznamu karty s adresarem (NFC_WriteRecord).\n");
+    return 6;
+  }
+
+  if (NumOfStructureStart > NumOfStructureEnd)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Posledni struktura je mensi jak prvni struktura!\n");
+    return 4;
+  }
+
+  if (NumOfStructureStart > aCardInfo->sRecipeInfo.RecipeSteps || NumOfStructureEnd > aCardInfo->sRecipeInfo.RecipeSteps)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Index je mimo rozsah!!\n");
+    return 1;
+  }
+  NFC_READER_DEBUG(TAGin, "Od indexu: %d do %d.\n", NumOfStructureStart, NumOfStructureEnd);
+
+  size_t zacatek = 0;
+  size_t konec = TRecipeInfo_Size - 1;
+
+  if (NumOfStructureStart > 0)
+  {
+    zacatek = TRecipeInfo_Size + (NumOfStructureStart - 1) * TRecipeStep_Size;
+  }
+  if (NumOfStructureEnd > 0)
+  {
+    konec = TRecipeInfo_Size + (NumOfStructureStart - 1) * TRecipeStep_Size + TRecipeStep_Size * (NumOfStructureEnd - NumOfStructureStart + 1) - 1;
+  }
+
+  if (aCardInfo->TRecipeStepLazy && NFC_LoadMissingTRecipeSteps(aNFC, aCardInfo) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze donacist kroky receptu pro CheckSum.\n");
+    return 2;
+  }
+
+  uint16_t CheckSumNew = NFC_GetCheckSum(*aCardInfo);
+  if (CheckSumNew != aCardInfo->sRecipeInfo.CheckSum)
+  {
+    aCardInfo->sRecipeInfo.CheckSum = CheckSumNew;
+    NFC_READER_ALL_DEBUG(TAGin, "CheckSum se lisi, novy checksum: %d\n", CheckSumNew);
+    if (NumOfStructureStart != 0)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Pridavam do zapisu SRecipeInfo strukturu.\n");
+      NFC_WriteStruct(aNFC, aCardInfo, 0);
+    }
+  }
+  else
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "CheckSum sedi.\n");
+  }
+
+  NFC_READER_ALL_DEBUG(TAGin, "Zacatek zapisu: %zu, Konec: %zu\n", zacatek, konec);
+
+  if (zacatek < TRecipeInfo_Size && NFC_RingBlocks != 0 && NFC_MarkTransactionHeader(aNFC, aCardInfo) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze zapsat zaznam hlavicky do kruhu transakci.\n");
+    return 2;
+  }
+
+  uint8_t iuid[NFC_UID_MAXSIZE] = {0}; // Buffer to store the returned UID
+  uint8_t iuidLength;
+  NFC_SessionInvalidateCache();
+  uint8_t PrilozenaKarta = NFC_HwReadPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT);
+  if (PrilozenaKarta == 1)
+  {
+    uint8_t iTyp = NFC_DetectTagType(aNFC, iuid, iuidLength);
+    if (iTyp == NFC_TAG_ISODEP && NFC_IsoDepSelect(aNFC) != 0)
+      return 2;
+    // Kontrola zapisu (NFC_VerifyWrite) pokracuje s vybranou kartou bez noveho hledani
+    if (iTyp != NFC_TAG_UNKNOWN)
+      NFC_SessionAttach(aNFC, iuid, iuidLength, iTyp);
+    if (iTyp == NFC_TAG_ISODEP)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC ISO-DEP\n");
+      // Cele bloky jako u ostatnich tagu, do jednoho APDU se vejde NFC_ISODEP_CHUNK / 16 bloku
+      uint8_t iData[NFC_ISODEP_CHUNK / PAGESIZE_CLASSIC * PAGESIZE_CLASSIC];
+      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
+      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
+      for (size_t i = PrvniBunka; i <= PosledniBunka; i += sizeof(iData) / PAGESIZE_CLASSIC)
+      {
+        size_t iPocet = PosledniBunka - i + 1;
+        if (iPocet > sizeof(iData) / PAGESIZE_CLASSIC)
+          iPocet = sizeof(iData) / PAGESIZE_CLASSIC;
+        for (size_t k = 0; k < iPocet; ++k)
+        {
+          NFC_GetCardInfoBlock(aCardInfo, i + k, iData + k * PAGESIZE_CLASSIC);
+        }
+        if (NFC_IsoDepWrite(aNFC, i * PAGESIZE_CLASSIC, iPocet * PAGESIZE_CLASSIC, iData) != 0)
+        {
+          NFC_READER_DEBUG(TAGin, "Karta nepotvrdila zapis bloku %zu - %zu.\n", i, i + iPocet - 1);
+          return 2;
+        }
+      }
+    }
+    else if (iTyp == NFC_TAG_FELICA)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC FeliCa\n");
+      uint8_t iData[NFC_FELICA_MAX_BLOCKS * PAGESIZE_CLASSIC];
+      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
+      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
+      for (size_t i = PrvniBunka; i <= PosledniBunka; i += NFC_Felica.WriteBlocks)
+      {
+        size_t iPocet = PosledniBunka - i + 1;
+        if (iPocet > NFC_Felica.WriteBlocks)
+          iPocet = NFC_Felica.WriteBlocks;
+        for (size_t k = 0; k < iPocet; ++k)
+        {
+          NFC_GetCardInfoBlock(aCardInfo, i + k, iData + k * PAGESIZE_CLASSIC);
+        }
+        if (NFC_FelicaWriteBlocks(aNFC, iuid, i, iPocet, iData) != 0)
+        {
+          NFC_READER_DEBUG(TAGin, "Karta nepotvrdila zapis bloku %zu - %zu.\n", i, i + iPocet - 1);
+          return 2;
+        }
+      }
+    }
+    // NFC MIFARE CLASSIC
+    else if (iTyp == NFC_TAG_CLASSIC)
+    {
+
+      NFC_READER_ALL_DEBUG(TAGin, "NFC classic\n");
+
+      uint8_t iData[PAGESIZE_CLASSIC];
+      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
+      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
+      if (NFC_BudgetBlock != 0 && NFC_GetMifareClassicIndex((TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size - 1) / PAGESIZE_CLASSIC) >= NFC_BudgetBlock)
+      {
+        NFC_READER_DEBUG(TAGin, "Recept zasahuje do hodnotoveho bloku %d.\n", NFC_BudgetBlock);
+        return 1;
+      }
+      TNFCWriteStep iKroky[2] = {{.CardInfo = aCardInfo, .Block = PrvniBunka, .Size = PAGESIZE_CLASSIC}};
+      NFC_PrepareWriteStep(&iKroky[0]);
+      int16_t iSektor = -1;
+      for (size_t i = PrvniBunka; i <= PosledniBunka; ++i)
+      {
+        TNFCWriteStep *iKrok = &iKroky[(i - PrvniBunka) % 2];
+        if (i < PosledniBunka)
+        {
+          // Dalsi blok se slozi, zatimco PN532 zapisuje aktualni
+          TNFCWriteStep *iDalsi = &iKroky[(i - PrvniBunka + 1) % 2];
+          *iDalsi = (TNFCWriteStep){.CardInfo = aCardInfo, .Block = i + 1, .Size = PAGESIZE_CLASSIC};
+          NFC_PipelineSet(NFC_PrepareWriteStep, iDalsi, iDalsi->Data);
+        }
+        // Sektor se autentizuje jednou, po chybe zapisu ho znovu autentizuje NFC_ClassicBlockRecover
+        if (NFC_ClassicSector(iKrok->Index) != iSektor)
+        {
+          if (!NFC_ClassicAuthenticate(aNFC, iuid, iuidLength, iKrok->Index))
+          {
+            NFC_PipelineCancel();
+            NFC_READER_ALL_DEBUG(TAGin, "\nNelze autentifikovat.");
+            return 3;
+          }
+          iSektor = NFC_ClassicSector(iKrok->Index);
+        }
+        NFC_READER_ALL_DEBUG("", "data: %zu na index: %d\n", i, iKrok->Index);
+        if (!NFC_ClassicBlockRecover(aNFC, iuid, iuidLength, iKrok->Index, iKrok->Data, true))
+        {
+          NFC_PipelineCancel();
+          NFC_READER_DEBUG(TAGin, "Karta nepotvrdila zapis bloku %d.\n", iKrok->Index);
+          return 2;
+        }
+        NFC_PipelineFlush(false);
+      }
+      if (PrvniBunka == 0 && NFC_BudgetBlock != 0)
+      {
+        // Hodnotovy blok se se zapisem hlavicky jen inicializuje - platnou hodnotu meni jen DECREMENT/INCREMENT
+        int32_t iRozpocet;
+        if (!NFC_ClassicAuthenticate(aNFC, iuid, iuidLength, NFC_BudgetBlock))
+          return 3;
+        if (!NFC_HwClassicReadDataBlock(aNFC, NFC_BudgetBlock, iData))
+        {
+          NFC_READER_DEBUG(TAGin, "Nelze precist hodnotovy blok.\n");
+          return 2;
+        }
+        if (!NFC_DecodeValueBlock(iData, &iRozpocet))
+        {
+          NFC_EncodeValueBlock(aCardInfo->sRecipeInfo.ActualBudget, NFC_BudgetBlock, iData);
+          if (!NFC_HwClassicWriteDataBlock(aNFC, NFC_BudgetBlock, iData))
+          {
+            NFC_READER_DEBUG(TAGin, "Nelze zapsat hodnotovy blok.\n");
+            return 2;
+          }
+        }
+      }
+    }
+    else if (iTyp == NFC_TAG_ULTRALIGHT)
+    { // NFC MIFARE ULTRALIGHT
+      size_t PrvniBunka = zacatek / PAGESIZE_ULTRALIGHT;
+      size_t PosledniBunka = konec / PAGESIZE_ULTRALIGHT;
+      TNFCWriteStep iKroky[2] = {{.CardInfo = aCardInfo, .Block = PrvniBunka, .Size = PAGESIZE_ULTRALIGHT}};
+      NFC_PrepareWriteStep(&iKroky[0]);
+      for (size_t i = PrvniBunka; i <= PosledniBunka; ++i)
+      {
+        TNFCWriteStep *iKrok = &iKroky[(i - PrvniBunka) % 2];
+        if (i < PosledniBunka)
+        {
+          TNFCWriteStep *iDalsi = &iKroky[(i - PrvniBunka + 1) % 2];
+          *iDalsi = (TNFCWriteStep){.CardInfo = aCardInfo, .Block = i + 1, .Size = PAGESIZE_ULTRALIGHT};
+          NFC_PipelineSet(NFC_PrepareWriteStep, iDalsi, iDalsi->Data);
+        }
+        uint8_t Zapsano = NFC_UltralightPageRecover(aNFC, iuid, iuidLength, iKrok->Index, iKrok->Data, true);
+        if (!Zapsano)
+        {
+          NFC_PipelineCancel();
+          NFC_READER_DEBUG(TAGin, "Karta nepotvrdila zapis strany %d.\n", iKrok->Index);
+          return 2;
+        }
+        NFC_PipelineFlush(false);
+        NFC_READER_ALL_DEBUG(TAGin, "Zapsano na %d stranu\n", iKrok->Index);
+      }
+    }
+    else
+    {
+      NFC_READER_DEBUG(TAGin, "Nepodporovany typ karty.\n");
+      return 5;
+    }
+
+    printf("\n");
+  }
+  else
+  {
+    NFC_READER_DEBUG(TAGin, "Na kartu nelze zapsat\n");
+    return 2;
+  }
+
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zapsaní všech struktur paměti do NFC tagu
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+
+    @returns 0 - Data se na NFC tag zapsala, 2 - Data se nezapsala, 3 - Nelze autentizovat NFC tag, 4 - jina chyba, 5 - Nepodporovany typ karty,
+             6 - Recept je nacten ze zaznamu karty s adresarem
+*/
+/**************************************************************************/
+uint8_t NFC_WriteAllData(pn532_t *aNFC, TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_WriteAllData";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_ALL_DEBUG(TAGin, "Zapisuji na kartu vsechna data\n");
+  if (aCardInfo->RecordBlock != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Recept je ze zaznamu karty s adresarem (NFC_WriteRecord).\n");
+    return 6;
+  }
+  uint8_t Error;
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    Error = NFC_WriteStructRange(aNFC, aCardInfo, 0, aCardInfo->sRecipeInfo.RecipeSteps);
+    if (Error == 0 || Error == 5)
+      break;
+  }
+  switch (Error)
+  {
+  case 0:
+    NFC_READER_ALL_DEBUG(TAGin, "Vsechna data do struktury se uspesne zapsala.\n");
+    return 0;
+    break;
+  case 2:
+    NFC_READER_ALL_DEBUG(TAGin, "Data se nezapsala.\n");
+    return 2;
+    break;
+  case 3:
+    NFC_READER_ALL_DEBUG(TAGin, "Nelze autentizovat NFC tag.\n");
+    return 3;
+    break;
+  case 5:
+    NFC_READER_ALL_DEBUG(TAGin, "Nepodporovany typ karty.\n");
+    return 5;
+    break;
+  default:
+    NFC_READER_ALL_DEBUG(TAGin, "Jina chyba.\n");
+    return 4;
+    break;
+  }
+  return 4;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Převod i pozice na pozici na Mifare Classic čipu na DATA paměťové místa
+
+    @param  i      Původní pozice
+
+    @returns Přepočítaná pozice
+*/
+/**************************************************************************/
+uint8_t NFC_GetMifareClassicIndex(size_t i)
+{
+  size_t number = 1 + OFFSETDATA_CLASSIC;
+  for (size_t k = 0; k < i; ++k)
+  {
+    ++number;
+    if (number % 4 == 0)
+    {
+      ++number;
+    }
+  }
+
+  return number - 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Nacteni vsech dat z NFC tagu do struktury aCardInfo
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+
+    @returns 0 - Data byla nahrána, 1 - Data nelze nacist/nebyla prilozena karta, 2- Nelze autentizovat NFC Tag, 3 - Nebyla nactena struktura TRecipeInfo, 4 - Nelze Alokovat pole, 5 - Nebylo vytvoreno pole pro data, 6 - Nepodporovany typ karty,
+             7 - Karta ma adresar zaznamu (NFC_LoadRecord), 20 - Neocekavana chyba
+*/
+/**************************************************************************/
+uint8_t NFC_LoadAllData(pn532_t *aNFC, TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_WriteAllData";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Nacitam vsechny data z NFC Tagu\n");
+  if (aCardInfo->TRecipeStepArrayCreated)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Uvolnuji pole\n");
+    NFC_DeAllocTRecipeStepArray(aCardInfo);
+  }
+  uint8_t Error = 0;
+  for (int i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    NFC_InitTCardInfo(aCardInfo);
+    Error = NFC_LoadTRecipeInfoStructure(aNFC, aCardInfo);
+    if (Error == 0 || Error == 4 || Error == 5)
+    {
+      break;
+    }
+    NFC_READER_DEBUG(TAGin, "Pokousim se znovu nacist TRecipeInfo strukturu.\n");
+  }
+  switch (Error)
+  {
+  case 0:
+    break;
+  case 2:
+    NFC_READER_DEBUG(TAGin, "Data nelze nacist/nebyla prilozena karta.\n");
+    return 1;
+    break;
+  case 3:
+    NFC_READER_DEBUG(TAGin, "Nelze autentizovat NFC Tag.\n");
+    return 2;
+    break;
+  case 4:
+    NFC_READER_DEBUG(TAGin, "Nepodporovany typ karty.\n");
+    return 6;
+    break;
+  case 5:
+    NFC_READER_DEBUG(TAGin, "Karta ma adresar zaznamu.\n");
+    return 7;
+    break;
+  default:
+    NFC_READER_DEBUG(TAGin, "Neocekavana chyba.\n");
+    return 20;
+    break;
+  }
+
+  for (int i = 0; i < MAXERRORREADING; ++i)
+  {
+    Error = NFC_AllocTRecipeStepArray(aCardInfo);
+    if (Error == 0)
+    {
+      break;
+    }
+    NFC_DeAllocTRecipeStepArray(aCardInfo);
+    NFC_READER_DEBUG(TAGin, "Pokousim se znovu nacist strukturu.\n");
+  }
+  switch (Error)
+  {
+  case 0:
+    break;
+  case 2:
+    NFC_READER_DEBUG(TAGin, "Nebyla nactena struktura TRecipeInfo.\n");
+    return 3;
+    break;
+  case 3:
+    NFC_READER_DEBUG(TAGin, "Nelze Alokovat pole.\n");
+    return 4;
+    break;
+  default:
+    NFC_READER_DEBUG(TAGin, "Neocekavana chyba.\n");
+    return 20;
+    break;
+  }
+
+  for (int i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    Error = NFC_LoadTRecipeSteps(aNFC, aCardInfo);
+    if (Error == 0 || Error == 5)
+    {
+      break;
+    }
+    NFC_READER_DEBUG(TAGin, "Pokousim se znovu nacist TRecipeSteps strukturu.\n");
+  }
+  switch (Error)
+  {
+  case 0:
+    break;
+  case 2:
+    NFC_READER_DEBUG(TAGin, "Data nelze nacist/nebyla prilozena karta.\n");
+    return 1;
+    break;
+  case 3:
+    NFC_READER_DEBUG(TAGin, "Nelze autentizovat NFC Tag.\n");
+    return 2;
+    break;
+  case 4:
+    NFC_READER_DEBUG(TAGin, "Nebylo vytvoreno pole struktur.\n");
+    return 5;
+    break;
+  case 5:
+    NFC_READER_DEBUG(TAGin, "Nepodporovany typ karty.\n");
+    return 6;
+    break;
+  default:
+    NFC_READER_DEBUG(TAGin, "Neocekavana chyba.\n");
+    return 20;
+    break;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení struktury TRecipeInfo z NFC tagu
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+
+
+    @returns 0 - Data se z NFC tag precetla, 2 - Data se neprecetla/nebyla prilozena karta, 3 - Nelze autentizovat NFC tag, 4 - Nepodporovany typ karty,
+             5 - Karta ma adresar zaznamu (NFC_LoadRecord)
+*/
+/**************************************************************************/
+uint8_t NFC_LoadTRecipeInfoStructure(pn532_t *aNFC, TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_GetTRecipeInfoStructure";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Nacitam strukturu TRecipeInfo.\n");
+  uint8_t iuid[NFC_UID_MAXSIZE] = {0}; // Buffer to store the returned UID
+  uint8_t iuidLength;
+
+  uint8_t PrilozenaKarta = NFC_HwReadPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT);
+  NFC_Session.AuthSector = -1;
+  if (PrilozenaKarta == 1)
+  {
+    uint8_t iTyp = NFC_DetectTagType(aNFC, iuid, iuidLength);
+    NFC_READER_ALL_DEBUG(TAGin, "Karta byla prilozena.\n");
+    if (iTyp == NFC_TAG_ISODEP)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC ISO-DEP\n");
+      if (NFC_IsoDepSelect(aNFC) != 0 || NFC_IsoDepRead(aNFC, 0, TRecipeInfo_Size, (uint8_t *)&aCardInfo->sRecipeInfo) != 0)
+      {
+        NFC_READER_DEBUG(TAGin, "Nelze precist TRecipeInfo.\n");
+        return 2;
+      }
+    }
+    else if (iTyp == NFC_TAG_FELICA)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC FeliCa\n");
+      if (NFC_FelicaReadBytes(aNFC, iuid, 0, TRecipeInfo_Size, (uint8_t *)&aCardInfo->sRecipeInfo) != 0)
+      {
+        NFC_READER_DEBUG(TAGin, "Nelze precist TRecipeInfo.\n");
+        return 2;
+      }
+    }
+    else if (iTyp == NFC_TAG_CLASSIC)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC classic\n");
+      uint8_t iData[PAGESIZE_CLASSIC];
+      size_t PosledniBunka = (TRecipeInfo_Size - 1) / PAGESIZE_CLASSIC;
+      for (size_t i = 0; i <= PosledniBunka; ++i)
+      {
+        size_t index = NFC_GetMifareClassicIndex(i);
+
+        uint8_t autorizovano = NFC_ClassicAuthenticate(aNFC, iuid, iuidLength, index);
+        NFC_READER_ALL_DEBUG("", "Autorizovano: %d\n", autorizovano);
+        if (autorizovano)
+        {
+          uint8_t success = NFC_ClassicBlockRecover(aNFC, iuid, iuidLength, index, iData, false);
+          if (success)
+          {
+            // Data seems to have been read ... spit it out
+            NFC_READER_ALL_DEBUG(TAGin, "Ctu Block %zu: ", i);
+            for (int k = 0; k < PAGESIZE_CLASSIC; ++k)
+            {
+              NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
+            }
+            NFC_READER_ALL_DEBUG("", "\n");
+
+            for (int k = 0; k < PAGESIZE_CLASSIC; ++k)
+            {
+              if (k + i * PAGESIZE_CLASSIC < TRecipeInfo_Size)
+              {
+
+                *(((uint8_t *)&aCardInfo->sRecipeInfo) + k + i * PAGESIZE_CLASSIC) = iData[k];
+                // NFC_READER_ALL_DEBUG("", "%d: %d, ", k, *(((uint8_t *)&aCardInfo->sRecipeInfo) + k + i * PAGESIZE_CLASSIC));
+              }
+              else
+              {
+                break;
+              }
+            }
+          }
+          else
+          {
+            NFC_READER_DEBUG(TAGin, "Nelze precist. Chyba %d, index: %zu\n", success, index);
+            return 2;
+          }
+        }
+        else
+        {
+          NFC_READER_DEBUG(TAGin, "Nelze autentifikovat.\n");
+          return 3;
+        }
+      }
+      int32_t iRozpocet;
+      if (NFC_BudgetBlock != 0 && NFC_ClassicAuthenticate(aNFC, iuid, iuidLength, NFC_BudgetBlock) &&
+          NFC_HwClassicReadDataBlock(aNFC, NFC_BudgetBlock, iData) && NFC_DecodeValueBlock(iData, &iRozpocet))
+      {
+        NFC_READER_ALL_DEBUG(TAGin, "ActualBudget z hodnotoveho bloku: %ld\n", (long)iRozpocet);
+        aCardInfo->sRecipeInfo.ActualBudget = iRozpocet;
+        aCardInfo->ActualBudgetValueBlock = true;
+      }
+    }
+    else if (iTyp == NFC_TAG_ULTRALIGHT)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC ultralight\n");
+
+      uint8_t iData[16];
+      size_t PosledniBunka = (TRecipeInfo_Size - 1) / 16;
+      for (size_t i = 0; i <= PosledniBunka; ++i)
+      {
+        uint8_t success = NFC_UltralightPageRecover(aNFC, iuid, iuidLength, (i * 4) + OFFSETDATA_ULTRALIGHT, iData, false);
+        if (success)
+        {
+          // Data seems to have been read ... spit it out
+          NFC_READER_ALL_DEBUG(TAGin, "\nCtu Block %zu: ", i);
+          for (int k = 0; k < 16; ++k)
+          {
+            NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
+          }
+          NFC_READER_ALL_DEBUG("", "\n");
+          for (int k = 0; k < 16; ++k)
+          {
+            if (k + i * 16 < TRecipeInfo_Size)
+            {
+              *(((uint8_t *)&aCardInfo->sRecipeInfo) + k + i * 16) = iData[k];
+              // NFC_READER_ALL_DEBUG("", "%d: %d, ", k, *(((uint8_t *)&aCardInfo->sRecipeInfo) + k + i * 16));
+            }
+            else
+            {
+              break;
+            }
+          }
+        }
+        else
+        {
+          NFC_READER_ALL_DEBUG(TAGin, "\nNelze precist. Chyba %d\n", success);
+          return 2;
+        }
+      }
+      uint32_t iPocitadlo;
+      if (NFC_DrinkCounter >= 0 && NFC_HasCounter(iuid, iuidLength) && NFC_ReadCounter(aNFC, NFC_DrinkCounter, &iPocitadlo))
+      {
+        NFC_READER_ALL_DEBUG(TAGin, "NumOfDrinks z citace: %lu\n", (unsigned long)iPocitadlo);
+        aCardInfo->sRecipeInfo.NumOfDrinks = iPocitadlo;
+        aCardInfo->NumOfDrinksCounter = true;
+      }
+    }
+    else
+    {
+      NFC_READER_DEBUG(TAGin, "Nepodporovany typ karty.\n");
+      return 4;
+    }
+  }
+  else
+  {
+    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+    return 2;
+  }
+  if (NFC_IsDirectory((uint8_t *)&aCardInfo->sRecipeInfo))
+  {
+    NFC_READER_DEBUG(TAGin, "Karta ma adresar zaznamu.\n");
+    return 5;
+  }
+  NFC_saveUID(aCardInfo, iuid, iuidLength);
+  if (NFC_RingBlocks != 0 && (NFC_SessionEnsure(aNFC, aCardInfo) != 0 || NFC_SessionFoldTransactions(aCardInfo) != 0))
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze precist kruh transakci.\n");
+    return 2;
+  }
+  aCardInfo->TRecipeInfoLoaded = true;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení všech struktur TRecipeStep z NFC tagu
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+
+
+    @returns 0 - Data se z NFC tag precetla, 2 - Data se neprecetla/nebyla prilozena karta, 3 - Nelze autentizovat NFC tag 4 - Není vytvořeno pole pro pole struktur, 5 - Nepodporovany typ karty,
+             6 - Recept je nacten ze zaznamu karty s adresarem
+*/
+/**************************************************************************/
+uint8_t NFC_LoadTRecipeSteps(pn532_t *aNFC, TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_LoadTRecipeSteps";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Nacitam vsechny strukturu TRecipeSteps.\n");
+  if (aCardInfo->RecordBlock != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Recept je ze zaznamu karty s adresarem (NFC_LoadRecord).\n");
+    return 6;
+  }
+  if (!aCardInfo->TRecipeStepArrayCreated)
+  {
+    NFC_READER_DEBUG(TAGin, "Neni vytvoreno pole pro hodnoty!.\n");
+    return 4;
+  }
+  uint8_t iuid[NFC_UID_MAXSIZE] = {0}; // Buffer to store the returned UID
+  uint8_t iuidLength;
+
+  uint8_t PrilozenaKarta = NFC_HwReadPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT);
+  NFC_Session.AuthSector = -1;
+  if (PrilozenaKarta == 1)
+  {
+    uint8_t iTyp = NFC_DetectTagType(aNFC, iuid, iuidLength);
+    if (iTyp == NFC_TAG_ISODEP)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC ISO-DEP\n");
+      if (NFC_IsoDepSelect(aNFC) != 0 ||
+          NFC_IsoDepRead(aNFC, TRecipeInfo_Size, aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size, (uint8_t *)aCardInfo->sRecipeStep) != 0)
+      {
+        NFC_READER_DEBUG(TAGin, "Nelze precist kroky receptu.\n");
+        return 2;
+      }
+    }
+    else if (iTyp == NFC_TAG_FELICA)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC FeliCa\n");
+      if (NFC_FelicaReadBytes(aNFC, iuid, TRecipeInfo_Size, aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size, (uint8_t *)aCardInfo->sRecipeStep) != 0)
+      {
+        NFC_READER_DEBUG(TAGin, "Nelze precist kroky receptu.\n");
+        return 2;
+      }
+    }
+    else if (iTyp == NFC_TAG_CLASSIC)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC classic\n");
+      size_t zacatek = TRecipeInfo_Size;
+      size_t konec = TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size - 1;
+      uint8_t iData[PAGESIZE_CLASSIC];
+      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
+      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
+      for (size_t i = PrvniBunka; i <= PosledniBunka; ++i)
+      {
+        size_t index = NFC_GetMifareClassicIndex(i);
+
+        uint8_t autorizovano = NFC_ClassicAuthenticate(aNFC, iuid, iuidLength, index);
+        NFC_READER_ALL_DEBUG("", "Autorizovano: %d\n", autorizovano);
+        if (autorizovano)
+        {
+          uint8_t success = NFC_ClassicBlockRecover(aNFC, iuid, iuidLength, index, iData, false);
+          if (success)
+          {
+            // Data seems to have been read ... spit it out
+            NFC_READER_ALL_DEBUG(TAGin, "Ctu Block %zu: ", i);
+            for (int k = 0; k < PAGESIZE_CLASSIC; ++k)
+            {
+              NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
+            }
+            NFC_READER_ALL_DEBUG("", "\n");
+            size_t Propocet = 0;
+            size_t IndexovaPosun = 0;
+            size_t Posun = +zacatek % PAGESIZE_CLASSIC;
+            for (size_t k = 0; k < PAGESIZE_CLASSIC; ++k)
+            {
+              if (k + i * PAGESIZE_CLASSIC < TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size)
+              {
+                Propocet = k;
+                IndexovaPosun = k + (i - PrvniBunka) * PAGESIZE_CLASSIC;
+                if (i == PrvniBunka)
+                {
+                  Propocet += Posun;
+                  if (Propocet == PAGESIZE_CLASSIC)
+                  {
+                    break;
+                  }
+                }
+                else
+                {
+                  IndexovaPosun = IndexovaPosun - Posun;
+                }
+
+                *(((uint8_t *)aCardInfo->sRecipeStep) + IndexovaPosun) = iData[Propocet];
+                // NFC_READER_ALL_DEBUG("", "%d: %p+%d-%d, ", k,aCardInfo->sRecipeStep,IndexovaPosun,iData[Propocet]);
+              }
+              else
+              {
+                break;
+              }
+            }
+          }
+          else
+          {
+            NFC_READER_DEBUG(TAGin, "Nelze precist. Chyba %d, index: %zu\n", success, index);
+            return 2;
+          }
+        }
+        else
+        {
+          NFC_READER_DEBUG(TAGin, "Nelze autentifikovat.\n");
+          return 3;
+        }
+      }
+    }
+    else if (iTyp == NFC_TAG_ULTRALIGHT)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC ultralight\n");
+
+      uint8_t iData[16];
+      size_t zacatek = TRecipeInfo_Size;
+      size_t konec = TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size - 1;
+      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
+      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
+      for (size_t i = PrvniBunka; i <= PosledniBunka; ++i)
+      {
+        uint8_t success = NFC_UltralightPageRecover(aNFC, iuid, iuidLength, (i * 4) + OFFSETDATA_ULTRALIGHT, iData, false);
+        if (success)
+        {
+          // Data seems to have been read ... spit it out
+          NFC_READER_ALL_DEBUG(TAGin, "\nCtu Block %zu: ", i);
+          for (int k = 0; k < 16; ++k)
+          {
+            NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
+          }
+          NFC_READER_ALL_DEBUG("", "\n");
+
+          size_t Propocet = 0;
+          size_t IndexovaPosun = 0;
+          size_t Posun = +zacatek % 16;
+
+          for (int k = 0; k < 16; ++k)
+          {
+            if (k + i * 16 < TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size)
+            {
+              Propocet = k;
+              IndexovaPosun = k + (i - PrvniBunka) * 16;
+              if (i == PrvniBunka)
+              {
+                Propocet += Posun;
+                if (Propocet == 16)
+                {
+                  break;
+                }
+              }
+              else
+              {
+                IndexovaPosun = IndexovaPosun - Posun;
+              }
+
+              *(((uint8_t *)aCardInfo->sRecipeStep) + IndexovaPosun) = iData[Propocet];
+              // NFC_READER_ALL_DEBUG("", "%d: %p+%d-%d, ", k, aCardInfo->sRecipeStep, IndexovaPosun, iData[Propocet]);
+            }
+            else
+            {
+              break;
+            }
+          }
+        }
+        else
+        {
+          NFC_READER_ALL_DEBUG(TAGin, "\nNelze precist. Chyba %d\n", success);
+          return 2;
+        }
+      }
+    }
+    else
+    {
+      NFC_READER_DEBUG(TAGin, "Nepodporovany typ karty.\n");
+      return 5;
+    }
+  }
+  else
+  {
+    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+    return 2;
+  }
+  aCardInfo->TRecipeStepLoaded = true;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení jedne struktur TRecipeStep z NFC tagu
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+    @param  NumOfStructure      aCardInfo struktura od 0 index
+
+    @returns 0 - Data se z NFC tag precetla, 2 - Data se neprecetla/nebyla prilozena karta, 3 - Nelze autentizovat NFC tag 4 - Není vytvořeno pole pro pole struktur, 5 - NumOfStructure je mimo rozsah kroků, 6 - Nepodporovany typ karty,
+             7 - Recept je nacten ze zaznamu karty s adresarem
+*/
+/**************************************************************************/
+uint8_t NFC_LoadTRecipeStep(pn532_t *aNFC, TCardInfo *aCardInfo, size_t NumOfStructure)
+{
+  static const char *TAGin = "NFC_LoadTRecipeStep";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Nacitam jednu strukturu TRecipeSteps.\n");
+  if (aCardInfo->RecordBlock != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Recept je ze zaznamu karty s adresarem (NFC_LoadRecord).\n");
+    return 7;
+  }
+  if (!aCardInfo->TRecipeStepArrayCreated)
+  {
+    NFC_READER_DEBUG(TAGin, "Neni vytvoreno pole pro hodnoty!.\n");
+    return 4;
+  }
+  if (NumOfStructure >= aCardInfo->sRecipeInfo.RecipeSteps)
+  {
+    NFC_READER_DEBUG(TAGin, "NumOfStructure je mimo rozsah kroků!.\n");
+    return 5;
+  }
+  uint8_t iuid[NFC_UID_MAXSIZE] = {0}; // Buffer to store the returned UID
+  uint8_t iuidLength;
+  size_t DataCounter = 0;
+  uint8_t PrilozenaKarta = NFC_HwReadPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT);
+  NFC_Session.AuthSector = -1;
+  if (PrilozenaKarta == 1)
+  {
+    uint8_t iTyp = NFC_DetectTagType(aNFC, iuid, iuidLength);
+    if (iTyp == NFC_TAG_ISODEP)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC ISO-DEP\n");
+      if (NFC_IsoDepSelect(aNFC) != 0 ||
+          NFC_IsoDepRead(aNFC, TRecipeInfo_Size + NumOfStructure * TRecipeStep_Size, TRecipeStep_Size, (uint8_t *)aCardInfo->sRecipeStep + NumOfStructure * TRecipeStep_Size) != 0)
+      {
+        NFC_READER_DEBUG(TAGin, "Nelze precist krok receptu.\n");
+        return 2;
+      }
+    }
+    else if (iTyp == NFC_TAG_FELICA)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC FeliCa\n");
+      if (NFC_FelicaReadBytes(aNFC, iuid, TRecipeInfo_Size + NumOfStructure * TRecipeStep_Size, TRecipeStep_Size,
+                              (uint8_t *)aCardInfo->sRecipeStep + NumOfStructure * TRecipeStep_Size) != 0)
+      {
+        NFC_READER_DEBUG(TAGin, "Nelze precist krok receptu.\n");
+        return 2;
+      }
+    }
+    else if (iTyp == NFC_TAG_CLASSIC)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC classic\n");
+      size_t zacatek = TRecipeInfo_Size + NumOfStructure * TRecipeStep_Size;
+      size_t konec = zacatek + TRecipeStep_Size - 1;
+      uint8_t iData[PAGESIZE_CLASSIC];
+      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
+      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
+      NFC_READER_ALL_DEBUG(TAGin, "PrvniBunka: %zu(%zu), PosledniBunka: %zu(%zu)\n", PrvniBunka, zacatek, PosledniBunka, konec);
+      for (size_t i = PrvniBunka; i <= PosledniBunka; ++i)
+      {
+        size_t index = NFC_GetMifareClassicIndex(i);
+
+        uint8_t autorizovano = NFC_ClassicAuthenticate(aNFC, iuid, iuidLength, index);
+        NFC_READER_ALL_DEBUG("", "Autorizovano: %d\n", autorizovano);
+        if (autorizovano)
+        {
+          uint8_t success = NFC_ClassicBlockRecover(aNFC, iuid, iuidLength, index, iData, false);
+          if (success)
+          {
+            // Data seems to have been read ... spit it out
+            NFC_READER_ALL_DEBUG(TAGin, "Ctu Block %zu: ", i);
+            for (int k = 0; k < PAGESIZE_CLASSIC; ++k)
+            {
+              NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
+            }
+            NFC_READER_ALL_DEBUG("", "\n");
+            size_t Propocet = 0;
+            size_t IndexovaPosun = 0;
+            size_t Posun = +zacatek % PAGESIZE_CLASSIC;
+            for (size_t k = 0; k < PAGESIZE_CLASSIC; ++k)
+            {
+              if (k + i * PAGESIZE_CLASSIC < konec + 1)
+              {
+                Propocet = k;
+                IndexovaPosun = k + (i - PrvniBunka) * PAGESIZE_CLASSIC + (NumOfStructure)*TRecipeStep_Size;
+                if (i == PrvniBunka)
+                {
+                  Propocet += Posun;
+                  if (Propocet == PAGESIZE_CLASSIC)
+                  {
+                    break;
+                  }
+                }
+                else
+                {
+                  IndexovaPosun = IndexovaPosun - Posun;
+                }
+
+                *(((uint8_t *)aCardInfo->sRecipeStep) + IndexovaPosun) = iData[Propocet];
+
+                // NFC_READER_ALL_DEBUG("", "%d: %d-%d, ", k + i * PAGESIZE_CLASSIC, IndexovaPosun, iData[Propocet]);
+                if (++DataCounter == TRecipeStep_Size)
+                {
+                  break;
+                }
+              }
+              else
+              {
                 break;
               }
             }
           }
           else
           {
-            NFC_READER_DEBUG(TAGin, "Nelze precist. Chyba %d, index: %d\n", success, index);
+            NFC_READER_DEBUG(TAGin, "Nelze precist. Chyba %d, index: %zu\n", success, index);
             return 2;
           }
         }
         else
         {
-          NFC_READER_DEBUG(TAGin, "Nelze autentifikovat.\n");
-          return 3;
+          NFC_READER_DEBUG(TAGin, "Nelze autentifikovat.\n");
+          return 3;
+        }
+      }
+    }
+    else if (iTyp == NFC_TAG_ULTRALIGHT)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "NFC ultralight\n");
+
+      uint8_t iData[16];
+      size_t zacatek = TRecipeInfo_Size + NumOfStructure * TRecipeStep_Size;
+      size_t konec = zacatek + TRecipeStep_Size - 1;
+      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
+      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
+      for (size_t i = PrvniBunka; i <= PosledniBunka; ++i)
+      {
+        uint8_t success = NFC_UltralightPageRecover(aNFC, iuid, iuidLength, (i * 4) + OFFSETDATA_ULTRALIGHT, iData, false);
+        if (success)
+        {
+          // Data seems to have been read ... spit it out
+          NFC_READER_ALL_DEBUG(TAGin, "\nCtu Block %zu: ", i);
+          for (int k = 0; k < 16; ++k)
+          {
+            NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
+          }
+          NFC_READER_ALL_DEBUG("", "\n");
+
+          size_t Propocet = 0;
+          size_t IndexovaPosun = 0;
+          size_t Posun = +zacatek % 16;
+
+          for (int k = 0; k < 16; ++k)
+          {
+            if (k + i * 16 < konec + 1)
+            {
+              Propocet = k;
+              IndexovaPosun = k + (i - PrvniBunka) * 16 + NumOfStructure * TRecipeStep_Size;
+              if (i == PrvniBunka)
+              {
+                Propocet += Posun;
+                if (Propocet == 16)
+                {
+                  break;
+                }
+              }
+              else
+              {
+                IndexovaPosun = IndexovaPosun - Posun;
+              }
+
+              *(((uint8_t *)aCardInfo->sRecipeStep) + IndexovaPosun) = iData[Propocet];
+              // NFC_READER_ALL_DEBUG("", "%d: %p+%d-%d, ", k, aCardInfo->sRecipeStep, IndexovaPosun, iData[Propocet]);
+              if (++DataCounter == TRecipeStep_Size)
+              {
+                break;
+              }
+            }
+            else
+            {
+              break;
+            }
+          }
+        }
+        else
+        {
+          NFC_READER_ALL_DEBUG(TAGin, "\nNelze precist. Chyba %d\n", success);
+          return 2;
+        }
+      }
+    }
+    else
+    {
+      NFC_READER_DEBUG(TAGin, "Nepodporovany typ karty.\n");
+      return 6;
+    }
+  }
+  else
+  {
+    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+    return 2;
+  }
+  aCardInfo->TRecipeStepLoaded = true;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Alokace pole pro strukturu TRecipeStep
+
+
+    @param  aCardInfo      aCardInfo struktura
+
+
+    @returns 0 - Pole se vytvořilo, 1 - Pole je již vytvořeno, 2 - Nebyla načtena struktura TRecipeInfo, 3 - Nelze alokovat pole
+*/
+/**************************************************************************/
+uint8_t NFC_AllocTRecipeStepArray(TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_AllocTRecipeStepArray";
+  NFC_PrefetchWait();
+  NFC_READER_ALL_DEBUG(TAGin, "Alokuji TRecipeStep\n");
+  if (!aCardInfo->TRecipeInfoLoaded)
+  {
+    NFC_READER_DEBUG(TAGin, "Nebyla nactena TRecipeInfo struktura.\n");
+    return 2;
+  }
+  if (aCardInfo->TRecipeStepArrayCreated)
+  {
+    NFC_READER_DEBUG(TAGin, "Pole pro TRecipeStepArray je jiz vytvoreno.\n");
+    return 1;
+  }
+  aCardInfo->sRecipeStep = (TRecipeStep *)malloc(TRecipeStep_Size * aCardInfo->sRecipeInfo.RecipeSteps);
+  if (!aCardInfo->sRecipeStep)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze vytvorit pole dat.\n");
+    return 3;
+  }
+  NFC_READER_ALL_DEBUG(TAGin, "Pole bylo vytvoreno.\n");
+  aCardInfo->TRecipeStepArrayCreated = true;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Dealokování pole pro strukturu TRecipeStep
+
+
+    @param  aCardInfo      aCardInfo struktura
+
+
+    @returns 0 - Pole se dealokovalo, 1 - Pole je již null
+*/
+/**************************************************************************/
+uint8_t NFC_DeAllocTRecipeStepArray(TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_DeAllocTRecipeStepArray";
+  NFC_PrefetchWait();
+  NFC_READER_ALL_DEBUG(TAGin, "Odalokovavam TRecipeStep\n");
+  if ((aCardInfo->sRecipeStep) == NULL)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "TRecipeStep je již null\n");
+    return 1;
+  }
+  free(aCardInfo->sRecipeStep);
+  aCardInfo->sRecipeStep = NULL;
+  aCardInfo->TRecipeStepArrayCreated = aCardInfo->TRecipeStepLoaded = aCardInfo->TRecipeStepLazy = false;
+  memset(aCardInfo->sRecipeStepLoadedMask, 0, sizeof(aCardInfo->sRecipeStepLoadedMask));
+  NFC_READER_ALL_DEBUG(TAGin, "Pole se odalokovalo\n");
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Nainicializovani hodnot aCardInfo
+
+
+    @param  aCardInfo      aCardInfo struktura
+
+*/
+/**************************************************************************/
+void NFC_InitTCardInfo(TCardInfo *aCardInfo)
+{
+  NFC_PrefetchWait();
+  aCardInfo->sRecipeStep = NULL;
+  aCardInfo->TRecipeInfoLoaded = aCardInfo->TRecipeStepArrayCreated = aCardInfo->TRecipeStepLoaded = aCardInfo->TRecipeStepLazy = false;
+  aCardInfo->NumOfDrinksCounter = aCardInfo->ActualBudgetValueBlock = aCardInfo->TransactionRing = false;
+  aCardInfo->TransactionSequence = 0;
+  aCardInfo->TransactionSlot = 0;
+  aCardInfo->RecordBlock = 0;
+  memset(aCardInfo->sRecipeStepLoadedMask, 0, sizeof(aCardInfo->sRecipeStepLoadedMask));
+  aCardInfo->sUidLength = 7;
+  for (size_t i = 0; i < aCardInfo->sUidLength; ++i)
+  {
+    aCardInfo->sUid[i] = 0;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ověří jestli je karta přítomna na čtečce
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo Pointer na TCardInfo strukturu
+
+    @returns    true - Pokud je přítomna, false - Pokud neni přitomna
+*/
+/**************************************************************************/
+bool NFC_isCardReady(pn532_t *aNFC)
+{
+  static const char *TAGin = "NFC_isCardReadyToRead";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  uint8_t iuid[NFC_UID_MAXSIZE] = {0};
+  uint8_t iuidLength;
+  NFC_READER_ALL_DEBUG(TAGin, "Zkousím jestli je karta přítomna.\n");
+  bool iStatus = NFC_HwReadPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, TIMEOUTCHECKCARD);
+  if (iStatus)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Je pritomna.\n");
+  }
+  else
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Neni pritomna.\n");
+  }
+  return iStatus;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Získá UID a délku UID karty
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aUid      Pointer na Uid pole
+     @param  aUidLength      Pointer na Uid délku
+
+    @returns    true - Pokud se správně načetlo, false - Pokud se špatně načetlo
+*/
+/**************************************************************************/
+bool NFC_getUID(pn532_t *aNFC, uint8_t *aUid, uint8_t *aUidLength)
+{
+  static const char *TAGin = "NFC_getUID";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_ALL_DEBUG(TAGin, "Ziskavam UID.\n");
+  bool iSuccess = NFC_HwReadPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, aUid, aUidLength, MAXTIMEOUT);
+  if (!iSuccess)
+    return false;
+  NFC_READER_ALL_DEBUG(TAGin, "UID se nacetlo: ");
+  for (size_t i = 0; i < *aUidLength; i++)
+  {
+    NFC_READER_ALL_DEBUG("", "%x ", aUid[i]);
+  }
+  NFC_READER_ALL_DEBUG("", ", s delkou: %d. \n", *aUidLength);
+  return true;
+}
+/**************************************************************************/
+/*!
+    @brief  Uloží UID a délku UID do TCardInfo struktury
+
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  aUid      Pointer na Uid pole
+     @param  aUidLength      Délka UID
+
+    @returns    true - Pokud se správně uložilo, false - Pokud se stala chyba při ukládání
+*/
+/**************************************************************************/
+bool NFC_saveUID(TCardInfo *aCardInfo, uint8_t *aUid, uint8_t aUidLength)
+{
+  static const char *TAGin = "NFC_saveUID";
+  if (aUidLength > NFC_UID_MAXSIZE)
+  {
+    NFC_READER_DEBUG(TAGin, "UID je delsi nez %d B.\n", NFC_UID_MAXSIZE);
+    return false;
+  }
+  NFC_READER_ALL_DEBUG(TAGin, "Ukladam UID:");
+  for (size_t i = 0; i < aUidLength; i++)
+  {
+    aCardInfo->sUid[i] = aUid[i];
+    NFC_READER_ALL_DEBUG("", "%x ", aCardInfo->sUid[i]);
+  }
+  NFC_READER_ALL_DEBUG("", ", s delkou: %d. \n", aUidLength);
+  aCardInfo->sUidLength = aUidLength;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zkontroluje jestli struktura TRecipeStep je stejná v zařízení jak v NFC čipu
+
+    @param  aNFC      Pointer na NFC
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  anumOfNFCStruct Číslo struktury(0- info, 1-end - recipe)
+
+    @returns 0 - Pokud se Data načetla a jsou stejna, 1 - Pokud se struktura liší, 2 - Pokud je anumOfNFCStruct mimo rozsah,3 - Nelze cist z karty, 5 - NumOfStructureStart je vetsi jak NumOfStructureEnd, 6 - Nenactene informace o aCardInfo,
+             7 - Recept je nacten ze zaznamu karty s adresarem
+*/
+/**************************************************************************/
+uint8_t NFC_CheckStructArrayIsSame(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd)
+{
+  static const char *TAGin = "NFC_CheckStructArrayIsSame";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Porovnavam data v rozsahu %d - %d.\n", NumOfStructureStart, NumOfStructureEnd);
+  size_t iBlok;
+  uint8_t Error = NFC_FindDifferentBlock(aNFC, aCardInfo, NumOfStructureStart, NumOfStructureEnd, &iBlok);
+  if (Error == 1)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Blok %zu se lisi.\n", iBlok);
+  }
+  else if (Error == 0)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Cely rozsah je stejny.\n");
+  }
+  return Error;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Porovnání rozsahu struktur s kartou bez alokace - bloky karty se čtou jednou v jedné relaci přes 16B buffer
+            a porovnávají se s TCardInfo strukturou, porovná se celý rozsah (rozdílné bloky vypíše NFC_CompareBytes)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  NumOfStructureStart Číslo 1. struktury(0- info, 1-end - recipe)
+    @param  NumOfStructureEnd Číslo poslední struktury(0- info, 1-end - recipe)
+    @param  aBlock      Pointer, do kterého se uloží číslo prvního rozdílného 16B bloku (může být NULL)
+
+    @returns Stejne navratove hodnoty jako NFC_CheckStructArrayIsSame
+*/
+/**************************************************************************/
+uint8_t NFC_FindDifferentBlock(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd, size_t *aBlock)
+{
+  static const char *TAGin = "NFC_FindDifferentBlock";
+  NFC_PrefetchWait();
+  if (NumOfStructureStart > NumOfStructureEnd)
+  {
+    NFC_READER_DEBUG(TAGin, "Startovni index je vetsi jak konecny!");
+    return 5;
+  }
+  if (NumOfStructureStart > aCardInfo->sRecipeInfo.RecipeSteps || NumOfStructureEnd > aCardInfo->sRecipeInfo.RecipeSteps)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Index je mimo rozsah!!\n");
+    return 2;
+  }
+  if (aCardInfo->TRecipeInfoLoaded != true)
+  {
+    NFC_READER_DEBUG(TAGin, "Nenactene info o sklenici!!\n");
+    return 6;
+  }
+  if (aCardInfo->RecordBlock != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Recept je ze zaznamu karty s adresarem .\n");
+    return 7;
+  }
+  size_t zacatek = NumOfStructureStart == 0 ? 0 : TRecipeInfo_Size + (NumOfStructureStart - 1) * TRecipeStep_Size;
+  size_t konec = NumOfStructureEnd == 0 ? TRecipeInfo_Size - 1 : TRecipeInfo_Size + NumOfStructureEnd * TRecipeStep_Size - 1;
+  uint8_t Error = NFC_CompareBytes(aNFC, aCardInfo, zacatek, konec, aBlock);
+  NFC_SessionClose();
+  return Error;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zapíše strukturu a zkontroluje (způsob kontroly viz NFC_SetVerifyPolicy)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  NumOfStructureStart Číslo 1. struktury(0- info, 1-end - recipe)
+    @param  NumOfStructureEnd Číslo 1. struktury(0- info, 1-end - recipe)
+
+    @returns    0 - Hodnoty na kartě sedí se zapsanými, 1- Data se liší, 2 - Index anumOfNFCStruct je mimo rozsah struktury, 3 - Na kartu nelze zapsat, 4 - Kartu nelze autentifikovat 5 - neocekavana chyba, 6 - Nelze naalokovat pole pro porovnavaci hodnoty, 7 - Spatne zadane prvni a posledni prvky, 8 - Nenactene informace o NFC tagu, 9 - Nepodporovany typ karty,
+                10 - Recept je nacten ze zaznamu karty s adresarem (zapisuje se pres NFC_WriteRecord)
+*/
+/**************************************************************************/
+uint8_t NFC_WriteCheck(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd)
+{
+  static const char *TAGin = "NFC_WriteCheck";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Zapisuji hodnoty a kontroluji jestli jsou stejne od %d do %d.\n", NumOfStructureStart, NumOfStructureEnd);
+  if (aCardInfo->RecordBlock != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Recept je ze zaznamu karty s adresarem (NFC_WriteRecord).\n");
+    return 10;
+  }
+  uint8_t Error = 0;
+  for (int k = 0; k < MAXERRORREADING; ++k)
+  {
+    NFC_SPAN_RETRY(k);
+    for (int i = 0; i < MAXERRORREADING; ++i)
+    {
+      NFC_SPAN_RETRY(i);
+      Error = NFC_WriteStructRange(aNFC, aCardInfo, NumOfStructureStart, NumOfStructureEnd);
+      if (Error == 0 || Error == 5)
+      {
+        break;
+      }
+    }
+    switch (Error)
+    {
+    case 0:
+      break;
+    case 1:
+      NFC_READER_DEBUG(TAGin, "Index anumOfNFCStruct je mimo rozsah struktury.\n");
+      return 2;
+      break;
+    case 2:
+      NFC_READER_DEBUG(TAGin, "Nelze zapsat do NFC tagu.\n");
+      return 3;
+      break;
+    case 3:
+      NFC_READER_DEBUG(TAGin, "Kartu nelze autentifikovat.\n");
+      return 4;
+      break;
+    case 4:
+      NFC_READER_DEBUG(TAGin, "Spatne zadane prvni a posledni prvky.\n");
+      return 7;
+    case 5:
+      NFC_READER_DEBUG(TAGin, "Nepodporovany typ karty.\n");
+      return 9;
+    default:
+      NFC_READER_DEBUG(TAGin, "Jina chyba.\n");
+      return 5;
+      break;
+    }
+    int64_t iStart = esp_timer_get_time();
+    for (int i = 0; i < MAXERRORREADING; ++i)
+    {
+      NFC_SPAN_RETRY(i);
+      Error = NFC_VerifyWrite(aNFC, aCardInfo, NumOfStructureStart, NumOfStructureEnd);
+      if (Error <= 1)
+      {
+        break;
+      }
+    }
+    ++NFC_Stats.Verifications;
+    NFC_Stats.VerifyTimeUs += esp_timer_get_time() - iStart;
+    if (Error != 0)
+      ++NFC_Stats.VerifyFailures;
+    switch (Error)
+    {
+    case 0:
+      NFC_READER_DEBUG(TAGin, "Data se zapsala správne.\n");
+      return 0;
+    case 1:
+      NFC_READER_DEBUG(TAGin, "Data se nezapsala spravne, zkusim znovu.\n");
+      break;
+    case 2:
+      NFC_READER_DEBUG(TAGin, "Index anumOfNFCStruct je mimo rozsah struktury.\n");
+      return 2;
+      break;
+    case 3:
+      NFC_READER_DEBUG(TAGin, "Nelze z karty cist.\n");
+      return 4;
+      break;
+    case 4:
+      NFC_READER_DEBUG(TAGin, "Nelze znaalokovat pole pro hodnoty porovnani.\n");
+      return 6;
+      break;
+    case 5:
+      NFC_READER_DEBUG(TAGin, "Spatne zadane prvni a posledni prvky.\n");
+      return 7;
+      break;
+    case 6:
+      NFC_READER_DEBUG(TAGin, "Nenactene informace o NFC tagu.\n");
+      return 8;
+    default:
+      NFC_READER_DEBUG(TAGin, "Jina chyba.\n");
+      return 5;
+      break;
+    }
+  }
+  NFC_READER_DEBUG(TAGin, "Data se nezapsala spravne ani po 5 pokusech.\n");
+  return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Vypočítá CheckSum
+
+    @param  aCardInfo Pointer na TCardInfo strukturu
+
+    @returns    hodnota CheckSum(hodnota bytu*(pozice bytu%4+1))
+*/
+/**************************************************************************/
+uint16_t NFC_GetCheckSum(TCardInfo aCardInfo)
+{
+  static const char *TAGin = "NFC_GetCheckSum";
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Pocitam checksum.\n");
+  if (aCardInfo.sRecipeInfo.NumOfDrinks == 0)
+  {
+    aCardInfo.sRecipeInfo.CheckSum = 0;
+    NFC_READER_DEBUG(TAGin, "Počet receptů je 0 -> Checksum = 0.\n");
+    return 0;
+  }
+  uint16_t CheckSum = 0;
+  NFC_READER_ALL_DEBUG(TAGin, "Prubeh CheckSumu: ");
+  for (size_t i = 0; i < TRecipeStep_Size * aCardInfo.sRecipeInfo.RecipeSteps; ++i)
+  {
+    CheckSum += *((uint8_t *)aCardInfo.sRecipeStep + i) * (i % 4 + 1);
+    NFC_READER_ALL_DEBUG("", " %d,", CheckSum);
+  }
+  NFC_READER_ALL_DEBUG("", "\n");
+  NFC_READER_DEBUG(TAGin, "Checksum je %d.\n", CheckSum);
+  return CheckSum;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Vytvoření TCardInfo struktury z TRecipeInfo struktury
+
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  aRecipeInfo Struktura aRecipeInfo
+
+    @returns    0 - Uspesne vytvoreni, 1 - Nelze alokovat pole
+*/
+/**************************************************************************/
+uint8_t NFC_CreateCardInfoFromRecipeInfo(TCardInfo *aCardInfo, TRecipeInfo aRecipeInfo)
+{
+  static const char *TAGin = "NFC_CreateCardInfoFromRecipeInfo";
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Vytvarim CardInfo z RecipeStepu.\n");
+  NFC_InitTCardInfo(aCardInfo);
+  for (size_t i = 0; i < TRecipeInfo_Size; ++i)
+  {
+    *(((uint8_t *)(&aCardInfo->sRecipeInfo)) + i) = *(((uint8_t *)(&aRecipeInfo)) + i);
+  }
+  NFC_READER_ALL_DEBUG(TAGin, "Data se prekopirovala.\n");
+  uint8_t Error = 0;
+  aCardInfo->TRecipeInfoLoaded = true;
+  if (aRecipeInfo.RecipeSteps > 0)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Alokuji pole.\n");
+    for (size_t i = 0; i < MAXERRORREADING; ++i)
+    {
+      Error = NFC_AllocTRecipeStepArray(aCardInfo);
+      if (Error == 0)
+        break;
+    }
+    switch (Error)
+    {
+    case 0:
+      for (size_t i = 0; i < TRecipeStep_Size * aCardInfo->sRecipeInfo.RecipeSteps; ++i)
+      {
+        *((uint8_t *)aCardInfo->sRecipeStep + i) = 0;
+      }
+      aCardInfo->sRecipeInfo.CheckSum = 0;
+      aCardInfo->TRecipeStepArrayCreated = true;
+      break;
+
+    default:
+      NFC_READER_DEBUG(TAGin, "Chyba vytvareni pole.\n");
+      return 1;
+      break;
+    }
+  }
+  NFC_READER_DEBUG(TAGin, "Vytvareno uspesne.\n");
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  VPridani struktur TRecipeStep do TCardInfo struktury
+
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  aRecipeStep Pointer na pole Struktur aRecipeStep
+    @param  SizeOfRecipeSteps Počet struktur
+    @param  DeAlloc Ma se odalokovat pole?
+
+    @returns    0 - Uspesne pridani, 1 - Neni nactena TRecipeInfo struktura, 2 - SizeOfRecipeSteps je nulove, 3 - Chyba vytvareni pole, 4 - aRecipeStep je NULL
+*/
+/**************************************************************************/
+uint8_t NFC_AddRecipeStepsToCardInfo(TCardInfo *aCardInfo, TRecipeStep *aRecipeStep, size_t SizeOfRecipeSteps, bool DeAlloc)
+{
+  static const char *TAGin = "NFC_AddRecipeStepsToCardInfo";
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Pridavam TRecipeStep do TCardInfo struktury.\n");
+  if (aCardInfo->TRecipeInfoLoaded != true)
+  {
+    NFC_READER_DEBUG(TAGin, "Neni nactena TRecipeInfo struktura.\n");
+    return 1;
+  }
+  if (SizeOfRecipeSteps == 0)
+  {
+    NFC_READER_DEBUG(TAGin, "SizeOfRecipeSteps je nulove.\n");
+    return 2;
+  }
+  uint8_t Error;
+
+  if (aCardInfo->sRecipeInfo.RecipeSteps != SizeOfRecipeSteps && aCardInfo->TRecipeStepArrayCreated)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Odalokovavam pole(Rozdilna velikost).\n");
+    NFC_DeAllocTRecipeStepArray(aCardInfo);
+    aCardInfo->TRecipeStepArrayCreated = false;
+  }
+  if (aCardInfo->TRecipeStepArrayCreated == false)
+  {
+    aCardInfo->sRecipeInfo.RecipeSteps = SizeOfRecipeSteps;
+    NFC_READER_ALL_DEBUG(TAGin, "Alokuji pole.\n");
+    for (size_t i = 0; i < MAXERRORREADING; ++i)
+    {
+      Error = NFC_AllocTRecipeStepArray(aCardInfo);
+      if (Error == 0)
+        break;
+    }
+    switch (Error)
+    {
+    case 0:
+      aCardInfo->TRecipeStepArrayCreated = true;
+      break;
+
+    default:
+      NFC_READER_DEBUG(TAGin, "Chyba vytvareni pole.\n");
+      return 3;
+      break;
+    }
+    aCardInfo->sRecipeInfo.RecipeSteps = SizeOfRecipeSteps;
+  }
+  for (size_t i = 0; i < TRecipeStep_Size * aCardInfo->sRecipeInfo.RecipeSteps; ++i)
+  {
+    *((uint8_t *)aCardInfo->sRecipeStep + i) = *((uint8_t *)aRecipeStep + i);
+  }
+  aCardInfo->TRecipeStepLazy = false;
+  aCardInfo->TRecipeStepLoaded = true;
+  if (DeAlloc)
+  {
+    free(aRecipeStep);
+    aRecipeStep = NULL;
+  }
+  aCardInfo->sRecipeInfo.CheckSum = NFC_GetCheckSum(*aCardInfo);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Funkce ke zmene velikosti pole s RecipeSteps hodnotami
+
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  NewSize Pointer na pole Struktur aRecipeStep
+
+
+    @returns    0 - uspesna zmena, 1 - Nejsou nactena RecipeInfo, 2 - Nelze Alokovat pole 20 - Neocekavana chyba
+*/
+/**************************************************************************/
+uint8_t NFC_ChangeRecipeStepsSize(TCardInfo *aCardInfo, uint8_t NewSize)
+{
+  static const char *TAGin = "NFC_ChangeRecipeStepsSize";
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Menim hodnoty velikosti pole\n");
+  if (aCardInfo->TRecipeInfoLoaded == 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Nejsou nactena RecipeInfo\n");
+    return 1;
+  }
+
+  if (NewSize == aCardInfo->sRecipeInfo.RecipeSteps)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Pole jsou stejne velke.\n");
+    return 0;
+  }
+  uint8_t Error;
+  if (aCardInfo->TRecipeStepArrayCreated)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Vytvarim pole o velikosti %zu bytu.\n", TRecipeStep_Size * NewSize);
+
+    TRecipeStep *NoveRecepty = (TRecipeStep *)malloc(TRecipeStep_Size * NewSize);
+    if (!NoveRecepty)
+    {
+      NFC_READER_DEBUG(TAGin, "Nelze vytvorit pole dat.\n");
+      return 2;
+    }
+    NFC_READER_ALL_DEBUG(TAGin, "Pole bylo vytvoreno.\n");
+    fflush(stdout);
+    for (size_t i = 0; i < NewSize; ++i)
+    {
+      for (size_t j = 0; j < TRecipeStep_Size; ++j)
+      {
+        if (i < aCardInfo->sRecipeInfo.RecipeSteps)
+        {
+          *((uint8_t *)NoveRecepty + i * TRecipeStep_Size + j) = *((uint8_t *)aCardInfo->sRecipeStep + i * TRecipeStep_Size + j);
+        }
+        else
+        {
+          *((uint8_t *)NoveRecepty + i * TRecipeStep_Size + j) = 0;
+        }
+      }
+    }
+    bool iLazy = aCardInfo->TRecipeStepLazy;
+    uint8_t iLoadedMask[sizeof(aCardInfo->sRecipeStepLoadedMask)];
+    memcpy(iLoadedMask, aCardInfo->sRecipeStepLoadedMask, sizeof(iLoadedMask));
+    for (size_t i = aCardInfo->sRecipeInfo.RecipeSteps; i < NewSize; ++i)
+    {
+      iLoadedMask[i / 8] |= 1 << (i % 8);
+    }
+    NFC_READER_ALL_DEBUG(TAGin, "Odalokovavam.\n");
+    NFC_DeAllocTRecipeStepArray(aCardInfo);
+    NFC_READER_ALL_DEBUG(TAGin, "Odalokovano.\n");
+    aCardInfo->sRecipeStep = NoveRecepty;
+    aCardInfo->TRecipeStepArrayCreated = aCardInfo->TRecipeStepLoaded = true;
+    if (iLazy)
+    {
+      // Nenactene kroky zustavaji nenactene, nove pridane kroky jsou nulove
+      aCardInfo->TRecipeStepLazy = true;
+      memcpy(aCardInfo->sRecipeStepLoadedMask, iLoadedMask, sizeof(iLoadedMask));
+      for (size_t i = 0; i < NewSize; ++i)
+      {
+        if (!(iLoadedMask[i / 8] & (1 << (i % 8))))
+        {
+          aCardInfo->TRecipeStepLoaded = false;
+          break;
+        }
+      }
+    }
+    aCardInfo->sRecipeInfo.RecipeSteps = NewSize;
+    NFC_READER_ALL_DEBUG(TAGin, "Udaje zmeneny.\n");
+  }
+  else
+  {
+    aCardInfo->sRecipeInfo.RecipeSteps = NewSize;
+    for (int i = 0; i < MAXERRORREADING; ++i)
+    {
+      Error = NFC_AllocTRecipeStepArray(aCardInfo);
+      if (Error == 0)
+      {
+        break;
+      }
+      NFC_DeAllocTRecipeStepArray(aCardInfo);
+    }
+    switch (Error)
+    {
+    case 0:
+      break;
+    case 2:
+      NFC_READER_DEBUG(TAGin, "Nebyla nactena struktura TRecipeInfo.\n");
+      return 1;
+      break;
+    case 3:
+      NFC_READER_DEBUG(TAGin, "Nelze Alokovat pole.\n");
+      return 2;
+      break;
+    default:
+      NFC_READER_DEBUG(TAGin, "Neocekavana chyba.\n");
+      return 20;
+      break;
+    }
+    for (size_t i = 0; i < TRecipeStep_Size * aCardInfo->sRecipeInfo.RecipeSteps; ++i)
+    {
+      *((uint8_t *)aCardInfo->sRecipeStep + i) = 0;
+    }
+  }
+  NFC_READER_DEBUG(TAGin, "Pole zmenilo svou velikost na %d prvku.\n", NewSize);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Funkce slouží k přesunutí dat z aCardInfoOrigin do aCardInfoNew
+    @param  aCardInfoOrigin Pointer na původní TCardInfo strukturu
+    @param  aCardInfoNew Pointer na novou TCardInfo strukturu
+
+
+    @returns    0 - uspesne kopirovani, 1 -Data TRecipeInfo nejsou nahrana v původní struktuře,2 - Nelze Alokovat pole. ,3 -Nebyla nactena struktura TRecipeInfo, 20- Neocekavana chyba
+*/
+/**************************************************************************/
+uint8_t NFC_CopyTCardInfo(TCardInfo *aCardInfoOrigin, TCardInfo *aCardInfoNew)
+{
+  static const char *TAGin = "NFC_CopyTCardInfo";
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Kopiruji data CardInfo do nove struktury\n");
+  if (!aCardInfoOrigin->TRecipeInfoLoaded)
+  {
+    NFC_READER_DEBUG(TAGin, "Data TRecipeInfo nejsou nahrana v puvodni strukture.\n");
+    return 1;
+  }
+  NFC_READER_ALL_DEBUG(TAGin, "Kopiruji TRecipeInfoData.\n");
+  aCardInfoNew->sRecipeInfo = aCardInfoOrigin->sRecipeInfo;
+  NFC_READER_ALL_DEBUG(TAGin, "Kopiruji Structure data.\n");
+  aCardInfoNew->sUidLength = aCardInfoOrigin->sUidLength;
+  for (size_t i = 0; i < aCardInfoNew->sUidLength; ++i)
+  {
+    aCardInfoNew->sUid[i] = aCardInfoOrigin->sUid[i];
+  }
+  aCardInfoNew->TRecipeInfoLoaded = aCardInfoOrigin->TRecipeInfoLoaded;
+  if (aCardInfoNew->TRecipeStepArrayCreated || aCardInfoNew->sRecipeStep != NULL)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Odalokavam puvodni pamet.\n");
+    NFC_DeAllocTRecipeStepArray(aCardInfoNew);
+  }
+
+  uint8_t Error;
+  if (aCardInfoOrigin->TRecipeStepArrayCreated)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Alokuju novou pamet.\n");
+    for (int i = 0; i < MAXERRORREADING; ++i)
+    {
+      Error = NFC_AllocTRecipeStepArray(aCardInfoNew);
+      if (Error == 0)
+      {
+        break;
+      }
+      NFC_DeAllocTRecipeStepArray(aCardInfoNew);
+    }
+    switch (Error)
+    {
+    case 0:
+      break;
+    case 2:
+      NFC_READER_DEBUG(TAGin, "Nebyla nactena struktura TRecipeInfo.\n");
+      return 3;
+      break;
+    case 3:
+      NFC_READER_DEBUG(TAGin, "Nelze Alokovat pole.\n");
+      return 2;
+      break;
+    default:
+      NFC_READER_DEBUG(TAGin, "Neocekavana chyba.\n");
+      return 20;
+      break;
+    }
+    for (size_t i = 0; i < TRecipeStep_Size * aCardInfoNew->sRecipeInfo.RecipeSteps; ++i)
+    {
+      *((uint8_t *)aCardInfoNew->sRecipeStep + i) = *((uint8_t *)aCardInfoOrigin->sRecipeStep + i);
+    }
+
+    aCardInfoNew->TRecipeStepArrayCreated = aCardInfoOrigin->TRecipeStepArrayCreated;
+    NFC_READER_ALL_DEBUG(TAGin, "Pole TRecipeStep se prekopirovalo.\n");
+  }
+  else
+  {
+    aCardInfoNew->sRecipeStep = NULL;
+  }
+  aCardInfoNew->TRecipeStepLoaded = aCardInfoOrigin->TRecipeStepLoaded;
+  aCardInfoNew->TRecipeStepLazy = aCardInfoOrigin->TRecipeStepLazy;
+  aCardInfoNew->NumOfDrinksCounter = aCardInfoOrigin->NumOfDrinksCounter;
+  aCardInfoNew->ActualBudgetValueBlock = aCardInfoOrigin->ActualBudgetValueBlock;
+  aCardInfoNew->TransactionRing = aCardInfoOrigin->TransactionRing;
+  aCardInfoNew->TransactionSequence = aCardInfoOrigin->TransactionSequence;
+  aCardInfoNew->TransactionSlot = aCardInfoOrigin->TransactionSlot;
+  aCardInfoNew->RecordBlock = aCardInfoOrigin->RecordBlock;
+  memcpy(aCardInfoNew->sRecipeStepLoadedMask, aCardInfoOrigin->sRecipeStepLoadedMask, sizeof(aCardInfoNew->sRecipeStepLoadedMask));
+
+  NFC_READER_DEBUG(TAGin, "Data se prekopirovala.\n");
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Publikování stavu karty ostatním úlohám (NFC_GetCardInfoSnapshot), volá jen úloha čtečky
+            po načtení nebo změně karty. Zapisuje se do nepublikovaného bufferu, úloha nikdy nečeká na čtenáře.
+            Kroky receptu se kopírují jen s NFC_READER_SNAPSHOT_STEPS_EN.
+
+    @param  aCardInfo      Pointer na TCardInfo strukturu, NULL - karta byla odebrána
+
+    @returns 0 - Stav se publikoval, 1 - Data TRecipeInfo nejsou nactena
+*/
+/**************************************************************************/
+uint8_t NFC_PublishCardInfo(TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_PublishCardInfo";
+  if (aCardInfo != NULL && !aCardInfo->TRecipeInfoLoaded)
+  {
+    NFC_READER_DEBUG(TAGin, "Data TRecipeInfo nejsou nactena.\n");
+    return 1;
+  }
+  uint32_t iSeq = __atomic_load_n(&NFC_SnapshotSeq, __ATOMIC_RELAXED);
+  TNFCCardSnapshot *iSnimek = &NFC_Snapshots[(iSeq / 2 + 1) % 2];
+  __atomic_store_n(&NFC_SnapshotSeq, iSeq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  memset(iSnimek, 0, sizeof(*iSnimek));
+  iSnimek->Epoch = iSeq / 2 + 1;
+  if (aCardInfo != NULL)
+  {
+    iSnimek->Present = true;
+    iSnimek->sRecipeInfo = aCardInfo->sRecipeInfo;
+    memcpy(iSnimek->sUid, aCardInfo->sUid, sizeof(iSnimek->sUid));
+    iSnimek->sUidLength = aCardInfo->sUidLength;
+    iSnimek->NumOfDrinksCounter = aCardInfo->NumOfDrinksCounter;
+    iSnimek->ActualBudgetValueBlock = aCardInfo->ActualBudgetValueBlock;
+    iSnimek->TransactionRing = aCardInfo->TransactionRing;
+    iSnimek->TransactionSequence = aCardInfo->TransactionSequence;
+#if NFC_READER_SNAPSHOT_STEPS_EN
+    // Kroky, ktere jeste nacita predcitani, se do snimku nedostanou
+    if (aCardInfo->TRecipeStepArrayCreated && (aCardInfo->TRecipeStepLoaded || aCardInfo->TRecipeStepLazy))
+    {
+      iSnimek->TRecipeStepLoaded = true;
+      for (size_t i = 0; i < aCardInfo->sRecipeInfo.RecipeSteps; ++i)
+      {
+        if (!NFC_IsTRecipeStepLoaded(aCardInfo, i))
+        {
+          iSnimek->TRecipeStepLoaded = false;
+          continue;
         }
+        iSnimek->sRecipeStep[i] = aCardInfo->sRecipeStep[i];
+        iSnimek->sRecipeStepLoadedMask[i / 8] |= 1 << (i % 8);
+      }
+    }
+#endif
+  }
+
+  __atomic_store_n(&NFC_SnapshotSeq, iSeq + 2, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Konzistentní kopie naposledy publikovaného stavu karty (NFC_PublishCardInfo), lze volat
+            z libovolné úlohy, úlohu čtečky neblokuje
+
+    @param  aSnapshot      Pointer, do kterého se snímek zkopíruje
+
+    @returns 0 - Snimek karty se zkopiroval, 1 - Neni publikovana zadna karta
+*/
+/**************************************************************************/
+uint8_t NFC_GetCardInfoSnapshot(TNFCCardSnapshot *aSnapshot)
+{
+  for (;;)
+  {
+    uint32_t iSeq = __atomic_load_n(&NFC_SnapshotSeq, __ATOMIC_ACQUIRE) & ~1u;
+    memcpy(aSnapshot, &NFC_Snapshots[(iSeq / 2) % 2], sizeof(*aSnapshot));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    // Buffer se prepisuje az pri druhe publikaci po iSeq (citac iSeq + 3)
+    if (__atomic_load_n(&NFC_SnapshotSeq, __ATOMIC_RELAXED) - iSeq < 3)
+      break;
+  }
+  return aSnapshot->Present ? 0 : 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Číslo poslední publikace stavu karty - čtenář podle něj pozná změnu bez kopírování snímku
+
+    @returns    Cislo publikace (0 - zatim nic nepublikovano)
+*/
+/**************************************************************************/
+uint32_t NFC_GetCardInfoEpoch(void)
+{
+  return __atomic_load_n(&NFC_SnapshotSeq, __ATOMIC_ACQUIRE) / 2;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zneplatnění všech bloků v cache relace (např. po zápisu na kartu)
+
+*/
+/**************************************************************************/
+static void NFC_SessionInvalidateCache(void)
+{
+  for (size_t i = 0; i < NFC_CACHE_BLOCKS; ++i)
+  {
+    NFC_Session.Cache[i].Valid = false;
+  }
+  NFC_Session.AuthSector = -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Otevření relace s přiloženou kartou, uloží UID a vyprázdní cache bloků
+
+    @param  aNFC      Pointer na NFC strukturu
+
+    @returns 0 - Relace je otevřena, 2 - Karta nebyla prilozena, 4 - Nepodporovany typ karty
+*/
+/**************************************************************************/
+uint8_t NFC_SessionOpen(pn532_t *aNFC)
+{
+  static const char *TAGin = "NFC_SessionOpen";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_ALL_DEBUG(TAGin, "Oteviram relaci s kartou.\n");
+  NFC_SessionClose();
+  uint8_t iuid[NFC_UID_MAXSIZE] = {0};
+  uint8_t iuidLength;
+  if (!NFC_HwReadPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT))
+  {
+    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+    return 2;
+  }
+  uint8_t iTyp = NFC_DetectTagType(aNFC, iuid, iuidLength);
+  if (iTyp == NFC_TAG_UNKNOWN)
+  {
+    NFC_READER_DEBUG(TAGin, "Nepodporovany typ karty (delka UID %d).\n", iuidLength);
+    return 4;
+  }
+  if (iTyp == NFC_TAG_ISODEP && NFC_IsoDepSelect(aNFC) != 0)
+  {
+    return 2;
+  }
+  NFC_SessionAttach(aNFC, iuid, iuidLength, iTyp);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Převzetí karty vybrané mimo relaci (NFC_WriteStructRange) do relace, aby další operace
+            s ní pokračovaly bez nového hledání karty
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aUid      UID vybrané karty
+    @param  aUidLength      Délka UID
+    @param  aTagType      Typ tagu (NFC_TAG_...)
+*/
+/**************************************************************************/
+static void NFC_SessionAttach(pn532_t *aNFC, const uint8_t *aUid, uint8_t aUidLength, uint8_t aTagType)
+{
+  NFC_SessionInvalidateCache();
+  for (size_t i = 0; i < aUidLength; ++i)
+  {
+    NFC_Session.sUid[i] = aUid[i];
+  }
+  NFC_Session.sUidLength = aUidLength;
+  NFC_Session.TagType = aTagType;
+  NFC_Session.AuthSector = -1;
+  NFC_Session.NFC = aNFC;
+  NFC_Session.Active = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Pokračování v relaci s kartou vybranou předchozí operací (zápis), relace s hledáním karty
+            se otevře jen když žádná otevřená není
+
+    @param  aNFC      Pointer na NFC strukturu
+
+    @returns Stejne navratove hodnoty jako NFC_SessionOpen
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionResume(pn532_t *aNFC)
+{
+  if (NFC_Session.Active && NFC_Session.NFC == aNFC)
+    return 0;
+  return NFC_SessionOpen(aNFC);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ukončení relace s kartou, cache bloků se zahodí
+
+*/
+/**************************************************************************/
+void NFC_SessionClose(void)
+{
+  NFC_PrefetchWait();
+  NFC_Session.Active = false;
+  NFC_Session.NFC = NULL;
+  NFC_SessionInvalidateCache();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Znovu vybere kartu relace po chybě čtení a ověří, že jde o stejnou kartu. Nejdřív se karta
+            rychle aktivuje podle UID (NFC_Recover), úplné hledání karty proběhne jen když neodpoví.
+
+    @returns 0 - Karta je znovu vybrana, 2 - Karta nebyla prilozena, 6 - Byla prilozena jina karta
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionReselect(void)
+{
+  static const char *TAGin = "NFC_SessionReselect";
+  NFC_SPAN(__func__);
+  uint8_t iuid[NFC_UID_MAXSIZE] = {0};
+  uint8_t iuidLength;
+  NFC_Session.AuthSector = -1;
+  if (NFC_Recover(NFC_Session.NFC, NFC_Session.sUid, NFC_Session.sUidLength))
+  {
+    if (NFC_Session.TagType == NFC_TAG_ISODEP && NFC_IsoDepSelect(NFC_Session.NFC) != 0)
+      return 2;
+    return 0;
+  }
+  if (!NFC_HwReadPassiveTargetID(NFC_Session.NFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT))
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+    return 2;
+  }
+  if (iuidLength != NFC_Session.sUidLength || memcmp(iuid, NFC_Session.sUid, iuidLength) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Byla prilozena jina karta.\n");
+    return 6;
+  }
+  if (NFC_Session.TagType == NFC_TAG_ISODEP && NFC_IsoDepSelect(NFC_Session.NFC) != 0)
+  {
+    return 2;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Autentizace sektoru Mifare Classic v otevřené relaci, pokud již není autentizován
+
+    @param  aIndex      Index bloku na Mifare Classic čipu
+
+    @returns 0 - Sektor je autentizovan, 3 - Nelze autentizovat NFC tag
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionAuthenticate(size_t aIndex)
+{
+  static const char *TAGin = "NFC_SessionAuthenticate";
+  int16_t iSector = NFC_ClassicSector(aIndex);
+  if (NFC_Session.AuthSector == iSector)
+    return 0;
+  if (!NFC_ClassicAuthenticate(NFC_Session.NFC, NFC_Session.sUid, NFC_Session.sUidLength, aIndex))
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Nelze autentifikovat sektor %d.\n", iSector);
+    NFC_Session.AuthSector = -1;
+    return 3;
+  }
+  NFC_Session.AuthSector = iSector;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení jednoho 16B bloku dat z karty v otevřené relaci (bez cache)
+
+    @param  aBlock      Číslo 16B bloku od začátku dat
+    @param  aData       Buffer o velikosti PAGESIZE_CLASSIC
+
+    @returns 0 - Blok se precetl, 2 - Blok nelze precist, 3 - Nelze autentizovat NFC tag
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionFetchBlock(size_t aBlock, uint8_t *aData)
+{
+  static const char *TAGin = "NFC_SessionFetchBlock";
+  if (NFC_Session.TagType == NFC_TAG_ISODEP)
+  {
+    if (NFC_IsoDepRead(NFC_Session.NFC, aBlock * PAGESIZE_CLASSIC, PAGESIZE_CLASSIC, aData) != 0)
+      return 2;
+  }
+  else if (NFC_Session.TagType == NFC_TAG_FELICA)
+  {
+    if (NFC_FelicaReadBlocks(NFC_Session.NFC, NFC_Session.sUid, aBlock, 1, aData) != 0)
+      return 2;
+  }
+  else if (NFC_Session.TagType == NFC_TAG_CLASSIC)
+  {
+    size_t index = NFC_GetMifareClassicIndex(aBlock);
+    if (NFC_SessionAuthenticate(index) != 0)
+      return 3;
+    if (!NFC_HwClassicReadDataBlock(NFC_Session.NFC, index, aData))
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Nelze precist blok %zu.\n", index);
+      NFC_Session.AuthSector = -1;
+      return 2;
+    }
+  }
+  else
+  {
+    if (!NFC_HwUltralightReadPage(NFC_Session.NFC, (aBlock * 4) + OFFSETDATA_ULTRALIGHT, aData))
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Nelze precist stranu %zu.\n", (aBlock * 4) + OFFSETDATA_ULTRALIGHT);
+      return 2;
+    }
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zápis jednoho 16B bloku dat na kartu v otevřené relaci, blok v cache se aktualizuje
+
+    @param  aBlock      Číslo 16B bloku od začátku dat
+    @param  aData       Data o velikosti PAGESIZE_CLASSIC
+
+    @returns 0 - Blok se zapsal, 2 - Blok nelze zapsat, 3 - Nelze autentizovat NFC tag
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionWriteBlock(size_t aBlock, uint8_t *aData)
+{
+  static const char *TAGin = "NFC_SessionWriteBlock";
+  if (NFC_Session.TagType == NFC_TAG_ISODEP)
+  {
+    if (NFC_IsoDepWrite(NFC_Session.NFC, aBlock * PAGESIZE_CLASSIC, PAGESIZE_CLASSIC, aData) != 0)
+      return 2;
+  }
+  else if (NFC_Session.TagType == NFC_TAG_FELICA)
+  {
+    if (NFC_FelicaWriteBlocks(NFC_Session.NFC, NFC_Session.sUid, aBlock, 1, aData) != 0)
+      return 2;
+  }
+  else if (NFC_Session.TagType == NFC_TAG_CLASSIC)
+  {
+    size_t index = NFC_GetMifareClassicIndex(aBlock);
+    if (NFC_SessionAuthenticate(index) != 0)
+      return 3;
+    if (!NFC_HwClassicWriteDataBlock(NFC_Session.NFC, index, aData))
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Nelze zapsat blok %zu.\n", index);
+      NFC_Session.AuthSector = -1;
+      return 2;
+    }
+  }
+  else
+  {
+    for (size_t k = 0; k < PAGESIZE_CLASSIC / PAGESIZE_ULTRALIGHT; ++k)
+    {
+      if (!NFC_HwUltralightWritePage(NFC_Session.NFC, (aBlock * 4) + k + OFFSETDATA_ULTRALIGHT, aData + k * PAGESIZE_ULTRALIGHT))
+      {
+        NFC_READER_ALL_DEBUG(TAGin, "Nelze zapsat stranu %zu.\n", (aBlock * 4) + k + OFFSETDATA_ULTRALIGHT);
+        return 2;
+      }
+    }
+  }
+  for (size_t i = 0; i < NFC_CACHE_BLOCKS; ++i)
+  {
+    if (NFC_Session.Cache[i].Valid && NFC_Session.Cache[i].Block == aBlock)
+    {
+      NFC_PipelineRelease(NFC_Session.Cache[i].Data);
+      memcpy(NFC_Session.Cache[i].Data, aData, PAGESIZE_CLASSIC);
+    }
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení 16B bloku přes cache relace, při chybě kartu znovu vybere a čtení opakuje
+
+    @param  aBlock      Číslo 16B bloku od začátku dat
+    @param  aData       Pointer, do kterého se uloží adresa dat bloku v cache
+
+    @returns 0 - Blok je k dispozici, 2 - Blok nelze precist, 3 - Nelze autentizovat NFC tag, 6 - Byla prilozena jina karta
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionReadBlock(size_t aBlock, uint8_t **aData)
+{
+  TNFCCacheBlock *iVolny = &NFC_Session.Cache[0];
+  for (size_t i = 0; i < NFC_CACHE_BLOCKS; ++i)
+  {
+    TNFCCacheBlock *iBlok = &NFC_Session.Cache[i];
+    if (iBlok->Valid && iBlok->Block == aBlock)
+    {
+      iBlok->LastUse = ++NFC_Session.UseCounter;
+      *aData = iBlok->Data;
+      return 0;
+    }
+    if (iVolny->Valid && (!iBlok->Valid || iBlok->LastUse < iVolny->LastUse))
+    {
+      iVolny = iBlok;
+    }
+  }
+
+  uint8_t Error = 2;
+  NFC_PipelineRelease(iVolny->Data);
+  iVolny->Valid = false;
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    Error = NFC_SessionFetchBlock(aBlock, iVolny->Data);
+    if (Error == 0)
+      break;
+    uint8_t ErrorSelect = NFC_SessionReselect();
+    if (ErrorSelect == 6)
+      return 6;
+  }
+  if (Error != 0)
+    return Error;
+  iVolny->Block = aBlock;
+  iVolny->Valid = true;
+  iVolny->LastUse = ++NFC_Session.UseCounter;
+  *aData = iVolny->Data;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Kopírování přečtených dat (práce pro NFC_PipelineSet)
+
+    @param  aStep      Pointer na TNFCCopyStep
+*/
+/**************************************************************************/
+static void NFC_CopyStep(void *aStep)
+{
+  TNFCCopyStep *iKopie = aStep;
+  memcpy(iKopie->Target, iKopie->Source, iKopie->Length);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení rozsahu bytů dat karty přes cache relace
+
+    @param  aOffset     Pozice prvního bytu od začátku dat
+    @param  aLength     Počet bytů
+    @param  aData       Výstupní buffer
+
+    @returns 0 - Data se precetla, 2 - Data nelze precist, 3 - Nelze autentizovat NFC tag, 6 - Byla prilozena jina karta
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionReadBytes(size_t aOffset, size_t aLength, uint8_t *aData)
+{
+  TNFCCopyStep iKopie[2];
+  size_t Precteno = 0;
+  for (size_t i = 0; Precteno < aLength; ++i)
+  {
+    uint8_t *iBlok;
+    size_t Posun = (aOffset + Precteno) % PAGESIZE_CLASSIC;
+    uint8_t Error = NFC_SessionReadBlock((aOffset + Precteno) / PAGESIZE_CLASSIC, &iBlok);
+    if (Error != 0)
+    {
+      NFC_PipelineCancel();
+      return Error;
+    }
+    size_t Delka = PAGESIZE_CLASSIC - Posun;
+    if (Delka > aLength - Precteno)
+      Delka = aLength - Precteno;
+    // Blok se z cache zkopiruje, zatimco PN532 cte dalsi blok
+    NFC_PipelineFlush(false);
+    iKopie[i % 2] = (TNFCCopyStep){.Source = iBlok + Posun, .Target = aData + Precteno, .Length = Delka};
+    NFC_PipelineSet(NFC_CopyStep, &iKopie[i % 2], iBlok);
+    Precteno += Delka;
+  }
+  NFC_PipelineFlush(false);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zápis souvislých 16B bloků dat v otevřené relaci s kontrolou každého bloku,
+            bloky, které již obsahují cílová data, se přeskočí
+
+    @param  aFirstBlock     Číslo prvního 16B bloku od začátku dat
+    @param  aData       Data k zápisu
+    @param  aBlocks     Počet 16B bloků
+    @param  aWritten    Čítač zapsaných bloků (může být NULL)
+    @param  aSkipped    Čítač přeskočených bloků (může být NULL)
+
+    @returns 0 - Bloky se zapsaly, 3 - Nelze autentizovat NFC tag, 4 - Data se nezapsala, 5 - Data na karte se lisi po zapisu
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionWriteBlocks(size_t aFirstBlock, uint8_t *aData, size_t aBlocks, uint32_t *aWritten, uint32_t *aSkipped)
+{
+  static const char *TAGin = "NFC_SessionWriteBlocks";
+  uint8_t Error = 0;
+  uint8_t iData[PAGESIZE_CLASSIC];
+  for (size_t i = aFirstBlock; i < aFirstBlock + aBlocks && Error == 0; ++i)
+  {
+    uint8_t *iPrecteno;
+    uint8_t *iCil = aData + (i - aFirstBlock) * PAGESIZE_CLASSIC;
+    if (NFC_SessionReadBlock(i, &iPrecteno) == 0 && memcmp(iPrecteno, iCil, PAGESIZE_CLASSIC) == 0)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Blok %zu uz obsahuje cilova data.\n", i);
+      if (aSkipped != NULL)
+        ++*aSkipped;
+      continue;
+    }
+    Error = 4;
+    for (size_t j = 0; j < MAXERRORREADING; ++j)
+    {
+      NFC_SPAN_RETRY(j);
+      uint8_t ErrorWrite = NFC_SessionWriteBlock(i, iCil);
+      if (ErrorWrite == 0 && NFC_SessionFetchBlock(i, iData) == 0 && memcmp(iData, iCil, PAGESIZE_CLASSIC) == 0)
+      {
+        Error = 0;
+        break;
+      }
+      Error = ErrorWrite == 3 ? 3 : (ErrorWrite == 0 ? 5 : 4);
+      if (NFC_SessionReselect() != 0)
+        break;
+    }
+    if (Error == 0 && aWritten != NULL)
+      ++*aWritten;
+  }
+  return Error;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zajistí otevřenou relaci se stejnou kartou, jaká je uložena v aCardInfo
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo Pointer na TCardInfo strukturu
+
+    @returns 0 - Relace je otevrena, 2 - Karta nebyla prilozena, 6 - Byla prilozena jina karta
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionEnsure(pn532_t *aNFC, TCardInfo *aCardInfo)
+{
+  if (NFC_Session.Active && NFC_Session.NFC == aNFC && NFC_Session.sUidLength == aCardInfo->sUidLength &&
+      memcmp(NFC_Session.sUid, aCardInfo->sUid, aCardInfo->sUidLength) == 0)
+  {
+    return 0;
+  }
+  uint8_t Error = 2;
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    Error = NFC_SessionOpen(aNFC);
+    if (Error == 0 || Error == 4)
+      break;
+  }
+  if (Error != 0)
+    return 2;
+  if (NFC_Session.sUidLength != aCardInfo->sUidLength || memcmp(NFC_Session.sUid, aCardInfo->sUid, aCardInfo->sUidLength) != 0)
+  {
+    NFC_SessionClose();
+    return 6;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Složení bytů dat z TCardInfo struktury tak, jak leží na kartě
+
+    @param  aCardInfo      Pointer na TCardInfo strukturu
+    @param  aOffset      Pozice prvního bytu od začátku dat
+    @param  aLength      Počet bytů
+    @param  aData       Výstupní buffer
+*/
+/**************************************************************************/
+static void NFC_GetCardInfoBytes(TCardInfo *aCardInfo, size_t aOffset, size_t aLength, uint8_t *aData)
+{
+  size_t iDelka = TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size;
+  for (size_t k = 0; k < aLength; ++k)
+  {
+    size_t iPozice = aOffset + k;
+    if (iPozice < TRecipeInfo_Size)
+      aData[k] = *((uint8_t *)&aCardInfo->sRecipeInfo + iPozice);
+    else if (iPozice < iDelka)
+      aData[k] = *((uint8_t *)aCardInfo->sRecipeStep + iPozice - TRecipeInfo_Size);
+    else
+      aData[k] = 0;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Složení 16B bloku dat z TCardInfo struktury tak, jak leží na kartě
+
+    @param  aCardInfo      Pointer na TCardInfo strukturu
+    @param  aBlock      Číslo 16B bloku od začátku dat
+    @param  aData       Buffer o velikosti PAGESIZE_CLASSIC
+*/
+/**************************************************************************/
+static void NFC_GetCardInfoBlock(TCardInfo *aCardInfo, size_t aBlock, uint8_t *aData)
+{
+  NFC_GetCardInfoBytes(aCardInfo, aBlock * PAGESIZE_CLASSIC, PAGESIZE_CLASSIC, aData);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Příprava zápisu bloku nebo strany - složení dat a index na čipu (práce pro NFC_PipelineSet)
+
+    @param  aStep      Pointer na TNFCWriteStep s vyplněným CardInfo, Block a Size
+*/
+/**************************************************************************/
+static void NFC_PrepareWriteStep(void *aStep)
+{
+  static const char *TAGin = "NFC_PrepareWriteStep";
+  TNFCWriteStep *iKrok = aStep;
+  NFC_GetCardInfoBytes(iKrok->CardInfo, iKrok->Block * iKrok->Size, iKrok->Size, iKrok->Data);
+  iKrok->Index = iKrok->Size == PAGESIZE_CLASSIC ? NFC_GetMifareClassicIndex(iKrok->Block) : iKrok->Block + OFFSETDATA_ULTRALIGHT;
+  NFC_READER_ALL_DEBUG(TAGin, "Bunka c.%zu:", iKrok->Block);
+  for (size_t k = 0; k < iKrok->Size; ++k)
+  {
+    NFC_READER_ALL_DEBUG("", "%d ", iKrok->Data[k]);
+  }
+  NFC_READER_ALL_DEBUG("", "\n");
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zpětné přečtení bloků v relaci s kartou vybranou předchozí operací (NFC_SessionResume)
+            a porovnání rozsahu bytů s TCardInfo strukturou. Po chybě čtení se karta znovu vybere a blok
+            se čte znovu, porovná se celý rozsah a vypíše se každý rozdílný blok.
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      Pointer na TCardInfo strukturu
+    @param  aFrom      První porovnávaný byte dat
+    @param  aTo      Poslední porovnávaný byte dat
+    @param  aBlock      Pointer, do kterého se uloží číslo prvního rozdílného 16B bloku (může být NULL)
+
+    @returns 0 - Data jsou stejna, 1 - Data se lisi, 3 - Nelze cist z karty
+*/
+/**************************************************************************/
+static uint8_t NFC_CompareBytes(pn532_t *aNFC, TCardInfo *aCardInfo, size_t aFrom, size_t aTo, size_t *aBlock)
+{
+  static const char *TAGin = "NFC_CompareBytes";
+  if (NFC_SessionResume(aNFC) != 0)
+    return 3;
+  size_t iRozdilne = 0;
+  uint8_t iOcekavano[PAGESIZE_CLASSIC];
+  uint8_t iData[PAGESIZE_CLASSIC];
+  for (size_t i = aFrom / PAGESIZE_CLASSIC; i <= aTo / PAGESIZE_CLASSIC; ++i)
+  {
+    uint8_t Error = 2;
+    for (size_t j = 0; j < MAXERRORREADING; ++j)
+    {
+      NFC_SPAN_RETRY(j);
+      Error = NFC_SessionFetchBlock(i, iData);
+      if (Error == 0 || NFC_SessionReselect() == 6)
+        break;
+    }
+    if (Error != 0)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Blok %zu nelze precist.\n", i);
+      return 3;
+    }
+    ++NFC_Stats.VerifyBlocksRead;
+    NFC_GetCardInfoBlock(aCardInfo, i, iOcekavano);
+    size_t iOd = i == aFrom / PAGESIZE_CLASSIC ? aFrom % PAGESIZE_CLASSIC : 0;
+    size_t iDo = i == aTo / PAGESIZE_CLASSIC ? aTo % PAGESIZE_CLASSIC : PAGESIZE_CLASSIC - 1;
+    if (memcmp(iData + iOd, iOcekavano + iOd, iDo - iOd + 1) != 0)
+    {
+      NFC_READER_DEBUG(TAGin, "Blok %zu se lisi.\n", i);
+      if (aBlock != NULL && iRozdilne == 0)
+        *aBlock = i;
+      ++iRozdilne;
+    }
+  }
+  if (iRozdilne > 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Rozdilnych bloku: %zu.\n", iRozdilne);
+    return 1;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zpětné přečtení jen hlavičky a porovnání kontrolního součtu receptu uloženého na kartě
+            s kontrolním součtem v TCardInfo struktuře. Zapsané kroky se nečtou, úplné přečtení je NFC_VERIFY_READBACK.
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      Pointer na TCardInfo strukturu
+
+    @returns 0 - Kontrolni soucet je stejny, 1 - Kontrolni soucet se lisi, 3 - Nelze cist z karty
+*/
+/**************************************************************************/
+static uint8_t NFC_VerifyChecksum(pn532_t *aNFC, TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_VerifyChecksum";
+  if (NFC_SessionResume(aNFC) != 0)
+    return 3;
+  uint8_t iData[(TRecipeInfo_Size + PAGESIZE_CLASSIC - 1) / PAGESIZE_CLASSIC * PAGESIZE_CLASSIC];
+  for (size_t i = 0; i < sizeof(iData) / PAGESIZE_CLASSIC; ++i)
+  {
+    if (NFC_SessionFetchBlock(i, iData + i * PAGESIZE_CLASSIC) != 0)
+      return 3;
+    ++NFC_Stats.VerifyBlocksRead;
+  }
+  TRecipeInfo iHlavicka;
+  memcpy(&iHlavicka, iData, TRecipeInfo_Size);
+  if (iHlavicka.CheckSum != aCardInfo->sRecipeInfo.CheckSum)
+  {
+    NFC_READER_DEBUG(TAGin, "Kontrolni soucet na karte %u, zapsany %u.\n", iHlavicka.CheckSum, aCardInfo->sRecipeInfo.CheckSum);
+    return 1;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Kontrola zapsaného rozsahu struktur podle zvolené politiky (NFC_SetVerifyPolicy)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      Pointer na TCardInfo strukturu
+    @param  NumOfStructureStart Číslo 1. struktury(0- info, 1-end - recipe)
+    @param  NumOfStructureEnd Číslo poslední struktury(0- info, 1-end - recipe)
+
+    @returns Stejne navratove hodnoty jako NFC_CheckStructArrayIsSame
+*/
+/**************************************************************************/
+static uint8_t NFC_VerifyWrite(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd)
+{
+  size_t iPrvni = NumOfStructureStart == 0 ? 0 : (TRecipeInfo_Size + (NumOfStructureStart - 1) * TRecipeStep_Size) / PAGESIZE_CLASSIC;
+  size_t iPosledni = NumOfStructureEnd == 0 ? 0 : (TRecipeInfo_Size + NumOfStructureEnd * TRecipeStep_Size - 1) / PAGESIZE_CLASSIC;
+  uint8_t Error;
+  switch (NFC_Stats.VerifyPolicy)
+  {
+  case NFC_VERIFY_TRUST_ACK:
+    // Neuspesny zapis vraci uz NFC_WriteStructRange
+    return 0;
+  case NFC_VERIFY_CHECKSUM:
+    return NFC_VerifyChecksum(aNFC, aCardInfo);
+  case NFC_VERIFY_READBACK:
+    if (iPrvni > 0)
+    {
+      // Hlavicka se mohla prepsat kvuli zmene kontrolniho souctu
+      Error = NFC_CompareBytes(aNFC, aCardInfo, 0, PAGESIZE_CLASSIC - 1, NULL);
+      if (Error != 0)
+        return Error;
+    }
+    return NFC_CompareBytes(aNFC, aCardInfo, iPrvni * PAGESIZE_CLASSIC, iPosledni * PAGESIZE_CLASSIC + PAGESIZE_CLASSIC - 1, NULL);
+  default:
+    return NFC_CheckStructArrayIsSame(aNFC, aCardInfo, NumOfStructureStart, NumOfStructureEnd);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Nastavení způsobu kontroly zápisu v NFC_WriteCheck
+
+    @param  aPolicy      Způsob kontroly zápisu
+*/
+/**************************************************************************/
+void NFC_SetVerifyPolicy(TNFCVerifyPolicy aPolicy)
+{
+  NFC_Stats.VerifyPolicy = aPolicy;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Statistiky knihovny
+
+    @param  aStats      Pointer, do kterého se statistiky zkopírují
+*/
+/**************************************************************************/
+void NFC_GetStats(TNFCStats *aStats)
+{
+  *aStats = NFC_Stats;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Vynulování statistik (nastavená politika kontroly zápisu a údaje z inicializace čtečky zůstávají)
+
+*/
+/**************************************************************************/
+void NFC_ResetStats(void)
+{
+  TNFCStats iPuvodni = NFC_Stats;
+  memset(&NFC_Stats, 0, sizeof(NFC_Stats));
+  NFC_Stats.VerifyPolicy = iPuvodni.VerifyPolicy;
+  NFC_Stats.FirmwareVersion = iPuvodni.FirmwareVersion;
+  NFC_Stats.WarmStart = iPuvodni.WarmStart;
+  NFC_Stats.InitTimeUs = iPuvodni.InitTimeUs;
+  NFC_Stats.BootToReadyUs = iPuvodni.BootToReadyUs;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Líné načtení karty - načte jen strukturu TRecipeInfo a připraví pole kroků,
+            jednotlivé kroky se načtou až při prvním přístupu přes NFC_GetTRecipeStep
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+
+    @returns 0 - Data byla nahrána, 1 - Data nelze nacist/nebyla prilozena karta, 2- Nelze autentizovat NFC Tag, 4 - Nelze Alokovat pole,
+             5 - Karta ma adresar zaznamu (NFC_LoadRecord)
+*/
+/**************************************************************************/
+uint8_t NFC_LoadTRecipeInfoLazy(pn532_t *aNFC, TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_LoadTRecipeInfoLazy";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Nacitam line hlavicku NFC Tagu\n");
+  if (aCardInfo->TRecipeStepArrayCreated)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Uvolnuji pole\n");
+    NFC_DeAllocTRecipeStepArray(aCardInfo);
+  }
+  NFC_InitTCardInfo(aCardInfo);
+  uint8_t Error = 2;
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    Error = NFC_SessionOpen(aNFC);
+    if (Error == 0)
+      break;
+  }
+  if (Error != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Data nelze nacist/nebyla prilozena karta.\n");
+    return 1;
+  }
+  NFC_saveUID(aCardInfo, NFC_Session.sUid, NFC_Session.sUidLength);
+
+  Error = NFC_SessionReadBytes(0, TRecipeInfo_Size, (uint8_t *)&aCardInfo->sRecipeInfo);
+  switch (Error)
+  {
+  case 0:
+    break;
+  case 3:
+    NFC_READER_DEBUG(TAGin, "Nelze autentizovat NFC Tag.\n");
+    return 2;
+    break;
+  default:
+    NFC_READER_DEBUG(TAGin, "Data nelze nacist/nebyla prilozena karta.\n");
+    return 1;
+    break;
+  }
+  if (NFC_IsDirectory((uint8_t *)&aCardInfo->sRecipeInfo))
+  {
+    NFC_READER_DEBUG(TAGin, "Karta ma adresar zaznamu.\n");
+    return 5;
+  }
+  if (NFC_RingBlocks != 0 && NFC_SessionFoldTransactions(aCardInfo) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze precist kruh transakci.\n");
+    return 1;
+  }
+  aCardInfo->TRecipeInfoLoaded = true;
+  if (NFC_DrinkCounter >= 0 && NFC_Session.TagType == NFC_TAG_ULTRALIGHT && NFC_HasCounter(NFC_Session.sUid, NFC_Session.sUidLength))
+  {
+    uint32_t iPocitadlo;
+    if (NFC_ReadCounter(aNFC, NFC_DrinkCounter, &iPocitadlo))
+    {
+      aCardInfo->sRecipeInfo.NumOfDrinks = iPocitadlo;
+      aCardInfo->NumOfDrinksCounter = true;
+    }
+    else
+    {
+      // Tag bez citace prikaz odmitne a prejde do stavu IDLE
+      NFC_SessionReselect();
+    }
+  }
+  if (NFC_BudgetBlock != 0 && NFC_Session.TagType == NFC_TAG_CLASSIC)
+  {
+    uint8_t iData[PAGESIZE_CLASSIC];
+    int32_t iRozpocet;
+    if (NFC_SessionAuthenticate(NFC_BudgetBlock) == 0 && NFC_HwClassicReadDataBlock(NFC_Session.NFC, NFC_BudgetBlock, iData) &&
+        NFC_DecodeValueBlock(iData, &iRozpocet))
+    {
+      aCardInfo->sRecipeInfo.ActualBudget = iRozpocet;
+      aCardInfo->ActualBudgetValueBlock = true;
+    }
+  }
+
+  if (NFC_AllocTRecipeStepArray(aCardInfo) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze Alokovat pole.\n");
+    return 4;
+  }
+  aCardInfo->TRecipeStepLazy = true;
+  aCardInfo->TRecipeStepLoaded = aCardInfo->sRecipeInfo.RecipeSteps == 0;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zjistí, jestli je krok v líném režimu již načten
+
+    @param  aCardInfo      aCardInfo struktura
+    @param  NumOfStructure      Číslo kroku od 0
+
+    @returns true - Krok je nacten, false - Krok se musi nacist z karty
+*/
+/**************************************************************************/
+static bool NFC_IsTRecipeStepLoaded(TCardInfo *aCardInfo, size_t NumOfStructure)
+{
+  if (!aCardInfo->TRecipeStepLazy)
+    return true;
+  return __atomic_load_n(&aCardInfo->sRecipeStepLoadedMask[NumOfStructure / 8], __ATOMIC_ACQUIRE) & (1 << (NumOfStructure % 8));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Načtení kroku přes cache relace bez čekání na běžící předčítání
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+    @param  NumOfStructure      Číslo kroku od 0
+    @param  aRecipeStep      Pointer, do kterého se uloží adresa kroku v aCardInfo (může být NULL)
+
+    @returns viz NFC_GetTRecipeStep
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionGetTRecipeStep(pn532_t *aNFC, TCardInfo *aCardInfo, size_t NumOfStructure, TRecipeStep **aRecipeStep)
+{
+  static const char *TAGin = "NFC_SessionGetTRecipeStep";
+  if (!aCardInfo->TRecipeStepArrayCreated)
+  {
+    NFC_READER_DEBUG(TAGin, "Neni vytvoreno pole pro hodnoty!.\n");
+    return 4;
+  }
+  if (NumOfStructure >= aCardInfo->sRecipeInfo.RecipeSteps)
+  {
+    NFC_READER_DEBUG(TAGin, "NumOfStructure je mimo rozsah kroků!.\n");
+    return 5;
+  }
+  if (!NFC_IsTRecipeStepLoaded(aCardInfo, NumOfStructure))
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Donacitam krok %zu.\n", NumOfStructure);
+    uint8_t Error = NFC_SessionEnsure(aNFC, aCardInfo);
+    if (Error != 0)
+      return Error;
+    Error = NFC_SessionReadBytes(TRecipeInfo_Size + NumOfStructure * TRecipeStep_Size, TRecipeStep_Size, (uint8_t *)&aCardInfo->sRecipeStep[NumOfStructure]);
+    if (Error != 0)
+      return Error;
+    __atomic_fetch_or(&aCardInfo->sRecipeStepLoadedMask[NumOfStructure / 8], 1 << (NumOfStructure % 8), __ATOMIC_RELEASE);
+
+    bool iVseNacteno = true;
+    for (size_t i = 0; i < aCardInfo->sRecipeInfo.RecipeSteps; ++i)
+    {
+      if (!NFC_IsTRecipeStepLoaded(aCardInfo, i))
+      {
+        iVseNacteno = false;
+        break;
       }
     }
-    else if ((iuidLength == 7))
+    aCardInfo->TRecipeStepLoaded = iVseNacteno;
+  }
+  if (aRecipeStep != NULL)
+  {
+    *aRecipeStep = &aCardInfo->sRecipeStep[NumOfStructure];
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Vrátí krok receptu, při prvním přístupu ho načte z karty přes cache relace
+            (sousední kroky ve stejném bloku se pak čtou už jen z cache). Pokud krok ještě
+            není načten a běží předčítání, počká na jeho dokončení.
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+    @param  NumOfStructure      Číslo kroku od 0
+    @param  aRecipeStep      Pointer, do kterého se uloží adresa kroku v aCardInfo (může být NULL)
+
+    @returns 0 - Krok je nacten, 2 - Data se neprecetla/nebyla prilozena karta, 3 - Nelze autentizovat NFC tag 4 - Není vytvořeno pole pro pole struktur, 5 - NumOfStructure je mimo rozsah kroků, 6 - Byla prilozena jina karta
+*/
+/**************************************************************************/
+uint8_t NFC_GetTRecipeStep(pn532_t *aNFC, TCardInfo *aCardInfo, size_t NumOfStructure, TRecipeStep **aRecipeStep)
+{
+  NFC_SPAN(__func__);
+  if (NumOfStructure < aCardInfo->sRecipeInfo.RecipeSteps && !NFC_IsTRecipeStepLoaded(aCardInfo, NumOfStructure))
+  {
+    NFC_PrefetchWait();
+  }
+  return NFC_SessionGetTRecipeStep(aNFC, aCardInfo, NumOfStructure, aRecipeStep);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Donačte všechny zatím nenačtené kroky v líném režimu (např. před výpočtem CheckSumu)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+
+    @returns 0 - Vsechny kroky jsou nacteny, jinak chyba z NFC_GetTRecipeStep
+*/
+/**************************************************************************/
+static uint8_t NFC_LoadMissingTRecipeSteps(pn532_t *aNFC, TCardInfo *aCardInfo)
+{
+  for (size_t i = 0; i < aCardInfo->sRecipeInfo.RecipeSteps && !aCardInfo->TRecipeStepLoaded; ++i)
+  {
+    uint8_t Error = NFC_SessionGetTRecipeStep(aNFC, aCardInfo, i, NULL);
+    if (Error != 0)
+      return Error;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Předčtení kroků, které budou následovat po kroku NumOfStructure podle NextID
+            (NextID je index dalšího kroku), do pole kroků v aCardInfo
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura
+    @param  NumOfStructure      Číslo aktuálního kroku od 0
+    @param  Depth      Počet kroků, které se mají předčíst
+
+    @returns 0 - Kroky jsou nacteny, 5 - NumOfStructure je mimo rozsah kroků, jinak chyba z NFC_GetTRecipeStep
+*/
+/**************************************************************************/
+uint8_t NFC_PrefetchTRecipeSteps(pn532_t *aNFC, TCardInfo *aCardInfo, size_t NumOfStructure, uint8_t Depth)
+{
+  static const char *TAGin = "NFC_PrefetchTRecipeSteps";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  TRecipeStep *iKrok;
+  uint8_t Error = NFC_SessionGetTRecipeStep(aNFC, aCardInfo, NumOfStructure, &iKrok);
+  if (Error != 0)
+    return Error;
+  for (uint8_t i = 0; i < Depth; ++i)
+  {
+    size_t iDalsi = iKrok->NextID;
+    if (iDalsi >= aCardInfo->sRecipeInfo.RecipeSteps || iDalsi == NumOfStructure)
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Konec receptu po %d krocich.\n", i);
+      break;
+    }
+    NFC_READER_ALL_DEBUG(TAGin, "Predcitam krok %zu.\n", iDalsi);
+    Error = NFC_SessionGetTRecipeStep(aNFC, aCardInfo, iDalsi, &iKrok);
+    if (Error != 0)
+      return Error;
+    NumOfStructure = iDalsi;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Úloha předčítání kroků na pozadí
+
+    @param  aParam      Nepoužito
+*/
+/**************************************************************************/
+static void NFC_PrefetchTask(void *aParam)
+{
+  (void)aParam;
+  NFC_Prefetch.Error = NFC_PrefetchTRecipeSteps(NFC_Prefetch.NFC, NFC_Prefetch.CardInfo, NFC_Prefetch.NumOfStructure, NFC_Prefetch.Depth);
+  xSemaphoreGive(NFC_Prefetch.Done);
+  vTaskDelete(NULL);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Spustí předčítání následujících kroků na pozadí, zatímco se provádí aktuální krok.
+            Ostatní funkce pracující s kartou na dokončení předčítání počkají.
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo      aCardInfo struktura (musí zůstat platná do dokončení předčítání)
+    @param  NumOfStructure      Číslo aktuálního kroku od 0
+    @param  Depth      Počet kroků, které se mají předčíst
+
+    @returns 0 - Predcitani bezi nebo neni potreba, 1 - Nelze vytvorit ulohu
+*/
+/**************************************************************************/
+uint8_t NFC_PrefetchTRecipeStepsAsync(pn532_t *aNFC, TCardInfo *aCardInfo, size_t NumOfStructure, uint8_t Depth)
+{
+  static const char *TAGin = "NFC_PrefetchTRecipeStepsAsync";
+  NFC_PrefetchWait();
+  if (!aCardInfo->TRecipeStepLazy || aCardInfo->TRecipeStepLoaded)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Vsechny kroky jsou jiz nacteny.\n");
+    return 0;
+  }
+  if (NFC_Prefetch.Done == NULL)
+  {
+    NFC_Prefetch.Done = xSemaphoreCreateBinary();
+    if (NFC_Prefetch.Done == NULL)
+    {
+      NFC_READER_DEBUG(TAGin, "Nelze vytvorit semafor.\n");
+      return 1;
+    }
+  }
+  NFC_Prefetch.NFC = aNFC;
+  NFC_Prefetch.CardInfo = aCardInfo;
+  NFC_Prefetch.NumOfStructure = NumOfStructure;
+  NFC_Prefetch.Depth = Depth;
+  NFC_Prefetch.Error = 0;
+  if (xTaskCreate(NFC_PrefetchTask, "NFC_Prefetch", NFC_PREFETCH_STACK, NULL, NFC_PREFETCH_PRIORITY, &NFC_Prefetch.Task) != pdPASS)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze vytvorit ulohu predcitani.\n");
+    NFC_Prefetch.Task = NULL;
+    return 1;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Počká na dokončení předčítání na pozadí (z úlohy předčítání se vrací hned)
+
+    @returns 0 - Predcitani neprobihalo nebo probehlo v poradku, jinak chyba z NFC_PrefetchTRecipeSteps
+*/
+/**************************************************************************/
+uint8_t NFC_PrefetchWait(void)
+{
+  if (NFC_Prefetch.Task == NULL || NFC_Prefetch.Task == xTaskGetCurrentTaskHandle())
+  {
+    return 0;
+  }
+  xSemaphoreTake(NFC_Prefetch.Done, portMAX_DELAY);
+  NFC_Prefetch.Task = NULL;
+  return NFC_Prefetch.Error;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Vytvoření obrazu dat karty (TRecipeInfo a pole TRecipeStep) z TCardInfo struktury
+
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  aImage Pointer na obraz karty
+
+    @returns    0 - Obraz se vytvoril, 1 - Neni nactena TRecipeInfo struktura, 2 - Nejsou nactena data kroku
+*/
+/**************************************************************************/
+uint8_t NFC_CreateImageFromCardInfo(TCardInfo *aCardInfo, TNFCImage *aImage)
+{
+  static const char *TAGin = "NFC_CreateImageFromCardInfo";
+  NFC_PrefetchWait();
+  if (!aCardInfo->TRecipeInfoLoaded)
+  {
+    NFC_READER_DEBUG(TAGin, "Neni nactena TRecipeInfo struktura.\n");
+    return 1;
+  }
+  if (aCardInfo->sRecipeInfo.RecipeSteps > 0 && (!aCardInfo->TRecipeStepArrayCreated || (aCardInfo->TRecipeStepLazy && !aCardInfo->TRecipeStepLoaded)))
+  {
+    NFC_READER_DEBUG(TAGin, "Nejsou nactena data kroku.\n");
+    return 2;
+  }
+  return NFC_CreateImageFromRecipe(aImage, &aCardInfo->sRecipeInfo, aCardInfo->sRecipeStep, aCardInfo->sRecipeInfo.RecipeSteps);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Vytvoření obrazu dat karty přímo z TRecipeInfo a pole TRecipeStep bez alokace,
+            RecipeSteps a CheckSum v obrazu se nastaví podle kroků
+
+    @param  aImage Pointer na obraz karty
+    @param  aRecipeInfo Pointer na TRecipeInfo strukturu
+    @param  aRecipeStep Pointer na pole Struktur TRecipeStep
+    @param  SizeOfRecipeSteps Počet struktur
+
+    @returns    0 - Obraz se vytvoril, 3 - Prilis mnoho kroku, 4 - aRecipeStep je NULL
+*/
+/**************************************************************************/
+uint8_t NFC_CreateImageFromRecipe(TNFCImage *aImage, TRecipeInfo *aRecipeInfo, TRecipeStep *aRecipeStep, size_t SizeOfRecipeSteps)
+{
+  static const char *TAGin = "NFC_CreateImageFromRecipe";
+  if (SizeOfRecipeSteps > 255)
+  {
+    NFC_READER_DEBUG(TAGin, "Prilis mnoho kroku.\n");
+    return 3;
+  }
+  if (SizeOfRecipeSteps > 0 && aRecipeStep == NULL)
+  {
+    NFC_READER_DEBUG(TAGin, "aRecipeStep je NULL.\n");
+    return 4;
+  }
+  TRecipeInfo *iInfo = (TRecipeInfo *)aImage->Data;
+  *iInfo = *aRecipeInfo;
+  iInfo->RecipeSteps = SizeOfRecipeSteps;
+  memmove(aImage->Data + TRecipeInfo_Size, aRecipeStep, SizeOfRecipeSteps * TRecipeStep_Size);
+
+  size_t iDelka = TRecipeInfo_Size + SizeOfRecipeSteps * TRecipeStep_Size;
+  aImage->Size = (iDelka + PAGESIZE_CLASSIC - 1) / PAGESIZE_CLASSIC * PAGESIZE_CLASSIC;
+  memset(aImage->Data + iDelka, 0, aImage->Size - iDelka);
+
+  TCardInfo iPohled;
+  iPohled.sRecipeInfo = *iInfo;
+  iPohled.sRecipeStep = (TRecipeStep *)(aImage->Data + TRecipeInfo_Size);
+  iInfo->CheckSum = NFC_GetCheckSum(iPohled);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zahájení hromadného zápisu karet, připraví obraz první karty
+
+    @param  aProv Pointer na stav hromadného zápisu
+    @param  aNext Funkce, která připraví obraz další karty (vrací false, pokud už další není)
+    @param  aContext Kontext předaný funkci aNext
+
+    @returns    0 - Prvni obraz je pripraven, 1 - Neni zadny obraz k zapisu
+*/
+/**************************************************************************/
+uint8_t NFC_ProvisionBegin(TNFCProvisioning *aProv, TNFCProvisionNext aNext, void *aContext)
+{
+  static const char *TAGin = "NFC_ProvisionBegin";
+  NFC_READER_DEBUG(TAGin, "Zahajuji hromadny zapis karet.\n");
+  aProv->Next = aNext;
+  aProv->Context = aContext;
+  aProv->Current = 0;
+  aProv->BackState = 0;
+  aProv->CardsOk = aProv->CardsFailed = aProv->BlocksWritten = aProv->BlocksSkipped = 0;
+  aProv->StartTime = esp_timer_get_time();
+  aProv->NextReady = aNext(&aProv->sImage[0], aContext);
+  if (!aProv->NextReady)
+  {
+    NFC_READER_DEBUG(TAGin, "Neni zadny obraz k zapisu.\n");
+    return 1;
+  }
+  return 0;
+}
+
+/*!
+Úloha, která připravuje obraz další karty během RF komunikace s aktuální kartou
+*/
+static TNFCProvisioning *NFC_ProvisionBuilding = NULL;
+static SemaphoreHandle_t NFC_ProvisionBuilt = NULL;
+
+static void NFC_ProvisionBuildNext(TNFCProvisioning *aProv)
+{
+  // BackState: 0 - zadny obraz, 1 - obraz pripraven, 2 - dalsi obraz uz neni
+  aProv->BackState = aProv->Next(&aProv->sImage[aProv->Current ^ 1], aProv->Context) ? 1 : 2;
+}
+
+static void NFC_ProvisionBuildTask(void *aParam)
+{
+  (void)aParam;
+  NFC_ProvisionBuildNext(NFC_ProvisionBuilding);
+  xSemaphoreGive(NFC_ProvisionBuilt);
+  vTaskDelete(NULL);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zápis připraveného obrazu na jednu kartu: detekce -> zápis (bloky se stejným obsahem
+            se přeskočí) -> kontrola -> odebrání karty. Obraz další karty se během RF komunikace
+            připravuje v samostatné úloze.
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aProv Pointer na stav hromadného zápisu
+
+    @returns    0 - Karta se zapsala, 1 - Neni dalsi obraz k zapisu, 2 - Karta nebyla prilozena, 3 - Nelze autentizovat NFC tag, 4 - Data se nezapsala, 5 - Data na karte se lisi po zapisu,
+                6 - Karta se zapsala, ale do NFC_REMOVAL_TIMEOUT nebyla odebrana
+*/
+/**************************************************************************/
+uint8_t NFC_ProvisionCard(pn532_t *aNFC, TNFCProvisioning *aProv)
+{
+  static const char *TAGin = "NFC_ProvisionCard";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  if (!aProv->NextReady)
+  {
+    NFC_READER_DEBUG(TAGin, "Neni dalsi obraz k zapisu.\n");
+    return 1;
+  }
+  uint8_t Error = NFC_SessionOpen(aNFC);
+  if (Error != 0)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+    return 2;
+  }
+
+  if (NFC_ProvisionBuilt == NULL)
+  {
+    NFC_ProvisionBuilt = xSemaphoreCreateBinary();
+  }
+  NFC_ProvisionBuilding = aProv;
+  bool iStavim = aProv->BackState == 0 && NFC_ProvisionBuilt != NULL && xTaskCreate(NFC_ProvisionBuildTask, "NFC_Provision", NFC_PREFETCH_STACK, NULL, NFC_PREFETCH_PRIORITY, NULL) == pdPASS;
+
+  TNFCImage *iImage = &aProv->sImage[aProv->Current];
+  Error = NFC_SessionWriteBlocks(0, iImage->Data, iImage->Size / PAGESIZE_CLASSIC, &aProv->BlocksWritten, &aProv->BlocksSkipped);
+
+  if (iStavim)
+  {
+    xSemaphoreTake(NFC_ProvisionBuilt, portMAX_DELAY);
+  }
+  else if (aProv->BackState == 0)
+  {
+    NFC_ProvisionBuildNext(aProv);
+  }
+
+  if (Error != 0)
+  {
+    // Obraz zustava aktualni pro dalsi kartu, pripraveny obraz se pouzije az po nem
+    NFC_READER_DEBUG(TAGin, "Kartu se nepodarilo zapsat, chyba %d.\n", Error);
+    ++aProv->CardsFailed;
+    NFC_SessionClose();
+    return Error;
+  }
+  ++aProv->CardsOk;
+  aProv->Current ^= 1;
+  aProv->NextReady = aProv->BackState == 1;
+  aProv->BackState = 0;
+  NFC_READER_DEBUG(TAGin, "Karta zapsana, %lu karet/min.\n", (unsigned long)NFC_ProvisionCardsPerMinute(aProv));
+
+  NFC_SessionClose();
+  int64_t iKonec = esp_timer_get_time() + NFC_REMOVAL_TIMEOUT * 1000LL;
+  while (NFC_isCardReady(aNFC))
+  {
+    if (esp_timer_get_time() >= iKonec)
+    {
+      NFC_READER_DEBUG(TAGin, "Karta nebyla odebrana.\n");
+      return 6;
+    }
+    NFC_READER_ALL_DEBUG(TAGin, "Cekam na odebrani karty.\n");
+    vTaskDelay(pdMS_TO_TICKS(NFC_REMOVAL_POLL_MS));
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Rychlost hromadného zápisu
+
+    @param  aProv Pointer na stav hromadného zápisu
+
+    @returns    Pocet uspesne zapsanych karet za minutu od NFC_ProvisionBegin
+*/
+/**************************************************************************/
+uint32_t NFC_ProvisionCardsPerMinute(TNFCProvisioning *aProv)
+{
+  int64_t iCas = esp_timer_get_time() - aProv->StartTime;
+  if (iCas <= 0)
+    return 0;
+  return (uint32_t)((int64_t)aProv->CardsOk * 60000000LL / iCas);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Výpis přesného obsahu karty (UID, typ tagu, surové bloky a dekódované TRecipeInfo)
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aDump      Pointer na výpis karty
+
+    @returns 0 - Karta se vypsala, 1 - Data nelze nacist/nebyla prilozena karta, 2 - Nelze autentizovat NFC Tag
+*/
+/**************************************************************************/
+uint8_t NFC_DumpCard(pn532_t *aNFC, TNFCCardDump *aDump)
+{
+  static const char *TAGin = "NFC_DumpCard";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Vypisuji obsah karty.\n");
+  memset(aDump, 0, sizeof(*aDump));
+  aDump->Version = NFC_DUMP_VERSION;
+  uint8_t Error = 2;
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    Error = NFC_SessionOpen(aNFC);
+    if (Error == 0 || Error == 4)
+      break;
+  }
+  if (Error != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+    return 1;
+  }
+  aDump->TagType = NFC_Session.TagType;
+  aDump->sUidLength = NFC_Session.sUidLength;
+  memcpy(aDump->sUid, NFC_Session.sUid, NFC_Session.sUidLength);
+
+  Error = NFC_SessionReadBytes(0, TRecipeInfo_Size, (uint8_t *)&aDump->sRecipeInfo);
+  if (Error == 0)
+  {
+    size_t iDelka = TRecipeInfo_Size + aDump->sRecipeInfo.RecipeSteps * TRecipeStep_Size;
+    aDump->Blocks = (iDelka + PAGESIZE_CLASSIC - 1) / PAGESIZE_CLASSIC;
+    for (size_t i = 0; i < aDump->Blocks && Error == 0; ++i)
+    {
+      uint8_t *iBlok;
+      Error = NFC_SessionReadBlock(i, &iBlok);
+      if (Error == 0)
+        memcpy(aDump->Data + i * PAGESIZE_CLASSIC, iBlok, PAGESIZE_CLASSIC);
+    }
+  }
+  NFC_SessionClose();
+  switch (Error)
+  {
+  case 0:
+    break;
+  case 3:
+    NFC_READER_DEBUG(TAGin, "Nelze autentizovat NFC Tag.\n");
+    return 2;
+    break;
+  default:
+    NFC_READER_DEBUG(TAGin, "Data nelze nacist.\n");
+    return 1;
+    break;
+  }
+
+  TCardInfo iPohled;
+  iPohled.sRecipeInfo = aDump->sRecipeInfo;
+  iPohled.sRecipeStep = (TRecipeStep *)(aDump->Data + TRecipeInfo_Size);
+  if (NFC_GetCheckSum(iPohled) == aDump->sRecipeInfo.CheckSum)
+  {
+    aDump->Flags |= NFC_DUMP_CHECKSUM_OK;
+  }
+  NFC_READER_DEBUG(TAGin, "Vypsano %d bloku.\n", aDump->Blocks);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Obnovení obsahu karty z výpisu, bloky se stejným obsahem se přeskočí
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aDump      Pointer na výpis karty
+    @param  aSameUid      Obnovit jen na kartu se stejným UID, jako má výpis
+
+    @returns 0 - Karta se obnovila, 1 - Nebyla prilozena karta, 2 - Nelze autentizovat NFC Tag, 3 - Data se nezapsala, 4 - Jina karta nebo typ tagu nez ve vypisu
+*/
+/**************************************************************************/
+uint8_t NFC_RestoreCard(pn532_t *aNFC, TNFCCardDump *aDump, bool aSameUid)
+{
+  static const char *TAGin = "NFC_RestoreCard";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Obnovuji obsah karty z vypisu.\n");
+  if (NFC_SessionOpen(aNFC) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+    return 1;
+  }
+  if (NFC_Session.TagType != aDump->TagType ||
+      (aSameUid && (NFC_Session.sUidLength != aDump->sUidLength || memcmp(NFC_Session.sUid, aDump->sUid, aDump->sUidLength) != 0)))
+  {
+    NFC_READER_DEBUG(TAGin, "Prilozena karta neodpovida vypisu.\n");
+    NFC_SessionClose();
+    return 4;
+  }
+  uint8_t Error = NFC_SessionWriteBlocks(0, aDump->Data, aDump->Blocks, NULL, NULL);
+  NFC_SessionClose();
+  switch (Error)
+  {
+  case 0:
+    NFC_READER_DEBUG(TAGin, "Karta obnovena.\n");
+    return 0;
+  case 3:
+    NFC_READER_DEBUG(TAGin, "Nelze autentizovat NFC Tag.\n");
+    return 2;
+  default:
+    NFC_READER_DEBUG(TAGin, "Data se nezapsala.\n");
+    return 3;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Dekódování výpisu karty do TCardInfo struktury (stejně jako po NFC_LoadAllData)
+
+    @param  aDump      Pointer na výpis karty
+    @param  aCardInfo Pointer na TCardInfo strukturu
+
+    @returns 0 - Uspesne dekodovani, 1 - Nelze alokovat pole
+*/
+/**************************************************************************/
+uint8_t NFC_CardDumpToCardInfo(TNFCCardDump *aDump, TCardInfo *aCardInfo)
+{
+  NFC_PrefetchWait();
+  if (aCardInfo->TRecipeStepArrayCreated)
+  {
+    NFC_DeAllocTRecipeStepArray(aCardInfo);
+  }
+  NFC_InitTCardInfo(aCardInfo);
+  aCardInfo->sRecipeInfo = aDump->sRecipeInfo;
+  aCardInfo->TRecipeInfoLoaded = true;
+  NFC_saveUID(aCardInfo, aDump->sUid, aDump->sUidLength);
+  if (NFC_AllocTRecipeStepArray(aCardInfo) != 0)
+    return 1;
+  memcpy(aCardInfo->sRecipeStep, aDump->Data + TRecipeInfo_Size, aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size);
+  aCardInfo->TRecipeStepLoaded = true;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zahájení záznamu všech operací se čtečkou do předem alokovaného bufferu
+
+    @param  aTrace      Pointer na záznam
+    @param  aFrames      Buffer rámců
+    @param  aCapacity      Počet rámců v bufferu
+*/
+/**************************************************************************/
+void NFC_TraceRecordStart(TNFCTrace *aTrace, TNFCTraceFrame *aFrames, size_t aCapacity)
+{
+  NFC_PrefetchWait();
+  memset(aTrace, 0, sizeof(*aTrace));
+  aTrace->sFrame = aFrames;
+  aTrace->Capacity = aCapacity;
+  aTrace->Mode = NFC_TRACE_RECORD;
+  aTrace->StartTime = esp_timer_get_time();
+  NFC_Trace = aTrace;
+}
+
+#if NFC_READER_EMULATOR_EN
+/**************************************************************************/
+/*!
+    @brief  Zahájení přehrávání záznamu - operace se čtečkou se nevolají, odpovědi se berou ze záznamu.
+            Operace se párují s rámci podle operace a argumentu, rámce navíc se přeskočí (Skipped)
+            a operace bez rámce v okně NFC_TRACE_RESYNC selže (Mismatches).
+
+    @param  aTrace      Pointer na záznam
+    @param  aFrames      Rámce záznamu
+    @param  aCount      Počet rámců
+    @param  aReplayTiming      Dodržet zaznamenanou dobu trvání operací
+*/
+/**************************************************************************/
+void NFC_TraceReplayStart(TNFCTrace *aTrace, TNFCTraceFrame *aFrames, size_t aCount, bool aReplayTiming)
+{
+  NFC_PrefetchWait();
+  memset(aTrace, 0, sizeof(*aTrace));
+  aTrace->sFrame = aFrames;
+  aTrace->Capacity = aTrace->Count = aCount;
+  aTrace->Mode = NFC_TRACE_REPLAY;
+  aTrace->ReplayTiming = aReplayTiming;
+  aTrace->StartTime = esp_timer_get_time();
+  NFC_Session.Active = false;
+  NFC_SessionInvalidateCache();
+  NFC_Trace = aTrace;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Ukončení záznamu nebo přehrávání
+
+*/
+/**************************************************************************/
+void NFC_TraceStop(void)
+{
+  NFC_PrefetchWait();
+  NFC_Trace = NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Součet doby trvání všech rámců záznamu (čas strávený v komunikaci se čtečkou)
+
+    @param  aTrace      Pointer na záznam
+
+    @returns Doba v us
+*/
+/**************************************************************************/
+uint64_t NFC_TraceDuration(TNFCTrace *aTrace)
+{
+  uint64_t iCas = 0;
+  for (size_t i = 0; i < aTrace->Count; ++i)
+  {
+    iCas += aTrace->sFrame[i].Duration;
+  }
+  return iCas;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Načtení adresáře záznamů z bloků na začátku dat v otevřené relaci
+
+    @param  aDirectory      Pointer, do kterého se adresář uloží
+
+    @returns 0 - Adresar se nacetl, 1 - Data nelze nacist, 2 - Nelze autentizovat NFC tag, 3 - Karta nema adresar zaznamu
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionReadDirectory(TNFCDirectory *aDirectory)
+{
+  uint8_t Error = NFC_SessionReadBytes(0, sizeof(TNFCDirectory), (uint8_t *)aDirectory);
+  if (Error != 0)
+    return Error == 3 ? 2 : 1;
+  if (!NFC_IsDirectory((uint8_t *)aDirectory))
+    return 3;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Rozpozná adresář záznamů v prvním 16B bloku dat - kontroluje se NFC_DIRECTORY_MAGIC, počet záznamů
+            a umístění záznamů, které jsou v prvním bloku, aby se karta s adresářem nenačetla jako jeden recept
+
+    @param  aData      Prvni 16B blok dat karty
+
+    @returns true - Blok je zacatek adresare zaznamu
+*/
+/**************************************************************************/
+static bool NFC_IsDirectory(const uint8_t *aData)
+{
+  TNFCDirectory iAdresar;
+  memset(&iAdresar, 0, sizeof(iAdresar));
+  memcpy(&iAdresar, aData, PAGESIZE_CLASSIC);
+  if (iAdresar.Magic != NFC_DIRECTORY_MAGIC || iAdresar.Count > NFC_DIRECTORY_RECORDS || iAdresar.CapacityBlocks <= NFC_DIRECTORY_BLOCKS)
+    return false;
+  size_t iVBloku = (PAGESIZE_CLASSIC - offsetof(TNFCDirectory, Entry)) / sizeof(TNFCDirectoryEntry);
+  for (size_t i = 0; i < iAdresar.Count && i < iVBloku; ++i)
+  {
+    if (iAdresar.Entry[i].Block < NFC_DIRECTORY_BLOCKS || iAdresar.Entry[i].Block + iAdresar.Entry[i].Blocks > iAdresar.CapacityBlocks)
+      return false;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Vytvoření prázdného adresáře záznamů na kartě - karta pak obsahuje více receptů
+            (NFC_LoadRecord, NFC_WriteRecord) místo jednoho receptu od začátku dat
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCapacityBlocks      Datová kapacita karty v 16B blocích (Mifare Classic 1K 47, NTAG216 54)
+
+    @returns 0 - Adresar se vytvoril, 1 - Nebyla prilozena karta, 2 - Nelze autentizovat NFC tag, 3 - Data se nezapsala, 4 - Spatna kapacita
+*/
+/**************************************************************************/
+uint8_t NFC_FormatDirectory(pn532_t *aNFC, uint8_t aCapacityBlocks)
+{
+  static const char *TAGin = "NFC_FormatDirectory";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  if (aCapacityBlocks <= NFC_DIRECTORY_BLOCKS)
+    return 4;
+  uint8_t Error = 2;
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    Error = NFC_SessionOpen(aNFC);
+    if (Error == 0 || Error == 4)
+      break;
+  }
+  if (Error != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+    return 1;
+  }
+  TNFCDirectory iAdresar;
+  memset(&iAdresar, 0, sizeof(iAdresar));
+  iAdresar.Magic = NFC_DIRECTORY_MAGIC;
+  iAdresar.CapacityBlocks = aCapacityBlocks;
+  Error = NFC_SessionWriteBlocks(0, (uint8_t *)&iAdresar, NFC_DIRECTORY_BLOCKS, NULL, NULL);
+  NFC_SessionClose();
+  if (Error != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Adresar se nezapsal.\n");
+    return Error == 3 ? 2 : 3;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Načtení záznamu z karty s adresářem v otevřené relaci (NFC_LoadRecord)
+
+    @param  aRecordId      ID záznamu (typ stroje)
+    @param  aCardInfo Pointer na TCardInfo strukturu
+
+    @returns Stejne navratove hodnoty jako NFC_LoadRecord
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionLoadRecord(uint16_t aRecordId, TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_SessionLoadRecord";
+  TNFCDirectory iAdresar;
+  uint8_t Error = NFC_SessionReadDirectory(&iAdresar);
+  if (Error != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze nacist adresar (%d).\n", Error);
+    return Error;
+  }
+  TNFCDirectoryEntry *iZaznam = NULL;
+  for (size_t i = 0; i < iAdresar.Count; ++i)
+  {
+    if (iAdresar.Entry[i].ID == aRecordId)
     {
-      NFC_READER_ALL_DEBUG(TAGin, "NFC ultralight\n");
+      iZaznam = &iAdresar.Entry[i];
+      break;
+    }
+  }
+  if (iZaznam == NULL)
+  {
+    NFC_READER_DEBUG(TAGin, "Zaznam %d na karte neni.\n", aRecordId);
+    return 4;
+  }
+  size_t iZacatek = iZaznam->Block * PAGESIZE_CLASSIC;
+  Error = NFC_SessionReadBytes(iZacatek, TRecipeInfo_Size, (uint8_t *)&aCardInfo->sRecipeInfo);
+  if (Error != 0)
+    return Error == 3 ? 2 : 1;
+  if (TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size > iZaznam->Blocks * PAGESIZE_CLASSIC)
+  {
+    NFC_READER_DEBUG(TAGin, "Zaznam je delsi nez jeho misto na karte.\n");
+    return 5;
+  }
+  aCardInfo->TRecipeInfoLoaded = true;
+  aCardInfo->RecordBlock = iZaznam->Block;
+  if (NFC_AllocTRecipeStepArray(aCardInfo) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze Alokovat pole.\n");
+    return 6;
+  }
+  Error = NFC_SessionReadBytes(iZacatek + TRecipeInfo_Size, aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size, (uint8_t *)aCardInfo->sRecipeStep);
+  if (Error != 0)
+    return Error == 3 ? 2 : 1;
+  aCardInfo->TRecipeStepLoaded = true;
+  return 0;
+}
 
-      uint8_t iData[16];
-      size_t PosledniBunka = (TRecipeInfo_Size - 1) / 16;
-      for (int i = 0; i <= PosledniBunka; ++i)
-      {
-        uint8_t success = pn532_mifareultralight_ReadPage(aNFC, (i * 4) + OFFSETDATA_ULTRALIGHT, iData);
-        if (success)
-        {
-          // Data seems to have been read ... spit it out
-          NFC_READER_ALL_DEBUG(TAGin, "\nCtu Block %d: ", i);
-          for (int k = 0; k < 16; ++k)
-          {
-            NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
-          }
-          NFC_READER_ALL_DEBUG("", "\n");
-          for (int k = 0; k < 16; ++k)
-          {
-            if (k + i * 16 < TRecipeInfo_Size)
-            {
-              *(((uint8_t *)&aCardInfo->sRecipeInfo) + k + i * 16) = iData[k];
-              // NFC_READER_ALL_DEBUG("", "%d: %d, ", k, *(((uint8_t *)&aCardInfo->sRecipeInfo) + k + i * 16));
-            }
-            else
-            {
-              break;
-            }
-          }
-        }
-        else
-        {
-          NFC_READER_ALL_DEBUG(TAGin, "\nNelze precist. Chyba %d\n", success);
-          return 2;
-        }
-      }
+/**************************************************************************/
+/*!
+    @brief  Načtení jednoho záznamu (receptu) z karty s adresářem - přečte se jen adresář a bloky záznamu,
+            doba načtení nezávisí na počtu záznamů na kartě. Recept si pamatuje blok záznamu (RecordBlock),
+            zapisuje se zpět jen přes NFC_WriteRecord - funkce pro zápis od začátku dat ho odmítnou.
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aRecordId      ID záznamu (typ stroje)
+    @param  aCardInfo Pointer na TCardInfo strukturu
+
+    @returns 0 - Zaznam se nacetl, 1 - Data nelze nacist/nebyla prilozena karta, 2 - Nelze autentizovat NFC tag,
+             3 - Karta nema adresar zaznamu, 4 - Zaznam na karte neni, 5 - Poskozeny zaznam, 6 - Nelze alokovat pole
+*/
+/**************************************************************************/
+uint8_t NFC_LoadRecord(pn532_t *aNFC, uint16_t aRecordId, TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_LoadRecord";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Nacitam zaznam %d.\n", aRecordId);
+  if (aCardInfo->TRecipeStepArrayCreated)
+  {
+    NFC_DeAllocTRecipeStepArray(aCardInfo);
+  }
+  NFC_InitTCardInfo(aCardInfo);
+  uint8_t Error = 2;
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    Error = NFC_SessionOpen(aNFC);
+    if (Error == 0 || Error == 4)
+      break;
+  }
+  if (Error != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Data nelze nacist/nebyla prilozena karta.\n");
+    return 1;
+  }
+  NFC_saveUID(aCardInfo, NFC_Session.sUid, NFC_Session.sUidLength);
+  Error = NFC_SessionLoadRecord(aRecordId, aCardInfo);
+  NFC_SessionClose();
+  return Error;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zápis záznamu na kartu s adresářem v otevřené relaci (NFC_WriteRecord)
+
+    @param  aRecordId      ID záznamu (typ stroje)
+    @param  aImage      Obraz receptu
+
+    @returns Stejne navratove hodnoty jako NFC_WriteRecord
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionWriteRecord(uint16_t aRecordId, TNFCImage *aImage)
+{
+  static const char *TAGin = "NFC_SessionWriteRecord";
+  TNFCDirectory iAdresar;
+  uint8_t Error = NFC_SessionReadDirectory(&iAdresar);
+  if (Error != 0)
+    return Error;
+
+  uint8_t iBloku = aImage->Size / PAGESIZE_CLASSIC;
+  uint8_t iKonec = NFC_DIRECTORY_BLOCKS;
+  TNFCDirectoryEntry *iZaznam = NULL;
+  for (size_t i = 0; i < iAdresar.Count; ++i)
+  {
+    if (iAdresar.Entry[i].ID == aRecordId)
+      iZaznam = &iAdresar.Entry[i];
+    if (iAdresar.Entry[i].Block + iAdresar.Entry[i].Blocks > iKonec)
+      iKonec = iAdresar.Entry[i].Block + iAdresar.Entry[i].Blocks;
+  }
+  if (iZaznam == NULL || iZaznam->Blocks < iBloku)
+  {
+    // Novy nebo delsi zaznam se pripise za posledni, puvodni misto zustane volne do preformatovani
+    if ((iZaznam == NULL && iAdresar.Count >= NFC_DIRECTORY_RECORDS) || iKonec + iBloku > iAdresar.CapacityBlocks)
+    {
+      NFC_READER_DEBUG(TAGin, "Na karte neni misto.\n");
+      return 4;
     }
-    else
+    if (iZaznam == NULL)
     {
-      NFC_READER_DEBUG(TAGin, "Na kartu z karty precist hodnoty\n");
+      iZaznam = &iAdresar.Entry[iAdresar.Count++];
+      iZaznam->ID = aRecordId;
     }
+    iZaznam->Block = iKonec;
+    iZaznam->Blocks = iBloku;
   }
-  else
+  Error = NFC_SessionWriteBlocks(iZaznam->Block, aImage->Data, iBloku, NULL, NULL);
+  if (Error == 0)
+    Error = NFC_SessionWriteBlocks(0, (uint8_t *)&iAdresar, NFC_DIRECTORY_BLOCKS, NULL, NULL);
+  if (Error != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Zaznam se nezapsal.\n");
+    return Error == 3 ? 2 : 5;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zápis jednoho záznamu na kartu s adresářem - vejde-li se záznam na své místo, přepíše se na místě,
+            jinak se připíše za poslední záznam. Ostatní záznamy se nepřepisují, adresář se zapíše po datech záznamu.
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aRecordId      ID záznamu (typ stroje)
+    @param  aCardInfo Pointer na TCardInfo strukturu s receptem
+
+    @returns 0 - Zaznam se zapsal, 1 - Nebyla prilozena karta, 2 - Nelze autentizovat NFC tag, 3 - Karta nema adresar zaznamu,
+             4 - Na karte neni misto, 5 - Data se nezapsala, 6 - Recept neni nacten, 7 - Nelze alokovat pamet
+*/
+/**************************************************************************/
+uint8_t NFC_WriteRecord(pn532_t *aNFC, uint16_t aRecordId, TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_WriteRecord";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  NFC_READER_DEBUG(TAGin, "Zapisuji zaznam %d.\n", aRecordId);
+  TNFCImage *iObraz = (TNFCImage *)malloc(sizeof(TNFCImage));
+  if (iObraz == NULL)
+    return 7;
+  if (NFC_CreateImageFromCardInfo(aCardInfo, iObraz) != 0)
+  {
+    free(iObraz);
+    return 6;
+  }
+  uint8_t Error = 2;
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    Error = NFC_SessionOpen(aNFC);
+    if (Error == 0 || Error == 4)
+      break;
+  }
+  if (Error != 0)
+  {
+    free(iObraz);
+    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+    return 1;
+  }
+  Error = NFC_SessionWriteRecord(aRecordId, iObraz);
+  NFC_SessionClose();
+  free(iObraz);
+  return Error;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Volba obsluhy tagu - NFC_TAG_ISODEP obsluhuje všechny karty jako ISO14443-4 (DESFire EV2/EV3,
+            NTAG 424) přes APDU s dlouhými rámci, recept se přenese jedním nebo dvěma příkazy.
+            NFC_TAG_FELICA hledá FeliCa karty (212/424 kbps) a data přenáší po více blocích (NFC_SetFelicaConfig).
+            Ostatní hodnoty vrátí výchozí volbu podle ATQA/SAK a GET_VERSION (Mifare Classic, Ultralight/NTAG, ISO-DEP).
+
+    @param  aTagType      Typ tagu
+*/
+/**************************************************************************/
+void NFC_SetTagBackend(TNFCTagType aTagType)
+{
+  NFC_PrefetchWait();
+  NFC_TagBackend = aTagType == NFC_TAG_ISODEP || aTagType == NFC_TAG_FELICA ? aTagType : NFC_TAG_UNKNOWN;
+  NFC_SessionClose();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Volba souboru s daty v aplikaci NDEF na ISO-DEP kartě
+
+    @param  aFileId      Identifikátor souboru (výchozí 0xE104 - NDEF soubor)
+*/
+/**************************************************************************/
+void NFC_SetIsoDepFile(uint16_t aFileId)
+{
+  NFC_PrefetchWait();
+  NFC_IsoDepFile = aFileId;
+  NFC_SessionClose();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Nastavení FeliCa obsluhy - služba s daty, počet bloků v jednom příkazu a přenosová rychlost
+
+    @param  aConfig      Pointer na nastavení (počty bloků se omezí na 1 - NFC_FELICA_MAX_BLOCKS)
+*/
+/**************************************************************************/
+void NFC_SetFelicaConfig(const TNFCFelicaConfig *aConfig)
+{
+  NFC_PrefetchWait();
+  NFC_Felica = *aConfig;
+  if (NFC_Felica.ReadBlocks < 1 || NFC_Felica.ReadBlocks > NFC_FELICA_MAX_BLOCKS)
+    NFC_Felica.ReadBlocks = NFC_Felica.ReadBlocks < 1 ? 1 : NFC_FELICA_MAX_BLOCKS;
+  if (NFC_Felica.WriteBlocks < 1 || NFC_Felica.WriteBlocks > NFC_FELICA_MAX_BLOCKS)
+    NFC_Felica.WriteBlocks = NFC_Felica.WriteBlocks < 1 ? 1 : NFC_FELICA_MAX_BLOCKS;
+  NFC_SessionClose();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Nastavení RF profilu čtečky (RFConfiguration) - počet pokusů InListPassiveTarget určuje,
+            jak rychle se vrátí dotaz bez přiložené karty (PN532 jinak zkouší do timeoutu).
+            Výchozí profil omezuje pokusy na NFC_RF_RETRIES_PASSIVE, dotaz bez karty se tak vrátí bez čekání
+            na timeout. MaxRetriesPassive 0xFF vrací chování PN532 (hledá do timeoutu). Ostatní hodnoty
+            výchozího profilu odpovídají PN532. Profil se použije při NFC_Reader_Init, s aNFC se zapíše hned.
+
+    @param  aNFC      Pointer na NFC strukturu (NULL - profil se jen uloží)
+    @param  aConfig      Pointer na RF profil
+
+    @returns 0 - Profil se nastavil, 1 - Ctecka profil neprijala
+*/
+/**************************************************************************/
+uint8_t NFC_SetRFConfig(pn532_t *aNFC, const TNFCRFConfig *aConfig)
+{
+  NFC_PrefetchWait();
+  NFC_RFConfig = *aConfig;
+  if (aNFC == NULL || NFC_EMULATOR_ACTIVE)
+    return 0;
+  return NFC_RFConfigApply(aNFC) ? 0 : 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Připojení výstupu IRQ PN532 - úloha čtečky při čekání na odpověď spí do přerušení místo
+            dotazování stavu čtečky. Platí pro všechny příkazy PN532, které skládá knihovna, včetně
+            autentizace, čtení a zápisu bloků (NFC_DrvDataExchange).
+
+    @param  aGpio      GPIO s výstupem IRQ (aktivní v nule), -1 - čekání dotazy na stav
+
+    @returns 0 - IRQ se nastavilo, 1 - GPIO nelze nastavit
+*/
+/**************************************************************************/
+uint8_t NFC_SetIrqPin(int aGpio)
+{
+  static const char *TAGin = "NFC_SetIrqPin";
+  NFC_PrefetchWait();
+  if (NFC_IrqPin >= 0)
+  {
+    gpio_isr_handler_remove(NFC_IrqPin);
+    NFC_IrqPin = -1;
+  }
+  if (aGpio < 0)
+    return 0;
+  if (NFC_IrqSemaphore == NULL)
+    NFC_IrqSemaphore = xSemaphoreCreateBinary();
+  if (NFC_IrqSemaphore == NULL)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze vytvorit semafor.\n");
+    return 1;
+  }
+  gpio_config_t iNastaveni = {.pin_bit_mask = 1ULL << aGpio,
+                              .mode = GPIO_MODE_INPUT,
+                              .pull_up_en = GPIO_PULLUP_ENABLE,
+                              .pull_down_en = GPIO_PULLDOWN_DISABLE,
+                              .intr_type = GPIO_INTR_NEGEDGE};
+  esp_err_t iChyba = gpio_config(&iNastaveni);
+  if (iChyba == ESP_OK)
+  {
+    // Sluzbu preruseni GPIO uz mohla nainstalovat aplikace
+    iChyba = gpio_install_isr_service(0);
+    if (iChyba == ESP_ERR_INVALID_STATE)
+      iChyba = ESP_OK;
+  }
+  if (iChyba == ESP_OK)
+    iChyba = gpio_isr_handler_add(aGpio, NFC_IrqHandler, NULL);
+  if (iChyba != ESP_OK)
   {
-    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
-    return 2;
+    NFC_READER_DEBUG(TAGin, "GPIO %d nelze nastavit (%d).\n", aGpio, iChyba);
+    return 1;
   }
-  aCardInfo->TRecipeInfoLoaded = true;
+  NFC_IrqPin = aGpio;
   return 0;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Přečtení všech struktur TRecipeStep z NFC tagu
-
-    @param  aNFC      Pointer na NFC strukturu
-    @param  aCardInfo      aCardInfo struktura
+    @brief  Nastavení klíčů sektoru Mifare Classic - kandidáti se zkouší od naposledy úspěšného,
+            diverzifikované klíče se odvodí z hlavního klíče a UID (NFC_SetKeyDiversification)
 
+    @param  aSector      Sektor (0 - NFC_CLASSIC_SECTORS - 1, NFC_ALL_SECTORS - všechny sektory)
+    @param  aKeys      Pole kandidátů
+    @param  aCount      Počet kandidátů (0 - výchozí klíč FF..FF, max. NFC_KEY_CANDIDATES)
 
-    @returns 0 - Data se z NFC tag precetla, 2 - Data se neprecetla/nebyla prilozena karta, 3 - Nelze autentizovat NFC tag 4 - Není vytvořeno pole pro pole struktur
+    @returns 0 - Klice se nastavily, 1 - Spatny sektor nebo pocet klicu
 */
 /**************************************************************************/
-uint8_t NFC_LoadTRecipeSteps(pn532_t *aNFC, TCardInfo *aCardInfo)
+uint8_t NFC_SetSectorKeys(uint8_t aSector, const TNFCKey *aKeys, uint8_t aCount)
 {
-  static const char *TAGin = "NFC_LoadTRecipeSteps";
-  NFC_READER_DEBUG(TAGin, "Nacitam vsechny strukturu TRecipeSteps.\n");
-  if (!aCardInfo->TRecipeStepArrayCreated)
+  if ((aSector >= NFC_CLASSIC_SECTORS && aSector != NFC_ALL_SECTORS) || aCount > NFC_KEY_CANDIDATES)
+    return 1;
+  NFC_PrefetchWait();
+  for (uint8_t i = 0; i < NFC_CLASSIC_SECTORS; ++i)
   {
-    NFC_READER_DEBUG(TAGin, "Neni vytvoreno pole pro hodnoty!.\n");
-    return 4;
+    if (aSector != NFC_ALL_SECTORS && aSector != i)
+      continue;
+    memcpy(NFC_SectorKeys[i], aKeys, aCount * sizeof(TNFCKey));
+    NFC_SectorKeyCount[i] = aCount;
+    NFC_SectorLastGood[i] = 0;
   }
-  uint8_t iuid[] = {0, 0, 0, 0, 0, 0, 0}; // Buffer to store the returned UID
-  uint8_t iuidLength;
-
-  uint8_t PrilozenaKarta = pn532_readPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT);
-  if (PrilozenaKarta == 1)
-  {
-    if (iuidLength == 4)
-    {
-      NFC_READER_ALL_DEBUG(TAGin, "NFC classic\n");
-      size_t zacatek = TRecipeInfo_Size;
-      size_t konec = TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size - 1;
-      uint8_t iData[PAGESIZE_CLASSIC];
-      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
-      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
-      for (int i = PrvniBunka; i <= PosledniBunka; ++i)
-      {
-        size_t index = NFC_GetMifareClassicIndex(i);
-
-        uint8_t keyuniversal[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-        uint8_t autorizovano = pn532_mifareclassic_AuthenticateBlock(aNFC, iuid, iuidLength, index, 1, keyuniversal);
-        NFC_READER_ALL_DEBUG("", "Autorizovano: %d\n", autorizovano);
-        if (autorizovano)
-        {
-          uint8_t success = pn532_mifareclassic_ReadDataBlock(aNFC, index, iData);
-          if (success)
-          {
-            // Data seems to have been read ... spit it out
-            NFC_READER_ALL_DEBUG(TAGin, "Ctu Block %d: ", i);
-            for (int k = 0; k < PAGESIZE_CLASSIC; ++k)
-            {
-              NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
-            }
-            NFC_READER_ALL_DEBUG("", "\n");
-            size_t Propocet = 0;
-            size_t IndexovaPosun = 0;
-            size_t Posun = +zacatek % PAGESIZE_CLASSIC;
-            for (size_t k = 0; k < PAGESIZE_CLASSIC; ++k)
-            {
-              if (k + i * PAGESIZE_CLASSIC < TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size)
-              {
-                Propocet = k;
-                IndexovaPosun = k + (i - PrvniBunka) * PAGESIZE_CLASSIC;
-                if (i == PrvniBunka)
-                {
-                  Propocet += Posun;
-                  if (Propocet == PAGESIZE_CLASSIC)
-                  {
-                    break;
-                  }
-                }
-                else
-                {
-                  IndexovaPosun = IndexovaPosun - Posun;
-                }
+  NFC_KeyCache.sUidLength = 0;
+  NFC_SessionClose();
+  return 0;
+}
 
-                *(((uint8_t *)aCardInfo->sRecipeStep) + IndexovaPosun) = iData[Propocet];
-                // NFC_READER_ALL_DEBUG("", "%d: %p+%d-%d, ", k,aCardInfo->sRecipeStep,IndexovaPosun,iData[Propocet]);
-              }
-              else
-              {
-                break;
-              }
-            }
-          }
-          else
-          {
-            NFC_READER_DEBUG(TAGin, "Nelze precist. Chyba %d, index: %d\n", success, index);
-            return 2;
-          }
-        }
-        else
-        {
-          NFC_READER_DEBUG(TAGin, "Nelze autentifikovat.\n");
-          return 3;
-        }
-      }
-    }
-    else if ((iuidLength == 7))
-    {
-      NFC_READER_ALL_DEBUG(TAGin, "NFC ultralight\n");
+/**************************************************************************/
+/*!
+    @brief  Nastavení funkce pro diverzifikaci klíčů podle UID karty, odvozené klíče se ukládají
+            do cache karty, takže se každý počítá jen jednou
 
-      uint8_t iData[16];
-      size_t zacatek = TRecipeInfo_Size;
-      size_t konec = TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size - 1;
-      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
-      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
-      for (int i = PrvniBunka; i <= PosledniBunka; ++i)
-      {
-        uint8_t success = pn532_mifareultralight_ReadPage(aNFC, (i * 4) + OFFSETDATA_ULTRALIGHT, iData);
-        if (success)
-        {
-          // Data seems to have been read ... spit it out
-          NFC_READER_ALL_DEBUG(TAGin, "\nCtu Block %d: ", i);
-          for (int k = 0; k < 16; ++k)
-          {
-            NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
-          }
-          NFC_READER_ALL_DEBUG("", "\n");
+    @param  aFunction      Funkce diverzifikace (NULL - diverzifikované klíče nejsou k dispozici)
+    @param  aContext      Kontext předaný funkci
+*/
+/**************************************************************************/
+void NFC_SetKeyDiversification(TNFCKeyDiversify aFunction, void *aContext)
+{
+  NFC_PrefetchWait();
+  NFC_KeyDiversify = aFunction;
+  NFC_KeyDiversifyContext = aContext;
+  NFC_KeyCache.sUidLength = 0;
+  NFC_SessionClose();
+}
 
-          size_t Propocet = 0;
-          size_t IndexovaPosun = 0;
-          size_t Posun = +zacatek % 16;
+/**************************************************************************/
+/*!
+    @brief  Pokračování výpočtu CRC-16/CCITT (polynom 0x1021) dalšími daty
 
-          for (int k = 0; k < 16; ++k)
-          {
-            if (k + i * 16 < TRecipeInfo_Size + aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size)
-            {
-              Propocet = k;
-              IndexovaPosun = k + (i - PrvniBunka) * 16;
-              if (i == PrvniBunka)
-              {
-                Propocet += Posun;
-                if (Propocet == 16)
-                {
-                  break;
-                }
-              }
-              else
-              {
-                IndexovaPosun = IndexovaPosun - Posun;
-              }
+    @param  aCrc      CRC předchozích dat (0xFFFF na začátku)
+    @param  aData      Data
+    @param  aLength      Počet bytů
 
-              *(((uint8_t *)aCardInfo->sRecipeStep) + IndexovaPosun) = iData[Propocet];
-              // NFC_READER_ALL_DEBUG("", "%d: %p+%d-%d, ", k, aCardInfo->sRecipeStep, IndexovaPosun, iData[Propocet]);
-            }
-            else
-            {
-              break;
-            }
-          }
-        }
-        else
-        {
-          NFC_READER_ALL_DEBUG(TAGin, "\nNelze precist. Chyba %d\n", success);
-          return 2;
-        }
-      }
-    }
-    else
+    @returns    CRC dat
+*/
+/**************************************************************************/
+static uint16_t NFC_Crc16Update(uint16_t aCrc, const uint8_t *aData, size_t aLength)
+{
+  uint16_t Crc = aCrc;
+  for (size_t i = 0; i < aLength; ++i)
+  {
+    Crc ^= (uint16_t)aData[i] << 8;
+    for (int k = 0; k < 8; ++k)
     {
-      NFC_READER_DEBUG(TAGin, "Na kartu z karty precist hodnoty.\n");
+      Crc = Crc & 0x8000 ? (Crc << 1) ^ 0x1021 : Crc << 1;
     }
   }
-  else
-  {
-    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
-    return 2;
-  }
-  aCardInfo->TRecipeStepLoaded = true;
-  return 0;
+  return Crc;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Přečtení jedne struktur TRecipeStep z NFC tagu
+    @brief  Výpočet CRC-16/CCITT (polynom 0x1021, počáteční hodnota 0xFFFF)
 
-    @param  aNFC      Pointer na NFC strukturu
-    @param  aCardInfo      aCardInfo struktura
-    @param  NumOfStructure      aCardInfo struktura od 0 index
+    @param  aData      Data
+    @param  aLength      Počet bytů
 
-    @returns 0 - Data se z NFC tag precetla, 2 - Data se neprecetla/nebyla prilozena karta, 3 - Nelze autentizovat NFC tag 4 - Není vytvořeno pole pro pole struktur, 5 - NumOfStructure je mimo rozsah kroků
+    @returns    CRC dat
 */
 /**************************************************************************/
-uint8_t NFC_LoadTRecipeStep(pn532_t *aNFC, TCardInfo *aCardInfo, size_t NumOfStructure)
+static uint16_t NFC_Crc16(const uint8_t *aData, size_t aLength)
 {
-  static const char *TAGin = "NFC_LoadTRecipeStep";
-  NFC_READER_DEBUG(TAGin, "Nacitam jednu strukturu TRecipeSteps.\n");
-  if (!aCardInfo->TRecipeStepArrayCreated)
-  {
-    NFC_READER_DEBUG(TAGin, "Neni vytvoreno pole pro hodnoty!.\n");
-    return 4;
-  }
-  if (NumOfStructure >= aCardInfo->sRecipeInfo.RecipeSteps)
-  {
-    NFC_READER_DEBUG(TAGin, "NumOfStructure je mimo rozsah kroků!.\n");
-    return 5;
-  }
-  uint8_t iuid[] = {0, 0, 0, 0, 0, 0, 0}; // Buffer to store the returned UID
-  uint8_t iuidLength;
-  size_t DataCounter = 0;
-  uint8_t PrilozenaKarta = pn532_readPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, MAXTIMEOUT);
-  if (PrilozenaKarta == 1)
-  {
-    if (iuidLength == 4)
-    {
-      NFC_READER_ALL_DEBUG(TAGin, "NFC classic\n");
-      size_t zacatek = TRecipeInfo_Size + NumOfStructure * TRecipeStep_Size;
-      size_t konec = zacatek + TRecipeStep_Size - 1;
-      uint8_t iData[PAGESIZE_CLASSIC];
-      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
-      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
-      NFC_READER_ALL_DEBUG(TAGin, "PrvniBunka: %d(%d), PosledniBunka: %d(%d)\n", PrvniBunka, zacatek, PosledniBunka, konec);
-      for (int i = PrvniBunka; i <= PosledniBunka; ++i)
-      {
-        size_t index = NFC_GetMifareClassicIndex(i);
+  return NFC_Crc16Update(0xFFFF, aData, aLength);
+}
 
-        uint8_t keyuniversal[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-        uint8_t autorizovano = pn532_mifareclassic_AuthenticateBlock(aNFC, iuid, iuidLength, index, 1, keyuniversal);
-        NFC_READER_ALL_DEBUG("", "Autorizovano: %d\n", autorizovano);
-        if (autorizovano)
-        {
-          uint8_t success = pn532_mifareclassic_ReadDataBlock(aNFC, index, iData);
-          if (success)
-          {
-            // Data seems to have been read ... spit it out
-            NFC_READER_ALL_DEBUG(TAGin, "Ctu Block %d: ", i);
-            for (int k = 0; k < PAGESIZE_CLASSIC; ++k)
-            {
-              NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
-            }
-            NFC_READER_ALL_DEBUG("", "\n");
-            size_t Propocet = 0;
-            size_t IndexovaPosun = 0;
-            size_t Posun = +zacatek % PAGESIZE_CLASSIC;
-            for (size_t k = 0; k < PAGESIZE_CLASSIC; ++k)
-            {
-              if (k + i * PAGESIZE_CLASSIC < konec + 1)
-              {
-                Propocet = k;
-                IndexovaPosun = k + (i - PrvniBunka) * PAGESIZE_CLASSIC + (NumOfStructure)*TRecipeStep_Size;
-                if (i == PrvniBunka)
-                {
-                  Propocet += Posun;
-                  if (Propocet == PAGESIZE_CLASSIC)
-                  {
-                    break;
-                  }
-                }
-                else
-                {
-                  IndexovaPosun = IndexovaPosun - Posun;
-                }
+/**************************************************************************/
+/*!
+    @brief  Kruh transakcí - výdej místo přepsání hlavičky zapíše jeden 16B záznam s hodnotami NumOfDrinks
+            a ActualBudget po transakci do dalšího bloku kruhu. Záznam patří k hlavičce, jejíž CRC nese.
+            Před každým zápisem hlavičky (např. dobití přes NFC_IncrementBudget) se do kruhu zapíše záznam
+            s příznakem NFC_TRANSACTION_HEADER a hodnotami nové hlavičky - starší záznamy se ignorují,
+            i když má nová hlavička stejné CRC jako některá dřívější. Recept nesmí zasahovat do bloků kruhu.
+
+    @param  aFirstBlock      První 16B blok kruhu od začátku dat (ne blok 0)
+    @param  aBlocks      Počet bloků kruhu (min. NFC_TRANSACTION_MIN_BLOCKS), 0 - kruh vypnut
+*/
+/**************************************************************************/
+void NFC_SetTransactionRing(uint8_t aFirstBlock, uint8_t aBlocks)
+{
+  NFC_PrefetchWait();
+  bool Platny = aFirstBlock != 0 && aBlocks >= NFC_TRANSACTION_MIN_BLOCKS && aFirstBlock + aBlocks <= 0x100;
+  NFC_RingBlock = Platny ? aFirstBlock : 0;
+  NFC_RingBlocks = Platny ? aBlocks : 0;
+}
 
-                *(((uint8_t *)aCardInfo->sRecipeStep) + IndexovaPosun) = iData[Propocet];
+/**************************************************************************/
+/*!
+    @brief  Přečtení kruhu transakcí v otevřené relaci, poslední platný záznam k hlavičce na kartě
+            nahradí NumOfDrinks a ActualBudget (kromě hodnot z čítače/hodnotového bloku)
 
-                // NFC_READER_ALL_DEBUG("", "%d: %d-%d, ", k + i * PAGESIZE_CLASSIC, IndexovaPosun, iData[Propocet]);
-                if (++DataCounter == TRecipeStep_Size)
-                {
-                  break;
-                }
-              }
-              else
-              {
-                break;
-              }
-            }
-          }
-          else
-          {
-            NFC_READER_DEBUG(TAGin, "Nelze precist. Chyba %d, index: %d\n", success, index);
-            return 2;
-          }
-        }
-        else
-        {
-          NFC_READER_DEBUG(TAGin, "Nelze autentifikovat.\n");
-          return 3;
-        }
-      }
+    @param  aCardInfo Pointer na TCardInfo strukturu
+
+    @returns 0 - Kruh se precetl, 2 - Data nelze precist, 3 - Nelze autentizovat NFC tag, 6 - Byla prilozena jina karta
+*/
+/**************************************************************************/
+static uint8_t NFC_SessionFoldTransactions(TCardInfo *aCardInfo)
+{
+  static const char *TAGin = "NFC_SessionFoldTransactions";
+  NFC_SPAN(__func__);
+  TRecipeInfo iHlavicka;
+  uint8_t Error = NFC_SessionReadBytes(0, TRecipeInfo_Size, (uint8_t *)&iHlavicka);
+  if (Error != 0)
+    return Error;
+  uint16_t iZaklad = NFC_Crc16((uint8_t *)&iHlavicka, TRecipeInfo_Size);
+  TNFCTransaction iPosledni;
+  bool Nalezeno = false;
+  bool Sekvence = false;
+  uint16_t iSekvence = 0;
+  uint8_t iSlot = NFC_RingBlocks - 1;
+  for (size_t i = 0; i < NFC_RingBlocks; ++i)
+  {
+    uint8_t *iBlok;
+    Error = NFC_SessionReadBlock(NFC_RingBlock + i, &iBlok);
+    if (Error != 0)
+      return Error;
+    TNFCTransaction iZaznam;
+    memcpy(&iZaznam, iBlok, sizeof(iZaznam));
+    if (iZaznam.Magic != NFC_TRANSACTION_MAGIC || iZaznam.Crc != NFC_Crc16(iBlok, offsetof(TNFCTransaction, Crc)))
+      continue;
+    // Poradova cisla pokracuji i pres zhutneni, aby novy zaznam neprepsal posledni platny
+    if (!Sekvence || (int16_t)(iZaznam.Sequence - iSekvence) > 0)
+    {
+      iSekvence = iZaznam.Sequence;
+      iSlot = i;
+      Sekvence = true;
     }
-    else if ((iuidLength == 7))
+    // Zaznam NFC_TRANSACTION_HEADER je novejsi nez zaznamy drivejsiho zapisu stejne hlavicky, takze je prekryje
+    if (iZaznam.Base == iZaklad && (!Nalezeno || (int16_t)(iZaznam.Sequence - iPosledni.Sequence) > 0))
     {
-      NFC_READER_ALL_DEBUG(TAGin, "NFC ultralight\n");
-
-      uint8_t iData[16];
-      size_t zacatek = TRecipeInfo_Size + NumOfStructure * TRecipeStep_Size;
-      size_t konec = zacatek + TRecipeStep_Size - 1;
-      size_t PrvniBunka = zacatek / PAGESIZE_CLASSIC;
-      size_t PosledniBunka = konec / PAGESIZE_CLASSIC;
-      for (int i = PrvniBunka; i <= PosledniBunka; ++i)
-      {
-        uint8_t success = pn532_mifareultralight_ReadPage(aNFC, (i * 4) + OFFSETDATA_ULTRALIGHT, iData);
-        if (success)
-        {
-          // Data seems to have been read ... spit it out
-          NFC_READER_ALL_DEBUG(TAGin, "\nCtu Block %d: ", i);
-          for (int k = 0; k < 16; ++k)
-          {
-            NFC_READER_ALL_DEBUG("", "%d ", iData[k]);
-          }
-          NFC_READER_ALL_DEBUG("", "\n");
+      iPosledni = iZaznam;
+      Nalezeno = true;
+    }
+  }
+  aCardInfo->TransactionRing = true;
+  aCardInfo->TransactionSequence = iSekvence;
+  aCardInfo->TransactionSlot = iSlot;
+  if (Nalezeno)
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Posledni zaznam %d: NumOfDrinks %lu, ActualBudget %lu\n", iPosledni.Sequence,
+                         (unsigned long)iPosledni.NumOfDrinks, (unsigned long)iPosledni.ActualBudget);
+    if (!aCardInfo->NumOfDrinksCounter)
+      aCardInfo->sRecipeInfo.NumOfDrinks = iPosledni.NumOfDrinks;
+    if (!aCardInfo->ActualBudgetValueBlock)
+      aCardInfo->sRecipeInfo.ActualBudget = iPosledni.ActualBudget;
+  }
+  return 0;
+}
 
-          size_t Propocet = 0;
-          size_t IndexovaPosun = 0;
-          size_t Posun = +zacatek % 16;
+/**************************************************************************/
+/*!
+    @brief  Zápis záznamu transakce do dalšího bloku kruhu - jeden zápis bez kontrolního čtení,
+            neúplný záznam odhalí CRC a platí předchozí záznam
 
-          for (int k = 0; k < 16; ++k)
-          {
-            if (k + i * 16 < konec + 1)
-            {
-              Propocet = k;
-              IndexovaPosun = k + (i - PrvniBunka) * 16 + NumOfStructure * TRecipeStep_Size;
-              if (i == PrvniBunka)
-              {
-                Propocet += Posun;
-                if (Propocet == 16)
-                {
-                  break;
-                }
-              }
-              else
-              {
-                IndexovaPosun = IndexovaPosun - Posun;
-              }
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  aNumOfDrinks      NumOfDrinks po transakci
+    @param  aActualBudget      ActualBudget po transakci
+    @param  aHeader      Hlavička, která se na kartu teprve zapíše (záznam NFC_TRANSACTION_HEADER), NULL - hlavička na kartě
 
-              *(((uint8_t *)aCardInfo->sRecipeStep) + IndexovaPosun) = iData[Propocet];
-              // NFC_READER_ALL_DEBUG("", "%d: %p+%d-%d, ", k, aCardInfo->sRecipeStep, IndexovaPosun, iData[Propocet]);
-              if (++DataCounter == TRecipeStep_Size)
-              {
-                break;
-              }
-            }
-            else
-            {
-              break;
-            }
-          }
-        }
-        else
-        {
-          NFC_READER_ALL_DEBUG(TAGin, "\nNelze precist. Chyba %d\n", success);
-          return 2;
-        }
-      }
+    @returns 0 - Zaznam se zapsal, 1 - Nebyla prilozena karta/jina karta, 2 - Nelze zapsat
+*/
+/**************************************************************************/
+static uint8_t NFC_AppendTransaction(pn532_t *aNFC, TCardInfo *aCardInfo, uint32_t aNumOfDrinks, uint32_t aActualBudget, const TRecipeInfo *aHeader)
+{
+  static const char *TAGin = "NFC_AppendTransaction";
+  NFC_SPAN(__func__);
+  TNFCTransaction iZaznam = {.Magic = NFC_TRANSACTION_MAGIC, .Flags = aHeader != NULL ? NFC_TRANSACTION_HEADER : 0,
+                             .Sequence = aCardInfo->TransactionSequence + 1, .NumOfDrinks = aNumOfDrinks, .ActualBudget = aActualBudget};
+  // Dalsi blok za poslednim zaznamem - poradove cislo po preteceni nenavazuje na pocet bloku kruhu
+  uint8_t iSlot = (aCardInfo->TransactionSlot + 1) % NFC_RingBlocks;
+  size_t iBlok = NFC_RingBlock + iSlot;
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    switch (NFC_SessionEnsure(aNFC, aCardInfo))
+    {
+    case 0:
+      break;
+    case 6:
+      NFC_READER_DEBUG(TAGin, "Byla prilozena jina karta.\n");
+      return 1;
+    default:
+      NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+      return 1;
+    }
+    // Zaznam patri k hlavicce, ktera je prave na karte (v relaci obvykle z cache)
+    TRecipeInfo iHlavicka;
+    if (aHeader != NULL)
+    {
+      iHlavicka = *aHeader;
     }
     else
     {
-      NFC_READER_DEBUG(TAGin, "Na kartu z karty precist hodnoty.\n");
+      uint8_t Error = NFC_SessionReadBytes(0, TRecipeInfo_Size, (uint8_t *)&iHlavicka);
+      if (Error == 6)
+        return 1;
+      if (Error != 0)
+        continue;
+    }
+    iZaznam.Base = NFC_Crc16((uint8_t *)&iHlavicka, TRecipeInfo_Size);
+    iZaznam.Crc = NFC_Crc16((uint8_t *)&iZaznam, offsetof(TNFCTransaction, Crc));
+    if (NFC_SessionWriteBlock(iBlok, (uint8_t *)&iZaznam) == 0)
+    {
+      aCardInfo->TransactionSequence = iZaznam.Sequence;
+      aCardInfo->TransactionSlot = iSlot;
+      return 0;
+    }
+    // Po nepotvrzenem zapisu se z bloku zjisti, jestli se zaznam zapsal
+    uint8_t iData[PAGESIZE_CLASSIC];
+    if (NFC_SessionReselect() == 0 && NFC_SessionFetchBlock(iBlok, iData) == 0 && memcmp(iData, &iZaznam, sizeof(iZaznam)) == 0)
+    {
+      aCardInfo->TransactionSequence = iZaznam.Sequence;
+      aCardInfo->TransactionSlot = iSlot;
+      return 0;
     }
+    NFC_READER_DEBUG(TAGin, "Zaznam se nezapsal, zkousim znovu.\n");
+  }
+  return 2;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zápis záznamu NFC_TRANSACTION_HEADER s hodnotami hlavičky z aCardInfo před jejím zápisem na kartu -
+            záznam začne epochu nové hlavičky, takže se po zápisu stejné hlavičky neoživí starší záznamy.
+            Kruh se nejdřív přečte z karty, aby záznam navázal na poslední zápis jiné čtečky.
+
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo Pointer na TCardInfo strukturu, jejíž hlavička se bude zapisovat
+
+    @returns 0 - Zaznam se zapsal, 1 - Nebyla prilozena karta/jina karta, 2 - Nelze zapsat
+*/
+/**************************************************************************/
+static uint8_t NFC_MarkTransactionHeader(pn532_t *aNFC, TCardInfo *aCardInfo)
+{
+  NFC_SPAN(__func__);
+  // Kruh se slozi do kopie, hodnoty v aCardInfo se prave zapisuji
+  TCardInfo iStav = *aCardInfo;
+  uint8_t Error = 2;
+  if (aCardInfo->TransactionRing)
+  {
+    Error = NFC_SessionEnsure(aNFC, &iStav);
   }
   else
   {
-    NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
-    return 2;
+    for (size_t i = 0; i < MAXERRORREADING; ++i)
+    {
+      NFC_SPAN_RETRY(i);
+      Error = NFC_SessionOpen(aNFC);
+      if (Error == 0 || Error == 4)
+        break;
+    }
+    if (Error == 0)
+      NFC_saveUID(&iStav, NFC_Session.sUid, NFC_Session.sUidLength);
   }
-  aCardInfo->TRecipeStepLoaded = true;
+  if (Error != 0)
+    return 1;
+  Error = NFC_SessionFoldTransactions(&iStav);
+  if (Error != 0)
+    return Error == 6 ? 1 : 2;
+  Error = NFC_AppendTransaction(aNFC, &iStav, aCardInfo->sRecipeInfo.NumOfDrinks, aCardInfo->sRecipeInfo.ActualBudget, &aCardInfo->sRecipeInfo);
+  if (Error != 0)
+    return Error;
+  aCardInfo->TransactionRing = true;
+  aCardInfo->TransactionSequence = iStav.TransactionSequence;
+  aCardInfo->TransactionSlot = iStav.TransactionSlot;
   return 0;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Alokace pole pro strukturu TRecipeStep
+    @brief  Mapování NumOfDrinks na jednosměrný čítač tagu Ultralight EV1/NTAG21x - hodnota se čte při načtení
+            hlavičky a NFC_IncrementNumOfDrinks ji zvyšuje jedním příkazem INCR_CNT. Tagy bez čítače
+            a Mifare Classic dál používají NumOfDrinks v hlavičce.
 
+    @param  aCounter      Číslo čítače (0 - 2), -1 - mapování vypnuto
+*/
+/**************************************************************************/
+void NFC_SetDrinkCounter(int8_t aCounter)
+{
+  NFC_PrefetchWait();
+  NFC_DrinkCounter = aCounter >= 0 && aCounter <= 2 ? aCounter : -1;
+}
 
-    @param  aCardInfo      aCardInfo struktura
+/**************************************************************************/
+/*!
+    @brief  Zvýšení NumOfDrinks na kartě - na čítači tagu (jeden příkaz INCR_CNT), záznamem v kruhu transakcí,
+            jinak zápisem hlavičky
 
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  aIncrement      O kolik se NumOfDrinks zvýší
 
-    @returns 0 - Pole se vytvořilo, 1 - Pole je již vytvořeno, 2 - Nebyla načtena struktura TRecipeInfo, 3 - Nelze alokovat pole
+    @returns 0 - NumOfDrinks se zvysilo, 1 - Nebyla prilozena karta/jina karta, 2 - Nelze zapsat, 3 - Pretekl by citac, 4 - Nenactene informace o NFC tagu,
+             5 - Recept je nacten ze zaznamu karty s adresarem
 */
 /**************************************************************************/
-uint8_t NFC_AllocTRecipeStepArray(TCardInfo *aCardInfo)
+uint8_t NFC_IncrementNumOfDrinks(pn532_t *aNFC, TCardInfo *aCardInfo, uint32_t aIncrement)
 {
-  static const char *TAGin = "NFC_AllocTRecipeStepArray";
-  NFC_READER_ALL_DEBUG(TAGin, "Alokuji TRecipeStep\n");
+  static const char *TAGin = "NFC_IncrementNumOfDrinks";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
   if (!aCardInfo->TRecipeInfoLoaded)
   {
-    NFC_READER_DEBUG(TAGin, "Nebyla nactena TRecipeInfo struktura.\n");
-    return 2;
+    NFC_READER_DEBUG(TAGin, "Nenactene informace o NFC tagu.\n");
+    return 4;
   }
-  if (aCardInfo->TRecipeStepArrayCreated)
+  if (aCardInfo->RecordBlock != 0)
   {
-    NFC_READER_DEBUG(TAGin, "Pole pro TRecipeStepArray je jiz vytvoreno.\n");
-    return 1;
+    NFC_READER_DEBUG(TAGin, "Recept je ze zaznamu karty s adresarem (NFC_WriteRecord).\n");
+    return 5;
   }
-  aCardInfo->sRecipeStep = (TRecipeStep *)malloc(TRecipeStep_Size * aCardInfo->sRecipeInfo.RecipeSteps);
-  if (!aCardInfo->sRecipeStep)
+  uint32_t iPuvodni = aCardInfo->sRecipeInfo.NumOfDrinks;
+  if ((!aCardInfo->NumOfDrinksCounter || NFC_DrinkCounter < 0) && aCardInfo->TransactionRing && NFC_RingBlocks != 0)
   {
-    NFC_READER_DEBUG(TAGin, "Nelze vytvorit pole dat.\n");
+    uint8_t Error = NFC_AppendTransaction(aNFC, aCardInfo, iPuvodni + aIncrement, aCardInfo->sRecipeInfo.ActualBudget, NULL);
+    if (Error == 0)
+      aCardInfo->sRecipeInfo.NumOfDrinks = iPuvodni + aIncrement;
+    return Error;
+  }
+  if (!aCardInfo->NumOfDrinksCounter || NFC_DrinkCounter < 0)
+  {
+    aCardInfo->sRecipeInfo.NumOfDrinks += aIncrement;
+    if (NFC_WriteCheck(aNFC, aCardInfo, 0, 0) != 0)
+    {
+      NFC_READER_DEBUG(TAGin, "Hlavicku nelze zapsat.\n");
+      aCardInfo->sRecipeInfo.NumOfDrinks = iPuvodni;
+      return 2;
+    }
+    return 0;
+  }
+
+  if (aIncrement > NFC_UL_COUNTER_MAX - iPuvodni)
+  {
+    NFC_READER_DEBUG(TAGin, "Citac by pretekl.\n");
     return 3;
   }
-  NFC_READER_ALL_DEBUG(TAGin, "Pole bylo vytvoreno.\n");
-  aCardInfo->TRecipeStepArrayCreated = true;
-  return 0;
+  bool iOdeslano = false; // INCR_CNT uz byl odeslan a mohl probehnout bez potvrzeni
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    switch (NFC_SessionEnsure(aNFC, aCardInfo))
+    {
+    case 0:
+      break;
+    case 6:
+      NFC_READER_DEBUG(TAGin, "Byla prilozena jina karta.\n");
+      return 1;
+    default:
+      NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+      return 1;
+    }
+    // Zvyseni citace je atomicke - pred kazdym pokusem se z citace zjisti, jestli nepotvrzeny prikaz probehl,
+    // INCR_CNT se posle jen dokud citac drzi puvodni hodnotu
+    uint32_t iHodnota;
+    if (!NFC_ReadCounter(NFC_Session.NFC, NFC_DrinkCounter, &iHodnota))
+    {
+      NFC_READER_DEBUG(TAGin, "Nelze precist citac, zkousim znovu.\n");
+      NFC_SessionReselect();
+      continue;
+    }
+    if (iOdeslano && iHodnota != iPuvodni)
+    {
+      aCardInfo->sRecipeInfo.NumOfDrinks = iHodnota;
+      return iHodnota == iPuvodni + aIncrement ? 0 : 2;
+    }
+    iPuvodni = iHodnota;
+    if (aIncrement > NFC_UL_COUNTER_MAX - iPuvodni)
+    {
+      NFC_READER_DEBUG(TAGin, "Citac by pretekl.\n");
+      aCardInfo->sRecipeInfo.NumOfDrinks = iPuvodni;
+      return 3;
+    }
+    iOdeslano = true;
+    if (NFC_IncrementCounter(NFC_Session.NFC, NFC_DrinkCounter, aIncrement))
+    {
+      aCardInfo->sRecipeInfo.NumOfDrinks = iPuvodni + aIncrement;
+      return 0;
+    }
+    NFC_READER_DEBUG(TAGin, "Citac se nezvysil, zkousim znovu.\n");
+    NFC_SessionReselect();
+  }
+  return 2;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Dealokování pole pro strukturu TRecipeStep
+    @brief  Uložení ActualBudget do hodnotového bloku Mifare Classic - hodnota se čte při načtení hlavičky,
+            neplatný blok se inicializuje se zápisem hlavičky a NFC_DecrementBudget/NFC_IncrementBudget ho mění
+            atomicky příkazy DECREMENT/INCREMENT a TRANSFER. Recept nesmí zasahovat do zvoleného bloku.
 
+    @param  aBlock      Fyzický blok Mifare Classic (ne blok 0 ani trailer sektoru), 0 - ActualBudget je v hlavičce
+*/
+/**************************************************************************/
+void NFC_SetBudgetValueBlock(uint8_t aBlock)
+{
+  NFC_PrefetchWait();
+  bool iTrailer = aBlock < 128 ? aBlock % 4 == 3 : aBlock % 16 == 15; // Mifare Classic 4K ma od bloku 128 sektory po 16 blocich
+  NFC_BudgetBlock = iTrailer ? 0 : aBlock;
+}
 
-    @param  aCardInfo      aCardInfo struktura
+/**************************************************************************/
+/*!
+    @brief  Změna ActualBudget na kartě - v hodnotovém bloku dvěma příkazy, snížení záznamem v kruhu transakcí,
+            jinak zápisem hlavičky
 
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  aAmount      Velikost změny
+    @param  aDecrement      true - snížení, false - zvýšení
 
-    @returns 0 - Pole se dealokovalo, 1 - Pole je již null
+    @returns 0 - ActualBudget se zmenil, 1 - Nebyla prilozena karta/jina karta, 2 - Nelze zapsat, 3 - Nedostatecny rozpocet/pretekl by, 4 - Nenactene informace o NFC tagu,
+             5 - Recept je nacten ze zaznamu karty s adresarem
 */
 /**************************************************************************/
-uint8_t NFC_DeAllocTRecipeStepArray(TCardInfo *aCardInfo)
+static uint8_t NFC_ChangeBudget(pn532_t *aNFC, TCardInfo *aCardInfo, uint32_t aAmount, bool aDecrement)
 {
-  static const char *TAGin = "NFC_DeAllocTRecipeStepArray";
-  NFC_READER_ALL_DEBUG(TAGin, "Odalokovavam TRecipeStep\n");
-  if ((aCardInfo->sRecipeStep) == NULL)
+  static const char *TAGin = "NFC_ChangeBudget";
+  NFC_SPAN(__func__);
+  NFC_PrefetchWait();
+  if (!aCardInfo->TRecipeInfoLoaded)
   {
-    NFC_READER_ALL_DEBUG(TAGin, "TRecipeStep je již null\n");
-    return 1;
+    NFC_READER_DEBUG(TAGin, "Nenactene informace o NFC tagu.\n");
+    return 4;
   }
-  free(aCardInfo->sRecipeStep);
-  aCardInfo->sRecipeStep = NULL;
-  aCardInfo->TRecipeStepArrayCreated = aCardInfo->TRecipeStepLoaded = false;
-  NFC_READER_ALL_DEBUG(TAGin, "Pole se odalokovalo\n");
-  return 0;
+  if (aCardInfo->RecordBlock != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Recept je ze zaznamu karty s adresarem (NFC_WriteRecord).\n");
+    return 5;
+  }
+  uint32_t iPuvodni = aCardInfo->sRecipeInfo.ActualBudget;
+  if (aDecrement ? aAmount > iPuvodni : aAmount > (aCardInfo->ActualBudgetValueBlock ? INT32_MAX : UINT32_MAX) - iPuvodni)
+  {
+    NFC_READER_DEBUG(TAGin, "Nedostatecny rozpocet.\n");
+    return 3;
+  }
+  uint32_t iNovy = aDecrement ? iPuvodni - aAmount : iPuvodni + aAmount;
+  if ((!aCardInfo->ActualBudgetValueBlock || NFC_BudgetBlock == 0) && aDecrement && aCardInfo->TransactionRing && NFC_RingBlocks != 0)
+  {
+    uint8_t Error = NFC_AppendTransaction(aNFC, aCardInfo, aCardInfo->sRecipeInfo.NumOfDrinks, iNovy, NULL);
+    if (Error == 0)
+      aCardInfo->sRecipeInfo.ActualBudget = iNovy;
+    return Error;
+  }
+  // Dobiti bez hodnotoveho bloku prepise hlavicku a tim zhutni kruh transakci
+  if (!aCardInfo->ActualBudgetValueBlock || NFC_BudgetBlock == 0)
+  {
+    aCardInfo->sRecipeInfo.ActualBudget = iNovy;
+    if (NFC_WriteCheck(aNFC, aCardInfo, 0, 0) != 0)
+    {
+      NFC_READER_DEBUG(TAGin, "Hlavicku nelze zapsat.\n");
+      aCardInfo->sRecipeInfo.ActualBudget = iPuvodni;
+      return 2;
+    }
+    return 0;
+  }
+
+  uint8_t iPrikaz[6] = {aDecrement ? NFC_CLASSIC_DECREMENT : NFC_CLASSIC_INCREMENT, NFC_BudgetBlock,
+                        aAmount & 0xFF, (aAmount >> 8) & 0xFF, (aAmount >> 16) & 0xFF, (aAmount >> 24) & 0xFF};
+  uint8_t iTransfer[2] = {NFC_CLASSIC_TRANSFER, NFC_BudgetBlock};
+  uint8_t iOdpoved[16];
+  bool iOdeslano = false; // DECREMENT/INCREMENT a TRANSFER uz byly odeslany a mohly probehnout bez potvrzeni
+  for (size_t i = 0; i < MAXERRORREADING; ++i)
+  {
+    NFC_SPAN_RETRY(i);
+    switch (NFC_SessionEnsure(aNFC, aCardInfo))
+    {
+    case 0:
+      break;
+    case 6:
+      NFC_READER_DEBUG(TAGin, "Byla prilozena jina karta.\n");
+      return 1;
+    default:
+      NFC_READER_DEBUG(TAGin, "Karta nebyla prilozena.\n");
+      return 1;
+    }
+    // Pred kazdym pokusem se z bloku zjisti, jestli nepotvrzeny TRANSFER probehl - prikazy se poslou
+    // jen dokud blok drzi puvodni hodnotu
+    uint8_t iData[PAGESIZE_CLASSIC];
+    int32_t iHodnota;
+    if (NFC_SessionAuthenticate(NFC_BudgetBlock) != 0 || !NFC_HwClassicReadDataBlock(NFC_Session.NFC, NFC_BudgetBlock, iData) ||
+        !NFC_DecodeValueBlock(iData, &iHodnota))
+    {
+      NFC_READER_DEBUG(TAGin, "Nelze precist hodnotovy blok, zkousim znovu.\n");
+      NFC_Session.AuthSector = -1;
+      NFC_SessionReselect();
+      continue;
+    }
+    if (iOdeslano && (uint32_t)iHodnota != iPuvodni)
+    {
+      aCardInfo->sRecipeInfo.ActualBudget = iHodnota;
+      return (uint32_t)iHodnota == iNovy ? 0 : 2;
+    }
+    iPuvodni = iHodnota;
+    if (iHodnota < 0 || (aDecrement ? aAmount > iPuvodni : aAmount > INT32_MAX - iPuvodni))
+    {
+      NFC_READER_DEBUG(TAGin, "Nedostatecny rozpocet.\n");
+      aCardInfo->sRecipeInfo.ActualBudget = iHodnota;
+      return 3;
+    }
+    iNovy = aDecrement ? iPuvodni - aAmount : iPuvodni + aAmount;
+    iOdeslano = true;
+    uint8_t iDelka = sizeof(iOdpoved);
+    if (NFC_HwInDataExchange(NFC_Session.NFC, iPrikaz, sizeof(iPrikaz), iOdpoved, &iDelka))
+    {
+      iDelka = sizeof(iOdpoved);
+      if (NFC_HwInDataExchange(NFC_Session.NFC, iTransfer, sizeof(iTransfer), iOdpoved, &iDelka))
+      {
+        aCardInfo->sRecipeInfo.ActualBudget = iNovy;
+        return 0;
+      }
+    }
+    NFC_READER_DEBUG(TAGin, "Hodnotovy blok se nezmenil, zkousim znovu.\n");
+    NFC_Session.AuthSector = -1;
+    NFC_SessionReselect();
+  }
+  return 2;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Nainicializovani hodnot aCardInfo
+    @brief  Snížení ActualBudget na kartě (platba)
 
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  aAmount      O kolik se ActualBudget sníží
 
-    @param  aCardInfo      aCardInfo struktura
-
+    @returns 0 - ActualBudget se snizil, 1 - Nebyla prilozena karta/jina karta, 2 - Nelze zapsat, 3 - Nedostatecny rozpocet, 4 - Nenactene informace o NFC tagu,
+             5 - Recept je nacten ze zaznamu karty s adresarem
 */
 /**************************************************************************/
-void NFC_InitTCardInfo(TCardInfo *aCardInfo)
+uint8_t NFC_DecrementBudget(pn532_t *aNFC, TCardInfo *aCardInfo, uint32_t aAmount)
 {
-  aCardInfo->sRecipeStep = NULL;
-  aCardInfo->TRecipeInfoLoaded = aCardInfo->TRecipeStepArrayCreated = aCardInfo->TRecipeStepLoaded = false;
-  aCardInfo->sUidLength = 7;
-  for (size_t i = 0; i < aCardInfo->sUidLength; ++i)
-  {
-    aCardInfo->sUid[i] = 0;
-  }
+  return NFC_ChangeBudget(aNFC, aCardInfo, aAmount, true);
 }
 
 /**************************************************************************/
 /*!
-    @brief  Ověří jestli je karta přítomna na čtečce
+    @brief  Zvýšení ActualBudget na kartě (dobití)
 
     @param  aNFC      Pointer na NFC strukturu
     @param  aCardInfo Pointer na TCardInfo strukturu
+    @param  aAmount      O kolik se ActualBudget zvýší
 
-    @returns    true - Pokud je přítomna, false - Pokud neni přitomna
+    @returns 0 - ActualBudget se zvysil, 1 - Nebyla prilozena karta/jina karta, 2 - Nelze zapsat, 3 - Pretekl by, 4 - Nenactene informace o NFC tagu,
+             5 - Recept je nacten ze zaznamu karty s adresarem
 */
 /**************************************************************************/
-bool NFC_isCardReady(pn532_t *aNFC)
+uint8_t NFC_IncrementBudget(pn532_t *aNFC, TCardInfo *aCardInfo, uint32_t aAmount)
 {
-  static const char *TAGin = "NFC_isCardReadyToRead";
-  uint8_t iuid[] = {0, 0, 0, 0, 0, 0, 0};
-  uint8_t iuidLength;
-  NFC_READER_ALL_DEBUG(TAGin, "Zkousím jestli je karta přítomna.\n");
-  bool iStatus = pn532_readPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, iuid, &iuidLength, TIMEOUTCHECKCARD);
-  if (iStatus)
-  {
-    NFC_READER_ALL_DEBUG(TAGin, "Je pritomna.\n");
-  }
-  else
-  {
-    NFC_READER_ALL_DEBUG(TAGin, "Neni pritomna.\n");
-  }
-  return iStatus;
+  return NFC_ChangeBudget(aNFC, aCardInfo, aAmount, false);
 }
 
 /**************************************************************************/
 /*!
-    @brief  Získá UID a délku UID karty
-
-    @param  aNFC      Pointer na NFC strukturu
-    @param  aUid      Pointer na Uid pole
-     @param  aUidLength      Pointer na Uid délku
+    @brief  Zahájení záznamu časové osy (úseky veřejných funkcí, výběru karty, autentizace, čtení/zápisu bloků a opakování)
 
-    @returns    true - Pokud se správně načetlo, false - Pokud se špatně načetlo
+    @param  aSpans      Pointer na časovou osu
+    @param  aBuffer      Předem alokovaný buffer úseků
+    @param  aCapacity      Počet úseků v bufferu
 */
 /**************************************************************************/
-bool NFC_getUID(pn532_t *aNFC, uint8_t *aUid, uint8_t *aUidLength)
+void NFC_SpansStart(TNFCSpans *aSpans, TNFCSpan *aBuffer, size_t aCapacity)
 {
-  static const char *TAGin = "NFC_getUID";
-  NFC_READER_ALL_DEBUG(TAGin, "Ziskavam UID.\n");
-  bool iSuccess = pn532_readPassiveTargetID(aNFC, PN532_MIFARE_ISO14443A, aUid, aUidLength, MAXTIMEOUT);
-  if (!iSuccess)
-    return false;
-  NFC_READER_ALL_DEBUG(TAGin, "UID se nacetlo: ");
-  for (size_t i = 0; i < *aUidLength; i++)
-  {
-    NFC_READER_ALL_DEBUG("", "%x ", aUid[i]);
-  }
-  NFC_READER_ALL_DEBUG("", ", s delkou: %zu. \n", *aUidLength);
-  return true;
+  NFC_PrefetchWait();
+  aSpans->sSpan = aBuffer;
+  aSpans->Capacity = aCapacity;
+  aSpans->Count = 0;
+  aSpans->StartTime = esp_timer_get_time();
+  NFC_Spans = aSpans;
 }
+
 /**************************************************************************/
 /*!
-    @brief  Uloží UID a délku UID do TCardInfo struktury
-
-    @param  aCardInfo Pointer na TCardInfo strukturu
-    @param  aUid      Pointer na Uid pole
-     @param  aUidLength      Délka UID
+    @brief  Ukončení záznamu časové osy
 
-    @returns    true - Pokud se správně uložilo, false - Pokud se stala chyba při ukládání
 */
 /**************************************************************************/
-bool NFC_saveUID(TCardInfo *aCardInfo, uint8_t *aUid, uint8_t aUidLength)
+void NFC_SpansStop(void)
 {
-  static const char *TAGin = "NFC_saveUID";
-  NFC_READER_ALL_DEBUG(TAGin, "Ukladam UID:");
-  for (size_t i = 0; i < aUidLength; i++)
-  {
-    aCardInfo->sUid[i] = aUid[i];
-    NFC_READER_ALL_DEBUG("", "%x ", aCardInfo->sUid[i]);
-  }
-  NFC_READER_ALL_DEBUG("", ", s delkou: %zu. \n", aUidLength);
-  aCardInfo->sUidLength = aUidLength;
-  return true;
+  NFC_PrefetchWait();
+  NFC_Spans = NULL;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Zkontroluje jestli struktura TRecipeStep je stejná v zařízení jak v NFC čipu
+    @brief  Export časové osy ve formátu Chrome trace JSON (lze otevřít v Perfetto nebo chrome://tracing)
 
-    @param  aNFC      Pointer na NFC
-    @param  aCardInfo Pointer na TCardInfo strukturu
-    @param  anumOfNFCStruct Číslo struktury(0- info, 1-end - recipe)
+    @param  aSpans      Pointer na časovou osu
+    @param  aFile      Soubor, do kterého se JSON zapíše
 
-    @returns 0 - Pokud se Data načetla a jsou stejna, 1 - Pokud se struktura liší, 2 - Pokud je anumOfNFCStruct mimo rozsah,3 - Nelze cist z karty, 4- Nelze naalokovat pole pro hodnoty, 5 - NumOfStructureStart je vetsi jak NumOfStructureEnd, 6 - Nenactene informace o aCardInfo
+    @returns 0 - Export probehl, 1 - Chyba zapisu
 */
 /**************************************************************************/
-uint8_t NFC_CheckStructArrayIsSame(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd)
+uint8_t NFC_SpansExportChrome(TNFCSpans *aSpans, FILE *aFile)
 {
-  static const char *TAGin = "NFC_CheckStructArrayIsSame";
-  NFC_READER_DEBUG(TAGin, "Porovnavam data v rozsahu %d - %d.\n", NumOfStructureStart, NumOfStructureEnd);
-  if (NumOfStructureStart > NumOfStructureEnd)
-  {
-    NFC_READER_DEBUG(TAGin, "Startovni index je vetsi jak konecny!");
-    return 5;
-  }
-  if (NumOfStructureStart > aCardInfo->sRecipeInfo.RecipeSteps || NumOfStructureEnd > aCardInfo->sRecipeInfo.RecipeSteps)
-  {
-    NFC_READER_ALL_DEBUG(TAGin, "Index je mimo rozsah!!\n");
-    return 2;
-  }
-  TCardInfo idataNFC1;
-  uint8_t Error;
-  NFC_InitTCardInfo(&idataNFC1);
-
-  if (aCardInfo->TRecipeInfoLoaded != true)
-  {
-    NFC_READER_DEBUG(TAGin, "Nenactene info o sklenici!!\n");
-    return 6;
-  }
-  idataNFC1.TRecipeInfoLoaded = true;
-  idataNFC1.sRecipeInfo.RecipeSteps = NumOfStructureEnd;
-  if (NumOfStructureEnd > 0)
+  static const char *TAGin = "NFC_SpansExportChrome";
+  size_t iPocet = aSpans->Count < aSpans->Capacity ? aSpans->Count : aSpans->Capacity;
+  bool iPrvni = true;
+  int iChyba = fprintf(aFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") < 0;
+  for (size_t i = 0; i < iPocet && !iChyba; ++i)
   {
-    if (NFC_AllocTRecipeStepArray(&idataNFC1) != 0)
-      return 4;
+    TNFCSpan *iSpan = &aSpans->sSpan[i];
+    if (iSpan->Duration == UINT32_MAX)
+      continue;
+    iChyba = fprintf(aFile, "%s\n{\"name\":\"%s\",\"cat\":\"nfc\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%lu,\"pid\":1,\"tid\":%lu}",
+                     iPrvni ? "" : ",", iSpan->Name, (unsigned long)iSpan->Start, (unsigned long)iSpan->Duration, (unsigned long)iSpan->Thread) < 0;
+    iPrvni = false;
   }
-  for (size_t i = NumOfStructureStart; i <= NumOfStructureEnd; ++i)
+  if (!iChyba)
+    iChyba = fprintf(aFile, "\n]}\n") < 0;
+  if (iChyba)
   {
-    if (i == 0)
-    {
-
-      for (size_t j = 0; j < MAXERRORREADING; ++j)
-      {
-        Error = NFC_LoadTRecipeInfoStructure(aNFC, &idataNFC1);
-        if (Error == 0)
-          break;
-      }
-      switch (Error)
-      {
-      case 0:
-        break;
-
-      default:
-        if (idataNFC1.TRecipeStepArrayCreated == true)
-        {
-          NFC_DeAllocTRecipeStepArray(&idataNFC1);
-        }
-        return 3;
-        break;
-      }
-      for (int j = 0; j < TRecipeInfo_Size; ++j)
-      {
-        if (*(((uint8_t *)&aCardInfo->sRecipeInfo) + j) != *(((uint8_t *)&idataNFC1.sRecipeInfo) + j))
-        {
-          NFC_READER_ALL_DEBUG(TAGin, "Struktura %d na pozici %d jsou rozdilne.\n", i, j);
-          if (idataNFC1.TRecipeStepArrayCreated == true)
-            NFC_DeAllocTRecipeStepArray(&idataNFC1);
-          return 1;
-        }
-      }
-      NFC_READER_ALL_DEBUG(TAGin, "Struktura %d je stejna.\n", i);
-    }
-    else
-    {
-      for (size_t j = 0; j < MAXERRORREADING; ++j)
-      {
-        Error = NFC_LoadTRecipeStep(aNFC, &idataNFC1, i - 1);
-        if (Error == 0)
-          break;
-      }
-      switch (Error)
-      {
-      case 0:
-        break;
-
-      default:
-        NFC_DeAllocTRecipeStepArray(&idataNFC1);
-        return 3;
-        break;
-      }
-      for (int j = 0; j < TRecipeStep_Size; ++j)
-      {
-        if (*(((uint8_t *)aCardInfo->sRecipeStep) + j + (i - 1) * TRecipeStep_Size) != *(((uint8_t *)idataNFC1.sRecipeStep) + j + (i - 1) * TRecipeStep_Size))
-        {
-          NFC_READER_ALL_DEBUG(TAGin, "Struktura %d na pozici %d jsou rozdílne.\n", i, j);
-          NFC_DeAllocTRecipeStepArray(&idataNFC1);
-          return 1;
-        }
-      }
-      NFC_READER_ALL_DEBUG(TAGin, "Struktura %d jsou stejne.\n", i);
-    }
+    NFC_READER_DEBUG(TAGin, "Chyba zapisu.\n");
+    return 1;
   }
-  NFC_READER_ALL_DEBUG(TAGin, "Cely rozsah je stejny.\n");
-  if (idataNFC1.TRecipeStepArrayCreated == true)
+  if (aSpans->Count > aSpans->Capacity)
   {
-    NFC_DeAllocTRecipeStepArray(&idataNFC1);
+    NFC_READER_DEBUG(TAGin, "Zahozeno %d useku (maly buffer).\n", (int)(aSpans->Count - aSpans->Capacity));
   }
   return 0;
 }
 
+#if NFC_READER_EMULATOR_EN
 /**************************************************************************/
 /*!
-    @brief  Zapíše strukturu a zkontroluje
+    @brief  Spuštění emulované karty - všechny operace se čtečkou se provádí nad pamětí karty vytvořené z výpisu
 
-    @param  aNFC      Pointer na NFC strukturu
-    @param  aCardInfo Pointer na TCardInfo strukturu
-    @param  NumOfStructureStart Číslo 1. struktury(0- info, 1-end - recipe)
-    @param  NumOfStructureEnd Číslo 1. struktury(0- info, 1-end - recipe)
+    @param  aCard      Pointer na výpis karty, ze které se emulovaná karta vytvoří
 
-    @returns    0 - Hodnoty na kartě sedí se zapsanými, 1- Data se liší, 2 - Index anumOfNFCStruct je mimo rozsah struktury, 3 - Na kartu nelze zapsat, 4 - Kartu nelze autentifikovat 5 - neocekavana chyba, 6 - Nelze naalokovat pole pro porovnavaci hodnoty, 7 - Spatne zadane prvni a posledni prvky, 8 - Nenactene informace o NFC tagu
+    @returns 0 - Emulace spustena, 1 - Vypis se nevejde do pameti karty, 2 - Nepodporovany typ tagu nebo delka UID
 */
 /**************************************************************************/
-uint8_t NFC_WriteCheck(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd)
+uint8_t NFC_EmulatorStart(TNFCCardDump *aCard)
 {
-  static const char *TAGin = "NFC_WriteCheck";
-  NFC_READER_DEBUG(TAGin, "Zapisuji hodnoty a kontroluji jestli jsou stejne od %d do %d.\n", NumOfStructureStart, NumOfStructureEnd);
-  uint8_t Error = 0;
-  for (int k = 0; k < MAXERRORREADING; ++k)
+  static const char *TAGin = "NFC_EmulatorStart";
+  NFC_PrefetchWait();
+  if (!((aCard->TagType == NFC_TAG_CLASSIC && (aCard->sUidLength == 4 || aCard->sUidLength == 7)) || (aCard->TagType == NFC_TAG_ULTRALIGHT && aCard->sUidLength == 7) ||
+        (aCard->TagType == NFC_TAG_ISODEP && (aCard->sUidLength == 4 || aCard->sUidLength == 7)) ||
+        (aCard->TagType == NFC_TAG_FELICA && aCard->sUidLength == 8)))
   {
-    for (int i = 0; i < MAXERRORREADING; ++i)
-    {
-      Error = NFC_WriteStructRange(aNFC, aCardInfo, NumOfStructureStart, NumOfStructureEnd);
-      if (Error == 0)
-      {
-        break;
-      }
-    }
-    switch (Error)
-    {
-    case 0:
-      break;
-    case 1:
-      NFC_READER_DEBUG(TAGin, "Index anumOfNFCStruct je mimo rozsah struktury.\n");
-      return 2;
-      break;
-    case 2:
-      NFC_READER_DEBUG(TAGin, "Nelze zapsat do NFC tagu.\n");
-      return 3;
-      break;
-    case 3:
-      NFC_READER_DEBUG(TAGin, "Kartu nelze autentifikovat.\n");
-      return 4;
-      break;
-    case 4:
-      NFC_READER_DEBUG(TAGin, "Spatne zadane prvni a posledni prvky.\n");
-      return 7;
-    default:
-      NFC_READER_DEBUG(TAGin, "Jina chyba.\n");
-      return 5;
-      break;
-    }
-    for (int i = 0; i < MAXERRORREADING; ++i)
-    {
-      Error = NFC_CheckStructArrayIsSame(aNFC, aCardInfo, NumOfStructureStart, NumOfStructureEnd);
-      if (Error <= 1)
-      {
-        break;
-      }
-    }
-    switch (Error)
+    NFC_READER_DEBUG(TAGin, "Nepodporovany typ tagu.\n");
+    return 2;
+  }
+  memset(NFC_Emulator.Memory, 0, NFC_EMULATOR_SIZE);
+  for (size_t i = 0; i < aCard->Blocks; ++i)
+  {
+    size_t iOffset = i * PAGESIZE_CLASSIC; // ISO-DEP - pozice v souboru s daty, FeliCa - blok ve službě
+    if (aCard->TagType == NFC_TAG_CLASSIC)
+      iOffset = NFC_GetMifareClassicIndex(i) * PAGESIZE_CLASSIC;
+    else if (aCard->TagType == NFC_TAG_ULTRALIGHT)
+      iOffset = (i * 4 + 8) * PAGESIZE_ULTRALIGHT;
+    if (NFC_EmulatorAccess(iOffset, aCard->Data + i * PAGESIZE_CLASSIC, PAGESIZE_CLASSIC, true) == 0)
     {
-    case 0:
-      NFC_READER_DEBUG(TAGin, "Data se zapsala správne.\n");
-      return 0;
-    case 1:
-      NFC_READER_DEBUG(TAGin, "Data se nezapsala spravne, zkusim znovu.\n");
-      break;
-    case 2:
-      NFC_READER_DEBUG(TAGin, "Index anumOfNFCStruct je mimo rozsah struktury.\n");
-      return 2;
-      break;
-    case 3:
-      NFC_READER_DEBUG(TAGin, "Nelze z karty cist.\n");
-      return 4;
-      break;
-    case 4:
-      NFC_READER_DEBUG(TAGin, "Nelze znaalokovat pole pro hodnoty porovnani.\n");
-      return 6;
-      break;
-    case 5:
-      NFC_READER_DEBUG(TAGin, "Spatne zadane prvni a posledni prvky.\n");
-      return 7;
-      break;
-    case 6:
-      NFC_READER_DEBUG(TAGin, "Nenactene informace o NFC tagu.\n");
-      return 8;
-    default:
-      NFC_READER_DEBUG(TAGin, "Jina chyba.\n");
-      return 5;
-      break;
+      NFC_READER_DEBUG(TAGin, "Vypis se nevejde do pameti karty.\n");
+      return 1;
     }
   }
-  NFC_READER_DEBUG(TAGin, "Data se nezapsala spravne ani po 5 pokusech.\n");
-  return 1;
+  NFC_Emulator.TagType = aCard->TagType;
+  NFC_Emulator.IsoDepSelect = 0;
+  NFC_Emulator.sUidLength = aCard->sUidLength;
+  memcpy(NFC_Emulator.sUid, aCard->sUid, aCard->sUidLength);
+  NFC_Session.Active = false;
+  NFC_SessionInvalidateCache();
+  NFC_Emulator.Active = true;
+  NFC_READER_DEBUG(TAGin, "Emulace karty spustena (%d bloku).\n", aCard->Blocks);
+  return 0;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Vypočítá CheckSum
-
-    @param  aCardInfo Pointer na TCardInfo strukturu
+    @brief  Ukončení emulace karty, operace se čtečkou jdou opět na PN532
 
-    @returns    hodnota CheckSum(hodnota bytu*(pozice bytu%4+1))
 */
 /**************************************************************************/
-uint16_t NFC_GetCheckSum(TCardInfo aCardInfo)
+void NFC_EmulatorStop(void)
 {
-  static const char *TAGin = "NFC_GetCheckSum";
-  NFC_READER_DEBUG(TAGin, "Pocitam checksum.\n");
-  if (aCardInfo.sRecipeInfo.NumOfDrinks == 0)
-  {
-    aCardInfo.sRecipeInfo.CheckSum = 0;
-    NFC_READER_DEBUG(TAGin, "Počet receptů je 0 -> Checksum = 0.\n");
-    return 0;
-  }
-  uint16_t CheckSum = 0;
-  NFC_READER_ALL_DEBUG(TAGin, "Prubeh CheckSumu: ");
-  for (size_t i = 0; i < TRecipeStep_Size * aCardInfo.sRecipeInfo.RecipeSteps; ++i)
-  {
-    CheckSum += *((uint8_t *)aCardInfo.sRecipeStep + i) * (i % 4 + 1);
-    NFC_READER_ALL_DEBUG("", " %d,", CheckSum);
-  }
-  NFC_READER_ALL_DEBUG("", "\n");
-  NFC_READER_DEBUG(TAGin, "Checksum je %d.\n", CheckSum);
-  return CheckSum;
+  NFC_PrefetchWait();
+  NFC_Emulator.Active = false;
+  NFC_Session.Active = false;
+  NFC_SessionInvalidateCache();
+}
+#endif
+
+#if NFC_READER_FAULTS_EN || NFC_READER_BENCH_EN
+static int NFC_CompareDuration(const void *a, const void *b)
+{
+  uint32_t iA = *(const uint32_t *)a;
+  uint32_t iB = *(const uint32_t *)b;
+  return (iA > iB) - (iA < iB);
 }
+#endif
 
+#if NFC_READER_FAULTS_EN
 /**************************************************************************/
 /*!
-    @brief  Vytvoření TCardInfo struktury z TRecipeInfo struktury
-
-    @param  aCardInfo Pointer na TCardInfo strukturu
-    @param  aRecipeInfo Struktura aRecipeInfo
+    @brief  Zahájení vkládání chyb do operací se čtečkou podle profilu
 
-    @returns    0 - Uspesne vytvoreni, 1 - Nelze alokovat pole
+    @param  aProfile      Pointer na profil chyb
 */
 /**************************************************************************/
-uint8_t NFC_CreateCardInfoFromRecipeInfo(TCardInfo *aCardInfo, TRecipeInfo aRecipeInfo)
+void NFC_FaultStart(const TNFCFaultProfile *aProfile)
 {
-  static const char *TAGin = "NFC_CreateCardInfoFromRecipeInfo";
-  NFC_READER_DEBUG(TAGin, "Vytvarim CardInfo z RecipeStepu.\n");
-  NFC_InitTCardInfo(aCardInfo);
-  for (size_t i = 0; i < TRecipeInfo_Size; ++i)
-  {
-    *(((uint8_t *)(&aCardInfo->sRecipeInfo)) + i) = *(((uint8_t *)(&aRecipeInfo)) + i);
-  }
-  NFC_READER_ALL_DEBUG(TAGin, "Data se prekopirovala.\n");
-  uint8_t Error = 0;
-  aCardInfo->TRecipeInfoLoaded = true;
-  if (aRecipeInfo.RecipeSteps > 0)
-  {
-    NFC_READER_ALL_DEBUG(TAGin, "Alokuji pole.\n");
-    for (size_t i = 0; i < MAXERRORREADING; ++i)
-    {
-      Error = NFC_AllocTRecipeStepArray(aCardInfo);
-      if (Error == 0)
-        break;
-    }
-    switch (Error)
-    {
-    case 0:
-      for (size_t i = 0; i < TRecipeStep_Size * aCardInfo->sRecipeInfo.RecipeSteps; ++i)
-      {
-        *((uint8_t *)aCardInfo->sRecipeStep + i) = 0;
-      }
-      aCardInfo->sRecipeInfo.CheckSum = 0;
-      aCardInfo->TRecipeStepArrayCreated = true;
-      break;
+  NFC_PrefetchWait();
+  NFC_Faults.Profile = *aProfile;
+  NFC_Faults.Random = aProfile->Seed != 0 ? aProfile->Seed : 1;
+  NFC_Faults.Blocks = 0;
+  NFC_Faults.RemovedUntil = 0;
+  NFC_Faults.Active = true;
+}
 
-    default:
-      NFC_READER_DEBUG(TAGin, "Chyba vytvareni pole.\n");
-      return 1;
-      break;
-    }
-  }
-  NFC_READER_DEBUG(TAGin, "Vytvareno uspesne.\n");
-  return 0;
+/**************************************************************************/
+/*!
+    @brief  Ukončení vkládání chyb
+
+*/
+/**************************************************************************/
+void NFC_FaultStop(void)
+{
+  NFC_PrefetchWait();
+  NFC_Faults.Active = false;
 }
 
 /**************************************************************************/
 /*!
-    @brief  VPridani struktur TRecipeStep do TCardInfo struktury
+    @brief  Měření zápisu a načtení karty při vkládání chyb - každý běh zapíše aCardInfo (NFC_WriteCheck),
+            načte celou kartu (NFC_LoadAllData) a porovná obsah
 
-    @param  aCardInfo Pointer na TCardInfo strukturu
-    @param  aRecipeStep Pointer na pole Struktur aRecipeStep
-    @param  SizeOfRecipeSteps Počet struktur
-    @param  DeAlloc Ma se odalokovat pole?
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aCardInfo Pointer na TCardInfo strukturu se zapisovanými daty
+    @param  aProfile      Pointer na profil chyb
+    @param  aRuns      Počet běhů
+    @param  aResult      Výsledek měření (časy v us)
 
-    @returns    0 - Uspesne pridani, 1 - Neni nactena TRecipeInfo struktura, 2 - SizeOfRecipeSteps je nulove, 3 - Chyba vytvareni pole, 4 - aRecipeStep je NULL
+    @returns 0 - Mereni probehlo, 1 - Nelze alokovat pole
 */
 /**************************************************************************/
-uint8_t NFC_AddRecipeStepsToCardInfo(TCardInfo *aCardInfo, TRecipeStep *aRecipeStep, size_t SizeOfRecipeSteps, bool DeAlloc)
+uint8_t NFC_ChaosBenchmark(pn532_t *aNFC, TCardInfo *aCardInfo, const TNFCFaultProfile *aProfile, uint32_t aRuns, TNFCChaosResult *aResult)
 {
-  static const char *TAGin = "NFC_AddRecipeStepsToCardInfo";
-  NFC_READER_DEBUG(TAGin, "Pridavam TRecipeStep do TCardInfo struktury.\n");
-  if (aCardInfo->TRecipeInfoLoaded != true)
+  static const char *TAGin = "NFC_ChaosBenchmark";
+  NFC_PrefetchWait();
+  memset(aResult, 0, sizeof(*aResult));
+  if (aRuns == 0)
+    return 0;
+  uint32_t *iDoby = malloc(aRuns * sizeof(uint32_t));
+  if (iDoby == NULL)
   {
-    NFC_READER_DEBUG(TAGin, "Neni nactena TRecipeInfo struktura.\n");
+    NFC_READER_DEBUG(TAGin, "Nelze alokovat pole.\n");
     return 1;
   }
-  if (SizeOfRecipeSteps == 0)
-  {
-    NFC_READER_DEBUG(TAGin, "SizeOfRecipeSteps je nulove.\n");
-    return 2;
-  }
-  uint8_t Error;
-
-  if (aCardInfo->sRecipeInfo.RecipeSteps != SizeOfRecipeSteps && aCardInfo->TRecipeStepArrayCreated)
-  {
-    NFC_READER_ALL_DEBUG(TAGin, "Odalokovavam pole(Rozdilna velikost).\n");
-    NFC_DeAllocTRecipeStepArray(aCardInfo);
-    aCardInfo->TRecipeStepArrayCreated = false;
-  }
-  if (aCardInfo->TRecipeStepArrayCreated == false)
+  TNFCFaultProfile iProfile = *aProfile;
+  for (uint32_t i = 0; i < aRuns; ++i)
   {
-    aCardInfo->sRecipeInfo.RecipeSteps = SizeOfRecipeSteps;
-    NFC_READER_ALL_DEBUG(TAGin, "Alokuji pole.\n");
-    for (size_t i = 0; i < MAXERRORREADING; ++i)
-    {
-      Error = NFC_AllocTRecipeStepArray(aCardInfo);
-      if (Error == 0)
-        break;
-    }
-    switch (Error)
+    TCardInfo iNacteno;
+    NFC_InitTCardInfo(&iNacteno);
+    iProfile.Seed = aProfile->Seed + i;
+    NFC_FaultStart(&iProfile);
+    int64_t iStart = esp_timer_get_time();
+    uint8_t Error = NFC_WriteCheck(aNFC, aCardInfo, 0, aCardInfo->sRecipeInfo.RecipeSteps);
+    if (Error == 0)
+      Error = NFC_LoadAllData(aNFC, &iNacteno);
+    iDoby[i] = (uint32_t)(esp_timer_get_time() - iStart);
+    NFC_FaultStop();
+    if (Error == 0 && memcmp(&iNacteno.sRecipeInfo, &aCardInfo->sRecipeInfo, TRecipeInfo_Size) == 0 &&
+        memcmp(iNacteno.sRecipeStep, aCardInfo->sRecipeStep, aCardInfo->sRecipeInfo.RecipeSteps * TRecipeStep_Size) == 0)
     {
-    case 0:
-      aCardInfo->TRecipeStepArrayCreated = true;
-      break;
-
-    default:
-      NFC_READER_DEBUG(TAGin, "Chyba vytvareni pole.\n");
-      return 3;
-      break;
+      ++aResult->Successes;
     }
-    aCardInfo->sRecipeInfo.RecipeSteps = SizeOfRecipeSteps;
-  }
-  for (size_t i = 0; i < TRecipeStep_Size * aCardInfo->sRecipeInfo.RecipeSteps; ++i)
-  {
-    *((uint8_t *)aCardInfo->sRecipeStep + i) = *((uint8_t *)aRecipeStep + i);
-  }
-  if (DeAlloc)
-  {
-    free(aRecipeStep);
-    aRecipeStep = NULL;
+    if (iNacteno.TRecipeStepArrayCreated)
+      NFC_DeAllocTRecipeStepArray(&iNacteno);
   }
-  aCardInfo->sRecipeInfo.CheckSum = NFC_GetCheckSum(*aCardInfo);
+  qsort(iDoby, aRuns, sizeof(uint32_t), NFC_CompareDuration);
+  aResult->Runs = aRuns;
+  aResult->P50Us = iDoby[(aRuns - 1) * 50 / 100];
+  aResult->P99Us = iDoby[(aRuns - 1) * 99 / 100];
+  aResult->MaxUs = iDoby[aRuns - 1];
+  free(iDoby);
+  NFC_READER_DEBUG(TAGin, "Uspesnost %lu/%lu, p50 %lu us, p99 %lu us, max %lu us.\n", (unsigned long)aResult->Successes, (unsigned long)aResult->Runs,
+                   (unsigned long)aResult->P50Us, (unsigned long)aResult->P99Us, (unsigned long)aResult->MaxUs);
   return 0;
 }
+#endif
+
+#if NFC_READER_BENCH_EN
+#if defined(__XTENSA__) || defined(__riscv)
+#include "esp_cpu.h"
+#define NFC_BENCH_CYCLES() ((uint32_t)esp_cpu_get_cycle_count())
+#elif defined(__x86_64__) || defined(__i386__)
+#define NFC_BENCH_CYCLES() ((uint32_t)__builtin_ia32_rdtsc())
+#else
+#define NFC_BENCH_CYCLES() ((uint32_t)0)
+#endif
+#define NFC_BENCH_COUNT 6 // Pocet benchmarku pro jednu velikost receptu
+// Bariera prekladace - zabrani vytazeni merene funkce ze smycky opakovani
+#define NFC_BENCH_CLOBBER() __asm__ volatile("" ::: "memory")
 
-/**************************************************************************/
 /*!
-    @brief  Funkce ke zmene velikosti pole s RecipeSteps hodnotami
+Kontext měřené funkce
+*/
+typedef struct
+{
+  TCardInfo *sCardInfo;
+  TCardInfo *sCopy;
+  uint8_t Size;
+  uint32_t Counter;
+  uint8_t Error;
+  volatile uint32_t Sink;
+} TNFCBenchContext;
 
-    @param  aCardInfo Pointer na TCardInfo strukturu
-    @param  NewSize Pointer na pole Struktur aRecipeStep
+typedef void (*TNFCBenchFunction)(TNFCBenchContext *aContext);
 
+static void NFC_BenchCheckSum(TNFCBenchContext *aContext)
+{
+  NFC_BENCH_CLOBBER();
+  aContext->Sink += NFC_GetCheckSum(*aContext->sCardInfo);
+}
 
-    @returns    0 - uspesna zmena, 1 - Nejsou nactena RecipeInfo, 2 - Nelze Alokovat pole 20 - Neocekavana chyba
-*/
-/**************************************************************************/
-uint8_t NFC_ChangeRecipeStepsSize(TCardInfo *aCardInfo, uint8_t NewSize)
+static void NFC_BenchMifareClassicIndex(TNFCBenchContext *aContext)
 {
-  static const char *TAGin = "NFC_ChangeRecipeStepsSize";
-  NFC_READER_DEBUG(TAGin, "Menim hodnoty velikosti pole\n");
-  if (aCardInfo->TRecipeInfoLoaded == 0)
+  NFC_BENCH_CLOBBER();
+  size_t iBloky = (TRecipeInfo_Size + aContext->Size * TRecipeStep_Size + PAGESIZE_CLASSIC - 1) / PAGESIZE_CLASSIC;
+  for (size_t i = 0; i < iBloky; ++i)
   {
-    NFC_READER_DEBUG(TAGin, "Nejsou nactena RecipeInfo\n");
-    return 1;
+    aContext->Sink += NFC_GetMifareClassicIndex(i);
   }
+}
 
-  if (NewSize == aCardInfo->sRecipeInfo.RecipeSteps)
-  {
-    NFC_READER_ALL_DEBUG(TAGin, "Pole jsou stejne velke.\n");
-    return 0;
-  }
-  uint8_t Error;
-  if (aCardInfo->TRecipeStepArrayCreated)
-  {
-    NFC_READER_ALL_DEBUG(TAGin, "Vytvarim pole o velikosti %d bytu.\n", TRecipeStep_Size * NewSize);
+static void NFC_BenchCopyTCardInfo(TNFCBenchContext *aContext)
+{
+  NFC_BENCH_CLOBBER();
+  uint8_t Error = NFC_CopyTCardInfo(aContext->sCardInfo, aContext->sCopy);
+  if (Error != 0)
+    aContext->Error = Error;
+}
 
-    TRecipeStep *NoveRecepty = (TRecipeStep *)malloc(TRecipeStep_Size * NewSize);
-    if (!NoveRecepty)
+static void NFC_BenchChangeRecipeStepsSize(TNFCBenchContext *aContext)
+{
+  NFC_BENCH_CLOBBER();
+  uint8_t iJinaVelikost = aContext->Size < 255 ? aContext->Size + 1 : aContext->Size - 1;
+  uint8_t Error = NFC_ChangeRecipeStepsSize(aContext->sCopy, (aContext->Counter++ & 1) ? aContext->Size : iJinaVelikost);
+  if (Error != 0)
+    aContext->Error = Error;
+}
+
+static void NFC_BenchWriteStructRange(TNFCBenchContext *aContext)
+{
+  NFC_BENCH_CLOBBER();
+  uint8_t Error = NFC_WriteStructRange(NULL, aContext->sCardInfo, 0, aContext->Size);
+  if (Error != 0)
+    aContext->Error = Error;
+}
+
+static void NFC_BenchLoadAllData(TNFCBenchContext *aContext)
+{
+  NFC_BENCH_CLOBBER();
+  uint8_t Error = NFC_LoadAllData(NULL, aContext->sCopy);
+  if (Error != 0)
+    aContext->Error = Error;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Změření jedné funkce - počet opakování se zdvojnásobuje, dokud dávka netrvá alespoň aMinTimeUs
+
+    @param  aName      Název benchmarku
+    @param  aFunction      Měřená funkce
+    @param  aContext      Kontext měřené funkce
+    @param  aMinTimeUs      Minimální doba měřené dávky
+    @param  aResult      Výsledek měření
+*/
+/**************************************************************************/
+static void NFC_BenchRun(const char *aName, TNFCBenchFunction aFunction, TNFCBenchContext *aContext, uint32_t aMinTimeUs, TNFCBenchResult *aResult)
+{
+  aContext->Error = 0;
+  aContext->Counter = 0;
+  aFunction(aContext); // Zahřátí cache a alokátoru
+  uint32_t iPocet = 1;
+  for (;;)
+  {
+    aContext->Counter = 0;
+    int64_t iStart = esp_timer_get_time();
+    uint32_t iCykly = NFC_BENCH_CYCLES();
+    for (uint32_t i = 0; i < iPocet; ++i)
     {
-      NFC_READER_DEBUG(TAGin, "Nelze vytvorit pole dat.\n");
-      return 2;
+      aFunction(aContext);
     }
-    NFC_READER_ALL_DEBUG(TAGin, "Pole bylo vytvoreno.\n");
-    fflush(stdout);
-    for (size_t i = 0; i < NewSize; ++i)
+    iCykly = NFC_BENCH_CYCLES() - iCykly;
+    int64_t iCas = esp_timer_get_time() - iStart;
+    if (iCas >= aMinTimeUs || iPocet >= (1u << 30))
     {
-      for (size_t j = 0; j < TRecipeStep_Size; ++j)
-      {
-        if (i < aCardInfo->sRecipeInfo.RecipeSteps)
-        {
-          *((uint8_t *)NoveRecepty + i * TRecipeStep_Size + j) = *((uint8_t *)aCardInfo->sRecipeStep + i * TRecipeStep_Size + j);
-        }
-        else
-        {
-          *((uint8_t *)NoveRecepty + i * TRecipeStep_Size + j) = 0;
-        }
-      }
+      aResult->Name = aName;
+      aResult->RecipeSteps = aContext->Size;
+      aResult->Error = aContext->Error;
+      aResult->Iterations = iPocet;
+      aResult->NsPerOp = (uint32_t)(iCas * 1000 / iPocet);
+      aResult->CyclesPerOp = iCykly / iPocet;
+      return;
     }
-    NFC_READER_ALL_DEBUG(TAGin, "Odalokovavam.\n");
-    NFC_DeAllocTRecipeStepArray(aCardInfo);
-    NFC_READER_ALL_DEBUG(TAGin, "Odalokovano.\n");
-    aCardInfo->sRecipeStep = NoveRecepty;
-    aCardInfo->TRecipeStepArrayCreated = aCardInfo->TRecipeStepLoaded = true;
-    aCardInfo->sRecipeInfo.RecipeSteps = NewSize;
-    NFC_READER_ALL_DEBUG(TAGin, "Udaje zmeneny.\n");
+    iPocet *= 2;
   }
-  else
+}
+
+/**************************************************************************/
+/*!
+    @brief  Mikrobenchmarky CPU části knihovny (kontrolní součet, přepočet indexů, kopírování a změna velikosti
+            TCardInfo, skládání bloků při zápisu a kopírování při načítání) pro zadané velikosti receptu.
+            Zápis a načtení běží nad emulovanou kartou Mifare Classic, takže se měří jen CPU čas.
+            Spuštěná emulace karty se na konci ukončí.
+
+    @param  aSizes      Počty kroků receptu (1 - 245)
+    @param  aNumSizes      Počet velikostí
+    @param  aMinTimeUs      Minimální doba jedné měřené dávky (čítač cyklů přetéká, doporučeno do 1 s)
+    @param  aResults      Pole výsledků
+    @param  aCapacity      Velikost pole výsledků
+
+    @returns Počet vyplněných výsledků
+*/
+/**************************************************************************/
+size_t NFC_RunMicrobenchmarks(const uint8_t *aSizes, size_t aNumSizes, uint32_t aMinTimeUs, TNFCBenchResult *aResults, size_t aCapacity)
+{
+  static const char *TAGin = "NFC_RunMicrobenchmarks";
+  static const char *Nazvy[NFC_BENCH_COUNT] = {"NFC_GetCheckSum", "NFC_GetMifareClassicIndex", "NFC_CopyTCardInfo",
+                                               "NFC_ChangeRecipeStepsSize", "NFC_WriteStructRange", "NFC_LoadAllData"};
+  static const TNFCBenchFunction Funkce[NFC_BENCH_COUNT] = {NFC_BenchCheckSum, NFC_BenchMifareClassicIndex, NFC_BenchCopyTCardInfo,
+                                                            NFC_BenchChangeRecipeStepsSize, NFC_BenchWriteStructRange, NFC_BenchLoadAllData};
+  static TNFCCardDump iKarta;
+  memset(&iKarta, 0, sizeof(iKarta));
+  iKarta.TagType = NFC_TAG_CLASSIC;
+  iKarta.sUidLength = 4;
+  if (NFC_EmulatorStart(&iKarta) != 0)
+    return 0;
+
+  size_t iPocet = 0;
+  for (size_t k = 0; k < aNumSizes && iPocet + NFC_BENCH_COUNT <= aCapacity; ++k)
   {
-    aCardInfo->sRecipeInfo.RecipeSteps = NewSize;
-    for (int i = 0; i < MAXERRORREADING; ++i)
+    if (aSizes[k] == 0 || TRecipeInfo_Size + aSizes[k] * TRecipeStep_Size > NFC_CAPACITY_CLASSIC_1K)
     {
-      Error = NFC_AllocTRecipeStepArray(aCardInfo);
-      if (Error == 0)
-      {
-        break;
-      }
-      NFC_DeAllocTRecipeStepArray(aCardInfo);
+      NFC_READER_DEBUG(TAGin, "Velikost %d se nevejde na kartu.\n", aSizes[k]);
+      continue;
     }
-    switch (Error)
-    {
-    case 0:
-      break;
-    case 2:
-      NFC_READER_DEBUG(TAGin, "Nebyla nactena struktura TRecipeInfo.\n");
-      return 1;
-      break;
-    case 3:
-      NFC_READER_DEBUG(TAGin, "Nelze Alokovat pole.\n");
-      return 2;
-      break;
-    default:
-      NFC_READER_DEBUG(TAGin, "Neocekavana chyba.\n");
-      return 20;
+    TRecipeStep *iKroky = (TRecipeStep *)malloc(TRecipeStep_Size * aSizes[k]);
+    if (iKroky == NULL)
       break;
+    for (size_t i = 0; i < aSizes[k]; ++i)
+    {
+      iKroky[i].ID = i;
+      iKroky[i].NextID = i + 1;
+      iKroky[i].ProcessType = i % 7;
     }
-    for (size_t i = 0; i < TRecipeStep_Size * aCardInfo->sRecipeInfo.RecipeSteps; ++i)
+    TRecipeInfo iInfo;
+    memset(&iInfo, 0, sizeof(iInfo));
+    iInfo.NumOfDrinks = 1; // S nulovym poctem napoju se kontrolni soucet nepocita
+    TCardInfo iCardInfo, iKopie;
+    NFC_InitTCardInfo(&iCardInfo);
+    NFC_InitTCardInfo(&iKopie);
+    NFC_CreateCardInfoFromRecipeInfo(&iCardInfo, iInfo);
+    NFC_AddRecipeStepsToCardInfo(&iCardInfo, iKroky, aSizes[k], true);
+
+    TNFCBenchContext iKontext = {.sCardInfo = &iCardInfo, .sCopy = &iKopie, .Size = aSizes[k]};
+    for (size_t i = 0; i < NFC_BENCH_COUNT; ++i)
     {
-      *((uint8_t *)aCardInfo->sRecipeStep + i) = 0;
+      NFC_BenchRun(Nazvy[i], Funkce[i], &iKontext, aMinTimeUs, &aResults[iPocet++]);
+      vTaskDelay(1);
     }
+    NFC_DeAllocTRecipeStepArray(&iCardInfo);
+    if (iKopie.TRecipeStepArrayCreated)
+      NFC_DeAllocTRecipeStepArray(&iKopie);
   }
-  NFC_READER_DEBUG(TAGin, "Pole zmenilo svou velikost na %d prvku.\n", NewSize);
-  return 0;
+  NFC_EmulatorStop();
+  return iPocet;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Funkce slouží k přesunutí dat z aCardInfoOrigin do aCardInfoNew
-    @param  aCardInfoOrigin Pointer na původní TCardInfo strukturu
-    @param  aCardInfoNew Pointer na novou TCardInfo strukturu
-
+    @brief  Výpis výsledků mikrobenchmarků
 
-    @returns    0 - uspesne kopirovani, 1 -Data TRecipeInfo nejsou nahrana v původní struktuře,2 - Nelze Alokovat pole. ,3 -Nebyla nactena struktura TRecipeInfo, 20- Neocekavana chyba
+    @param  aResults      Pole výsledků
+    @param  aCount      Počet výsledků
 */
 /**************************************************************************/
-uint8_t NFC_CopyTCardInfo(TCardInfo *aCardInfoOrigin, TCardInfo *aCardInfoNew)
+void NFC_PrintBenchResults(TNFCBenchResult *aResults, size_t aCount)
 {
-  static const char *TAGin = "NFC_CopyTCardInfo";
-  NFC_READER_DEBUG(TAGin, "Kopiruji data CardInfo do nove struktury\n");
-  if (!aCardInfoOrigin->TRecipeInfoLoaded)
-  {
-    NFC_READER_DEBUG(TAGin, "Data TRecipeInfo nejsou nahrana v puvodni strukture.\n");
-    return 1;
-  }
-  NFC_READER_ALL_DEBUG(TAGin, "Kopiruji TRecipeInfoData.\n");
-  aCardInfoNew->sRecipeInfo = aCardInfoOrigin->sRecipeInfo;
-  NFC_READER_ALL_DEBUG(TAGin, "Kopiruji Structure data.\n");
-  aCardInfoNew->sUidLength = aCardInfoOrigin->sUidLength;
-  for (size_t i = 0; i < aCardInfoNew->sUidLength; ++i)
-  {
-    aCardInfoNew->sUid[i] = aCardInfoOrigin->sUid[i];
-  }
-  aCardInfoNew->TRecipeInfoLoaded = aCardInfoOrigin->TRecipeInfoLoaded;
-  if (aCardInfoNew->TRecipeStepArrayCreated || aCardInfoNew->sRecipeStep != NULL)
+  printf("%-28s %6s %10s %12s %12s\n", "Benchmark", "Kroky", "Iterace", "ns/op", "cykly/op");
+  for (size_t i = 0; i < aCount; ++i)
   {
-    NFC_READER_ALL_DEBUG(TAGin, "Odalokavam puvodni pamet.\n");
-    NFC_DeAllocTRecipeStepArray(aCardInfoNew);
+    printf("%-28s %6u %10lu %12lu %12lu%s\n", aResults[i].Name, aResults[i].RecipeSteps, (unsigned long)aResults[i].Iterations,
+           (unsigned long)aResults[i].NsPerOp, (unsigned long)aResults[i].CyclesPerOp, aResults[i].Error != 0 ? " CHYBA" : "");
   }
+  fflush(stdout);
+}
 
-  uint8_t Error;
-  if (aCardInfoOrigin->TRecipeStepArrayCreated)
-  {
-    NFC_READER_ALL_DEBUG(TAGin, "Alokuju novou pamet.\n");
-    for (int i = 0; i < MAXERRORREADING; ++i)
-    {
-      Error = NFC_AllocTRecipeStepArray(aCardInfoNew);
-      if (Error == 0)
-      {
-        break;
-      }
-      NFC_DeAllocTRecipeStepArray(aCardInfoNew);
-    }
-    switch (Error)
-    {
-    case 0:
-      break;
-    case 2:
-      NFC_READER_DEBUG(TAGin, "Nebyla nactena struktura TRecipeInfo.\n");
-      return 3;
-      break;
-    case 3:
-      NFC_READER_DEBUG(TAGin, "Nelze Alokovat pole.\n");
-      return 2;
-      break;
-    default:
-      NFC_READER_DEBUG(TAGin, "Neocekavana chyba.\n");
-      return 20;
-      break;
-    }
-    for (size_t i = 0; i < TRecipeStep_Size * aCardInfoNew->sRecipeInfo.RecipeSteps; ++i)
-    {
-      *((uint8_t *)aCardInfoNew->sRecipeStep + i) = *((uint8_t *)aCardInfoOrigin->sRecipeStep + i);
-    }
+/**************************************************************************/
+/*!
+    @brief  Měření dotazu na přítomnost karty (NFC_isCardReady) na skutečné čtečce - doba dotazu bez karty
+            závisí na RF profilu (NFC_SetRFConfig). Do výsledku se přidají i doby inicializace čtečky
+            a latence výměn rámců přes nastavený přenos.
 
-    aCardInfoNew->TRecipeStepArrayCreated = aCardInfoOrigin->TRecipeStepArrayCreated;
-    NFC_READER_ALL_DEBUG(TAGin, "Pole TRecipeStep se prekopirovalo.\n");
+    @param  aNFC      Pointer na NFC strukturu
+    @param  aRuns      Počet dotazů
+    @param  aResult      Výsledek měření (časy v us)
+
+    @returns 0 - Mereni probehlo, 1 - Nelze alokovat pole
+*/
+/**************************************************************************/
+uint8_t NFC_PollBenchmark(pn532_t *aNFC, uint32_t aRuns, TNFCPollResult *aResult)
+{
+  NFC_PrefetchWait();
+  memset(aResult, 0, sizeof(*aResult));
+  aResult->InitTimeUs = NFC_Stats.InitTimeUs;
+  aResult->BootToReadyUs = NFC_Stats.BootToReadyUs;
+  aResult->Transport = NFC_Transport != NULL && NFC_Transport->Name != NULL ? NFC_Transport->Name : "pn532";
+  if (aRuns == 0)
+    return 0;
+  uint32_t *iDoby = malloc(aRuns * sizeof(uint32_t));
+  if (iDoby == NULL)
+    return 1;
+  uint32_t iVymeny = NFC_Stats.TransportExchanges;
+  uint64_t iDobaVymen = NFC_Stats.TransportTimeUs;
+  NFC_Stats.TransportMaxUs = 0;
+  uint32_t iPrikazy = NFC_Stats.Commands;
+  uint64_t iDobaPrikazu = NFC_Stats.CommandTimeUs;
+  uint64_t iCpuPrikazu = NFC_Stats.CommandCpuUs;
+  uint32_t iIrqTimeouty = NFC_Stats.IrqTimeouts;
+  for (uint32_t i = 0; i < aRuns; ++i)
+  {
+    int64_t iStart = esp_timer_get_time();
+    if (NFC_isCardReady(aNFC))
+      ++aResult->CardPresent;
+    iDoby[i] = (uint32_t)(esp_timer_get_time() - iStart);
   }
-  else
+  aResult->Exchanges = NFC_Stats.TransportExchanges - iVymeny;
+  aResult->ExchangeAvgUs = aResult->Exchanges != 0 ? (uint32_t)((NFC_Stats.TransportTimeUs - iDobaVymen) / aResult->Exchanges) : 0;
+  aResult->ExchangeMaxUs = NFC_Stats.TransportMaxUs;
+  uint32_t iPocet = NFC_Stats.Commands - iPrikazy;
+  if (iPocet != 0)
   {
-    aCardInfoNew->sRecipeStep = NULL;
+    aResult->CommandAvgUs = (uint32_t)((NFC_Stats.CommandTimeUs - iDobaPrikazu) / iPocet);
+    aResult->CommandCpuUs = (uint32_t)((NFC_Stats.CommandCpuUs - iCpuPrikazu) / iPocet);
   }
-  aCardInfoNew->TRecipeStepLoaded = aCardInfoOrigin->TRecipeStepLoaded;
-
-  NFC_READER_DEBUG(TAGin, "Data se prekopirovala.\n");
+  aResult->IrqTimeouts = NFC_Stats.IrqTimeouts - iIrqTimeouty;
+  qsort(iDoby, aRuns, sizeof(uint32_t), NFC_CompareDuration);
+  aResult->Runs = aRuns;
+  aResult->P50Us = iDoby[(aRuns - 1) * 50 / 100];
+  aResult->P99Us = iDoby[(aRuns - 1) * 99 / 100];
+  aResult->MaxUs = iDoby[aRuns - 1];
+  free(iDoby);
   return 0;
 }
+
+/**************************************************************************/
+/*!
+    @brief  Výpis výsledku měření dotazu na kartu
+
+    @param  aResult      Výsledek měření
+*/
+/**************************************************************************/
+void NFC_PrintPollResult(const TNFCPollResult *aResult)
+{
+  printf("Inicializace %lu us, od startu %llu us\n", (unsigned long)aResult->InitTimeUs, (unsigned long long)aResult->BootToReadyUs);
+  printf("Dotaz na kartu: %lu/%lu s kartou, p50 %lu us, p99 %lu us, max %lu us\n", (unsigned long)aResult->CardPresent,
+         (unsigned long)aResult->Runs, (unsigned long)aResult->P50Us, (unsigned long)aResult->P99Us, (unsigned long)aResult->MaxUs);
+  printf("Prenos %s: %lu vymen, prumer %lu us, max %lu us\n", aResult->Transport != NULL ? aResult->Transport : "?",
+         (unsigned long)aResult->Exchanges, (unsigned long)aResult->ExchangeAvgUs, (unsigned long)aResult->ExchangeMaxUs);
+  printf("Prikaz PN532: prumer %lu us, CPU %lu us, IRQ timeout %lu\n", (unsigned long)aResult->CommandAvgUs,
+         (unsigned long)aResult->CommandCpuUs, (unsigned long)aResult->IrqTimeouts);
+  fflush(stdout);
+}
+#endif
@@ -11,6 +11,7 @@ extern "C"
 {
 #endif
 
+#include <stdio.h>
 #include "pn532.h"
 
 typedef struct __attribute__((packed))
@@ -34,23 +35,351 @@ typedef struct __attribute__((packed))
 
   } TRecipeStep;
 
+#define NFC_UID_MAXSIZE 10 // Nejdelsi UID (trojnasobne UID ISO14443A, FeliCa IDm ma 8 B)
 
   typedef struct
   {
     TRecipeInfo sRecipeInfo;
     TRecipeStep *sRecipeStep;
-    uint8_t sUid[7];
+    uint8_t sUid[NFC_UID_MAXSIZE];
     uint8_t sUidLength;
     bool TRecipeInfoLoaded;
     bool TRecipeStepArrayCreated;
     bool TRecipeStepLoaded;
+    bool TRecipeStepLazy;
+    uint8_t sRecipeStepLoadedMask[32];
+    bool NumOfDrinksCounter; // NumOfDrinks je nacteny z citace tagu (NFC_SetDrinkCounter)
+    bool ActualBudgetValueBlock; // ActualBudget je nacteny z hodnotoveho bloku Mifare Classic (NFC_SetBudgetValueBlock)
+    bool TransactionRing; // NumOfDrinks/ActualBudget jsou slozene z kruhu transakci (NFC_SetTransactionRing)
+    uint16_t TransactionSequence; // Poradove cislo posledniho zaznamu v kruhu transakci
+    uint8_t TransactionSlot; // Blok kruhu transakci s poslednim zaznamem (od prvniho bloku kruhu)
+    uint8_t RecordBlock; // Prvni 16B blok zaznamu, ze ktereho se recept nacetl (NFC_LoadRecord), 0 - recept od zacatku dat
   } TCardInfo;
 
+#ifndef NFC_READER_SNAPSHOT_STEPS_EN
+#define NFC_READER_SNAPSHOT_STEPS_EN 0 // Snimek karty obsahuje i kroky receptu (2 buffery po cca 800 B RAM)
+#endif
+
+  typedef struct
+  {
+    uint32_t Epoch; // Cislo publikace (NFC_GetCardInfoEpoch)
+    bool Present;   // Karta je prilozena a nactena (false - NFC_PublishCardInfo(NULL))
+    TRecipeInfo sRecipeInfo; // Pocet kroku je v sRecipeInfo.RecipeSteps
+    uint8_t sUid[NFC_UID_MAXSIZE];
+    uint8_t sUidLength;
+#if NFC_READER_SNAPSHOT_STEPS_EN
+    TRecipeStep sRecipeStep[UINT8_MAX];
+    bool TRecipeStepLoaded;            // Vsechny kroky receptu jsou ve snimku
+    uint8_t sRecipeStepLoadedMask[32]; // Kroky, ktere jsou ve snimku
+#endif
+    bool NumOfDrinksCounter;
+    bool ActualBudgetValueBlock;
+    bool TransactionRing;
+    uint16_t TransactionSequence;
+  } TNFCCardSnapshot;
+
   static const size_t TRecipeInfo_Size = sizeof(TRecipeInfo);
   static const size_t TRecipeStep_Size = sizeof(TRecipeStep);
 
+#define NFC_IMAGE_MAXSIZE ((sizeof(TRecipeInfo) + 255 * sizeof(TRecipeStep) + 15) / 16 * 16)
+#define NFC_CAPACITY_CLASSIC_1K 752 // Datova kapacita Mifare Classic 1K (bez bloku 0 a trailer bloku)
+#define NFC_CAPACITY_NTAG213 128    // Datova kapacita NTAG213 od strany 8
+#define NFC_CAPACITY_NTAG215 488    // Datova kapacita NTAG215 od strany 8
+#define NFC_CAPACITY_NTAG216 872    // Datova kapacita NTAG216 od strany 8
+
+  typedef struct
+  {
+    uint8_t Data[NFC_IMAGE_MAXSIZE];
+    uint16_t Size;
+  } TNFCImage;
+
+  typedef bool (*TNFCProvisionNext)(TNFCImage *aImage, void *aContext);
+
+  typedef enum
+  {
+    NFC_TAG_UNKNOWN = 0,
+    NFC_TAG_CLASSIC = 1,
+    NFC_TAG_ULTRALIGHT = 2,
+    NFC_TAG_ISODEP = 3, // ISO14443-4 (DESFire EV2/EV3, NTAG 424), data v souboru aplikace NDEF
+    NFC_TAG_FELICA = 4  // FeliCa 212/424 kbps, data ve službě bez šifrování
+  } TNFCTagType;
+
+#define NFC_FELICA_MAX_BLOCKS 8 // Max. pocet bloku v jednom prikazu Read/Write Without Encryption
+
+  typedef struct
+  {
+    uint16_t ServiceCode; // Sluzba s daty (FeliCa Lite-S 0x0009 - cteni/zapis bez sifrovani)
+    uint8_t ReadBlocks;   // Max. bloku v jednom Read Without Encryption (1 - NFC_FELICA_MAX_BLOCKS, Lite-S 4)
+    uint8_t WriteBlocks;  // Max. bloku v jednom Write Without Encryption (1 - NFC_FELICA_MAX_BLOCKS, Lite-S 1)
+    bool Baud424;         // true - 424 kbps, false - 212 kbps
+  } TNFCFelicaConfig;
+
+#define NFC_KEY_SIZE 6         // Velikost klice Mifare Classic
+#define NFC_KEY_CANDIDATES 4   // Max. pocet kandidatu klice pro jeden sektor
+#define NFC_CLASSIC_SECTORS 40 // Pocet sektoru Mifare Classic 4K
+#define NFC_ALL_SECTORS 0xFF   // NFC_SetSectorKeys - klice pro vsechny sektory
+
+  typedef struct
+  {
+    uint8_t Key[NFC_KEY_SIZE]; // Klic nebo hlavni klic pro diverzifikaci
+    uint8_t KeyNumber;         // 0 - klic A, 1 - klic B
+    bool Diversify;            // true - klic se odvodi z Key a UID karty (NFC_SetKeyDiversification)
+  } TNFCKey;
+
+  typedef bool (*TNFCKeyDiversify)(const uint8_t *aUid, uint8_t aUidLength, uint8_t aSector, const uint8_t *aMasterKey, uint8_t *aKey, void *aContext);
+
+#define NFC_DIRECTORY_MAGIC 0x5244 // "DR" - karta s adresarem zaznamu
+#define NFC_DIRECTORY_BLOCKS 2      // Pocet 16B bloku adresare na zacatku dat
+#define NFC_DIRECTORY_RECORDS 7     // Max. pocet zaznamu v adresari
+
+  typedef struct __attribute__((packed))
+  {
+    uint16_t ID;    // ID zaznamu (typ stroje)
+    uint8_t Block;  // Prvni 16B blok zaznamu od zacatku dat
+    uint8_t Blocks; // Pocet 16B bloku vyhrazenych pro zaznam
+  } TNFCDirectoryEntry;
+
+  typedef struct __attribute__((packed))
+  {
+    uint16_t Magic;         // NFC_DIRECTORY_MAGIC
+    uint8_t Count;          // Pocet zaznamu
+    uint8_t CapacityBlocks; // Datova kapacita karty v 16B blocich
+    TNFCDirectoryEntry Entry[NFC_DIRECTORY_RECORDS];
+  } TNFCDirectory;
+
+#define NFC_TRANSACTION_MAGIC 0x54 // "T" - zaznam kruhu transakci
+#define NFC_TRANSACTION_MIN_BLOCKS 2 // Min. pocet 16B bloku kruhu (posledni platny zaznam se neprepisuje)
+#define NFC_TRANSACTION_HEADER 0x01  // Flags - zaznam zapsany pred zapisem hlavicky, starsi zaznamy k ni nepatri
+
+  typedef struct __attribute__((packed))
+  {
+    uint8_t Magic;         // NFC_TRANSACTION_MAGIC
+    uint8_t Flags;         // NFC_TRANSACTION_HEADER
+    uint16_t Sequence;     // Poradove cislo zaznamu (po preteceni pokracuje od 0)
+    uint16_t Base;         // CRC hlavicky na karte, ke ktere zaznam patri
+    uint32_t NumOfDrinks;  // NumOfDrinks po transakci
+    uint32_t ActualBudget; // ActualBudget po transakci
+    uint16_t Crc;          // CRC-16/CCITT predchozich bytu
+  } TNFCTransaction;
+
+#define NFC_DUMP_VERSION 1
+#define NFC_DUMP_CHECKSUM_OK 0x01 // CheckSum v TRecipeInfo odpovida krokum
+
+  typedef struct __attribute__((packed))
+  {
+    uint8_t Version;
+    uint8_t TagType;
+    uint8_t Flags;
+    uint8_t sUidLength;
+    uint8_t sUid[NFC_UID_MAXSIZE];
+    uint16_t Blocks;
+    TRecipeInfo sRecipeInfo;
+    uint8_t Data[NFC_IMAGE_MAXSIZE];
+  } TNFCCardDump;
+
+  typedef struct
+  {
+    TNFCImage sImage[2];
+    uint8_t Current;
+    bool NextReady;
+    uint8_t BackState;
+    TNFCProvisionNext Next;
+    void *Context;
+    uint32_t CardsOk;
+    uint32_t CardsFailed;
+    uint32_t BlocksWritten;
+    uint32_t BlocksSkipped;
+    int64_t StartTime;
+  } TNFCProvisioning;
+
   
+#define NFC_TRACE_SELECT 1        // Vyber karty, Arg = timeout, Data = UID, Data[12..13] = ATQA, Data[14] = SAK, Data[15] = delka UID
+#define NFC_TRACE_AUTH 2          // Autentizace Classic (NFC_DrvDataExchange), Arg = blok, Data = klic
+#define NFC_TRACE_CLASSIC_READ 3  // Cteni bloku Classic (NFC_DrvDataExchange), Arg = blok, Data = prectena data
+#define NFC_TRACE_CLASSIC_WRITE 4 // Zapis bloku Classic (NFC_DrvDataExchange), Arg = blok, Data = zapsana data
+#define NFC_TRACE_UL_READ 5       // Cteni 4 stran Ultralight (NFC_DrvDataExchange), Arg = strana, Data = prectena data
+#define NFC_TRACE_UL_WRITE 6      // Zapis strany Ultralight (NFC_DrvDataExchange), Arg = strana, Data = zapsana data
+#define NFC_TRACE_EXCHANGE 7      // InDataExchange s prikazem karty (NFC_DrvDataExchange), Arg = prvni dva byty prikazu, Result = delka odpovedi + 1, Data = odpoved (max 16 B)
+#define NFC_TRACE_EXCHANGE_DATA 8 // Pokracovani delsi odpovedi NFC_TRACE_EXCHANGE, Arg = pozice v odpovedi, Data = dalsich 16 B
+#define NFC_TRACE_REACTIVATE 9    // Rychla aktivace zname karty po chybe, Arg = timeout, Data = UID, Data[15] = delka UID
+
+  typedef struct __attribute__((packed))
+  {
+    uint8_t Op;
+    uint8_t Result;
+    uint16_t Arg;
+    uint32_t Start;
+    uint32_t Duration;
+    uint8_t Data[16];
+  } TNFCTraceFrame;
+
+  typedef enum
+  {
+    NFC_TRACE_OFF,
+    NFC_TRACE_RECORD,
+    NFC_TRACE_REPLAY
+  } TNFCTraceMode;
+
+  typedef struct
+  {
+    TNFCTraceFrame *sFrame;
+    size_t Capacity;
+    size_t Count;
+    size_t Position;
+    TNFCTraceMode Mode;
+    bool ReplayTiming;
+    int64_t StartTime;
+    uint32_t Dropped;
+    uint32_t Mismatches; // Operace, ke kterym se pri prehravani nenasel ramec
+    uint32_t Skipped;    // Ramce preskocene pri prehravani (zaznam s operacemi navic)
+  } TNFCTrace;
+
+  typedef struct
+  {
+    const char *Name;  // Nazev useku (staticky retezec, jmeno funkce)
+    uint32_t Start;    // Zacatek v us od NFC_SpansStart
+    uint32_t Duration; // Doba trvani v us (UINT32_MAX - usek stale bezi)
+    uint32_t Thread;   // Uloha, ve ktere usek bezel
+  } TNFCSpan;
+
+  typedef struct
+  {
+    TNFCSpan *sSpan;
+    size_t Capacity;
+    size_t Count; // Pocet zahajenych useku, nad Capacity se useky zahazuji
+    int64_t StartTime;
+  } TNFCSpans;
+
+  typedef enum
+  {
+    NFC_VERIFY_FULL,      // Porovnani rozsahu struktur (NFC_CheckStructArrayIsSame)
+    NFC_VERIFY_TRUST_ACK, // Zapis se povazuje za uspesny po potvrzeni karty
+    NFC_VERIFY_READBACK,  // Zpetne precteni zapsanych bloku v jedne relaci
+    NFC_VERIFY_CHECKSUM   // Zpetne precteni hlavicky a porovnani ulozeneho kontrolniho souctu receptu
+  } TNFCVerifyPolicy;
+
+  typedef struct
+  {
+    TNFCVerifyPolicy VerifyPolicy;
+    uint32_t Verifications;    // Pocet kontrol zapisu
+    uint32_t VerifyFailures;   // Pocet kontrol, ve kterych se data lisila nebo nesla precist
+    uint32_t VerifyBlocksRead; // Pocet bloku prectenych pri kontrole (NFC_VERIFY_READBACK, NFC_VERIFY_CHECKSUM)
+    uint64_t VerifyTimeUs;     // Celkova doba kontrol zapisu
+    uint32_t FirmwareVersion;  // Verze firmware PN53x (IC, verze, revize, podporovane protokoly)
+    bool WarmStart;            // Inicializace pouzila ulozenou verzi firmware (softwarovy restart, deep sleep)
+    uint32_t InitTimeUs;       // Doba NFC_Reader_Init
+    uint64_t BootToReadyUs;    // Doba od startu systemu do pripravenosti ctecky
+    uint32_t Recoveries;       // Pocet rychlych obnoveni spojeni s kartou po chybe
+    uint32_t RecoveryFailures; // Pocet neuspesnych obnoveni (karta byla odebrana)
+    uint64_t RecoveryTimeUs;   // Celkova doba obnovovani spojeni
+    uint32_t KeyDerivations;   // Pocet odvozenych (diverzifikovanych) klicu
+    uint32_t KeyMisses;        // Pocet neuspesnych autentizaci kandidatem klice
+    uint32_t TransportExchanges; // Pocet vymen ramcu pres prenos (NFC_Reader_InitTransport)
+    uint64_t TransportTimeUs;    // Celkova doba vymen ramcu
+    uint32_t TransportMaxUs;     // Nejdelsi vymena ramcu
+    uint32_t Commands;           // Pocet prikazu PN532 (bez emulovane karty a prehravani)
+    uint64_t CommandTimeUs;      // Celkova doba prikazu
+    uint64_t CommandCpuUs;       // Cas CPU ulohy ctecky behem prikazu (ESP-IDF jen s CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, jinak 0)
+    uint32_t IrqWaits;           // Pocet cekani na IRQ PN532 (NFC_SetIrqPin)
+    uint32_t IrqTimeouts;        // Pocet cekani, kdy IRQ neprislo a pripravenost se overila dotazem
+    uint32_t PipelineOverlaps;   // Pocet priprav dalsiho prikazu provedenych behem zpracovani predchoziho v PN532
+  } TNFCStats;
+
+  typedef struct
+  {
+    uint8_t MaxRetriesPassive; // Pocet pokusu InListPassiveTarget (0xFF - do timeoutu jako PN532, vychozi 0x05)
+    uint8_t MaxRetriesAtr;     // Pocet pokusu ATR_REQ (vychozi PN532 0xFF)
+    uint8_t MaxRetriesPsl;     // Pocet pokusu PSL_REQ (vychozi PN532 0x01)
+    uint8_t AtrTimeout;        // Timeout ATR_RES, kod 0x01 - 0x10 = 100 us * 2^(n-1) (vychozi PN532 0x0B - 102,4 ms)
+    uint8_t RetryTimeout;      // Timeout odpovedi karty mimo DEP, kod jako AtrTimeout (vychozi PN532 0x0A - 51,2 ms)
+    bool AutoRfca;             // Pred zapnutim pole kontrolovat cizi RF pole
+  } TNFCRFConfig;
+
+#define NFC_FRAME_MAXSIZE 262 // Nejdelsi ramec PN532 (preambule, start, LEN, LCS, 255 B, DCS, postambule)
+
+  typedef struct
+  {
+    const char *Name; // Nazev prenosu ve statistikach a benchmarcich
+    void *Context;    // Kontext predany funkcim prenosu
+    // Odeslani ramce prikazu, kontrola ACK, cekani na pripravenost a precteni ramce odpovedi od preambule,
+    // po ACK muze volat NFC_TransportAcked (priprava dalsiho prikazu behem zpracovani v PN532).
+    // *aResponseLength je na vstupu ocekavana delka ramce odpovedi, aResponse ma misto pro NFC_FRAME_MAXSIZE bytu
+    bool (*Exchange)(void *aContext, const uint8_t *aFrame, size_t aFrameLength, uint8_t *aResponse, size_t *aResponseLength,
+                     uint16_t aTimeout);
+    void (*Close)(void *aContext); // Muze byt NULL
+    // Odeslani ACK, kterym PN532 prerusi rozpracovany prikaz (napr. hledani karty po timeoutu), muze byt NULL
+    void (*Abort)(void *aContext);
+  } TNFCTransport;
+
+#ifndef NFC_READER_EMULATOR_EN
+#define NFC_READER_EMULATOR_EN 0 // Emulovana karta a prehravani zaznamu (jen hostitel a testy, ve firmware zbytecne zabira RAM)
+#endif
+
+#ifndef NFC_READER_FAULTS_EN
+#define NFC_READER_FAULTS_EN 0 // Vkladani chyb pro mereni opakovani a zotaveni (jen pro testovani)
+#endif
+
+#if NFC_READER_FAULTS_EN
+  typedef struct
+  {
+    uint16_t AuthFailPermille;  // Pravdepodobnost selhani autentizace v promile
+    uint16_t ReadFailPermille;  // Pravdepodobnost chyby cteni (CRC) v promile
+    uint16_t WriteFailPermille; // Pravdepodobnost chyby zapisu v promile
+    uint16_t TornWritePermille; // Pravdepodobnost potrhaneho zapisu (zapise se jen pulka bloku) v promile
+    uint16_t SlowPermille;      // Pravdepodobnost pomale odpovedi v promile
+    uint32_t SlowDelayMs;       // Zpozdeni pomale odpovedi
+    uint16_t RemoveAfterBlocks; // Karta se odebere po N blokovych operacich (0 - nikdy)
+    uint32_t RemoveMs;          // Jak dlouho je karta odebrana
+    uint32_t Seed;              // Seminko generatoru nahodnych cisel
+  } TNFCFaultProfile;
+
+  typedef struct
+  {
+    uint32_t Runs;
+    uint32_t Successes;
+    uint32_t P50Us;
+    uint32_t P99Us;
+    uint32_t MaxUs;
+  } TNFCChaosResult;
+#endif
+
+#ifndef NFC_READER_BENCH_EN
+#define NFC_READER_BENCH_EN 0 // Mikrobenchmarky CPU casti knihovny (prekladat bez debug vypisu)
+#endif
+
+#if NFC_READER_BENCH_EN
+  typedef struct
+  {
+    const char *Name;     // Nazev benchmarku
+    uint8_t RecipeSteps;  // Pocet kroku receptu
+    uint8_t Error;        // Posledni chyba mereni funkce (0 - bez chyby)
+    uint32_t Iterations;  // Pocet opakovani v merene davce
+    uint32_t NsPerOp;     // Doba jedne operace v ns
+    uint32_t CyclesPerOp; // Pocet cyklu CPU na operaci (0 - citac cyklu neni k dispozici)
+  } TNFCBenchResult;
+
+  typedef struct
+  {
+    uint32_t Runs;
+    uint32_t CardPresent; // Pocet dotazu, na ktere karta odpovedela
+    uint32_t P50Us;
+    uint32_t P99Us;
+    uint32_t MaxUs;
+    uint32_t InitTimeUs;    // Doba NFC_Reader_Init
+    uint64_t BootToReadyUs; // Doba od startu systemu do pripravenosti ctecky
+    const char *Transport;  // Nazev prenosu
+    uint32_t Exchanges;     // Pocet vymen ramcu pres prenos behem mereni
+    uint32_t ExchangeAvgUs; // Prumerna doba vymeny ramce
+    uint32_t ExchangeMaxUs; // Nejdelsi vymena ramce behem mereni
+    uint32_t CommandAvgUs;  // Prumerna doba prikazu PN532
+    uint32_t CommandCpuUs;  // Prumerny cas CPU na prikaz (s IRQ bez cekani na odpoved)
+    uint32_t IrqTimeouts;   // Cekani na IRQ, ktera skoncila dotazem na stav
+  } TNFCPollResult;
+#endif
+
   uint8_t NFC_Reader_Init(pn532_t *aNFC,uint8_t aClk, uint8_t aMiso, uint8_t aMosi, uint8_t aSs);
+  uint8_t NFC_Reader_InitTransport(pn532_t *aNFC, const TNFCTransport *aTransport);
+  void NFC_TransportAcked(void);
   void NFC_Print(TCardInfo aCardInfo);
   uint8_t NFC_WriteStruct(pn532_t *aNFC, TCardInfo* aCardInfo, uint16_t NumOfStructure);
   uint8_t NFC_WriteStructRange(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd);
@@ -64,6 +393,7 @@ typedef struct __attribute__((packed))
   bool NFC_getUID(pn532_t *aNFC, uint8_t *aUid, uint8_t *aUidLength);
   bool NFC_saveUID(TCardInfo *aCardInfo, uint8_t *aUid, uint8_t aUidLength);
   uint8_t NFC_CheckStructArrayIsSame(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart,uint16_t NumOfStructureEnd);
+  uint8_t NFC_FindDifferentBlock(pn532_t *aNFC, TCardInfo *aCardInfo, uint16_t NumOfStructureStart, uint16_t NumOfStructureEnd, size_t *aBlock);
   uint8_t NFC_WriteAllData(pn532_t *aNFC, TCardInfo *aCardInfo);
   uint8_t NFC_GetMifareClassicIndex(size_t i);
   uint8_t NFC_LoadAllData(pn532_t *aNFC, TCardInfo *aCardInfo);
@@ -73,6 +403,67 @@ typedef struct __attribute__((packed))
   uint8_t NFC_AddRecipeStepsToCardInfo(TCardInfo *aCardInfo,TRecipeStep *aRecipeStep, size_t SizeOfRecipeSteps,bool DeAlloc);
   uint8_t NFC_ChangeRecipeStepsSize(TCardInfo *aCardInfo,uint8_t NewSize);
     uint8_t NFC_CopyTCardInfo(TCardInfo *aCardInfoOrigin,TCardInfo *aCardInfoNew);
+  uint8_t NFC_PublishCardInfo(TCardInfo *aCardInfo);
+  uint8_t NFC_GetCardInfoSnapshot(TNFCCardSnapshot *aSnapshot);
+  uint32_t NFC_GetCardInfoEpoch(void);
+  uint8_t NFC_SessionOpen(pn532_t *aNFC);
+  void NFC_SessionClose(void);
+  uint8_t NFC_LoadTRecipeInfoLazy(pn532_t *aNFC, TCardInfo *aCardInfo);
+  uint8_t NFC_GetTRecipeStep(pn532_t *aNFC, TCardInfo *aCardInfo, size_t NumOfStructure, TRecipeStep **aRecipeStep);
+  uint8_t NFC_PrefetchTRecipeSteps(pn532_t *aNFC, TCardInfo *aCardInfo, size_t NumOfStructure, uint8_t Depth);
+  uint8_t NFC_PrefetchTRecipeStepsAsync(pn532_t *aNFC, TCardInfo *aCardInfo, size_t NumOfStructure, uint8_t Depth);
+  uint8_t NFC_PrefetchWait(void);
+  uint8_t NFC_CreateImageFromCardInfo(TCardInfo *aCardInfo, TNFCImage *aImage);
+  uint8_t NFC_CreateImageFromRecipe(TNFCImage *aImage, TRecipeInfo *aRecipeInfo, TRecipeStep *aRecipeStep, size_t SizeOfRecipeSteps);
+  uint8_t NFC_ProvisionBegin(TNFCProvisioning *aProv, TNFCProvisionNext aNext, void *aContext);
+  uint8_t NFC_ProvisionCard(pn532_t *aNFC, TNFCProvisioning *aProv);
+  uint32_t NFC_ProvisionCardsPerMinute(TNFCProvisioning *aProv);
+  uint8_t NFC_DumpCard(pn532_t *aNFC, TNFCCardDump *aDump);
+  uint8_t NFC_RestoreCard(pn532_t *aNFC, TNFCCardDump *aDump, bool aSameUid);
+  uint8_t NFC_CardDumpToCardInfo(TNFCCardDump *aDump, TCardInfo *aCardInfo);
+  uint8_t NFC_FormatDirectory(pn532_t *aNFC, uint8_t aCapacityBlocks);
+  uint8_t NFC_LoadRecord(pn532_t *aNFC, uint16_t aRecordId, TCardInfo *aCardInfo);
+  uint8_t NFC_WriteRecord(pn532_t *aNFC, uint16_t aRecordId, TCardInfo *aCardInfo);
+  void NFC_TraceRecordStart(TNFCTrace *aTrace, TNFCTraceFrame *aFrames, size_t aCapacity);
+#if NFC_READER_EMULATOR_EN
+  void NFC_TraceReplayStart(TNFCTrace *aTrace, TNFCTraceFrame *aFrames, size_t aCount, bool aReplayTiming);
+#endif
+  void NFC_TraceStop(void);
+  uint64_t NFC_TraceDuration(TNFCTrace *aTrace);
+  void NFC_SetTagBackend(TNFCTagType aTagType);
+  void NFC_SetIsoDepFile(uint16_t aFileId);
+  void NFC_SetFelicaConfig(const TNFCFelicaConfig *aConfig);
+  uint8_t NFC_SetRFConfig(pn532_t *aNFC, const TNFCRFConfig *aConfig);
+  uint8_t NFC_SetIrqPin(int aGpio);
+  uint8_t NFC_SetSectorKeys(uint8_t aSector, const TNFCKey *aKeys, uint8_t aCount);
+  void NFC_SetKeyDiversification(TNFCKeyDiversify aFunction, void *aContext);
+  void NFC_SetDrinkCounter(int8_t aCounter);
+  uint8_t NFC_IncrementNumOfDrinks(pn532_t *aNFC, TCardInfo *aCardInfo, uint32_t aIncrement);
+  void NFC_SetBudgetValueBlock(uint8_t aBlock);
+  void NFC_SetTransactionRing(uint8_t aFirstBlock, uint8_t aBlocks);
+  uint8_t NFC_DecrementBudget(pn532_t *aNFC, TCardInfo *aCardInfo, uint32_t aAmount);
+  uint8_t NFC_IncrementBudget(pn532_t *aNFC, TCardInfo *aCardInfo, uint32_t aAmount);
+  void NFC_SetVerifyPolicy(TNFCVerifyPolicy aPolicy);
+  void NFC_GetStats(TNFCStats *aStats);
+  void NFC_ResetStats(void);
+  void NFC_SpansStart(TNFCSpans *aSpans, TNFCSpan *aBuffer, size_t aCapacity);
+  void NFC_SpansStop(void);
+  uint8_t NFC_SpansExportChrome(TNFCSpans *aSpans, FILE *aFile);
+#if NFC_READER_EMULATOR_EN
+  uint8_t NFC_EmulatorStart(TNFCCardDump *aCard);
+  void NFC_EmulatorStop(void);
+#endif
+#if NFC_READER_BENCH_EN
+  size_t NFC_RunMicrobenchmarks(const uint8_t *aSizes, size_t aNumSizes, uint32_t aMinTimeUs, TNFCBenchResult *aResults, size_t aCapacity);
+  void NFC_PrintBenchResults(TNFCBenchResult *aResults, size_t aCount);
+  uint8_t NFC_PollBenchmark(pn532_t *aNFC, uint32_t aRuns, TNFCPollResult *aResult);
+  void NFC_PrintPollResult(const TNFCPollResult *aResult);
+#endif
+#if NFC_READER_FAULTS_EN
+  void NFC_FaultStart(const TNFCFaultProfile *aProfile);
+  void NFC_FaultStop(void);
+  uint8_t NFC_ChaosBenchmark(pn532_t *aNFC, TCardInfo *aCardInfo, const TNFCFaultProfile *aProfile, uint32_t aRuns, TNFCChaosResult *aResult);
+#endif
 
   
 
@@ -0,0 +1,73 @@
+/* ==========================================
+    NFC_reader - Knihovna na synchronizaci dat z NFC Čipu
+    Copyright (c) 2024 Luboš Chmelař
+    [Licence]
+========================================== */
+#ifndef NFC_reader_debug_H
+#define NFC_reader_debug_H
+
+#include <stdio.h>
+
+#ifndef NFC_READER_ALL_DEBUG_EN
+#define NFC_READER_ALL_DEBUG_EN 1 // Všechno debugovaní
+#endif
+#ifndef NFC_READER_DEBUG_EN
+#define NFC_READER_DEBUG_EN 1     // Lehké debugování
+#endif
+
+// Výpisy by měření mikrobenchmarků zkreslily (NFC_READER_BENCH_EN je v NFC_reader.h)
+#if defined(NFC_READER_BENCH_EN) && NFC_READER_BENCH_EN && (NFC_READER_ALL_DEBUG_EN || NFC_READER_DEBUG_EN)
+#error "NFC_READER_BENCH_EN se preklada bez debugovani (NFC_READER_ALL_DEBUG_EN=0, NFC_READER_DEBUG_EN=0)"
+#endif
+
+/*!
+Zajištění výpisu všeho debugování
+*/
+#if NFC_READER_ALL_DEBUG_EN
+#define NFC_READER_ALL_DEBUG(tag, fmt, ...)                      \
+  do                                                             \
+  {                                                              \
+    if (tag && *tag)                                             \
+    {                                                            \
+      printf("\x1B[31m[%s]DA:\x1B[0m " fmt, tag, ##__VA_ARGS__); \
+      fflush(stdout);                                            \
+    }                                                            \
+    else                                                         \
+    {                                                            \
+      printf(fmt, ##__VA_ARGS__);                                \
+    }                                                            \
+  } while (0)
+#else
+#define NFC_READER_ALL_DEBUG(tag, fmt, ...) \
+  do                                        \
+  {                                         \
+    (void)(tag);                            \
+  } while (0)
+#endif
+
+/*!
+Zajištění výpisu lehkého debugování
+*/
+#if NFC_READER_DEBUG_EN
+#define NFC_READER_DEBUG(tag, fmt, ...)                         \
+  do                                                            \
+  {                                                             \
+    if (tag && *tag)                                            \
+    {                                                           \
+      printf("\x1B[36m[%s]D:\x1B[0m " fmt, tag, ##__VA_ARGS__); \
+      fflush(stdout);                                           \
+    }                                                           \
+    else                                                        \
+    {                                                           \
+      printf(fmt, ##__VA_ARGS__);                               \
+    }                                                           \
+  } while (0)
+#else
+#define NFC_READER_DEBUG(tag, fmt, ...) \
+  do                                    \
+  {                                     \
+    (void)(tag);                        \
+  } while (0)
+#endif
+
+#endif
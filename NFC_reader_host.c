@@ -0,0 +1,1299 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "NFC_reader_host.h"
+#include "NFC_reader_debug.h"
+
+#if defined(__linux__)
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/i2c-dev.h>
+#include <linux/spi/spidev.h>
+
+#define NFC_IMPORT_MAGIC "NFCR"          // Hlavička binárního souboru receptů
+#define NFC_IMPORT_HEADER_SIZE 8         // Magic + verze + rezerva
+#define NFC_IMPORT_VERSION 1             // Verze binárního formátu
+#define NFC_IMPORT_RELEASE (1024 * 1024) // Po kolika přečtených bytech se uvolní stránky souboru
+#define NFC_CORPUS_MAGIC "NFCC"          // Hlavička souboru s výpisy karet
+#define NFC_CORPUS_HEADER_SIZE 8         // Magic + verze + rezerva
+#define NFC_TRACE_MAGIC "NFCT"           // Hlavička souboru se záznamem komunikace
+#define NFC_TRACE_VERSION 1              // Verze formátu záznamu
+#define NFC_SPI_DATA_WRITE 0x01          // SPI - zápis rámce
+#define NFC_SPI_STATUS_READ 0x02         // SPI - čtení stavu (bit 0 - odpověď připravena)
+#define NFC_SPI_DATA_READ 0x03           // SPI - čtení rámce
+#define NFC_ACK_SIZE 6                   // Rámec ACK
+#define NFC_ACK_DELAY_US 1000            // Doba, za kterou PN532 příkaz potvrdí
+#define NFC_LINK_POLL_US 250             // Výchozí interval dotazu na připravenost PN532
+
+static const uint8_t NFC_Ack[NFC_ACK_SIZE] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+
+/**************************************************************************/
+/*!
+    @brief  Otevření souboru s recepty (binární formát "NFCR" nebo CSV) přes mmap
+
+    @param  aImport      Pointer na stav importu
+    @param  aPath      Cesta k souboru
+    @param  aCapacity      Datová kapacita cílového tagu v bytech (např. NFC_CAPACITY_CLASSIC_1K)
+
+    @returns 0 - Soubor je otevren, 1 - Soubor nelze otevrit, 2 - Nepodporovana verze binarniho formatu
+*/
+/**************************************************************************/
+uint8_t NFC_ImportOpen(TNFCImport *aImport, const char *aPath, uint16_t aCapacity)
+{
+  static const char *TAGin = "NFC_ImportOpen";
+  NFC_READER_DEBUG(TAGin, "Oteviram soubor receptu %s.\n", aPath);
+  memset(aImport, 0, sizeof(*aImport));
+  aImport->Capacity = aCapacity;
+  aImport->Fd = open(aPath, O_RDONLY);
+  if (aImport->Fd < 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Soubor nelze otevrit.\n");
+    return 1;
+  }
+  struct stat iStat;
+  if (fstat(aImport->Fd, &iStat) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Nelze zjistit velikost souboru.\n");
+    NFC_ImportClose(aImport);
+    return 1;
+  }
+  aImport->Size = iStat.st_size;
+  if (aImport->Size > 0)
+  {
+    void *iData = mmap(NULL, aImport->Size, PROT_READ, MAP_PRIVATE, aImport->Fd, 0);
+    if (iData == MAP_FAILED)
+    {
+      NFC_READER_DEBUG(TAGin, "Soubor nelze namapovat.\n");
+      NFC_ImportClose(aImport);
+      return 1;
+    }
+    madvise(iData, aImport->Size, MADV_SEQUENTIAL);
+    aImport->Data = iData;
+  }
+
+  aImport->Format = NFC_IMPORT_CSV;
+  if (aImport->Size >= NFC_IMPORT_HEADER_SIZE && memcmp(aImport->Data, NFC_IMPORT_MAGIC, 4) == 0)
+  {
+    if (aImport->Data[4] != NFC_IMPORT_VERSION)
+    {
+      NFC_READER_DEBUG(TAGin, "Nepodporovana verze %d.\n", aImport->Data[4]);
+      NFC_ImportClose(aImport);
+      return 2;
+    }
+    aImport->Format = NFC_IMPORT_BINARY;
+    aImport->Position = NFC_IMPORT_HEADER_SIZE;
+  }
+  NFC_READER_ALL_DEBUG(TAGin, "Format: %s, velikost %zu B.\n", aImport->Format == NFC_IMPORT_BINARY ? "binarni" : "CSV", aImport->Size);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Uzavření souboru s recepty
+
+    @param  aImport      Pointer na stav importu
+*/
+/**************************************************************************/
+void NFC_ImportClose(TNFCImport *aImport)
+{
+  if (aImport->Data != NULL)
+  {
+    munmap((void *)aImport->Data, aImport->Size);
+    aImport->Data = NULL;
+  }
+  if (aImport->Fd >= 0)
+  {
+    close(aImport->Fd);
+    aImport->Fd = -1;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Uvolnění již zpracovaných stránek souboru, aby paměť importu zůstala omezená
+
+    @param  aImport      Pointer na stav importu
+*/
+/**************************************************************************/
+static void NFC_ImportRelease(TNFCImport *aImport)
+{
+  size_t iStranka = sysconf(_SC_PAGESIZE);
+  size_t iKonec = aImport->Position / iStranka * iStranka;
+  if (iKonec - aImport->Released >= NFC_IMPORT_RELEASE)
+  {
+    madvise((void *)(aImport->Data + aImport->Released), iKonec - aImport->Released, MADV_DONTNEED);
+    aImport->Released = iKonec;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Kontrola receptu vůči rozložení cílového tagu
+
+    @param  aImport      Pointer na stav importu
+    @param  aRecipeInfo      Pointer na TRecipeInfo receptu
+
+    @returns 0 - Recept je v poradku, 3 - Recept se nevejde na tag nebo ma neplatne hodnoty
+*/
+/**************************************************************************/
+static uint8_t NFC_ImportValidate(TNFCImport *aImport, const TRecipeInfo *aRecipeInfo)
+{
+  static const char *TAGin = "NFC_ImportValidate";
+  size_t iDelka = TRecipeInfo_Size + aRecipeInfo->RecipeSteps * TRecipeStep_Size;
+  if (aImport->Capacity != 0 && iDelka > aImport->Capacity)
+  {
+    NFC_READER_DEBUG(TAGin, "Recept %d (%zu B) se nevejde na tag (%d B).\n", aRecipeInfo->ID, iDelka, aImport->Capacity);
+    return 3;
+  }
+  if (aRecipeInfo->RecipeSteps > 0 && aRecipeInfo->ActualRecipeStep >= aRecipeInfo->RecipeSteps)
+  {
+    NFC_READER_DEBUG(TAGin, "Recept %d ma ActualRecipeStep mimo rozsah.\n", aRecipeInfo->ID);
+    return 3;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Načtení dalšího receptu v binárním formátu (TRecipeInfo + pole TRecipeStep tak, jak jsou na kartě)
+
+    @returns viz NFC_ImportNext
+*/
+/**************************************************************************/
+static uint8_t NFC_ImportNextBinary(TNFCImport *aImport, TNFCImage *aImage)
+{
+  static const char *TAGin = "NFC_ImportNextBinary";
+  if (aImport->Position >= aImport->Size)
+    return 1;
+  const TRecipeInfo *iInfo = (const TRecipeInfo *)(aImport->Data + aImport->Position);
+  if (aImport->Size - aImport->Position < TRecipeInfo_Size ||
+      aImport->Size - aImport->Position < TRecipeInfo_Size + iInfo->RecipeSteps * TRecipeStep_Size)
+  {
+    NFC_READER_DEBUG(TAGin, "Zaznam %lu je zkraceny.\n", (unsigned long)aImport->Records);
+    aImport->Position = aImport->Size;
+    return 2;
+  }
+  aImport->Position += TRecipeInfo_Size + iInfo->RecipeSteps * TRecipeStep_Size;
+  if (NFC_ImportValidate(aImport, iInfo) != 0)
+    return 3;
+  NFC_CreateImageFromRecipe(aImage, (TRecipeInfo *)iInfo, (TRecipeStep *)(aImport->Data + aImport->Position - iInfo->RecipeSteps * TRecipeStep_Size), iInfo->RecipeSteps);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přečtení jednoho čísla z CSV řádku (oddělovač ',' nebo ';') s kontrolou rozsahu cílového pole
+
+    @param  aImport      Pointer na stav importu
+    @param  aMax      Největší hodnota, která se do pole vejde
+    @param  aValue      Výstupní hodnota
+
+    @returns 0 - Cislo se precetlo, 1 - Na radku uz neni dalsi cislo, 2 - Cislo je vetsi nez aMax
+*/
+/**************************************************************************/
+static uint8_t NFC_ImportParseNumber(TNFCImport *aImport, uint32_t aMax, uint32_t *aValue)
+{
+  const uint8_t *iZnak = aImport->Data + aImport->Position;
+  const uint8_t *iKonec = aImport->Data + aImport->Size;
+  while (iZnak < iKonec && (*iZnak == ' ' || *iZnak == '\t'))
+    ++iZnak;
+  if (iZnak == iKonec || *iZnak < '0' || *iZnak > '9')
+  {
+    aImport->Position = iZnak - aImport->Data;
+    return 1;
+  }
+  // Po prekroceni aMax se dalsi cislice jen preskoci, aby hodnota nepretekla
+  uint64_t iHodnota = 0;
+  while (iZnak < iKonec && *iZnak >= '0' && *iZnak <= '9')
+  {
+    if (iHodnota <= aMax)
+      iHodnota = iHodnota * 10 + (*iZnak - '0');
+    ++iZnak;
+  }
+  while (iZnak < iKonec && (*iZnak == ' ' || *iZnak == '\t'))
+    ++iZnak;
+  if (iZnak < iKonec && (*iZnak == ',' || *iZnak == ';'))
+    ++iZnak;
+  aImport->Position = iZnak - aImport->Data;
+  if (iHodnota > aMax)
+    return 2;
+  *aValue = (uint32_t)iHodnota;
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Načtení dalšího receptu z CSV řádku
+            "Type,ID,NumOfDrinks,ActualRecipeStep,ActualBudget,Parameters,ID,NextID,ProcessType,..."
+            (řádky začínající '#' jsou komentáře). Kroky se parsují přímo do obrazu karty.
+
+    @returns viz NFC_ImportNext
+*/
+/**************************************************************************/
+static uint8_t NFC_ImportNextCsv(TNFCImport *aImport, TNFCImage *aImage)
+{
+  static const char *TAGin = "NFC_ImportNextCsv";
+  while (aImport->Position < aImport->Size)
+  {
+    ++aImport->Line;
+    const uint8_t *iRadek = aImport->Data + aImport->Position;
+    const uint8_t *iKonecRadku = memchr(iRadek, '\n', aImport->Size - aImport->Position);
+    size_t iDalsiRadek = iKonecRadku ? (size_t)(iKonecRadku - aImport->Data) + 1 : aImport->Size;
+    if (*iRadek == '#' || *iRadek == '\n' || *iRadek == '\r')
+    {
+      aImport->Position = iDalsiRadek;
+      continue;
+    }
+
+    // Rozsahy poli TRecipeInfo v poradi sloupcu
+    static const uint32_t iMaxima[6] = {UINT8_MAX, UINT16_MAX, UINT32_MAX, UINT8_MAX, UINT32_MAX, UINT8_MAX};
+    uint32_t iHodnoty[6];
+    for (size_t i = 0; i < 6; ++i)
+    {
+      uint8_t iStav = NFC_ImportParseNumber(aImport, iMaxima[i], &iHodnoty[i]);
+      if (iStav == 1)
+      {
+        NFC_READER_DEBUG(TAGin, "Radek %lu nema hlavicku receptu.\n", (unsigned long)aImport->Line);
+        aImport->Position = iDalsiRadek;
+        return 3;
+      }
+      if (iStav == 2)
+      {
+        NFC_READER_DEBUG(TAGin, "Radek %lu ma %zu. hodnotu hlavicky mimo rozsah.\n", (unsigned long)aImport->Line, i + 1);
+        aImport->Position = iDalsiRadek;
+        return 3;
+      }
+    }
+    TRecipeInfo iInfo = {0};
+    iInfo.Type = iHodnoty[0];
+    iInfo.ID = iHodnoty[1];
+    iInfo.NumOfDrinks = iHodnoty[2];
+    iInfo.ActualRecipeStep = iHodnoty[3];
+    iInfo.ActualBudget = iHodnoty[4];
+    iInfo.Parameters = iHodnoty[5];
+
+    uint8_t *iKroky = aImage->Data + TRecipeInfo_Size;
+    size_t iPocet = 0;
+    uint32_t iHodnota;
+    uint8_t iStav = 1;
+    while (aImport->Position < iDalsiRadek && (iStav = NFC_ImportParseNumber(aImport, UINT8_MAX, &iHodnota)) == 0)
+    {
+      if (iPocet >= 255 * TRecipeStep_Size)
+      {
+        NFC_READER_DEBUG(TAGin, "Radek %lu ma prilis mnoho kroku.\n", (unsigned long)aImport->Line);
+        aImport->Position = iDalsiRadek;
+        return 3;
+      }
+      iKroky[iPocet++] = iHodnota;
+    }
+    aImport->Position = iDalsiRadek;
+    if (iStav == 2)
+    {
+      NFC_READER_DEBUG(TAGin, "Radek %lu ma hodnotu kroku %zu mimo rozsah.\n", (unsigned long)aImport->Line, iPocet / TRecipeStep_Size + 1);
+      return 3;
+    }
+    if (iPocet % TRecipeStep_Size != 0)
+    {
+      NFC_READER_DEBUG(TAGin, "Radek %lu ma neuplny krok.\n", (unsigned long)aImport->Line);
+      return 3;
+    }
+    iInfo.RecipeSteps = iPocet / TRecipeStep_Size;
+    if (NFC_ImportValidate(aImport, &iInfo) != 0)
+      return 3;
+    NFC_CreateImageFromRecipe(aImage, &iInfo, (TRecipeStep *)iKroky, iInfo.RecipeSteps);
+    return 0;
+  }
+  return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Načtení dalšího receptu ze souboru přímo do obrazu karty připraveného k zápisu
+
+    @param  aImport      Pointer na stav importu
+    @param  aImage      Pointer na obraz karty
+
+    @returns 0 - Obraz je pripraven, 1 - Konec souboru, 2 - Soubor je poskozeny, 3 - Recept je neplatny/nevejde se na tag (preskocen)
+*/
+/**************************************************************************/
+uint8_t NFC_ImportNext(TNFCImport *aImport, TNFCImage *aImage)
+{
+  uint8_t Error;
+  if (aImport->Format == NFC_IMPORT_BINARY)
+  {
+    Error = NFC_ImportNextBinary(aImport, aImage);
+  }
+  else
+  {
+    Error = NFC_ImportNextCsv(aImport, aImage);
+  }
+  if (Error == 0)
+  {
+    ++aImport->Records;
+  }
+  else if (Error == 3)
+  {
+    ++aImport->Rejected;
+    aImport->RejectedLine = aImport->Line;
+  }
+  NFC_ImportRelease(aImport);
+  return Error;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Napojení importu na hromadný zápis (TNFCProvisionNext), neplatné recepty se přeskočí
+
+    @param  aImage      Pointer na obraz karty
+    @param  aContext      Pointer na TNFCImport
+
+    @returns true - Obraz je pripraven, false - Dalsi recept uz neni
+*/
+/**************************************************************************/
+bool NFC_ImportProvisionNext(TNFCImage *aImage, void *aContext)
+{
+  uint8_t Error;
+  do
+  {
+    Error = NFC_ImportNext((TNFCImport *)aContext, aImage);
+  } while (Error == 3);
+  return Error == 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Uložení výpisu karty na konec souboru s výpisy (soubor se případně vytvoří).
+            Záznamy mají pevnou velikost, takže je lze číst přímo z namapovaného souboru.
+
+    @param  aPath      Cesta k souboru
+    @param  aDump      Pointer na výpis karty
+
+    @returns 0 - Vypis se ulozil, 1 - Soubor nelze otevrit, 2 - Soubor neni soubor s vypisy, 3 - Chyba zapisu
+*/
+/**************************************************************************/
+uint8_t NFC_DumpSave(const char *aPath, TNFCCardDump *aDump)
+{
+  static const char *TAGin = "NFC_DumpSave";
+  FILE *iSoubor = fopen(aPath, "a+b");
+  if (iSoubor == NULL)
+  {
+    NFC_READER_DEBUG(TAGin, "Soubor %s nelze otevrit.\n", aPath);
+    return 1;
+  }
+  uint8_t iHlavicka[NFC_CORPUS_HEADER_SIZE] = {0};
+  fseek(iSoubor, 0, SEEK_END);
+  if (ftell(iSoubor) == 0)
+  {
+    memcpy(iHlavicka, NFC_CORPUS_MAGIC, 4);
+    iHlavicka[4] = NFC_DUMP_VERSION;
+    iHlavicka[5] = sizeof(TNFCCardDump) & 0xFF;
+    iHlavicka[6] = sizeof(TNFCCardDump) >> 8;
+    fwrite(iHlavicka, 1, sizeof(iHlavicka), iSoubor);
+  }
+  else
+  {
+    fseek(iSoubor, 0, SEEK_SET);
+    if (fread(iHlavicka, 1, sizeof(iHlavicka), iSoubor) != sizeof(iHlavicka) || memcmp(iHlavicka, NFC_CORPUS_MAGIC, 4) != 0)
+    {
+      NFC_READER_DEBUG(TAGin, "Soubor %s neni soubor s vypisy.\n", aPath);
+      fclose(iSoubor);
+      return 2;
+    }
+    fseek(iSoubor, 0, SEEK_END);
+  }
+  size_t iZapsano = fwrite(aDump, 1, sizeof(TNFCCardDump), iSoubor);
+  if (fclose(iSoubor) != 0 || iZapsano != sizeof(TNFCCardDump))
+  {
+    NFC_READER_DEBUG(TAGin, "Chyba zapisu.\n");
+    return 3;
+  }
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Otevření souboru s výpisy karet přes mmap (bez parsování, záznamy se čtou přímo)
+
+    @param  aCorpus      Pointer na soubor s výpisy
+    @param  aPath      Cesta k souboru
+
+    @returns 0 - Soubor je otevren, 1 - Soubor nelze otevrit, 2 - Soubor neni soubor s vypisy, ma jinou verzi nebo je zkraceny
+*/
+/**************************************************************************/
+uint8_t NFC_CorpusOpen(TNFCCorpus *aCorpus, const char *aPath)
+{
+  static const char *TAGin = "NFC_CorpusOpen";
+  memset(aCorpus, 0, sizeof(*aCorpus));
+  aCorpus->Fd = open(aPath, O_RDONLY);
+  struct stat iStat;
+  if (aCorpus->Fd < 0 || fstat(aCorpus->Fd, &iStat) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Soubor %s nelze otevrit.\n", aPath);
+    NFC_CorpusClose(aCorpus);
+    return 1;
+  }
+  aCorpus->Size = iStat.st_size;
+  if (aCorpus->Size < NFC_CORPUS_HEADER_SIZE)
+  {
+    NFC_READER_DEBUG(TAGin, "Soubor %s neni soubor s vypisy.\n", aPath);
+    NFC_CorpusClose(aCorpus);
+    return 2;
+  }
+  void *iData = mmap(NULL, aCorpus->Size, PROT_READ, MAP_PRIVATE, aCorpus->Fd, 0);
+  if (iData == MAP_FAILED)
+  {
+    NFC_READER_DEBUG(TAGin, "Soubor nelze namapovat.\n");
+    aCorpus->Data = NULL;
+    NFC_CorpusClose(aCorpus);
+    return 1;
+  }
+  aCorpus->Data = iData;
+  if (memcmp(aCorpus->Data, NFC_CORPUS_MAGIC, 4) != 0 || aCorpus->Data[4] != NFC_DUMP_VERSION ||
+      (aCorpus->Data[5] | (aCorpus->Data[6] << 8)) != sizeof(TNFCCardDump))
+  {
+    NFC_READER_DEBUG(TAGin, "Soubor %s neni soubor s vypisy nebo ma jinou verzi.\n", aPath);
+    NFC_CorpusClose(aCorpus);
+    return 2;
+  }
+  if ((aCorpus->Size - NFC_CORPUS_HEADER_SIZE) % sizeof(TNFCCardDump) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Soubor %s je zkraceny.\n", aPath);
+    NFC_CorpusClose(aCorpus);
+    return 2;
+  }
+  aCorpus->Count = (aCorpus->Size - NFC_CORPUS_HEADER_SIZE) / sizeof(TNFCCardDump);
+  NFC_READER_ALL_DEBUG(TAGin, "Soubor obsahuje %zu vypisu.\n", aCorpus->Count);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Výpis karty ze souboru s výpisy (ukazuje přímo do namapovaného souboru). Výpis s neplatnou
+            verzí, typem tagu, délkou UID nebo počtem bloků se nevrátí, aby obnovení nečetlo mimo Data.
+
+    @param  aCorpus      Pointer na soubor s výpisy
+    @param  aIndex      Pořadí výpisu od 0
+
+    @returns Pointer na vypis, NULL - aIndex je mimo rozsah nebo je vypis poskozeny
+*/
+/**************************************************************************/
+const TNFCCardDump *NFC_CorpusGet(TNFCCorpus *aCorpus, size_t aIndex)
+{
+  static const char *TAGin = "NFC_CorpusGet";
+  if (aIndex >= aCorpus->Count)
+    return NULL;
+  const TNFCCardDump *iVypis = (const TNFCCardDump *)(aCorpus->Data + NFC_CORPUS_HEADER_SIZE + aIndex * sizeof(TNFCCardDump));
+  if (iVypis->Version != NFC_DUMP_VERSION || iVypis->TagType == NFC_TAG_UNKNOWN || iVypis->TagType > NFC_TAG_FELICA ||
+      iVypis->sUidLength == 0 || iVypis->sUidLength > NFC_UID_MAXSIZE || iVypis->Blocks > NFC_IMAGE_MAXSIZE / 16)
+  {
+    NFC_READER_DEBUG(TAGin, "Vypis %zu je poskozeny.\n", aIndex);
+    return NULL;
+  }
+  return iVypis;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Uzavření souboru s výpisy
+
+    @param  aCorpus      Pointer na soubor s výpisy
+*/
+/**************************************************************************/
+void NFC_CorpusClose(TNFCCorpus *aCorpus)
+{
+  if (aCorpus->Data != NULL)
+  {
+    munmap((void *)aCorpus->Data, aCorpus->Size);
+    aCorpus->Data = NULL;
+  }
+  if (aCorpus->Fd >= 0)
+  {
+    close(aCorpus->Fd);
+    aCorpus->Fd = -1;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Uložení záznamu komunikace se čtečkou do souboru
+
+    @param  aPath      Cesta k souboru
+    @param  aTrace      Pointer na záznam
+
+    @returns 0 - Zaznam se ulozil, 1 - Soubor nelze otevrit, 3 - Chyba zapisu
+*/
+/**************************************************************************/
+uint8_t NFC_TraceSave(const char *aPath, TNFCTrace *aTrace)
+{
+  static const char *TAGin = "NFC_TraceSave";
+  FILE *iSoubor = fopen(aPath, "wb");
+  if (iSoubor == NULL)
+  {
+    NFC_READER_DEBUG(TAGin, "Soubor %s nelze otevrit.\n", aPath);
+    return 1;
+  }
+  uint8_t iHlavicka[8] = {0};
+  memcpy(iHlavicka, NFC_TRACE_MAGIC, 4);
+  iHlavicka[4] = NFC_TRACE_VERSION;
+  size_t iZapsano = fwrite(iHlavicka, 1, sizeof(iHlavicka), iSoubor);
+  iZapsano += fwrite(aTrace->sFrame, sizeof(TNFCTraceFrame), aTrace->Count, iSoubor) * sizeof(TNFCTraceFrame);
+  if (fclose(iSoubor) != 0 || iZapsano != sizeof(iHlavicka) + aTrace->Count * sizeof(TNFCTraceFrame))
+  {
+    NFC_READER_DEBUG(TAGin, "Chyba zapisu.\n");
+    return 3;
+  }
+  NFC_READER_DEBUG(TAGin, "Ulozeno %zu ramcu.\n", aTrace->Count);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Načtení záznamu komunikace ze souboru (pro NFC_TraceReplayStart)
+
+    @param  aPath      Cesta k souboru
+    @param  aFrames      Buffer rámců
+    @param  aCapacity      Počet rámců v bufferu
+    @param  aCount      Počet načtených rámců
+
+    @returns 0 - Zaznam se nacetl, 1 - Soubor nelze otevrit, 2 - Soubor neni zaznam komunikace, 3 - Zaznam se nevejde do bufferu
+*/
+/**************************************************************************/
+uint8_t NFC_TraceLoad(const char *aPath, TNFCTraceFrame *aFrames, size_t aCapacity, size_t *aCount)
+{
+  static const char *TAGin = "NFC_TraceLoad";
+  *aCount = 0;
+  FILE *iSoubor = fopen(aPath, "rb");
+  if (iSoubor == NULL)
+  {
+    NFC_READER_DEBUG(TAGin, "Soubor %s nelze otevrit.\n", aPath);
+    return 1;
+  }
+  uint8_t iHlavicka[8];
+  if (fread(iHlavicka, 1, sizeof(iHlavicka), iSoubor) != sizeof(iHlavicka) || memcmp(iHlavicka, NFC_TRACE_MAGIC, 4) != 0 || iHlavicka[4] != NFC_TRACE_VERSION)
+  {
+    NFC_READER_DEBUG(TAGin, "Soubor %s neni zaznam komunikace.\n", aPath);
+    fclose(iSoubor);
+    return 2;
+  }
+  *aCount = fread(aFrames, sizeof(TNFCTraceFrame), aCapacity, iSoubor);
+  TNFCTraceFrame iNavic;
+  bool iPlno = fread(&iNavic, sizeof(iNavic), 1, iSoubor) == 1;
+  fclose(iSoubor);
+  if (iPlno)
+  {
+    NFC_READER_DEBUG(TAGin, "Zaznam se nevejde do bufferu.\n");
+    return 3;
+  }
+  NFC_READER_DEBUG(TAGin, "Nacteno %zu ramcu.\n", *aCount);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Monotónní čas v us pro timeouty přenosů
+
+    @returns    Cas v us
+*/
+/**************************************************************************/
+static int64_t NFC_LinkTime(void)
+{
+  struct timespec iCas;
+  clock_gettime(CLOCK_MONOTONIC, &iCas);
+  return (int64_t)iCas.tv_sec * 1000000 + iCas.tv_nsec / 1000;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Otočení pořadí bitů v bytech (PN532 na SPI vysílá LSB first, ne každý řadič to umí)
+
+    @param  aLink      Pointer na stav přenosu
+    @param  aData      Data
+    @param  aLength      Počet bytů
+*/
+/**************************************************************************/
+static void NFC_LinkReverse(TNFCLink *aLink, uint8_t *aData, size_t aLength)
+{
+  if (!aLink->ReverseBits)
+    return;
+  for (size_t i = 0; i < aLength; ++i)
+  {
+    uint8_t b = aData[i];
+    b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+    b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+    aData[i] = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Jeden přenos SPI s nastavením chip select jen na dobu přenosu
+
+    @param  aLink      Pointer na stav přenosu
+    @param  aTx      Odesílaná data (již v pořadí bitů sběrnice)
+    @param  aRx      Přijatá data (může být NULL)
+    @param  aLength      Počet bytů
+
+    @returns true - Prenos probehl, false - Chyba spidev
+*/
+/**************************************************************************/
+static bool NFC_SpiTransfer(TNFCLink *aLink, const uint8_t *aTx, uint8_t *aRx, size_t aLength)
+{
+  struct spi_ioc_transfer iPrenos;
+  memset(&iPrenos, 0, sizeof(iPrenos));
+  iPrenos.tx_buf = (uintptr_t)aTx;
+  iPrenos.rx_buf = (uintptr_t)aRx;
+  iPrenos.len = aLength;
+  ++aLink->Syscalls;
+  return ioctl(aLink->Fd, SPI_IOC_MESSAGE(1), &iPrenos) >= 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Čekání na přerušení od výstupu IRQ PN532 místo dalšího dotazu na stav. Přečtené události
+            se zahodí, připravenost vždy potvrdí následující dotaz na stav.
+
+    @param  aLink      Pointer na stav přenosu (IrqFd >= 0)
+    @param  aDeadline      Čas konce timeoutu v us (NFC_LinkTime)
+
+    @returns true - Prislo preruseni, false - Timeout nebo chyba
+*/
+/**************************************************************************/
+static bool NFC_LinkWaitIrq(TNFCLink *aLink, int64_t aDeadline)
+{
+  int64_t iZbyva = aDeadline - NFC_LinkTime();
+  struct pollfd iCekani = {.fd = aLink->IrqFd, .events = POLLIN | POLLPRI};
+  ++aLink->IrqWaits;
+  ++aLink->Syscalls;
+  if (iZbyva <= 0 || poll(&iCekani, 1, (int)((iZbyva + 999) / 1000)) <= 0)
+  {
+    ++aLink->IrqTimeouts;
+    return false;
+  }
+  uint8_t iUdalosti[64];
+  ++aLink->Syscalls;
+  if (read(aLink->IrqFd, iUdalosti, sizeof(iUdalosti)) < 0)
+    return false;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Čekání na připravenost PN532 dotazy na stav (SR)
+
+    @param  aLink      Pointer na stav přenosu
+    @param  aDeadline      Čas konce timeoutu v us (NFC_LinkTime)
+
+    @returns true - PN532 je pripraven, false - Timeout nebo chyba spidev
+*/
+/**************************************************************************/
+static bool NFC_SpiWaitReady(TNFCLink *aLink, int64_t aDeadline)
+{
+  uint8_t iTx[2] = {NFC_SPI_STATUS_READ, 0x00};
+  uint8_t iRx[2];
+  NFC_LinkReverse(aLink, iTx, sizeof(iTx));
+  for (;;)
+  {
+    if (!NFC_SpiTransfer(aLink, iTx, iRx, sizeof(iTx)))
+      return false;
+    NFC_LinkReverse(aLink, iRx, sizeof(iRx));
+    if (iRx[1] & 0x01)
+      return true;
+    if (NFC_LinkTime() >= aDeadline)
+      return false;
+    if (aLink->IrqFd < 0)
+      usleep(aLink->PollUs);
+    else
+      NFC_LinkWaitIrq(aLink, aDeadline);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Kontrola začátku rámce odpovědi přečteného ze SPI (preambule, LEN/LCS, TFI, kód odpovědi, DCS)
+
+    @param  aFrame      Rámec od preambule
+    @param  aLength      Počet přečtených bytů
+    @param  aCode      Kód příkazu
+    @param  aMissing      Pointer, do kterého se uloží počet bytů, které rámci chybí do postambule
+
+    @returns 0 - Ramec je cely a platny, 1 - Zacatek ramce je platny, chybi aMissing bytu, 2 - Neplatny ramec
+*/
+/**************************************************************************/
+static uint8_t NFC_SpiFrameCheck(const uint8_t *aFrame, size_t aLength, uint8_t aCode, size_t *aMissing)
+{
+  *aMissing = 0;
+  if (aLength < 7 || aFrame[0] != 0x00 || aFrame[1] != 0x00 || aFrame[2] != 0xFF || (uint8_t)(aFrame[3] + aFrame[4]) != 0 ||
+      aFrame[3] < 2 || aFrame[5] != 0xD5 || aFrame[6] != (uint8_t)(aCode + 1))
+    return 2;
+  // b5..b(4 + LEN) TFI a data, b(5 + LEN) DCS, b(6 + LEN) postambule
+  size_t iDelka = aFrame[3] + 7u;
+  if (aLength < iDelka)
+  {
+    *aMissing = iDelka - aLength;
+    return 1;
+  }
+  uint8_t iSoucet = 0;
+  for (size_t i = 0; i <= aFrame[3]; ++i)
+  {
+    iSoucet += aFrame[5 + i];
+  }
+  return iSoucet == 0 ? 0 : 2;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Kontrola rámce odpovědi a dočtení jeho zbytku, když byl přečten jen začátek. Další čtení
+            pokračuje v rámci, PN532 vysílá první byte zbytku už během bytu příkazu čtení.
+
+    @param  aLink      Pointer na stav přenosu
+    @param  aFrame      Rámec od preambule (místo pro NFC_FRAME_MAXSIZE bytů)
+    @param  aLength      Počet přečtených bytů, po návratu délka rámce
+    @param  aCode      Kód příkazu
+
+    @returns true - Ramec je platny, false - Neplatny ramec nebo chyba spidev
+*/
+/**************************************************************************/
+static bool NFC_SpiFrameFinish(TNFCLink *aLink, uint8_t *aFrame, size_t *aLength, uint8_t aCode)
+{
+  size_t iChybi;
+  uint8_t iKontrola = NFC_SpiFrameCheck(aFrame, *aLength, aCode, &iChybi);
+  if (iKontrola == 1)
+  {
+    uint8_t iTx[NFC_FRAME_MAXSIZE] = {NFC_SPI_DATA_READ};
+    NFC_LinkReverse(aLink, iTx, 1);
+    if (!NFC_SpiTransfer(aLink, iTx, aFrame + *aLength, iChybi))
+      return false;
+    NFC_LinkReverse(aLink, aFrame + *aLength, iChybi);
+    *aLength += iChybi;
+    iKontrola = NFC_SpiFrameCheck(aFrame, *aLength, aCode, &iChybi);
+  }
+  return iKontrola == 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Výměna rámce přes spidev - zápis příkazu, stav, ACK a při známé době zpracování příkazu
+            i stav a odpověď jdou jedním SPI_IOC_MESSAGE. Čte se jen očekávaná délka odpovědi
+            (*aResponseLength), delší rámec se dočte podle LEN. Doba zpracování se pro každý kód příkazu
+            měří, a když odpověď ještě není připravena, dočte se po dotazech na stav.
+
+    @returns true - Odpoved se precetla, false - Chybi ACK, timeout, neplatny ramec nebo chyba spidev
+*/
+/**************************************************************************/
+static bool NFC_SpiExchange(void *aContext, const uint8_t *aFrame, size_t aFrameLength, uint8_t *aResponse, size_t *aResponseLength,
+                            uint16_t aTimeout)
+{
+  static const char *TAGin = "NFC_SpiExchange";
+  TNFCLink *iLink = aContext;
+  int64_t iStart = NFC_LinkTime();
+  int64_t iKonec = iStart + aTimeout * 1000LL;
+  uint8_t iKod = aFrame[6];
+  // Hlavicka s TFI a kodem odpovedi se cte vzdy, zbytek podle ocekavane delky
+  size_t iDelka = *aResponseLength < 8 ? 8 : (*aResponseLength < NFC_FRAME_MAXSIZE ? *aResponseLength : NFC_FRAME_MAXSIZE);
+  if (aFrameLength > NFC_FRAME_MAXSIZE)
+    return false;
+
+  uint8_t iZapis[1 + NFC_FRAME_MAXSIZE] = {NFC_SPI_DATA_WRITE};
+  memcpy(iZapis + 1, aFrame, aFrameLength);
+  uint8_t iStavTx[2] = {NFC_SPI_STATUS_READ, 0x00};
+  uint8_t iAckTx[1 + NFC_ACK_SIZE] = {NFC_SPI_DATA_READ};
+  uint8_t iCteniTx[1 + NFC_FRAME_MAXSIZE] = {NFC_SPI_DATA_READ};
+  uint8_t iStavRx[2], iAckRx[1 + NFC_ACK_SIZE], iStavOdpovediRx[2], iCteniRx[1 + NFC_FRAME_MAXSIZE];
+  NFC_LinkReverse(iLink, iZapis, 1 + aFrameLength);
+  NFC_LinkReverse(iLink, iStavTx, 1);
+  NFC_LinkReverse(iLink, iAckTx, 1);
+  NFC_LinkReverse(iLink, iCteniTx, 1);
+
+  // Mezi castmi zpravy se chip select uvolni (cs_change), u posledni casti by zustal aktivni
+  struct spi_ioc_transfer iPrenos[5];
+  memset(iPrenos, 0, sizeof(iPrenos));
+  iPrenos[0].tx_buf = (uintptr_t)iZapis;
+  iPrenos[0].len = 1 + aFrameLength;
+  iPrenos[0].delay_usecs = NFC_ACK_DELAY_US;
+  iPrenos[0].cs_change = 1;
+  iPrenos[1].tx_buf = (uintptr_t)iStavTx;
+  iPrenos[1].rx_buf = (uintptr_t)iStavRx;
+  iPrenos[1].len = sizeof(iStavTx);
+  iPrenos[1].cs_change = 1;
+  iPrenos[2].tx_buf = (uintptr_t)iAckTx;
+  iPrenos[2].rx_buf = (uintptr_t)iAckRx;
+  iPrenos[2].len = sizeof(iAckTx);
+  iPrenos[2].delay_usecs = iLink->ReadyUs[iKod];
+  iPrenos[2].cs_change = 1;
+  iPrenos[3].tx_buf = (uintptr_t)iStavTx;
+  iPrenos[3].rx_buf = (uintptr_t)iStavOdpovediRx;
+  iPrenos[3].len = sizeof(iStavTx);
+  iPrenos[3].cs_change = 1;
+  iPrenos[4].tx_buf = (uintptr_t)iCteniTx;
+  iPrenos[4].rx_buf = (uintptr_t)iCteniRx;
+  iPrenos[4].len = 1 + iDelka;
+  // S IRQ se na odpoved ceka prerusenim, odhad doby zpracovani neni potreba
+  bool iSOdpovedi = iLink->IrqFd < 0 && iLink->ReadyUs[iKod] != 0;
+  if (!iSOdpovedi)
+    iPrenos[2].cs_change = 0;
+  ++iLink->Syscalls;
+  if (ioctl(iLink->Fd, iSOdpovedi ? SPI_IOC_MESSAGE(5) : SPI_IOC_MESSAGE(3), iPrenos) < 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Chyba spidev.\n");
+    return false;
+  }
+  NFC_LinkReverse(iLink, iStavRx, sizeof(iStavRx));
+  NFC_LinkReverse(iLink, iAckRx, sizeof(iAckRx));
+  if (!(iStavRx[1] & 0x01))
+  {
+    // ACK jeste nebyl pripraven - precte se po dotazech na stav, odpoved zvlast
+    iSOdpovedi = false;
+    if (!NFC_SpiWaitReady(iLink, iKonec) || !NFC_SpiTransfer(iLink, iAckTx, iAckRx, sizeof(iAckTx)))
+      return false;
+    NFC_LinkReverse(iLink, iAckRx, sizeof(iAckRx));
+  }
+  if (memcmp(iAckRx + 1, NFC_Ack, NFC_ACK_SIZE) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Prikaz %02X nebyl potvrzen.\n", iKod);
+    return false;
+  }
+  // Ve davce s odpovedi uz PN532 nic nezpracovava, pripravu dalsiho prikazu spusti knihovna po vymene
+  if (!iSOdpovedi)
+    NFC_TransportAcked();
+
+  if (iSOdpovedi)
+  {
+    // Plati ramec, ktery prosel kontrolou - stav se mohl precist tesne pred pripravenosti odpovedi
+    NFC_LinkReverse(iLink, iStavOdpovediRx, sizeof(iStavOdpovediRx));
+    NFC_LinkReverse(iLink, iCteniRx, 1 + iDelka);
+    size_t iChybi;
+    uint8_t iKontrola = NFC_SpiFrameCheck(iCteniRx + 1, iDelka, iKod, &iChybi);
+    if (iKontrola == 2 && (iStavOdpovediRx[1] & 0x01))
+    {
+      NFC_READER_DEBUG(TAGin, "Prikaz %02X: neplatny ramec odpovedi.\n", iKod);
+      return false;
+    }
+    iSOdpovedi = iKontrola != 2;
+  }
+  if (iSOdpovedi)
+  {
+    // Odpoved byla pripravena - odhad doby zpracovani se zkrati, aby nezustal zbytecne dlouhy
+    iLink->ReadyUs[iKod] -= iLink->ReadyUs[iKod] / 8;
+  }
+  else
+  {
+    // Data prectena pred pripravenosti PN532 jsou neplatna, odpoved se precte znovu
+    if (!NFC_SpiWaitReady(iLink, iKonec))
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Prikaz %02X: timeout odpovedi.\n", iKod);
+      return false;
+    }
+    int64_t iDoba = NFC_LinkTime() - iStart - NFC_ACK_DELAY_US;
+    if (iLink->IrqFd < 0)
+      iLink->ReadyUs[iKod] = iDoba <= 1 ? 1 : (iDoba > UINT16_MAX ? UINT16_MAX : iDoba);
+    if (!NFC_SpiTransfer(iLink, iCteniTx, iCteniRx, 1 + iDelka))
+      return false;
+    NFC_LinkReverse(iLink, iCteniRx, 1 + iDelka);
+  }
+  if (!NFC_SpiFrameFinish(iLink, iCteniRx + 1, &iDelka, iKod))
+  {
+    NFC_READER_DEBUG(TAGin, "Prikaz %02X: neplatny ramec odpovedi.\n", iKod);
+    return false;
+  }
+  memcpy(aResponse, iCteniRx + 1, iDelka);
+  *aResponseLength = iDelka;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Čtení z PN532 na I2C - každé čtení začíná stavovým bytem, dokud PN532 není připraven,
+            čte se jen stav
+
+    @param  aLink      Pointer na stav přenosu
+    @param  aData      Buffer na stavový byte a data
+    @param  aLength      Počet bytů včetně stavového
+    @param  aDeadline      Čas konce timeoutu v us (NFC_LinkTime)
+
+    @returns true - Data se precetla, false - Timeout nebo chyba i2c-dev
+*/
+/**************************************************************************/
+static bool NFC_I2cRead(TNFCLink *aLink, uint8_t *aData, size_t aLength, int64_t aDeadline)
+{
+  for (;;)
+  {
+    uint8_t iStav = 0;
+    ++aLink->Syscalls;
+    if (read(aLink->Fd, &iStav, 1) == 1 && (iStav & 0x01))
+      break;
+    if (NFC_LinkTime() >= aDeadline)
+      return false;
+    if (aLink->IrqFd < 0)
+      usleep(aLink->PollUs);
+    else
+      NFC_LinkWaitIrq(aLink, aDeadline);
+  }
+  ++aLink->Syscalls;
+  return read(aLink->Fd, aData, aLength) == (ssize_t)aLength && (aData[0] & 0x01);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Výměna rámce přes i2c-dev
+
+    @returns true - Odpoved se precetla, false - Chybi ACK, timeout nebo chyba i2c-dev
+*/
+/**************************************************************************/
+static bool NFC_I2cExchange(void *aContext, const uint8_t *aFrame, size_t aFrameLength, uint8_t *aResponse, size_t *aResponseLength,
+                            uint16_t aTimeout)
+{
+  static const char *TAGin = "NFC_I2cExchange";
+  TNFCLink *iLink = aContext;
+  int64_t iKonec = NFC_LinkTime() + aTimeout * 1000LL;
+  // Cteni na I2C zacina vzdy od zacatku ramce, cte se proto cely buffer
+  size_t iDelka = NFC_FRAME_MAXSIZE;
+  ++iLink->Syscalls;
+  if (write(iLink->Fd, aFrame, aFrameLength) != (ssize_t)aFrameLength)
+  {
+    NFC_READER_DEBUG(TAGin, "Chyba i2c-dev.\n");
+    return false;
+  }
+  uint8_t iAck[1 + NFC_ACK_SIZE];
+  if (!NFC_I2cRead(iLink, iAck, sizeof(iAck), iKonec) || memcmp(iAck + 1, NFC_Ack, NFC_ACK_SIZE) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Prikaz %02X nebyl potvrzen.\n", aFrame[6]);
+    return false;
+  }
+  NFC_TransportAcked();
+  uint8_t iCteni[1 + NFC_FRAME_MAXSIZE];
+  if (!NFC_I2cRead(iLink, iCteni, 1 + iDelka, iKonec))
+  {
+    NFC_READER_ALL_DEBUG(TAGin, "Prikaz %02X: timeout odpovedi.\n", aFrame[6]);
+    return false;
+  }
+  memcpy(aResponse, iCteni + 1, iDelka);
+  *aResponseLength = iDelka;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Čtení přesného počtu bytů z UART s timeoutem
+
+    @param  aLink      Pointer na stav přenosu
+    @param  aData      Buffer
+    @param  aLength      Počet bytů
+    @param  aDeadline      Čas konce timeoutu v us (NFC_LinkTime)
+
+    @returns true - Data se precetla, false - Timeout nebo chyba
+*/
+/**************************************************************************/
+static bool NFC_HsuRead(TNFCLink *aLink, uint8_t *aData, size_t aLength, int64_t aDeadline)
+{
+  size_t iPrecteno = 0;
+  while (iPrecteno < aLength)
+  {
+    int64_t iZbyva = aDeadline - NFC_LinkTime();
+    if (iZbyva <= 0)
+      return false;
+    struct pollfd iPoll = {.fd = aLink->Fd, .events = POLLIN};
+    ++aLink->Syscalls;
+    if (poll(&iPoll, 1, (int)((iZbyva + 999) / 1000)) <= 0)
+      return false;
+    ++aLink->Syscalls;
+    ssize_t iPocet = read(aLink->Fd, aData + iPrecteno, aLength - iPrecteno);
+    if (iPocet <= 0)
+      return false;
+    iPrecteno += iPocet;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Výměna rámce přes UART (HSU) - před prvním příkazem se PN532 probudí dlouhou preambulí,
+            odpověď se čte podle délky v hlavičce rámce
+
+    @returns true - Odpoved se precetla, false - Chybi ACK, timeout nebo chyba UART
+*/
+/**************************************************************************/
+static bool NFC_HsuExchange(void *aContext, const uint8_t *aFrame, size_t aFrameLength, uint8_t *aResponse, size_t *aResponseLength,
+                            uint16_t aTimeout)
+{
+  static const char *TAGin = "NFC_HsuExchange";
+  TNFCLink *iLink = aContext;
+  int64_t iKonec = NFC_LinkTime() + aTimeout * 1000LL;
+  if (!iLink->Awake)
+  {
+    static const uint8_t iProbuzeni[16] = {0x55, 0x55};
+    ++iLink->Syscalls;
+    if (write(iLink->Fd, iProbuzeni, sizeof(iProbuzeni)) != sizeof(iProbuzeni))
+      return false;
+    iLink->Awake = true;
+  }
+  // Zbytky odpovedi po predchozim timeoutu by se cetly misto ACK
+  tcflush(iLink->Fd, TCIFLUSH);
+  ++iLink->Syscalls;
+  if (write(iLink->Fd, aFrame, aFrameLength) != (ssize_t)aFrameLength)
+  {
+    NFC_READER_DEBUG(TAGin, "Chyba UART.\n");
+    return false;
+  }
+  uint8_t iAck[NFC_ACK_SIZE];
+  if (!NFC_HsuRead(iLink, iAck, sizeof(iAck), iKonec) || memcmp(iAck, NFC_Ack, NFC_ACK_SIZE) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Prikaz %02X nebyl potvrzen.\n", aFrame[6]);
+    return false;
+  }
+  NFC_TransportAcked();
+  // Synchronizace na start 00 FF, pak LEN, LCS a LEN + 2 B (data, DCS, postambule)
+  uint8_t iPredchozi = 0xFF;
+  uint8_t iByte = 0x00;
+  while (!(iPredchozi == 0x00 && iByte == 0xFF))
+  {
+    iPredchozi = iByte;
+    if (!NFC_HsuRead(iLink, &iByte, 1, iKonec))
+    {
+      NFC_READER_ALL_DEBUG(TAGin, "Prikaz %02X: timeout odpovedi.\n", aFrame[6]);
+      return false;
+    }
+  }
+  uint8_t iRamec[NFC_FRAME_MAXSIZE] = {0x00, 0x00, 0xFF};
+  if (!NFC_HsuRead(iLink, iRamec + 3, 2, iKonec) || (uint8_t)(iRamec[3] + iRamec[4]) != 0 || iRamec[3] + 7u > NFC_FRAME_MAXSIZE ||
+      !NFC_HsuRead(iLink, iRamec + 5, iRamec[3] + 2, iKonec))
+  {
+    NFC_READER_DEBUG(TAGin, "Prikaz %02X: neplatny ramec odpovedi.\n", aFrame[6]);
+    return false;
+  }
+  *aResponseLength = iRamec[3] + 7;
+  memcpy(aResponse, iRamec, *aResponseLength);
+  return true;
+}
+
+static void NFC_TransportCloseContext(void *aContext)
+{
+  NFC_TransportClose(aContext);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Přerušení rozpracovaného příkazu - PN532 po přijetí ACK od hostitele příkaz ukončí
+            a neodpovídá na něj
+
+    @param  aContext      Pointer na stav přenosu
+*/
+/**************************************************************************/
+static void NFC_LinkAbort(void *aContext)
+{
+  static const char *TAGin = "NFC_LinkAbort";
+  TNFCLink *iLink = aContext;
+  bool iOk;
+  if (iLink->Type == NFC_LINK_SPI)
+  {
+    uint8_t iZapis[1 + NFC_ACK_SIZE] = {NFC_SPI_DATA_WRITE};
+    memcpy(iZapis + 1, NFC_Ack, NFC_ACK_SIZE);
+    NFC_LinkReverse(iLink, iZapis, sizeof(iZapis));
+    iOk = NFC_SpiTransfer(iLink, iZapis, NULL, sizeof(iZapis));
+  }
+  else
+  {
+    ++iLink->Syscalls;
+    iOk = write(iLink->Fd, NFC_Ack, NFC_ACK_SIZE) == NFC_ACK_SIZE;
+  }
+  if (iLink->Type == NFC_LINK_HSU)
+    tcflush(iLink->Fd, TCIFLUSH);
+  if (!iOk)
+    NFC_READER_DEBUG(TAGin, "ACK se nepodarilo odeslat.\n");
+}
+
+/**************************************************************************/
+/*!
+    @brief  Otevření PN532 na spidev (Linux) - výměna příkazu se skládá do co nejmenšího počtu SPI_IOC_MESSAGE
+
+    @param  aLink      Pointer na stav přenosu (musí platit po celou dobu používání)
+    @param  aTransport      Přenos pro NFC_Reader_InitTransport
+    @param  aDevice      Zařízení (např. /dev/spidev0.0)
+    @param  aSpeedHz      Frekvence hodin (PN532 max. 5 MHz)
+
+    @returns 0 - Prenos je otevren, 1 - Zarizeni nelze otevrit, 2 - Zarizeni nelze nastavit
+*/
+/**************************************************************************/
+uint8_t NFC_TransportSpiOpen(TNFCLink *aLink, TNFCTransport *aTransport, const char *aDevice, uint32_t aSpeedHz)
+{
+  static const char *TAGin = "NFC_TransportSpiOpen";
+  memset(aLink, 0, sizeof(*aLink));
+  aLink->Type = NFC_LINK_SPI;
+  aLink->PollUs = NFC_LINK_POLL_US;
+  aLink->IrqFd = -1;
+  aLink->Fd = open(aDevice, O_RDWR);
+  if (aLink->Fd < 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Zarizeni %s nelze otevrit.\n", aDevice);
+    return 1;
+  }
+  uint8_t iRezim = SPI_MODE_0;
+  uint8_t iLsb = 1;
+  uint8_t iBity = 8;
+  if (ioctl(aLink->Fd, SPI_IOC_WR_MODE, &iRezim) != 0 || ioctl(aLink->Fd, SPI_IOC_WR_BITS_PER_WORD, &iBity) != 0 ||
+      ioctl(aLink->Fd, SPI_IOC_WR_MAX_SPEED_HZ, &aSpeedHz) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Zarizeni %s nelze nastavit.\n", aDevice);
+    NFC_TransportClose(aLink);
+    return 2;
+  }
+  aLink->ReverseBits = ioctl(aLink->Fd, SPI_IOC_WR_LSB_FIRST, &iLsb) != 0;
+  NFC_READER_ALL_DEBUG(TAGin, "LSB first %s.\n", aLink->ReverseBits ? "v knihovne" : "v radici");
+  *aTransport = (TNFCTransport){.Name = "spidev", .Context = aLink, .Exchange = NFC_SpiExchange, .Close = NFC_TransportCloseContext,
+                                .Abort = NFC_LinkAbort};
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Otevření PN532 na i2c-dev (Linux)
+
+    @param  aLink      Pointer na stav přenosu (musí platit po celou dobu používání)
+    @param  aTransport      Přenos pro NFC_Reader_InitTransport
+    @param  aDevice      Zařízení (např. /dev/i2c-1)
+    @param  aAddress      7bitová adresa PN532 (0x24)
+
+    @returns 0 - Prenos je otevren, 1 - Zarizeni nelze otevrit, 2 - Zarizeni nelze nastavit
+*/
+/**************************************************************************/
+uint8_t NFC_TransportI2cOpen(TNFCLink *aLink, TNFCTransport *aTransport, const char *aDevice, uint8_t aAddress)
+{
+  static const char *TAGin = "NFC_TransportI2cOpen";
+  memset(aLink, 0, sizeof(*aLink));
+  aLink->Type = NFC_LINK_I2C;
+  aLink->PollUs = NFC_LINK_POLL_US;
+  aLink->IrqFd = -1;
+  aLink->Fd = open(aDevice, O_RDWR);
+  if (aLink->Fd < 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Zarizeni %s nelze otevrit.\n", aDevice);
+    return 1;
+  }
+  if (ioctl(aLink->Fd, I2C_SLAVE, aAddress) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Adresu %02X nelze nastavit.\n", aAddress);
+    NFC_TransportClose(aLink);
+    return 2;
+  }
+  NFC_TransportI2cAttach(aLink, aTransport, aLink->Fd);
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Připojení PN532 na již otevřeném i2c-dev s nastavenou adresou. Každé čtení vrací stavový
+            byte a data, nepřipravený PN532 jen stav nebo nic (neblokující popisovač, v testech socketpair
+            SOCK_SEQPACKET). Přenos popisovač uzavře v NFC_TransportClose.
+
+    @param  aLink      Pointer na stav přenosu (musí platit po celou dobu používání)
+    @param  aTransport      Přenos pro NFC_Reader_InitTransport
+    @param  aFd      Otevřený popisovač
+*/
+/**************************************************************************/
+void NFC_TransportI2cAttach(TNFCLink *aLink, TNFCTransport *aTransport, int aFd)
+{
+  memset(aLink, 0, sizeof(*aLink));
+  aLink->Type = NFC_LINK_I2C;
+  aLink->PollUs = NFC_LINK_POLL_US;
+  aLink->IrqFd = -1;
+  aLink->Fd = aFd;
+  *aTransport = (TNFCTransport){.Name = "i2c-dev", .Context = aLink, .Exchange = NFC_I2cExchange, .Close = NFC_TransportCloseContext,
+                                .Abort = NFC_LinkAbort};
+}
+
+/**************************************************************************/
+/*!
+    @brief  Otevření PN532 na UART (HSU) - funguje i s pseudoterminálem, na jehož druhé straně běží
+            testovací protistrana
+
+    @param  aLink      Pointer na stav přenosu (musí platit po celou dobu používání)
+    @param  aTransport      Přenos pro NFC_Reader_InitTransport
+    @param  aDevice      Zařízení (např. /dev/ttyS0, /dev/pts/3)
+    @param  aBaud      Rychlost (9600 - 921600, PN532 po startu 115200)
+
+    @returns 0 - Prenos je otevren, 1 - Zarizeni nelze otevrit, 2 - Zarizeni nelze nastavit
+*/
+/**************************************************************************/
+uint8_t NFC_TransportHsuOpen(TNFCLink *aLink, TNFCTransport *aTransport, const char *aDevice, uint32_t aBaud)
+{
+  static const char *TAGin = "NFC_TransportHsuOpen";
+  static const uint32_t iRychlosti[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+  static const speed_t iKody[] = {B9600, B19200, B38400, B57600, B115200, B230400, B460800, B921600};
+  memset(aLink, 0, sizeof(*aLink));
+  aLink->Type = NFC_LINK_HSU;
+  aLink->PollUs = NFC_LINK_POLL_US;
+  aLink->IrqFd = -1;
+  aLink->Fd = open(aDevice, O_RDWR | O_NOCTTY);
+  if (aLink->Fd < 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Zarizeni %s nelze otevrit.\n", aDevice);
+    return 1;
+  }
+  speed_t iRychlost = 0;
+  for (size_t i = 0; i < sizeof(iRychlosti) / sizeof(iRychlosti[0]); ++i)
+  {
+    if (iRychlosti[i] == aBaud)
+      iRychlost = iKody[i];
+  }
+  struct termios iNastaveni;
+  if (iRychlost == 0 || tcgetattr(aLink->Fd, &iNastaveni) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Zarizeni %s nelze nastavit.\n", aDevice);
+    NFC_TransportClose(aLink);
+    return 2;
+  }
+  cfmakeraw(&iNastaveni);
+  cfsetispeed(&iNastaveni, iRychlost);
+  cfsetospeed(&iNastaveni, iRychlost);
+  if (tcsetattr(aLink->Fd, TCSANOW, &iNastaveni) != 0)
+  {
+    NFC_READER_DEBUG(TAGin, "Zarizeni %s nelze nastavit.\n", aDevice);
+    NFC_TransportClose(aLink);
+    return 2;
+  }
+  *aTransport = (TNFCTransport){.Name = "hsu", .Context = aLink, .Exchange = NFC_HsuExchange, .Close = NFC_TransportCloseContext,
+                                .Abort = NFC_LinkAbort};
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Připojení výstupu IRQ PN532 - při čekání na připravenost se místo dotazů na stav po PollUs
+            čeká na přerušení. Popisovač zůstává volajícímu (uzavře ho sám po NFC_TransportClose).
+
+    @param  aLink      Pointer na stav přenosu
+    @param  aFd      Popisovač, který je čitelný při sestupné hraně IRQ (událost řádku GPIO
+                     z GPIO_V2_GET_LINE_IOCTL, v testech eventfd), -1 - dotazy na stav
+*/
+/**************************************************************************/
+void NFC_TransportSetIrq(TNFCLink *aLink, int aFd)
+{
+  aLink->IrqFd = aFd;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Uzavření přenosu
+
+    @param  aLink      Pointer na stav přenosu
+*/
+/**************************************************************************/
+void NFC_TransportClose(TNFCLink *aLink)
+{
+  if (aLink->Fd >= 0)
+  {
+    close(aLink->Fd);
+    aLink->Fd = -1;
+  }
+}
+
+#endif
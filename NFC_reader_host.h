@@ -0,0 +1,94 @@
+/* ==========================================
+    NFC_reader - Knihovna na synchronizaci dat z NFC Čipu
+    Copyright (c) 2024 Luboš Chmelař
+    [Licence]
+========================================== */
+#ifndef NFC_reader_host_H
+#define NFC_reader_host_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "NFC_reader.h"
+
+#if defined(__linux__)
+
+  typedef enum
+  {
+    NFC_IMPORT_BINARY,
+    NFC_IMPORT_CSV
+  } TNFCImportFormat;
+
+  typedef struct
+  {
+    int Fd;
+    const uint8_t *Data;
+    size_t Size;
+    size_t Position;
+    size_t Released;
+    TNFCImportFormat Format;
+    uint16_t Capacity;
+    uint32_t Line;
+    uint32_t Records;
+    uint32_t Rejected;
+    uint32_t RejectedLine;
+  } TNFCImport;
+
+  uint8_t NFC_ImportOpen(TNFCImport *aImport, const char *aPath, uint16_t aCapacity);
+  uint8_t NFC_ImportNext(TNFCImport *aImport, TNFCImage *aImage);
+  void NFC_ImportClose(TNFCImport *aImport);
+  bool NFC_ImportProvisionNext(TNFCImage *aImage, void *aContext);
+
+  typedef struct
+  {
+    int Fd;
+    const uint8_t *Data;
+    size_t Size;
+    size_t Count;
+  } TNFCCorpus;
+
+  uint8_t NFC_DumpSave(const char *aPath, TNFCCardDump *aDump);
+  uint8_t NFC_CorpusOpen(TNFCCorpus *aCorpus, const char *aPath);
+  const TNFCCardDump *NFC_CorpusGet(TNFCCorpus *aCorpus, size_t aIndex);
+  void NFC_CorpusClose(TNFCCorpus *aCorpus);
+
+  uint8_t NFC_TraceSave(const char *aPath, TNFCTrace *aTrace);
+  uint8_t NFC_TraceLoad(const char *aPath, TNFCTraceFrame *aFrames, size_t aCapacity, size_t *aCount);
+
+  typedef enum
+  {
+    NFC_LINK_SPI, // spidev, LSB first, rezim 0
+    NFC_LINK_I2C, // i2c-dev, adresa 0x24
+    NFC_LINK_HSU  // UART (i pty pro testy)
+  } TNFCLinkType;
+
+  typedef struct
+  {
+    int Fd;
+    TNFCLinkType Type;
+    bool ReverseBits;         // SPI - radic neumi LSB first, bity se otaci v knihovne
+    bool Awake;               // HSU - PN532 uz byl probuzen
+    uint32_t PollUs;          // Interval dotazu na pripravenost PN532
+    uint32_t Syscalls;        // Pocet systemovych volani prenosu
+    int IrqFd;                // Udalosti IRQ PN532 (NFC_TransportSetIrq, -1 - dotazy na stav)
+    uint32_t IrqWaits;        // Pocet cekani na IRQ
+    uint32_t IrqTimeouts;     // Pocet cekani, kdy IRQ neprislo do timeoutu
+    uint16_t ReadyUs[256];    // SPI - naposledy namerena doba zpracovani prikazu podle kodu (0 - nezname)
+  } TNFCLink;
+
+  uint8_t NFC_TransportSpiOpen(TNFCLink *aLink, TNFCTransport *aTransport, const char *aDevice, uint32_t aSpeedHz);
+  uint8_t NFC_TransportI2cOpen(TNFCLink *aLink, TNFCTransport *aTransport, const char *aDevice, uint8_t aAddress);
+  void NFC_TransportI2cAttach(TNFCLink *aLink, TNFCTransport *aTransport, int aFd);
+  uint8_t NFC_TransportHsuOpen(TNFCLink *aLink, TNFCTransport *aTransport, const char *aDevice, uint32_t aBaud);
+  void NFC_TransportSetIrq(TNFCLink *aLink, int aFd);
+  void NFC_TransportClose(TNFCLink *aLink);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
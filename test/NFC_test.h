@@ -0,0 +1,91 @@
+/* ==========================================
+    NFC_reader - společné pomůcky testů na hostiteli
+========================================== */
+#ifndef NFC_test_H
+#define NFC_test_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "NFC_reader.h"
+
+static int NFC_TestErrors = 0;
+
+// Nesplnena podminka se vypise a test na konci skonci chybou
+#define NFC_TEST_CHECK(aCondition)                                               \
+  do                                                                             \
+  {                                                                              \
+    if (!(aCondition))                                                           \
+    {                                                                            \
+      fprintf(stderr, "%s:%d: neplati %s\n", __FILE__, __LINE__, #aCondition); \
+      ++NFC_TestErrors;                                                          \
+    }                                                                            \
+  } while (0)
+
+#define NFC_TEST_RESULT() (NFC_TestErrors == 0 ? 0 : 1)
+
+/**************************************************************************/
+/*!
+    @brief  Recept pro testy - kroky mají ID podle pořadí a typ procesu posunutý o aBase
+
+    @param  aCardInfo      Pointer na TCardInfo strukturu
+    @param  aSteps      Počet kroků receptu
+    @param  aBase      Posun typu procesu, aby se recepty daly rozlišit
+    @param  aBudget      Rozpočet v hlavičce
+*/
+/**************************************************************************/
+static inline void NFC_TestRecipe(TCardInfo *aCardInfo, size_t aSteps, uint8_t aBase, uint32_t aBudget)
+{
+  TRecipeInfo iInfo;
+  memset(&iInfo, 0, sizeof(iInfo));
+  iInfo.NumOfDrinks = 3;
+  iInfo.ActualBudget = aBudget;
+  NFC_InitTCardInfo(aCardInfo);
+  NFC_CreateCardInfoFromRecipeInfo(aCardInfo, iInfo);
+  TRecipeStep iKroky[255];
+  memset(iKroky, 0, sizeof(iKroky));
+  for (size_t i = 0; i < aSteps; ++i)
+  {
+    iKroky[i].ID = i;
+    iKroky[i].NextID = i + 1;
+    iKroky[i].ProcessType = aBase + i;
+  }
+  NFC_AddRecipeStepsToCardInfo(aCardInfo, iKroky, aSteps, false);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Prázdná karta pro emulátor (NFC_EmulatorStart)
+
+    @param  aDump      Pointer na obraz karty
+    @param  aTagType      Typ karty
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID
+*/
+/**************************************************************************/
+static inline void NFC_TestCardDump(TNFCCardDump *aDump, TNFCTagType aTagType, const char *aUid, uint8_t aUidLength)
+{
+  memset(aDump, 0, sizeof(*aDump));
+  aDump->TagType = aTagType;
+  aDump->sUidLength = aUidLength;
+  memcpy(aDump->sUid, aUid, aUidLength);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Uložení obsahu do dočasného souboru
+
+    @param  aPath      Šablona cesty pro mkstemp, přepíše se cestou souboru
+    @param  aData      Obsah souboru
+    @param  aSize      Velikost obsahu
+*/
+/**************************************************************************/
+static inline void NFC_TestFile(char *aPath, const void *aData, size_t aSize)
+{
+  int iFd = mkstemp(aPath);
+  NFC_TEST_CHECK(iFd >= 0 && write(iFd, aData, aSize) == (ssize_t)aSize);
+  close(iFd);
+}
+
+#endif
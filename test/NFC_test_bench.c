@@ -0,0 +1,60 @@
+/* ==========================================
+    NFC_reader - mikrobenchmarky CPU části knihovny (NFC_READER_BENCH_EN) doběhnou bez chyby,
+    měření dotazu na kartu (NFC_PollBenchmark) s kartou i bez karty
+========================================== */
+#include "NFC_test.h"
+#include "shim_card.h"
+
+static pn532_t NFC;
+
+/**************************************************************************/
+/*!
+    @brief  Mikrobenchmarky - pro každou velikost receptu stejná sada bez chyby
+*/
+/**************************************************************************/
+static void NFC_TestMicrobenchmarks(void)
+{
+  static const uint8_t Velikosti[] = {1, 20, 200};
+  TNFCBenchResult iVysledky[64];
+  size_t iPocet = NFC_RunMicrobenchmarks(Velikosti, sizeof(Velikosti), 1000, iVysledky, sizeof(iVysledky) / sizeof(iVysledky[0]));
+  // Pro kazdou velikost receptu stejna sada benchmarku
+  NFC_TEST_CHECK(iPocet > 0 && iPocet % sizeof(Velikosti) == 0);
+  for (size_t i = 0; i < iPocet; ++i)
+  {
+    NFC_TEST_CHECK(iVysledky[i].Error == 0 && iVysledky[i].Iterations > 0);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Dotaz na kartu přes ovladač pn532 - počet dotazů s kartou, seřazené percentily a doby inicializace
+*/
+/**************************************************************************/
+static void NFC_TestPoll(void)
+{
+  TNFCPollResult iVysledek;
+  ShimCardInsert(SHIM_CARD_CLASSIC, (const uint8_t *)"\x04\x11\x22\x33", 4);
+  NFC_TEST_CHECK(NFC_Reader_Init(&NFC, 18, 19, 23, 5) == 0);
+  TNFCStats iStats;
+  NFC_GetStats(&iStats);
+
+  NFC_TEST_CHECK(NFC_PollBenchmark(&NFC, 20, &iVysledek) == 0);
+  NFC_TEST_CHECK(iVysledek.Runs == 20 && iVysledek.CardPresent == 20);
+  NFC_TEST_CHECK(iVysledek.P50Us <= iVysledek.P99Us && iVysledek.P99Us <= iVysledek.MaxUs);
+  NFC_TEST_CHECK(iVysledek.InitTimeUs == iStats.InitTimeUs && iVysledek.BootToReadyUs == iStats.BootToReadyUs);
+  NFC_TEST_CHECK(iVysledek.Transport != NULL && strcmp(iVysledek.Transport, "pn532") == 0 && iVysledek.Exchanges == 0);
+
+  // Bez karty PN532 neodpovi a dotaz skonci timeoutem
+  ShimCardRemove();
+  NFC_TEST_CHECK(NFC_PollBenchmark(&NFC, 3, &iVysledek) == 0);
+  NFC_TEST_CHECK(iVysledek.Runs == 3 && iVysledek.CardPresent == 0 && iVysledek.P50Us <= iVysledek.MaxUs);
+
+  NFC_TEST_CHECK(NFC_PollBenchmark(&NFC, 0, &iVysledek) == 0 && iVysledek.Runs == 0 && iVysledek.InitTimeUs == iStats.InitTimeUs);
+}
+
+int main(void)
+{
+  NFC_TestMicrobenchmarks();
+  NFC_TestPoll();
+  return NFC_TEST_RESULT();
+}
@@ -0,0 +1,103 @@
+/* ==========================================
+    NFC_reader - NumOfDrinks v čítači Ultralight EV1 (NFC_SetDrinkCounter): čtení READ_CNT při načtení
+    hlavičky, zvýšení INCR_CNT, opakování po chybě a ztracené potvrzení INCR_CNT bez dvojího zvýšení
+========================================== */
+#include "NFC_test.h"
+#include "shim_card.h"
+
+#define NFC_TEST_COUNTER 0
+
+static pn532_t NFC;
+
+static const uint8_t NFC_TestUid[] = {0x04, 0x99, 0x22, 0x33, 0x44, 0x55, 0x66};
+
+/**************************************************************************/
+/*!
+    @brief  Emulovaná karta - NumOfDrinks se načte z čítače a zvýší se v čítači, hlavička se nezapisuje
+*/
+/**************************************************************************/
+static void NFC_TestEmulator(void)
+{
+  static TNFCCardDump iKarta;
+  TCardInfo iZapis, iCteni;
+  NFC_TestCardDump(&iKarta, NFC_TAG_ULTRALIGHT, (const char *)NFC_TestUid, sizeof(NFC_TestUid));
+  NFC_TestRecipe(&iZapis, 4, 40, 1000);
+  iZapis.sRecipeInfo.NumOfDrinks = 77;
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iKarta) == 0);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iCteni.NumOfDrinksCounter && iCteni.sRecipeInfo.NumOfDrinks == 0);
+  NFC_TEST_CHECK(NFC_IncrementNumOfDrinks(&NFC, &iCteni, 4) == 0 && iCteni.sRecipeInfo.NumOfDrinks == 4);
+  NFC_SessionClose();
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iCteni.NumOfDrinksCounter && iCteni.sRecipeInfo.NumOfDrinks == 4);
+  NFC_SessionClose();
+  NFC_EmulatorStop();
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Model PN532 - READ_CNT při načtení, INCR_CNT, opakování po chybě čtení čítače a po chybě INCR_CNT,
+            ztracená odpověď na provedený INCR_CNT se pozná z čítače a příkaz se už neposílá
+*/
+/**************************************************************************/
+static void NFC_TestDriver(void)
+{
+  TCardInfo iZapis, iCteni;
+  ShimCardInsert(SHIM_CARD_ULTRALIGHT, NFC_TestUid, sizeof(NFC_TestUid));
+  NFC_TestRecipe(&iZapis, 4, 40, 1000);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  ShimCardCounters()[NFC_TEST_COUNTER] = 5;
+
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iCteni.NumOfDrinksCounter && iCteni.sRecipeInfo.NumOfDrinks == 5);
+
+  // Jeden INCR_CNT: 40 Tg A5 citac hodnota(3) 00
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_TEST_CHECK(NFC_IncrementNumOfDrinks(&NFC, &iCteni, 2) == 0 && iCteni.sRecipeInfo.NumOfDrinks == 7);
+  NFC_TEST_CHECK(ShimCardCounters()[NFC_TEST_COUNTER] == 7 && ShimCardStats.Increments == 1);
+  NFC_TEST_CHECK(ShimCardStats.Commands == 2 && ShimCardLog[1].Length == 8 && memcmp(ShimCardLog[1].Data, "\x40\x01\xA5\x00\x02\x00\x00\x00", 8) == 0);
+
+  // Chyba READ_CNT - po novem vyberu karty se citac precte znovu a zvysi jednou
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  ShimCardScript((const uint8_t *)"\x40\x01\x39", 3, (const uint8_t *)"\x01", 1, 1);
+  NFC_TEST_CHECK(NFC_IncrementNumOfDrinks(&NFC, &iCteni, 1) == 0 && iCteni.sRecipeInfo.NumOfDrinks == 8);
+  NFC_TEST_CHECK(ShimCardCounters()[NFC_TEST_COUNTER] == 8 && ShimCardStats.Increments == 1 && ShimCardStats.Scripted == 1);
+
+  // INCR_CNT neprobehl - citac drzi puvodni hodnotu a prikaz se posle znovu
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  ShimCardScript((const uint8_t *)"\x40\x01\xA5", 3, (const uint8_t *)"\x01", 1, 1);
+  NFC_TEST_CHECK(NFC_IncrementNumOfDrinks(&NFC, &iCteni, 2) == 0 && iCteni.sRecipeInfo.NumOfDrinks == 10);
+  NFC_TEST_CHECK(ShimCardCounters()[NFC_TEST_COUNTER] == 10 && ShimCardStats.Increments == 1 && ShimCardStats.Scripted == 1);
+
+  // INCR_CNT probehl, ale odpoved se ztratila - novy pokus jen precte citac, dvakrat se nezvysi
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  ShimCardLoseResponse((const uint8_t *)"\x40\x01\xA5", 3, 1);
+  NFC_TEST_CHECK(NFC_IncrementNumOfDrinks(&NFC, &iCteni, 3) == 0 && iCteni.sRecipeInfo.NumOfDrinks == 13);
+  NFC_TEST_CHECK(ShimCardCounters()[NFC_TEST_COUNTER] == 13 && ShimCardStats.Increments == 1 && ShimCardStats.Scripted == 1);
+
+  // Citac by pretekl - karta se nemeni
+  ShimCardCounters()[NFC_TEST_COUNTER] = 0xFFFFFF;
+  iCteni.sRecipeInfo.NumOfDrinks = 0xFFFFFF;
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_TEST_CHECK(NFC_IncrementNumOfDrinks(&NFC, &iCteni, 1) == 3 && ShimCardStats.Commands == 0);
+  NFC_SessionClose();
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+}
+
+int main(void)
+{
+  NFC_SetDrinkCounter(NFC_TEST_COUNTER);
+  NFC_TestEmulator();
+  NFC_TestDriver();
+  return NFC_TEST_RESULT();
+}
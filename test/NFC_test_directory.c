@@ -0,0 +1,103 @@
+/* ==========================================
+    NFC_reader - karta s adresářem záznamů: formátování, zápis a načtení záznamů, přepsání záznamu,
+    plný adresář, karta bez místa a chybějící záznam
+========================================== */
+#include "NFC_test.h"
+
+#define NFC_TEST_CAPACITY 47 // Mifare Classic 1K
+
+static pn532_t NFC;
+
+/**************************************************************************/
+/*!
+    @brief  Zápis receptu záznamu aId - kroky a rozpočet podle ID
+
+    @returns Navratova hodnota NFC_WriteRecord
+*/
+/**************************************************************************/
+static uint8_t NFC_TestWrite(uint16_t aId, size_t aSteps)
+{
+  TCardInfo iZapis;
+  NFC_TestRecipe(&iZapis, aSteps, aId * 10, 100 * aId);
+  iZapis.sRecipeInfo.ID = aId;
+  uint8_t iVysledek = NFC_WriteRecord(&NFC, aId, &iZapis);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+  return iVysledek;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Načtení záznamu aId a kontrola receptu zapsaného NFC_TestWrite
+*/
+/**************************************************************************/
+static bool NFC_TestHolds(uint16_t aId, size_t aSteps)
+{
+  TCardInfo iCteni;
+  NFC_InitTCardInfo(&iCteni);
+  bool iShoda = NFC_LoadRecord(&NFC, aId, &iCteni) == 0 && iCteni.RecordBlock >= NFC_DIRECTORY_BLOCKS && iCteni.sRecipeInfo.ID == aId &&
+                iCteni.sRecipeInfo.RecipeSteps == aSteps && iCteni.sRecipeInfo.ActualBudget == 100u * aId;
+  for (size_t i = 0; iShoda && i < aSteps; ++i)
+  {
+    iShoda = iCteni.sRecipeStep[i].ProcessType == aId * 10 + i;
+  }
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  return iShoda;
+}
+
+int main(void)
+{
+  static TNFCCardDump iKarta;
+  TCardInfo iZapis, iCteni;
+  size_t iBloku = (TRecipeInfo_Size + TRecipeStep_Size + 15) / 16; // Zaznam s jednim krokem
+  NFC_TEST_CHECK(NFC_DIRECTORY_BLOCKS + NFC_DIRECTORY_RECORDS * iBloku < NFC_TEST_CAPACITY);
+  NFC_TestCardDump(&iKarta, NFC_TAG_CLASSIC, "\x04\x11\x22\x33", 4);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iKarta) == 0);
+
+  // Karta s jednim receptem adresar nema
+  NFC_TestRecipe(&iZapis, 4, 40, 1000);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadRecord(&NFC, 1, &iCteni) == 3);
+  NFC_TEST_CHECK(NFC_WriteRecord(&NFC, 1, &iZapis) == 3);
+
+  // Format -> zapis -> nacteni, chybejici zaznam
+  NFC_TEST_CHECK(NFC_FormatDirectory(&NFC, NFC_DIRECTORY_BLOCKS) == 4);
+  NFC_TEST_CHECK(NFC_FormatDirectory(&NFC, NFC_TEST_CAPACITY) == 0);
+  NFC_TEST_CHECK(NFC_LoadRecord(&NFC, 1, &iCteni) == 4);
+  NFC_TEST_CHECK(NFC_TestWrite(1, 1) == 0 && NFC_TestWrite(2, 1) == 0 && NFC_TestWrite(3, 1) == 0);
+  NFC_TEST_CHECK(NFC_TestHolds(1, 1) && NFC_TestHolds(2, 1) && NFC_TestHolds(3, 1));
+  NFC_TEST_CHECK(NFC_LoadRecord(&NFC, 4, &iCteni) == 4);
+
+  // Zaznam nacteny z adresare se od zacatku dat nezapisuje
+  NFC_TEST_CHECK(NFC_LoadRecord(&NFC, 2, &iCteni) == 0);
+  NFC_TEST_CHECK(NFC_IncrementNumOfDrinks(&NFC, &iCteni, 1) == 5);
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+
+  // Delsi zaznam se pripise za posledni, ostatni zaznamy zustanou
+  NFC_TEST_CHECK(NFC_TestWrite(2, 8) == 0);
+  NFC_TEST_CHECK(NFC_TestHolds(1, 1) && NFC_TestHolds(2, 8) && NFC_TestHolds(3, 1));
+  NFC_TEST_CHECK(NFC_TestWrite(2, 1) == 0 && NFC_TestHolds(2, 1));
+
+  // Plny adresar - dalsi ID se nezapise, existujici zaznam se prepise na miste
+  for (uint16_t i = 4; i <= NFC_DIRECTORY_RECORDS; ++i)
+  {
+    NFC_TEST_CHECK(NFC_TestWrite(i, 1) == 0);
+  }
+  NFC_TEST_CHECK(NFC_TestWrite(NFC_DIRECTORY_RECORDS + 1, 1) == 4);
+  NFC_TEST_CHECK(NFC_LoadRecord(&NFC, NFC_DIRECTORY_RECORDS + 1, &iCteni) == 4);
+  NFC_TEST_CHECK(NFC_TestWrite(5, 1) == 0);
+  for (uint16_t i = 1; i <= NFC_DIRECTORY_RECORDS; ++i)
+  {
+    NFC_TEST_CHECK(NFC_TestHolds(i, 1));
+  }
+
+  // Karta bez mista - zaznam se nevejde do kapacity
+  NFC_TEST_CHECK(NFC_FormatDirectory(&NFC, NFC_DIRECTORY_BLOCKS + iBloku) == 0);
+  NFC_TEST_CHECK(NFC_LoadRecord(&NFC, 1, &iCteni) == 4);
+  NFC_TEST_CHECK(NFC_TestWrite(1, 1) == 0 && NFC_TestWrite(2, 1) == 4 && NFC_TestWrite(1, 8) == 4);
+  NFC_TEST_CHECK(NFC_TestHolds(1, 1) && NFC_LoadRecord(&NFC, 2, &iCteni) == 4);
+  NFC_EmulatorStop();
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+  return NFC_TEST_RESULT();
+}
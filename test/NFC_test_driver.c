@@ -0,0 +1,188 @@
+/* ==========================================
+    NFC_reader - ovladač knihovny nad rámci PN532 (NFC_DrvDataExchange), skládání příkazů autentizace,
+    čtení a zápisu, zpracování stavu odpovědi a přerušení hledání karty rámcem ACK
+========================================== */
+#include "NFC_test.h"
+#include "shim_card.h"
+
+static pn532_t NFC;
+
+static const uint8_t NFC_TestUid[] = {0x04, 0x11, 0x22, 0x33};
+
+/**************************************************************************/
+/*!
+    @brief  Vyhledání příkazu v záznamu modelu PN532
+
+    @param  aPrefix      Začátek příkazu
+    @param  aPrefixLength      Délka začátku příkazu
+    @param  aLength      Očekávaná délka celého příkazu
+
+    @returns Index prikazu v ShimCardLog, -1 - prikaz se neposlal
+*/
+/**************************************************************************/
+static int NFC_TestFindCommand(const uint8_t *aPrefix, uint8_t aPrefixLength, uint8_t aLength)
+{
+  uint32_t iPocet = ShimCardStats.Commands < SHIM_CARD_LOG ? ShimCardStats.Commands : SHIM_CARD_LOG;
+  for (uint32_t i = 0; i < iPocet; ++i)
+  {
+    if (ShimCardLog[i].Length == aLength && memcmp(ShimCardLog[i].Data, aPrefix, aPrefixLength) == 0)
+      return (int)i;
+  }
+  return -1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Mifare Classic - InDataExchange s autentizací klíčem A a UID, čtením a zápisem bloku
+*/
+/**************************************************************************/
+static void NFC_TestClassicFrames(void)
+{
+  TCardInfo iZapis, iCteni;
+  ShimCardInsert(SHIM_CARD_CLASSIC, NFC_TestUid, sizeof(NFC_TestUid));
+  NFC_TestRecipe(&iZapis, 4, 40, 1000);
+  uint8_t iBlok = NFC_GetMifareClassicIndex(0);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+
+  // Autentizace klicem B: 40 Tg 61 blok klic(6) UID(4), cteni: 40 Tg 30 blok, zapis: 40 Tg A0 blok data(16)
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  uint8_t iAuth[] = {0x40, 0x01, 0x61, iBlok, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x04, 0x11, 0x22, 0x33};
+  uint8_t iRead[] = {0x40, 0x01, 0x30, iBlok};
+  int iAuthIndex = NFC_TestFindCommand(iAuth, sizeof(iAuth), sizeof(iAuth));
+  int iReadIndex = NFC_TestFindCommand(iRead, sizeof(iRead), sizeof(iRead));
+  NFC_TEST_CHECK(ShimCardLog[0].Length == 3 && memcmp(ShimCardLog[0].Data, "\x4A\x01\x00", 3) == 0);
+  NFC_TEST_CHECK(iAuthIndex == 1 && iReadIndex == 2 && ShimCardStats.Commands == 3);
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.RecipeSteps == 4 && iCteni.sRecipeInfo.ActualBudget == 1000);
+  NFC_SessionClose();
+
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  iZapis.sRecipeInfo.ActualBudget = 900;
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  uint8_t iWrite[] = {0x40, 0x01, 0xA0, iBlok};
+  int iWriteIndex = NFC_TestFindCommand(iWrite, sizeof(iWrite), sizeof(iWrite) + 16);
+  NFC_TEST_CHECK(iWriteIndex > 0);
+  if (iWriteIndex > 0)
+    NFC_TEST_CHECK(memcmp(ShimCardLog[iWriteIndex].Data + 4, ShimCardMemory() + iBlok * 16, 16) == 0);
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ultralight - čtení 4 stran a zápis jedné strany přes InDataExchange
+*/
+/**************************************************************************/
+static void NFC_TestUltralightFrames(void)
+{
+  TCardInfo iZapis, iCteni;
+  ShimCardInsert(SHIM_CARD_ULTRALIGHT, (const uint8_t *)"\x04\x99\x22\x33\x44\x55\x66", 7);
+  NFC_TestRecipe(&iZapis, 4, 40, 1000);
+
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  // Prvni strana dat je 8
+  uint8_t iWrite[] = {0x40, 0x01, 0xA2, 0x08};
+  int iWriteIndex = NFC_TestFindCommand(iWrite, sizeof(iWrite), sizeof(iWrite) + 4);
+  NFC_TEST_CHECK(iWriteIndex > 0);
+  if (iWriteIndex > 0)
+    NFC_TEST_CHECK(memcmp(ShimCardLog[iWriteIndex].Data + 4, ShimCardMemory() + 8 * 4, 4) == 0);
+
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  uint8_t iRead[] = {0x40, 0x01, 0x30, 0x08};
+  NFC_TEST_CHECK(NFC_TestFindCommand(iRead, sizeof(iRead), sizeof(iRead)) > 0);
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.RecipeSteps == 4 && iCteni.sRecipeInfo.ActualBudget == 1000);
+  NFC_SessionClose();
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stav odpovědi InDataExchange - chyba autentizace, krátká odpověď, chybějící odpověď
+            a stav s nastaveným bitem NAD/MI (dolních 6 bitů je chyba)
+*/
+/**************************************************************************/
+static void NFC_TestStatus(void)
+{
+  TCardInfo iZapis, iCteni;
+  ShimCardInsert(SHIM_CARD_CLASSIC, NFC_TestUid, sizeof(NFC_TestUid));
+  NFC_TestRecipe(&iZapis, 4, 40, 1000);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  uint8_t iBlok = NFC_GetMifareClassicIndex(0);
+  uint8_t iCteniBloku[] = {0x40, 0x01, 0x30, iBlok};
+
+  // Chyba autentizace 0x14 u kazdeho pokusu obema klici - karta se nezkousi cist
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  ShimCardScript((const uint8_t *)"\x40\x01\x60", 3, (const uint8_t *)"\x14", 1, SHIM_CARD_FOREVER);
+  ShimCardScript((const uint8_t *)"\x40\x01\x61", 3, (const uint8_t *)"\x14", 1, SHIM_CARD_FOREVER);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 2);
+  NFC_TEST_CHECK(ShimCardStats.Scripted > 0 && ShimCardStats.Auths == 0 && ShimCardStats.Reads == 0);
+  NFC_SessionClose();
+
+  // Kratka odpoved na READ a PN532 bez odpovedi - cteni se po novem vyberu karty opakuje
+  ShimCardInsert(SHIM_CARD_CLASSIC, NFC_TestUid, sizeof(NFC_TestUid));
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  ShimCardScript(iCteniBloku, sizeof(iCteniBloku), (const uint8_t *)"\x00\x01\x02\x03\x04\x05\x06\x07\x08", 9, 1);
+  ShimCardScript(iCteniBloku, sizeof(iCteniBloku), NULL, 0, 1);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(ShimCardStats.Scripted == 2 && ShimCardStats.Reads == 1 && ShimCardStats.Selects == 3);
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.RecipeSteps == 4 && iCteni.sRecipeInfo.ActualBudget == 1000);
+  NFC_SessionClose();
+
+  // Stav 0x40 (NAD) neni chyba, data odpovedi se pouziji misto pameti karty
+  uint8_t iOdpoved[1 + 16] = {0x40};
+  memcpy(iOdpoved + 1, ShimCardMemory() + iBlok * 16, 16);
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  ShimCardScript(iCteniBloku, sizeof(iCteniBloku), iOdpoved, sizeof(iOdpoved), 1);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(ShimCardStats.Scripted == 1 && ShimCardStats.Reads == 0 && ShimCardStats.Selects == 1);
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.RecipeSteps == 4 && iCteni.sRecipeInfo.ActualBudget == 1000);
+  NFC_SessionClose();
+
+  // Chyba zapisu 0x01 - zapis se opakuje a karta ma nakonec spravna data
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  uint8_t iZapisBloku[] = {0x40, 0x01, 0xA0, iBlok};
+  ShimCardScript(iZapisBloku, sizeof(iZapisBloku), (const uint8_t *)"\x01", 1, 1);
+  iZapis.sRecipeInfo.ActualBudget = 700;
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  NFC_TEST_CHECK(ShimCardStats.Scripted == 1);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0 && iCteni.sRecipeInfo.ActualBudget == 700);
+  NFC_SessionClose();
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Bez karty se hledání po timeoutu přeruší rámcem ACK po SPI ovladače a PN532 hned přijme další příkaz
+*/
+/**************************************************************************/
+static void NFC_TestAbort(void)
+{
+  pn532_t iNFC;
+  pn532_spi_init(&iNFC, 18, 19, 23, 5);
+  ShimCardInsert(SHIM_CARD_CLASSIC, NFC_TestUid, sizeof(NFC_TestUid));
+  ShimCardRemove();
+  NFC_TEST_CHECK(!NFC_isCardReady(&iNFC));
+  NFC_TEST_CHECK(ShimCardStats.Selects == 1 && ShimCardStats.Aborts == 1);
+  NFC_TEST_CHECK(pn532_getFirmwareVersion(&iNFC) != 0 && ShimCardStats.Rejected == 0);
+  NFC_TEST_CHECK(!NFC_isCardReady(&iNFC) && ShimCardStats.Aborts == 2 && ShimCardStats.Rejected == 0);
+}
+
+int main(void)
+{
+  NFC_TestClassicFrames();
+  NFC_TestUltralightFrames();
+  NFC_TestStatus();
+  NFC_TestAbort();
+  return NFC_TEST_RESULT();
+}
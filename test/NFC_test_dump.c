@@ -0,0 +1,120 @@
+/* ==========================================
+    NFC_reader - výpis karty, uložení do souboru s výpisy a obnovení na jinou emulovanou kartu,
+    zkrácený nebo poškozený soubor s výpisy se odmítne
+========================================== */
+#include "NFC_test.h"
+#include "NFC_reader_host.h"
+
+#define NFC_TEST_STEPS 50
+
+static pn532_t NFC;
+
+/**************************************************************************/
+/*!
+    @brief  Výpis -> soubor s výpisy -> obnovení na prázdnou kartu se stejným UID, jiná karta se odmítne
+*/
+/**************************************************************************/
+static void NFC_TestRoundTrip(void)
+{
+  static TNFCCardDump iKarta, iVypis, iPrazdna;
+  TCardInfo iZapis, iCteni;
+  NFC_TestCardDump(&iKarta, NFC_TAG_CLASSIC, "\x04\x11\x22\x33", 4);
+  NFC_TestRecipe(&iZapis, NFC_TEST_STEPS, 40, 1000);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iKarta) == 0);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  NFC_TEST_CHECK(NFC_DumpCard(&NFC, &iVypis) == 0);
+  NFC_EmulatorStop();
+  NFC_TEST_CHECK(iVypis.Version == NFC_DUMP_VERSION && iVypis.TagType == NFC_TAG_CLASSIC && (iVypis.Flags & NFC_DUMP_CHECKSUM_OK));
+  NFC_TEST_CHECK(iVypis.Blocks == (TRecipeInfo_Size + NFC_TEST_STEPS * TRecipeStep_Size + 15) / 16);
+
+  char iSoubor[] = "/tmp/NFC_test_dumpXXXXXX";
+  NFC_TestFile(iSoubor, "", 0);
+  NFC_TEST_CHECK(NFC_DumpSave(iSoubor, &iVypis) == 0);
+  NFC_TEST_CHECK(NFC_DumpSave(iSoubor, &iVypis) == 0);
+  TNFCCorpus iCorpus;
+  NFC_TEST_CHECK(NFC_CorpusOpen(&iCorpus, iSoubor) == 0 && iCorpus.Count == 2);
+  const TNFCCardDump *iUlozeny = NFC_CorpusGet(&iCorpus, 1);
+  NFC_TEST_CHECK(iUlozeny != NULL && memcmp(iUlozeny, &iVypis, sizeof(iVypis)) == 0);
+  NFC_TEST_CHECK(NFC_CorpusGet(&iCorpus, 2) == NULL);
+
+  // Obnoveni na prazdnou kartu se stejnym UID, karta s jinym UID se se stejnym UID neobnovi
+  NFC_TestCardDump(&iPrazdna, NFC_TAG_CLASSIC, "\x04\x55\x66\x77", 4);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iPrazdna) == 0);
+  NFC_TEST_CHECK(NFC_RestoreCard(&NFC, (TNFCCardDump *)iUlozeny, true) == 4);
+  NFC_EmulatorStop();
+  NFC_TestCardDump(&iPrazdna, NFC_TAG_CLASSIC, "\x04\x11\x22\x33", 4);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iPrazdna) == 0);
+  NFC_TEST_CHECK(NFC_RestoreCard(&NFC, (TNFCCardDump *)iUlozeny, true) == 0);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadAllData(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.RecipeSteps == NFC_TEST_STEPS && iCteni.sRecipeInfo.ActualBudget == 1000);
+  NFC_TEST_CHECK(memcmp(iCteni.sRecipeStep, iZapis.sRecipeStep, NFC_TEST_STEPS * TRecipeStep_Size) == 0);
+  NFC_EmulatorStop();
+  NFC_CorpusClose(&iCorpus);
+  unlink(iSoubor);
+
+  // Vypis se dekoduje stejne jako nactena karta
+  NFC_TEST_CHECK(NFC_CardDumpToCardInfo(&iVypis, &iCteni) == 0);
+  NFC_TEST_CHECK(iCteni.sUidLength == 4 && memcmp(iCteni.sUid, "\x04\x11\x22\x33", 4) == 0);
+  NFC_TEST_CHECK(memcmp(iCteni.sRecipeStep, iZapis.sRecipeStep, NFC_TEST_STEPS * TRecipeStep_Size) == 0);
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Krátký soubor, cizí hlavička, useknutý poslední výpis a výpis s nesmyslným počtem bloků
+*/
+/**************************************************************************/
+static void NFC_TestCorrupt(void)
+{
+  static TNFCCardDump iVypis;
+  static uint8_t iObsah[8 + 2 * sizeof(TNFCCardDump)];
+  TNFCCorpus iCorpus;
+  NFC_TestCardDump(&iVypis, NFC_TAG_ULTRALIGHT, "\x04\x99\x22\x33\x44\x55\x66", 7);
+  iVypis.Version = NFC_DUMP_VERSION;
+  iVypis.Blocks = 4;
+
+  char iSoubor[] = "/tmp/NFC_test_dumpXXXXXX";
+  NFC_TestFile(iSoubor, "", 0);
+  NFC_TEST_CHECK(NFC_DumpSave(iSoubor, &iVypis) == 0);
+  iVypis.Blocks = NFC_IMAGE_MAXSIZE / 16 + 1;
+  NFC_TEST_CHECK(NFC_DumpSave(iSoubor, &iVypis) == 0);
+  FILE *iCteni = fopen(iSoubor, "rb");
+  NFC_TEST_CHECK(iCteni != NULL && fread(iObsah, 1, sizeof(iObsah), iCteni) == sizeof(iObsah));
+  fclose(iCteni);
+  unlink(iSoubor);
+
+  // Poskozeny vypis se nevrati, ostatni vypisy souboru zustanou citelne
+  NFC_TEST_CHECK(NFC_CorpusOpen(&iCorpus, iSoubor) == 1);
+  char iCely[] = "/tmp/NFC_test_dumpXXXXXX";
+  NFC_TestFile(iCely, iObsah, sizeof(iObsah));
+  NFC_TEST_CHECK(NFC_CorpusOpen(&iCorpus, iCely) == 0 && iCorpus.Count == 2);
+  NFC_TEST_CHECK(NFC_CorpusGet(&iCorpus, 0) != NULL && NFC_CorpusGet(&iCorpus, 1) == NULL);
+  NFC_CorpusClose(&iCorpus);
+  unlink(iCely);
+
+  char iUseknuty[] = "/tmp/NFC_test_dumpXXXXXX";
+  NFC_TestFile(iUseknuty, iObsah, sizeof(iObsah) - 1);
+  NFC_TEST_CHECK(NFC_CorpusOpen(&iCorpus, iUseknuty) == 2);
+  unlink(iUseknuty);
+
+  char iKratky[] = "/tmp/NFC_test_dumpXXXXXX";
+  NFC_TestFile(iKratky, iObsah, 5);
+  NFC_TEST_CHECK(NFC_CorpusOpen(&iCorpus, iKratky) == 2);
+  unlink(iKratky);
+
+  char iCizi[] = "/tmp/NFC_test_dumpXXXXXX";
+  iObsah[0] = 'X';
+  NFC_TestFile(iCizi, iObsah, sizeof(iObsah));
+  NFC_TEST_CHECK(NFC_CorpusOpen(&iCorpus, iCizi) == 2);
+  NFC_TEST_CHECK(NFC_DumpSave(iCizi, &iVypis) == 2);
+  unlink(iCizi);
+}
+
+int main(void)
+{
+  NFC_TestRoundTrip();
+  NFC_TestCorrupt();
+  return NFC_TEST_RESULT();
+}
@@ -0,0 +1,211 @@
+/* ==========================================
+    NFC_reader - zápis a načtení receptu na emulované karty všech podporovaných typů
+========================================== */
+#include <stddef.h>
+#include "NFC_test.h"
+
+static pn532_t NFC;
+
+/**************************************************************************/
+/*!
+    @brief  Zápis receptu, načtení celé karty, líné načtení a načtení jednoho kroku
+
+    @param  aDump      Emulovaná karta
+    @param  aBackend      Typ tagu pro NFC_SetTagBackend
+    @param  aSteps      Počet kroků receptu
+*/
+/**************************************************************************/
+static void NFC_TestRoundTrip(TNFCCardDump *aDump, TNFCTagType aBackend, size_t aSteps)
+{
+  TCardInfo iZapis, iCteni;
+  NFC_TestRecipe(&iZapis, aSteps, 40, 1000);
+  NFC_TEST_CHECK(NFC_EmulatorStart(aDump) == 0);
+  NFC_SetTagBackend(aBackend);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadAllData(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.RecipeSteps == aSteps);
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.ActualBudget == 1000);
+  NFC_TEST_CHECK(memcmp(iCteni.sRecipeStep, iZapis.sRecipeStep, aSteps * sizeof(TRecipeStep)) == 0);
+
+  // Stejny recept se zapisem s kontrolou nezmeni a krok se da nacist i line
+  NFC_TEST_CHECK(NFC_WriteCheck(&NFC, &iZapis, 0, aSteps) == 0);
+  TRecipeStep *iKrok;
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(NFC_GetTRecipeStep(&NFC, &iCteni, aSteps - 1, &iKrok) == 0 && iKrok->ProcessType == (uint8_t)(40 + aSteps - 1));
+  NFC_EmulatorStop();
+  NFC_SetTagBackend(NFC_TAG_UNKNOWN);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zápis s kontrolou podle zvoleného způsobu - změněný krok je na kartě, READBACK přečte zapsané bloky
+            s hlavičkou, CHECKSUM jen hlavičku a obě kontroly pokračují s kartou vybranou zápisem bez nového výběru
+
+    @param  aPolicy      Způsob kontroly zápisu
+*/
+/**************************************************************************/
+static void NFC_TestVerifyPolicy(TNFCVerifyPolicy aPolicy)
+{
+  static TNFCCardDump iKarta;
+  static TNFCTraceFrame iZaznam[400];
+  TNFCTrace iTrace;
+  NFC_TestCardDump(&iKarta, NFC_TAG_CLASSIC, "\x04\x11\x22\x33", 4);
+  TCardInfo iZapis, iCteni;
+  NFC_TestRecipe(&iZapis, 30, 40, 1000);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iKarta) == 0);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  NFC_SetVerifyPolicy(aPolicy);
+  NFC_ResetStats();
+  iZapis.sRecipeStep[20].ProcessType = 1;
+  NFC_TraceRecordStart(&iTrace, iZaznam, sizeof(iZaznam) / sizeof(iZaznam[0]));
+  NFC_TEST_CHECK(NFC_WriteCheck(&NFC, &iZapis, 20, 22) == 0);
+  NFC_TraceStop();
+  TNFCStats iStats;
+  NFC_GetStats(&iStats);
+  NFC_TEST_CHECK(iStats.VerifyPolicy == aPolicy && iStats.Verifications == 1 && iStats.VerifyFailures == 0);
+  // CHECKSUM cte jen hlavicku s kontrolnim souctem, READBACK hlavicku a oba zapsane bloky
+  uint32_t iBloku = aPolicy == NFC_VERIFY_READBACK ? 3 : (aPolicy == NFC_VERIFY_CHECKSUM ? 1 : 0);
+  NFC_TEST_CHECK(iStats.VerifyBlocksRead == iBloku);
+  // Po poslednim zapisu se karta jen cte
+  size_t iVybery = 0, iCteniBloku = 0;
+  for (size_t i = 0; i < iTrace.Count; ++i)
+  {
+    if (iZaznam[i].Op == NFC_TRACE_CLASSIC_WRITE)
+      iVybery = iCteniBloku = 0;
+    else if (iZaznam[i].Op == NFC_TRACE_SELECT)
+      ++iVybery;
+    else if (iZaznam[i].Op == NFC_TRACE_CLASSIC_READ)
+      ++iCteniBloku;
+  }
+  NFC_TEST_CHECK(iVybery == 0 && iCteniBloku == iBloku);
+  NFC_TEST_CHECK(iVybery == 0 && (iCteniBloku > 0) == (iStats.VerifyBlocksRead > 0));
+
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadAllData(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(memcmp(iCteni.sRecipeStep, iZapis.sRecipeStep, 30 * sizeof(TRecipeStep)) == 0);
+  NFC_SetVerifyPolicy(NFC_VERIFY_FULL);
+  NFC_EmulatorStop();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Porovnání rozsahu struktur s kartou - shodná karta projde, jinak se vrátí první rozdílný blok
+*/
+/**************************************************************************/
+static void NFC_TestFindDifferentBlock(void)
+{
+  static TNFCCardDump iKarta;
+  NFC_TestCardDump(&iKarta, NFC_TAG_CLASSIC, "\x04\x11\x22\x33", 4);
+  TCardInfo iZapis;
+  NFC_TestRecipe(&iZapis, 20, 40, 1000);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iKarta) == 0);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  size_t iBlok = 0;
+  NFC_TEST_CHECK(NFC_FindDifferentBlock(&NFC, &iZapis, 0, 20, &iBlok) == 0);
+  NFC_TEST_CHECK(NFC_CheckStructArrayIsSame(&NFC, &iZapis, 0, 20) == 0);
+  iZapis.sRecipeStep[5].ProcessType ^= 0xFF;
+  NFC_TEST_CHECK(NFC_FindDifferentBlock(&NFC, &iZapis, 0, 20, &iBlok) == 1);
+  NFC_TEST_CHECK(iBlok == (TRecipeInfo_Size + 5 * TRecipeStep_Size + offsetof(TRecipeStep, ProcessType)) / 16);
+  NFC_TEST_CHECK(NFC_CheckStructArrayIsSame(&NFC, &iZapis, 0, 20) == 1);
+  NFC_EmulatorStop();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Rozpočet v hodnotovém bloku Mifare Classic - odečtení, nedostatečný rozpočet a dobití
+*/
+/**************************************************************************/
+static void NFC_TestValueBlock(void)
+{
+  static TNFCCardDump iKarta;
+  NFC_TestCardDump(&iKarta, NFC_TAG_CLASSIC, "\x04\x11\x22\x33", 4);
+  TCardInfo iZapis, iCteni;
+  NFC_TestRecipe(&iZapis, 10, 40, 1000);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iKarta) == 0);
+  NFC_SetBudgetValueBlock(62);
+  NFC_TEST_CHECK(NFC_WriteCheck(&NFC, &iZapis, 0, 10) == 0);
+
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadAllData(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iCteni.ActualBudgetValueBlock && iCteni.sRecipeInfo.ActualBudget == 1000);
+  NFC_TEST_CHECK(NFC_DecrementBudget(&NFC, &iCteni, 250) == 0 && iCteni.sRecipeInfo.ActualBudget == 750);
+  NFC_TEST_CHECK(NFC_DecrementBudget(&NFC, &iCteni, 2500) == 3 && iCteni.sRecipeInfo.ActualBudget == 750);
+  NFC_TEST_CHECK(NFC_IncrementBudget(&NFC, &iCteni, 50) == 0 && iCteni.sRecipeInfo.ActualBudget == 800);
+
+  // Prepis hlavicky platny hodnotovy blok nenastavi zpet na rozpocet z hlavicky
+  NFC_TEST_CHECK(NFC_WriteStructRange(&NFC, &iZapis, 0, 10) == 0);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0 && iCteni.sRecipeInfo.ActualBudget == 800);
+  NFC_SetBudgetValueBlock(0);
+  NFC_EmulatorStop();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Kruh transakcí - odečtení se skládá z kruhu a přepis hlavičky staré záznamy neoživí
+*/
+/**************************************************************************/
+static void NFC_TestTransactionRing(void)
+{
+  static TNFCCardDump iKarta;
+  NFC_TestCardDump(&iKarta, NFC_TAG_CLASSIC, "\x04\x11\x22\x33\x44\x55\x66", 7);
+  TCardInfo iZapis, iCteni;
+  NFC_TestRecipe(&iZapis, 20, 40, 1000);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iKarta) == 0);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  NFC_SetTransactionRing(6, 3);
+
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0 && iCteni.TransactionRing);
+  for (int i = 0; i < 5; ++i)
+  {
+    NFC_TEST_CHECK(NFC_DecrementBudget(&NFC, &iCteni, 10) == 0);
+  }
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.ActualBudget == 950);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0 && iCteni.sRecipeInfo.ActualBudget == 950);
+
+  // Novy zapis hlavicky zacne novou epochu, starsi odecty se znovu nepouziji
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0 && iCteni.sRecipeInfo.ActualBudget == 1000);
+  NFC_TEST_CHECK(NFC_DecrementBudget(&NFC, &iCteni, 7) == 0);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0 && iCteni.sRecipeInfo.ActualBudget == 993);
+  NFC_SetTransactionRing(0, 0);
+  NFC_EmulatorStop();
+}
+
+int main(void)
+{
+  static TNFCCardDump iKarta;
+
+  NFC_TestCardDump(&iKarta, NFC_TAG_CLASSIC, "\x04\x11\x22\x33", 4);
+  NFC_TestRoundTrip(&iKarta, NFC_TAG_UNKNOWN, 40);
+
+  NFC_TestCardDump(&iKarta, NFC_TAG_ULTRALIGHT, "\x04\x99\x22\x33\x44\x55\x66", 7);
+  NFC_TestRoundTrip(&iKarta, NFC_TAG_UNKNOWN, 10);
+
+  NFC_TestCardDump(&iKarta, NFC_TAG_ISODEP, "\x04\x55\x22\x33\x44\x55\x66", 7);
+  NFC_TestRoundTrip(&iKarta, NFC_TAG_ISODEP, 100);
+
+  // Data v jinem souboru aplikace NDEF (NFC_SetIsoDepFile)
+  NFC_TestCardDump(&iKarta, NFC_TAG_ISODEP, "\x04\x55\x22\x33\x44\x55\x66", 7);
+  NFC_SetIsoDepFile(0xE105);
+  NFC_TestRoundTrip(&iKarta, NFC_TAG_ISODEP, 20);
+  NFC_SetIsoDepFile(0xE104);
+
+  NFC_TestCardDump(&iKarta, NFC_TAG_FELICA, "\x01\x2E\x45\x67\x89\xAB\xCD\xEF", 8);
+  NFC_TestRoundTrip(&iKarta, NFC_TAG_FELICA, 60);
+
+  NFC_TestVerifyPolicy(NFC_VERIFY_TRUST_ACK);
+  NFC_TestVerifyPolicy(NFC_VERIFY_READBACK);
+  NFC_TestVerifyPolicy(NFC_VERIFY_CHECKSUM);
+  NFC_TestFindDifferentBlock();
+  NFC_TestValueBlock();
+  NFC_TestTransactionRing();
+  return NFC_TEST_RESULT();
+}
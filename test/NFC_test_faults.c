@@ -0,0 +1,46 @@
+/* ==========================================
+    NFC_reader - zápis a načtení emulované karty při vkládání chyb (NFC_READER_FAULTS_EN)
+========================================== */
+#include <stddef.h>
+#include "NFC_test.h"
+
+int main(void)
+{
+  static TNFCCardDump iKarta;
+  pn532_t iNFC;
+  TCardInfo iZapis;
+  NFC_TestCardDump(&iKarta, NFC_TAG_CLASSIC, "\x04\x11\x22\x33", 4);
+  NFC_TestRecipe(&iZapis, 20, 40, 1000);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iKarta) == 0);
+
+  // Bez chyb projde kazdy beh
+  TNFCFaultProfile iProfil;
+  memset(&iProfil, 0, sizeof(iProfil));
+  iProfil.Seed = 1;
+  TNFCChaosResult iVysledek;
+  NFC_TEST_CHECK(NFC_ChaosBenchmark(&iNFC, &iZapis, &iProfil, 10, &iVysledek) == 0);
+  NFC_TEST_CHECK(iVysledek.Runs == 10 && iVysledek.Successes == 10);
+
+  // Ojedinele chyby cteni a zapisu pokryje opakovani
+  iProfil.ReadFailPermille = 20;
+  iProfil.WriteFailPermille = 20;
+  iProfil.AuthFailPermille = 20;
+  NFC_TEST_CHECK(NFC_ChaosBenchmark(&iNFC, &iZapis, &iProfil, 20, &iVysledek) == 0);
+  NFC_TEST_CHECK(iVysledek.Runs == 20 && iVysledek.Successes == 20);
+
+  // Porovnani opakuje chybne cteni bloku a projde i bloky za prvnim rozdilem
+  NFC_TEST_CHECK(NFC_WriteAllData(&iNFC, &iZapis) == 0);
+  memset(&iProfil, 0, sizeof(iProfil));
+  iProfil.Seed = 2;
+  iProfil.ReadFailPermille = 200;
+  NFC_FaultStart(&iProfil);
+  size_t iBlok = 0;
+  NFC_TEST_CHECK(NFC_FindDifferentBlock(&iNFC, &iZapis, 0, 20, &iBlok) == 0);
+  iZapis.sRecipeStep[5].ProcessType ^= 0xFF;
+  iZapis.sRecipeStep[15].ProcessType ^= 0xFF;
+  NFC_TEST_CHECK(NFC_FindDifferentBlock(&iNFC, &iZapis, 0, 20, &iBlok) == 1);
+  NFC_TEST_CHECK(iBlok == (TRecipeInfo_Size + 5 * TRecipeStep_Size + offsetof(TRecipeStep, ProcessType)) / 16);
+  NFC_FaultStop();
+  NFC_EmulatorStop();
+  return NFC_TEST_RESULT();
+}
@@ -0,0 +1,159 @@
+/* ==========================================
+    NFC_reader - přenos HSU (UART) přes pseudoterminál, na druhé straně je jednoduchý model PN532
+    s kartou Mifare Classic 1K
+========================================== */
+#include <stdlib.h>
+#include <unistd.h>
+#include <pty.h>
+#include <pthread.h>
+#include "NFC_test.h"
+#include "NFC_reader_host.h"
+
+static int NFC_TestMaster;
+static uint8_t NFC_TestMemory[64][16];
+static volatile bool NFC_TestNoCard; // InListPassiveTarget se jen potvrdi a hleda se do preruseni
+static volatile int NFC_TestAborts;  // Prijate ACK od hostitele
+
+static bool NFC_TestRead(uint8_t *aBuffer, size_t aLength)
+{
+  size_t iPrecteno = 0;
+  while (iPrecteno < aLength)
+  {
+    ssize_t iDelka = read(NFC_TestMaster, aBuffer + iPrecteno, aLength - iPrecteno);
+    if (iDelka <= 0)
+      return false;
+    iPrecteno += iDelka;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Odeslání ACK a rámce odpovědi PN532
+
+    @param  aData      Kód odpovědi a data
+    @param  aLength      Délka dat (0 - jen ACK)
+*/
+/**************************************************************************/
+static void NFC_TestReply(const uint8_t *aData, uint8_t aLength)
+{
+  static const uint8_t Ack[] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+  uint8_t iRamec[NFC_FRAME_MAXSIZE] = {0x00, 0x00, 0xFF, aLength + 1, (uint8_t)-(aLength + 1), 0xD5};
+  uint8_t iSoucet = 0xD5;
+  for (uint8_t i = 0; i < aLength; ++i)
+  {
+    iRamec[6 + i] = aData[i];
+    iSoucet += aData[i];
+  }
+  iRamec[6 + aLength] = -iSoucet;
+  iRamec[7 + aLength] = 0x00;
+  if (write(NFC_TestMaster, Ack, sizeof(Ack)) != sizeof(Ack) || aLength == 0)
+    return;
+  usleep(300);
+  if (write(NFC_TestMaster, iRamec, aLength + 8) != aLength + 8)
+    return;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Model PN532 - čeká na začátek rámce 00 FF (probouzecí 0x55 přeskočí) a odpovídá na příkazy
+*/
+/**************************************************************************/
+static void *NFC_TestPn532(void *aParam)
+{
+  (void)aParam;
+  uint8_t iRamec[NFC_FRAME_MAXSIZE];
+  for (;;)
+  {
+    uint8_t iByte = 0, iPredchozi = 0xFF;
+    while (!(iPredchozi == 0x00 && iByte == 0xFF))
+    {
+      iPredchozi = iByte;
+      if (!NFC_TestRead(&iByte, 1))
+        return NULL;
+    }
+    // LEN, LCS, TFI, prikaz..., DCS, postambule, ACK od hostitele ma LEN 0 a LCS FF
+    if (!NFC_TestRead(iRamec, 2))
+      return NULL;
+    if (iRamec[0] == 0x00 && iRamec[1] == 0xFF)
+    {
+      ++NFC_TestAborts;
+      continue;
+    }
+    if (!NFC_TestRead(iRamec + 2, iRamec[0] + 2))
+      return NULL;
+    const uint8_t *iPrikaz = iRamec + 3;
+    uint8_t iOdpoved[40];
+    uint8_t iDelka = 0;
+    iOdpoved[iDelka++] = iPrikaz[0] + 1;
+    switch (iPrikaz[0])
+    {
+    case 0x02: // GetFirmwareVersion
+      memcpy(iOdpoved + iDelka, "\x32\x01\x06\x07", 4);
+      iDelka += 4;
+      break;
+    case 0x4A: // InListPassiveTarget - Mifare Classic 1K s UID 04 11 22 33
+      if (NFC_TestNoCard)
+      {
+        iDelka = 0;
+        break;
+      }
+      memcpy(iOdpoved + iDelka, "\x01\x01\x00\x04\x08\x04\x04\x11\x22\x33", 10);
+      iDelka += 10;
+      break;
+    case 0x40: // InDataExchange
+      iOdpoved[iDelka++] = 0x00;
+      if (iPrikaz[2] == 0x30)
+      {
+        memcpy(iOdpoved + iDelka, NFC_TestMemory[iPrikaz[3] % 64], 16);
+        iDelka += 16;
+      }
+      else if (iPrikaz[2] == 0xA0)
+        memcpy(NFC_TestMemory[iPrikaz[3] % 64], iPrikaz + 4, 16);
+      break;
+    default: // SAMConfiguration, RFConfiguration, InRelease...
+      break;
+    }
+    NFC_TestReply(iOdpoved, iDelka);
+  }
+}
+
+int main(void)
+{
+  int iSlave;
+  char iJmeno[64];
+  NFC_TEST_CHECK(openpty(&NFC_TestMaster, &iSlave, iJmeno, NULL, NULL) == 0);
+  pthread_t iVlakno;
+  pthread_create(&iVlakno, NULL, NFC_TestPn532, NULL);
+
+  TNFCLink iLink;
+  TNFCTransport iTransport;
+  pn532_t iNFC;
+  NFC_TEST_CHECK(NFC_TransportHsuOpen(&iLink, &iTransport, iJmeno, 115200) == 0);
+  NFC_TEST_CHECK(NFC_Reader_InitTransport(&iNFC, &iTransport) == 0);
+  TNFCStats iStats;
+  NFC_GetStats(&iStats);
+  NFC_TEST_CHECK(iStats.FirmwareVersion == 0x32010607);
+
+  TCardInfo iZapis, iCteni;
+  NFC_TestRecipe(&iZapis, 10, 3, 77);
+  NFC_TEST_CHECK(NFC_WriteAllData(&iNFC, &iZapis) == 0);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadAllData(&iNFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.ActualBudget == 77);
+  NFC_TEST_CHECK(memcmp(iCteni.sRecipeStep, iZapis.sRecipeStep, 10 * sizeof(TRecipeStep)) == 0);
+
+  // Bez karty se hledani po timeoutu prerusi ACK a PN532 hned prijme dalsi prikaz
+  NFC_TestNoCard = true;
+  NFC_TEST_CHECK(!NFC_isCardReady(&iNFC));
+  for (int i = 0; i < 100 && NFC_TestAborts == 0; ++i)
+    usleep(1000);
+  NFC_TEST_CHECK(NFC_TestAborts > 0);
+  NFC_TestNoCard = false;
+  NFC_TEST_CHECK(NFC_isCardReady(&iNFC));
+
+  NFC_TransportClose(&iLink);
+  close(iSlave);
+  close(NFC_TestMaster);
+  return NFC_TEST_RESULT();
+}
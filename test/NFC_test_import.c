@@ -0,0 +1,131 @@
+/* ==========================================
+    NFC_reader - import receptů z CSV a binárního souboru přímo do obrazů karet, řádky s hodnotami mimo rozsah
+    polí se odmítnou s číslem řádku
+========================================== */
+#include <unistd.h>
+#include "NFC_test.h"
+#include "NFC_reader_host.h"
+
+/**************************************************************************/
+/*!
+    @brief  CSV - komentáře se přeskočí, řádek s neúplným krokem se odmítne a import pokračuje dalším řádkem
+*/
+/**************************************************************************/
+static void NFC_TestCsv(void)
+{
+  static const char iCsv[] = "# Type,ID,NumOfDrinks,ActualRecipeStep,ActualBudget,Parameters,kroky...\n"
+                             "1,100,3,0,1000,0,0,1,40,1,2,41\n"
+                             "1,101,3,0,1000,0,0,1\n"
+                             "2;102;5;1;250;7;0;1;50;1;2;51;2;3;52\n";
+  char iSoubor[] = "/tmp/NFC_test_importXXXXXX";
+  NFC_TestFile(iSoubor, iCsv, sizeof(iCsv) - 1);
+
+  static TNFCImport iImport;
+  static TNFCImage iObraz;
+  TRecipeInfo iInfo;
+  NFC_TEST_CHECK(NFC_ImportOpen(&iImport, iSoubor, NFC_CAPACITY_CLASSIC_1K) == 0);
+  NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 0);
+  memcpy(&iInfo, iObraz.Data, sizeof(iInfo));
+  NFC_TEST_CHECK(iInfo.ID == 100 && iInfo.RecipeSteps == 2 && iInfo.ActualBudget == 1000);
+  NFC_TEST_CHECK(memcmp(iObraz.Data + TRecipeInfo_Size, "\x00\x01\x28\x01\x02\x29", 6) == 0);
+  NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 3);
+  NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 0);
+  memcpy(&iInfo, iObraz.Data, sizeof(iInfo));
+  NFC_TEST_CHECK(iInfo.Type == 2 && iInfo.ID == 102 && iInfo.RecipeSteps == 3 && iInfo.ActualRecipeStep == 1 && iInfo.Parameters == 7);
+  NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 1);
+  NFC_TEST_CHECK(iImport.Records == 2 && iImport.Rejected == 1);
+  NFC_ImportClose(&iImport);
+  unlink(iSoubor);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Binární soubor - záznamy se převezmou tak, jak jsou na kartě, zkrácený záznam se nahlásí
+*/
+/**************************************************************************/
+static void NFC_TestBinary(void)
+{
+  uint8_t iData[8 + 2 * sizeof(TRecipeInfo) + 3 * sizeof(TRecipeStep)] = "NFCR\x01";
+  TRecipeInfo iInfo;
+  memset(&iInfo, 0, sizeof(iInfo));
+  iInfo.Type = 1;
+  iInfo.ID = 200;
+  iInfo.RecipeSteps = 2;
+  iInfo.ActualBudget = 500;
+  memcpy(iData + 8, &iInfo, sizeof(iInfo));
+  memcpy(iData + 8 + sizeof(iInfo), "\x00\x01\x10\x01\x02\x11", 6);
+  // Druhy zaznam ma mit 10 kroku, v souboru je jen jeden
+  iInfo.ID = 201;
+  iInfo.RecipeSteps = 10;
+  memcpy(iData + 8 + sizeof(iInfo) + 6, &iInfo, sizeof(iInfo));
+  memcpy(iData + 8 + 2 * sizeof(iInfo) + 6, "\x00\x01\x10", 3);
+  char iSoubor[] = "/tmp/NFC_test_importXXXXXX";
+  NFC_TestFile(iSoubor, iData, sizeof(iData));
+
+  static TNFCImport iImport;
+  static TNFCImage iObraz;
+  NFC_TEST_CHECK(NFC_ImportOpen(&iImport, iSoubor, NFC_CAPACITY_NTAG215) == 0);
+  NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 0);
+  memcpy(&iInfo, iObraz.Data, sizeof(iInfo));
+  NFC_TEST_CHECK(iInfo.ID == 200 && iInfo.RecipeSteps == 2 && iInfo.ActualBudget == 500);
+  NFC_TEST_CHECK(memcmp(iObraz.Data + TRecipeInfo_Size, "\x00\x01\x10\x01\x02\x11", 6) == 0);
+  NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 2);
+  NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 1);
+  NFC_ImportClose(&iImport);
+  unlink(iSoubor);
+
+  // Jina verze binarniho formatu se neotevre
+  iData[4] = 2;
+  char iSoubor2[] = "/tmp/NFC_test_importXXXXXX";
+  NFC_TestFile(iSoubor2, iData, sizeof(iData));
+  NFC_TEST_CHECK(NFC_ImportOpen(&iImport, iSoubor2, NFC_CAPACITY_NTAG215) == 2);
+  unlink(iSoubor2);
+}
+
+/**************************************************************************/
+/*!
+    @brief  CSV - hodnoty mimo rozsah polí TRecipeInfo a kroků se odmítnou s číslem řádku, krajní hodnoty projdou
+*/
+/**************************************************************************/
+static void NFC_TestCsvRange(void)
+{
+  static const char iCsv[] = "# Type,ID,NumOfDrinks,ActualRecipeStep,ActualBudget,Parameters,kroky...\n"
+                             "1,100,3,0,1000,0,0,1,40,1,2,41\n"
+                             "256,101,3,0,1000,0,0,1,40\n"
+                             "1,65536,3,0,1000,0,0,1,40\n"
+                             "1,102,3,0,99999999999,0,0,1,40\n"
+                             "1,103,3,0,1000,0,0,1,300\n"
+                             "1,104,4294967295,0,4294967295,255,0,1,255\n";
+  char iSoubor[] = "/tmp/NFC_test_importXXXXXX";
+  NFC_TestFile(iSoubor, iCsv, sizeof(iCsv) - 1);
+
+  static TNFCImport iImport;
+  static TNFCImage iObraz;
+  TRecipeInfo iInfo;
+  NFC_TEST_CHECK(NFC_ImportOpen(&iImport, iSoubor, NFC_CAPACITY_CLASSIC_1K) == 0);
+  NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 0);
+  memcpy(&iInfo, iObraz.Data, sizeof(iInfo));
+  NFC_TEST_CHECK(iInfo.ID == 100 && iInfo.RecipeSteps == 2);
+
+  // Type, ID, ActualBudget a krok mimo rozsah - kazdy radek se odmitne a nahlasi
+  for (uint32_t iRadek = 3; iRadek <= 6; ++iRadek)
+  {
+    NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 3);
+    NFC_TEST_CHECK(iImport.RejectedLine == iRadek);
+  }
+  NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 0);
+  memcpy(&iInfo, iObraz.Data, sizeof(iInfo));
+  NFC_TEST_CHECK(iInfo.ID == 104 && iInfo.NumOfDrinks == UINT32_MAX && iInfo.ActualBudget == UINT32_MAX && iInfo.Parameters == 255);
+  NFC_TEST_CHECK(NFC_ImportNext(&iImport, &iObraz) == 1);
+  NFC_TEST_CHECK(iImport.Records == 2 && iImport.Rejected == 4);
+  NFC_ImportClose(&iImport);
+  unlink(iSoubor);
+}
+
+int main(void)
+{
+  NFC_TestCsv();
+  NFC_TestBinary();
+  NFC_TestCsvRange();
+  return NFC_TEST_RESULT();
+}
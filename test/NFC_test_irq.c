@@ -0,0 +1,149 @@
+/* ==========================================
+    NFC_reader - čekání na připravenost PN532 přes IRQ (NFC_TransportSetIrq): přenos i2c-dev nad
+    socketpair s modelem PN532, přerušení přichází rourou. Bez IRQ se čeká dotazy na stav.
+========================================== */
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "NFC_test.h"
+#include "NFC_reader_host.h"
+#include "shim_card.h"
+
+#define NFC_TEST_DELAY_MS 5 // Doba zpracovani prikazu modelem
+
+static int NFC_TestModel;                    // Strana modelu PN532
+static int NFC_TestIrq[2] = {-1, -1};        // Roura IRQ, model zapisuje do [1]
+static volatile bool NFC_TestUseIrq;         // Model pri pripravenosti zapise do roury
+static volatile bool NFC_TestRespond = true; // false - model prikaz jen potvrdi
+
+static void NFC_TestSleep(void)
+{
+  struct timespec iCas = {0, NFC_TEST_DELAY_MS * 1000000L};
+  nanosleep(&iCas, NULL);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Model PN532 - připravenost oznámí zprávou se stavem, data zprávou se stavem a daty,
+            v režimu IRQ navíc bytem v rouře
+*/
+/**************************************************************************/
+static void NFC_TestReady(const uint8_t *aData, size_t aLength)
+{
+  uint8_t iStav = 0x01;
+  uint8_t iZprava[1 + NFC_FRAME_MAXSIZE] = {0x01};
+  memcpy(iZprava + 1, aData, aLength);
+  NFC_TestSleep();
+  if (send(NFC_TestModel, &iStav, 1, 0) != 1 || send(NFC_TestModel, iZprava, 1 + aLength, 0) != (ssize_t)(1 + aLength))
+    return;
+  if (NFC_TestUseIrq && write(NFC_TestIrq[1], &iStav, 1) != 1)
+    return;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Model PN532 na I2C - na GetFirmwareVersion odpoví PN532 v1.6, čtení bez připravenosti
+            nevrátí nic
+*/
+/**************************************************************************/
+static void *NFC_TestPn532(void *aParam)
+{
+  (void)aParam;
+  static const uint8_t Ack[] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+  static const uint8_t Verze[] = {0x00, 0x00, 0xFF, 0x06, 0xFA, 0xD5, 0x03, 0x32, 0x01, 0x06, 0x07, 0xE8, 0x00};
+  uint8_t iPrikaz[NFC_FRAME_MAXSIZE];
+  while (recv(NFC_TestModel, iPrikaz, sizeof(iPrikaz), 0) > 0)
+  {
+    NFC_TestReady(Ack, sizeof(Ack));
+    if (!NFC_TestRespond)
+      continue;
+    // I2C cte vzdy cely buffer ramce
+    uint8_t iRamec[NFC_FRAME_MAXSIZE] = {0};
+    memcpy(iRamec, Verze, sizeof(Verze));
+    NFC_TestReady(iRamec, sizeof(iRamec));
+  }
+  return NULL;
+}
+
+/*!
+Monotónní čas v ms
+*/
+static int64_t NFC_TestMs(void)
+{
+  struct timespec iCas;
+  clock_gettime(CLOCK_MONOTONIC, &iCas);
+  return iCas.tv_sec * 1000LL + iCas.tv_nsec / 1000000;
+}
+
+/**************************************************************************/
+/*!
+    @brief  GetFirmwareVersion přímo přes přenos
+
+    @returns true - Odpoved je PN532 v1.6
+*/
+/**************************************************************************/
+static bool NFC_TestFirmware(TNFCTransport *aTransport, uint16_t aTimeout)
+{
+  static const uint8_t Prikaz[] = {0x00, 0x00, 0xFF, 0x02, 0xFE, 0xD4, 0x02, 0x2A, 0x00};
+  uint8_t iOdpoved[NFC_FRAME_MAXSIZE];
+  size_t iDelka = 14;
+  return aTransport->Exchange(aTransport->Context, Prikaz, sizeof(Prikaz), iOdpoved, &iDelka, aTimeout) && iDelka >= 12 &&
+         memcmp(iOdpoved + 5, "\xD5\x03\x32\x01\x06\x07", 6) == 0;
+}
+
+int main(void)
+{
+  int iSpoj[2];
+  NFC_TEST_CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, iSpoj) == 0 && pipe(NFC_TestIrq) == 0);
+  // i2c-dev s nepripravenym PN532 nevraci stav, cteni z modelu proto neblokuje
+  fcntl(iSpoj[0], F_SETFL, fcntl(iSpoj[0], F_GETFL) | O_NONBLOCK);
+  NFC_TestModel = iSpoj[1];
+  pthread_t iVlakno;
+  pthread_create(&iVlakno, NULL, NFC_TestPn532, NULL);
+
+  TNFCLink iLink;
+  TNFCTransport iTransport;
+  NFC_TransportI2cAttach(&iLink, &iTransport, iSpoj[0]);
+
+  // Bez IRQ se ceka dotazy na stav
+  NFC_TEST_CHECK(NFC_TestFirmware(&iTransport, 1000));
+  NFC_TEST_CHECK(iLink.IrqWaits == 0 && iLink.IrqTimeouts == 0);
+
+  // S IRQ se mezi dotazy na stav ceka na rouru (na ACK i na odpoved)
+  NFC_TestUseIrq = true;
+  NFC_TransportSetIrq(&iLink, NFC_TestIrq[0]);
+  NFC_TEST_CHECK(NFC_TestFirmware(&iTransport, 1000));
+  NFC_TEST_CHECK(iLink.IrqWaits >= 2 && iLink.IrqTimeouts == 0);
+
+  // Odpoved neprijde - cekani na IRQ skonci timeoutem prikazu
+  NFC_TestRespond = false;
+  int64_t iStart = NFC_TestMs();
+  NFC_TEST_CHECK(!NFC_TestFirmware(&iTransport, 50));
+  NFC_TEST_CHECK(iLink.IrqTimeouts == 1 && NFC_TestMs() - iStart >= 50 && NFC_TestMs() - iStart < 1000);
+  NFC_TestRespond = true;
+
+  // Po odpojeni IRQ se zase ceka dotazy na stav
+  NFC_TestUseIrq = false;
+  NFC_TransportSetIrq(&iLink, -1);
+  uint32_t iCekani = iLink.IrqWaits;
+  NFC_TEST_CHECK(NFC_TestFirmware(&iTransport, 1000));
+  NFC_TEST_CHECK(iLink.IrqWaits == iCekani);
+
+  NFC_TransportClose(&iLink);
+  pthread_join(iVlakno, NULL);
+  close(NFC_TestModel);
+  close(NFC_TestIrq[0]);
+  close(NFC_TestIrq[1]);
+
+  // Ovladac pn532 bez pinu IRQ ceka dotazy na stav
+  static pn532_t iNFC;
+  ShimCardInsert(SHIM_CARD_CLASSIC, (const uint8_t *)"\x04\x11\x22\x33", 4);
+  NFC_TEST_CHECK(NFC_SetIrqPin(-1) == 0);
+  NFC_ResetStats();
+  NFC_TEST_CHECK(NFC_isCardReady(&iNFC));
+  TNFCStats iStats;
+  NFC_GetStats(&iStats);
+  NFC_TEST_CHECK(iStats.IrqTimeouts == 0);
+  return NFC_TEST_RESULT();
+}
@@ -0,0 +1,155 @@
+/* ==========================================
+    NFC_reader - klíče sektorů Mifare Classic (NFC_SetSectorKeys): autentizace klíčem sektoru,
+    kandidáti od naposledy úspěšného, diverzifikované klíče podle UID a karta s jiným klíčem se nepřečte
+========================================== */
+#include "NFC_test.h"
+#include "shim_card.h"
+
+#define NFC_TEST_STEPS 20
+#define NFC_TEST_SECTORS 16 // Mifare Classic 1K modelu PN532
+
+static pn532_t NFC;
+
+static const uint8_t NFC_TestUid[] = {0x04, 0x11, 0x22, 0x33};
+static const TNFCKey NFC_TestKey = {.Key = {0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5}, .KeyNumber = 1};
+static const TNFCKey NFC_TestSectorKey = {.Key = {0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5}, .KeyNumber = 1};
+static const TNFCKey NFC_TestWrongKey = {.Key = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06}, .KeyNumber = 1};
+
+/**************************************************************************/
+/*!
+    @brief  Diverzifikace pro test - hlavní klíč XOR UID XOR sektor, kontext počítá volání
+*/
+/**************************************************************************/
+static bool NFC_TestDiversify(const uint8_t *aUid, uint8_t aUidLength, uint8_t aSector, const uint8_t *aMasterKey, uint8_t *aKey, void *aContext)
+{
+  ++*(uint32_t *)aContext;
+  for (size_t i = 0; i < NFC_KEY_SIZE; ++i)
+  {
+    aKey[i] = aMasterKey[i] ^ aUid[i % aUidLength] ^ aSector;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Nastavení klíče B v traileru sektoru karty modelu PN532
+
+    @param  aSector      Sektor
+    @param  aKey      Klíč
+*/
+/**************************************************************************/
+static void NFC_TestTrailerKey(uint8_t aSector, const uint8_t *aKey)
+{
+  memcpy(ShimCardMemory() + (aSector * 4 + 3) * 16 + 10, aKey, NFC_KEY_SIZE);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Načtení celého receptu z karty
+
+    @returns Navratova hodnota NFC_LoadAllData, 0xFF - Nacteny recept nesouhlasi
+*/
+/**************************************************************************/
+static uint8_t NFC_TestLoad(void)
+{
+  TCardInfo iCteni;
+  NFC_InitTCardInfo(&iCteni);
+  uint8_t iVysledek = NFC_LoadAllData(&NFC, &iCteni);
+  if (iVysledek == 0 && iCteni.sRecipeStep[NFC_TEST_STEPS - 1].ProcessType != 40 + NFC_TEST_STEPS - 1)
+    iVysledek = 0xFF;
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  return iVysledek;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ověří, že se autentizovalo klíčem aKey (40 Tg 61 blok klíč UID)
+*/
+/**************************************************************************/
+static bool NFC_TestAuthWith(const uint8_t *aKey)
+{
+  uint32_t iPocet = ShimCardStats.Commands < SHIM_CARD_LOG ? ShimCardStats.Commands : SHIM_CARD_LOG;
+  for (uint32_t i = 0; i < iPocet; ++i)
+  {
+    if (ShimCardLog[i].Length == 14 && ShimCardLog[i].Data[2] == 0x61 && memcmp(ShimCardLog[i].Data + 4, aKey, NFC_KEY_SIZE) == 0)
+      return true;
+  }
+  return false;
+}
+
+int main(void)
+{
+  TCardInfo iZapis;
+  TNFCStats iStats;
+  ShimCardInsert(SHIM_CARD_CLASSIC, NFC_TestUid, sizeof(NFC_TestUid));
+  NFC_TestRecipe(&iZapis, NFC_TEST_STEPS, 40, 1000);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  uint8_t iPosledni = NFC_GetMifareClassicIndex((TRecipeInfo_Size + NFC_TEST_STEPS * TRecipeStep_Size - 1) / 16) / 4;
+  NFC_TEST_CHECK(iPosledni >= 1);
+
+  // Karta s jinym klicem - vychozi klic FF..FF nepasuje
+  for (uint8_t i = 0; i < NFC_TEST_SECTORS; ++i)
+  {
+    NFC_TestTrailerKey(i, NFC_TestKey.Key);
+  }
+  NFC_TEST_CHECK(NFC_TestLoad() == 2);
+
+  // Klic pro vsechny sektory, druhy sektor ma vlastni klic
+  NFC_TestTrailerKey(1, NFC_TestSectorKey.Key);
+  NFC_TEST_CHECK(NFC_SetSectorKeys(NFC_ALL_SECTORS, &NFC_TestKey, 1) == 0);
+  NFC_TEST_CHECK(NFC_SetSectorKeys(1, &NFC_TestSectorKey, 1) == 0);
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_ResetStats();
+  NFC_TEST_CHECK(NFC_TestLoad() == 0);
+  NFC_GetStats(&iStats);
+  NFC_TEST_CHECK(NFC_TestAuthWith(NFC_TestKey.Key) && NFC_TestAuthWith(NFC_TestSectorKey.Key) && iStats.KeyMisses == 0);
+
+  // Spatny kandidat pred spravnym - zkusi se jednou, dalsi nacteni zacne naposledy uspesnym klicem
+  TNFCKey iKandidati[] = {NFC_TestWrongKey, NFC_TestKey};
+  NFC_TestTrailerKey(1, NFC_TestKey.Key);
+  NFC_TEST_CHECK(NFC_SetSectorKeys(NFC_ALL_SECTORS, iKandidati, 2) == 0);
+  NFC_ResetStats();
+  NFC_TEST_CHECK(NFC_TestLoad() == 0);
+  NFC_GetStats(&iStats);
+  NFC_TEST_CHECK(iStats.KeyMisses == iPosledni + 1u);
+  NFC_ResetStats();
+  NFC_TEST_CHECK(NFC_TestLoad() == 0);
+  NFC_GetStats(&iStats);
+  NFC_TEST_CHECK(iStats.KeyMisses == 0);
+
+  // Jen spatne klice
+  NFC_TEST_CHECK(NFC_SetSectorKeys(NFC_ALL_SECTORS, &NFC_TestWrongKey, 1) == 0);
+  NFC_TEST_CHECK(NFC_TestLoad() == 2);
+
+  // Diverzifikovane klice podle UID - kazdy se odvodi jednou, bez funkce diverzifikace se karta neprecte
+  uint32_t iOdvozeni = 0;
+  TNFCKey iHlavni = {.Key = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60}, .KeyNumber = 1, .Diversify = true};
+  uint8_t iKlic[NFC_KEY_SIZE];
+  for (uint8_t i = 0; i < NFC_TEST_SECTORS; ++i)
+  {
+    NFC_TestDiversify(NFC_TestUid, sizeof(NFC_TestUid), i, iHlavni.Key, iKlic, &iOdvozeni);
+    NFC_TestTrailerKey(i, iKlic);
+  }
+  iOdvozeni = 0;
+  NFC_TEST_CHECK(NFC_SetSectorKeys(NFC_ALL_SECTORS, &iHlavni, 1) == 0);
+  NFC_TEST_CHECK(NFC_TestLoad() == 2);
+  NFC_SetKeyDiversification(NFC_TestDiversify, &iOdvozeni);
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_ResetStats();
+  NFC_TEST_CHECK(NFC_TestLoad() == 0);
+  NFC_GetStats(&iStats);
+  NFC_TestDiversify(NFC_TestUid, sizeof(NFC_TestUid), 1, iHlavni.Key, iKlic, &iOdvozeni);
+  NFC_TEST_CHECK(NFC_TestAuthWith(iKlic));
+  NFC_TEST_CHECK(iOdvozeni == iPosledni + 2u && iStats.KeyDerivations == iPosledni + 1u && iStats.KeyMisses == 0);
+  iOdvozeni = 0;
+  NFC_TEST_CHECK(NFC_TestLoad() == 0 && iOdvozeni == 0);
+
+  // Karta s jinym UID ma jine odvozene klice
+  static uint8_t iPamet[SHIM_CARD_MEMORY];
+  memcpy(iPamet, ShimCardMemory(), SHIM_CARD_MEMORY);
+  ShimCardInsert(SHIM_CARD_CLASSIC, (const uint8_t *)"\x04\x55\x66\x77", 4);
+  memcpy(ShimCardMemory(), iPamet, SHIM_CARD_MEMORY);
+  NFC_TEST_CHECK(NFC_TestLoad() == 2 && iOdvozeni > 0);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+  return NFC_TEST_RESULT();
+}
@@ -0,0 +1,56 @@
+/* ==========================================
+    NFC_reader - líné načtení receptu, kroky se čtou až při prvním přístupu přes cache bloků relace
+========================================== */
+#include "NFC_test.h"
+#include "shim_card.h"
+
+static pn532_t NFC;
+
+/**************************************************************************/
+/*!
+    @brief  Zápis receptu, líné načtení hlavičky a kroků - kroky ve stejném bloku se nečtou znovu
+
+    @param  aType      Typ karty modelu PN532
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID
+    @param  aSteps      Počet kroků receptu
+*/
+/**************************************************************************/
+static void NFC_TestLazy(uint8_t aType, const uint8_t *aUid, uint8_t aUidLength, size_t aSteps)
+{
+  TCardInfo iZapis, iCteni;
+  TRecipeStep *iKrok;
+  ShimCardInsert(aType, aUid, aUidLength);
+  NFC_TestRecipe(&iZapis, aSteps, 40, 1000);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadAllData(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.RecipeSteps == aSteps && iCteni.sRecipeInfo.ActualBudget == 1000);
+  NFC_TEST_CHECK(memcmp(iCteni.sRecipeStep, iZapis.sRecipeStep, aSteps * sizeof(TRecipeStep)) == 0);
+  uint32_t iCelaKarta = ShimCardStats.Reads;
+
+  // Hlavicka je v jednom bloku, prvni krok nacte dalsi blok a druhy krok je uz v cache
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.RecipeSteps == aSteps && iCteni.TRecipeStepLazy && !iCteni.TRecipeStepLoaded);
+  NFC_TEST_CHECK(ShimCardStats.Reads == 1);
+  NFC_TEST_CHECK(NFC_GetTRecipeStep(&NFC, &iCteni, 0, &iKrok) == 0 && iKrok->ProcessType == 40);
+  NFC_TEST_CHECK(ShimCardStats.Reads == 2);
+  NFC_TEST_CHECK(NFC_GetTRecipeStep(&NFC, &iCteni, 1, &iKrok) == 0 && iKrok->ProcessType == 41);
+  NFC_TEST_CHECK(ShimCardStats.Reads == 2);
+  NFC_TEST_CHECK(NFC_GetTRecipeStep(&NFC, &iCteni, aSteps - 1, &iKrok) == 0 && iKrok->ProcessType == (uint8_t)(40 + aSteps - 1));
+  NFC_TEST_CHECK(ShimCardStats.Reads == 3 && ShimCardStats.Reads < iCelaKarta);
+  NFC_TEST_CHECK(ShimCardStats.Selects == 1);
+  NFC_SessionClose();
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+}
+
+int main(void)
+{
+  NFC_TestLazy(SHIM_CARD_CLASSIC, (const uint8_t *)"\x04\x11\x22\x33", 4, 40);
+  NFC_TestLazy(SHIM_CARD_ULTRALIGHT, (const uint8_t *)"\x04\x99\x22\x33\x44\x55\x66", 7, 20);
+  return NFC_TEST_RESULT();
+}
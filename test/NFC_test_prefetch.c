@@ -0,0 +1,112 @@
+/* ==========================================
+    NFC_reader - předčítání kroků na pozadí, předčtené bloky zůstávají v cache relace, nová relace
+    nebo výměna karty je zahodí
+========================================== */
+#include "NFC_test.h"
+#include "shim_card.h"
+
+#define NFC_TEST_STEPS 40
+
+static pn532_t NFC;
+
+static const uint8_t NFC_TestUid[] = {0x04, 0x11, 0x22, 0x33};
+
+/**************************************************************************/
+/*!
+    @brief  Zjistí, jestli je krok v líném režimu načten (sRecipeStepLoadedMask)
+*/
+/**************************************************************************/
+static bool NFC_TestStepLoaded(TCardInfo *aCardInfo, size_t aStep)
+{
+  return aCardInfo->sRecipeStepLoadedMask[aStep / 8] & (1 << (aStep % 8));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Poslední předčtený krok - další krok musí ležet v blocích, které předčtení načetlo
+
+    @returns Cislo kroku od 2
+*/
+/**************************************************************************/
+static size_t NFC_TestLastPrefetched(void)
+{
+  for (size_t i = 2; i < NFC_TEST_STEPS - 1; ++i)
+  {
+    size_t iZacatek = (TRecipeInfo_Size + i * TRecipeStep_Size) / 16;
+    size_t iKonec = (TRecipeInfo_Size + (i + 2) * TRecipeStep_Size - 1) / 16;
+    if (iZacatek == iKonec)
+      return i;
+  }
+  return 2;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Líné načtení hlavičky a předčtení kroků 1..aLast na pozadí
+
+    @param  aCardInfo      aCardInfo struktura
+    @param  aLast      Poslední předčítaný krok
+    @param  aWait      true - počká se na dokončení předčítání
+*/
+/**************************************************************************/
+static void NFC_TestPrefetch(TCardInfo *aCardInfo, size_t aLast, bool aWait)
+{
+  NFC_InitTCardInfo(aCardInfo);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, aCardInfo) == 0);
+  NFC_TEST_CHECK(NFC_PrefetchTRecipeStepsAsync(&NFC, aCardInfo, 0, aLast) == 0);
+  if (aWait)
+    NFC_TEST_CHECK(NFC_PrefetchWait() == 0);
+}
+
+int main(void)
+{
+  TCardInfo iZapis, iCteni;
+  TRecipeStep *iKrok;
+  size_t iPosledni = NFC_TestLastPrefetched();
+  ShimCardInsert(SHIM_CARD_CLASSIC, NFC_TestUid, sizeof(NFC_TestUid));
+  NFC_TestRecipe(&iZapis, NFC_TEST_STEPS, 40, 1000);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+
+  // Predctene kroky jsou nactene a dalsi krok ve stejnem bloku se uz cte z cache relace
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_TestPrefetch(&iCteni, iPosledni, true);
+  for (size_t i = 0; i <= iPosledni; ++i)
+  {
+    NFC_TEST_CHECK(NFC_TestStepLoaded(&iCteni, i) && iCteni.sRecipeStep[i].ProcessType == 40 + i);
+  }
+  NFC_TEST_CHECK(!NFC_TestStepLoaded(&iCteni, iPosledni + 1));
+  uint32_t iCteniKarty = ShimCardStats.Reads;
+  NFC_TEST_CHECK(NFC_GetTRecipeStep(&NFC, &iCteni, iPosledni + 1, &iKrok) == 0 && iKrok->ProcessType == 40 + iPosledni + 1);
+  NFC_TEST_CHECK(ShimCardStats.Reads == iCteniKarty && ShimCardStats.Selects == 1);
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+
+  // Relace otevrena behem predcitani pocka na jeho konec a cache zahodi - krok se cte znovu z karty
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_TestPrefetch(&iCteni, iPosledni, false);
+  NFC_TEST_CHECK(NFC_SessionOpen(&NFC) == 0);
+  NFC_TEST_CHECK(NFC_TestStepLoaded(&iCteni, iPosledni) && iCteni.sRecipeStep[iPosledni].ProcessType == 40 + iPosledni);
+  iCteniKarty = ShimCardStats.Reads;
+  NFC_TEST_CHECK(NFC_GetTRecipeStep(&NFC, &iCteni, iPosledni + 1, &iKrok) == 0 && iKrok->ProcessType == 40 + iPosledni + 1);
+  NFC_TEST_CHECK(ShimCardStats.Reads == iCteniKarty + 1);
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+
+  // Vymena karty - kroky mimo cache se z jine karty nenactou, ani predcitanim
+  NFC_TestPrefetch(&iCteni, iPosledni, true);
+  static uint8_t iPamet[SHIM_CARD_MEMORY];
+  memcpy(iPamet, ShimCardMemory(), SHIM_CARD_MEMORY);
+  ShimCardInsert(SHIM_CARD_CLASSIC, (const uint8_t *)"\x04\x55\x66\x77", 4);
+  memcpy(ShimCardMemory(), iPamet, SHIM_CARD_MEMORY);
+  NFC_TEST_CHECK(NFC_GetTRecipeStep(&NFC, &iCteni, NFC_TEST_STEPS - 1, &iKrok) == 6);
+  NFC_TEST_CHECK(!NFC_TestStepLoaded(&iCteni, NFC_TEST_STEPS - 1));
+  NFC_TEST_CHECK(NFC_PrefetchTRecipeStepsAsync(&NFC, &iCteni, 20, 5) == 0);
+  NFC_TEST_CHECK(NFC_PrefetchWait() == 6);
+  for (size_t i = 20; i <= 25; ++i)
+  {
+    NFC_TEST_CHECK(!NFC_TestStepLoaded(&iCteni, i));
+  }
+  NFC_TEST_CHECK(ShimCardStats.Reads == 0);
+  NFC_SessionClose();
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+  return NFC_TEST_RESULT();
+}
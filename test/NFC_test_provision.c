@@ -0,0 +1,151 @@
+/* ==========================================
+    NFC_reader - hromadný zápis karet: obraz další karty se připravuje v samostatné úloze,
+    zápis přeskakuje bloky se stejným obsahem a čekání na odebrání karty je omezené
+========================================== */
+#include <pthread.h>
+#include <time.h>
+#include "NFC_test.h"
+#include "shim_card.h"
+
+#define NFC_TEST_CARDS 3
+#define NFC_TEST_STEPS 20
+
+static pn532_t NFC;
+
+typedef struct
+{
+  uint16_t Images;    // Pocet pripravenych obrazu
+  uint16_t MaxImages; // Kolik obrazu se ma pripravit
+  pthread_t Main;     // Vlakno testu
+  uint16_t InTask;    // Obrazy pripravene mimo vlakno testu
+} TNFCTestSource;
+
+/**************************************************************************/
+/*!
+    @brief  Obraz karty pro hromadný zápis - recept s ID podle pořadí obrazu
+
+    @param  aImage      Pointer na obraz karty
+    @param  aId      ID receptu
+*/
+/**************************************************************************/
+static void NFC_TestImage(TNFCImage *aImage, uint16_t aId)
+{
+  TRecipeInfo iInfo;
+  TRecipeStep iKroky[NFC_TEST_STEPS];
+  memset(&iInfo, 0, sizeof(iInfo));
+  iInfo.ID = aId;
+  iInfo.ActualBudget = 1000 + aId;
+  for (size_t i = 0; i < NFC_TEST_STEPS; ++i)
+  {
+    iKroky[i] = (TRecipeStep){.ID = i, .NextID = i + 1, .ProcessType = aId + i};
+  }
+  NFC_CreateImageFromRecipe(aImage, &iInfo, iKroky, NFC_TEST_STEPS);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Zdroj obrazů pro NFC_ProvisionBegin, počítá obrazy připravené v úloze hromadného zápisu
+*/
+/**************************************************************************/
+static bool NFC_TestNext(TNFCImage *aImage, void *aContext)
+{
+  TNFCTestSource *iZdroj = aContext;
+  if (iZdroj->Images >= iZdroj->MaxImages)
+    return false;
+  if (!pthread_equal(pthread_self(), iZdroj->Main))
+    ++iZdroj->InTask;
+  NFC_TestImage(aImage, ++iZdroj->Images);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ověří, že data karty modelu PN532 odpovídají obrazu receptu aId
+*/
+/**************************************************************************/
+static bool NFC_TestCardHolds(uint16_t aId)
+{
+  TNFCImage iObraz;
+  NFC_TestImage(&iObraz, aId);
+  for (size_t i = 0; i < iObraz.Size / 16; ++i)
+  {
+    if (memcmp(ShimCardMemory() + NFC_GetMifareClassicIndex(i) * 16, iObraz.Data + i * 16, 16) != 0)
+      return false;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Odebrání karty 150 ms po spuštění, během čekání NFC_ProvisionCard na odebrání
+*/
+/**************************************************************************/
+static void *NFC_TestRemover(void *aParam)
+{
+  (void)aParam;
+  struct timespec iCas = {0, 150 * 1000000L};
+  nanosleep(&iCas, NULL);
+  ShimCardRemove();
+  return NULL;
+}
+
+/*!
+Monotónní čas v ms
+*/
+static int64_t NFC_TestMs(void)
+{
+  struct timespec iCas;
+  clock_gettime(CLOCK_MONOTONIC, &iCas);
+  return iCas.tv_sec * 1000LL + iCas.tv_nsec / 1000000;
+}
+
+int main(void)
+{
+  static TNFCProvisioning iZapis;
+  TNFCTestSource iZdroj = {.MaxImages = NFC_TEST_CARDS, .Main = pthread_self()};
+  NFC_TEST_CHECK(NFC_ProvisionBegin(&iZapis, NFC_TestNext, &iZdroj) == 0);
+  NFC_TEST_CHECK(iZdroj.Images == 1 && iZdroj.InTask == 0);
+
+  // Kazda karta dostane svuj obraz, dalsi obraz se pripravi v uloze behem zapisu, karta se pak odebere
+  for (uint8_t i = 0; i < NFC_TEST_CARDS; ++i)
+  {
+    uint8_t iUid[] = {0x04, 0x10, 0x20, i};
+    ShimCardInsert(SHIM_CARD_CLASSIC, iUid, sizeof(iUid));
+    if (i == 1)
+    {
+      // Zapis prvniho bloku selze pri kazdem pokusu - obraz zustava pro dalsi kartu
+      uint8_t iZapisBloku[] = {0x40, 0x01, 0xA0, NFC_GetMifareClassicIndex(0)};
+      ShimCardScript(iZapisBloku, sizeof(iZapisBloku), (const uint8_t *)"\x01", 1, SHIM_CARD_FOREVER);
+      NFC_TEST_CHECK(NFC_ProvisionCard(&NFC, &iZapis) == 4);
+      NFC_TEST_CHECK(iZapis.CardsFailed == 1 && iZapis.NextReady);
+      ShimCardInsert(SHIM_CARD_CLASSIC, iUid, sizeof(iUid));
+    }
+    pthread_t iOdebrani;
+    pthread_create(&iOdebrani, NULL, NFC_TestRemover, NULL);
+    int64_t iStart = NFC_TestMs();
+    NFC_TEST_CHECK(NFC_ProvisionCard(&NFC, &iZapis) == 0);
+    NFC_TEST_CHECK(NFC_TestMs() - iStart >= 150 && NFC_TestMs() - iStart < 2000);
+    pthread_join(iOdebrani, NULL);
+    NFC_TEST_CHECK(NFC_TestCardHolds(i + 1));
+    NFC_TEST_CHECK(iZapis.CardsOk == i + 1u);
+  }
+  NFC_TEST_CHECK(iZdroj.Images == NFC_TEST_CARDS && iZdroj.InTask == NFC_TEST_CARDS - 1);
+  NFC_TEST_CHECK(!iZapis.NextReady && NFC_ProvisionCard(&NFC, &iZapis) == 1);
+  NFC_TEST_CHECK(iZapis.BlocksSkipped == 0 && iZapis.BlocksWritten > 0);
+
+  // Karta se stejnymi daty se jen precte, neodebrana karta skonci po NFC_REMOVAL_TIMEOUT chybou 6
+  iZdroj.Images = 0;
+  iZdroj.MaxImages = 1;
+  NFC_TEST_CHECK(NFC_ProvisionBegin(&iZapis, NFC_TestNext, &iZdroj) == 0);
+  static uint8_t iPamet[SHIM_CARD_MEMORY];
+  memcpy(iPamet, ShimCardMemory(), SHIM_CARD_MEMORY);
+  ShimCardInsert(SHIM_CARD_CLASSIC, (const uint8_t *)"\x04\x10\x20\x00", 4);
+  memcpy(ShimCardMemory(), iPamet, SHIM_CARD_MEMORY);
+  NFC_TestImage(&iZapis.sImage[iZapis.Current], NFC_TEST_CARDS);
+  int64_t iStart = NFC_TestMs();
+  NFC_TEST_CHECK(NFC_ProvisionCard(&NFC, &iZapis) == 6);
+  NFC_TEST_CHECK(NFC_TestMs() - iStart >= NFC_REMOVAL_TIMEOUT && NFC_TestMs() - iStart < NFC_REMOVAL_TIMEOUT + 1000);
+  NFC_TEST_CHECK(iZapis.CardsOk == 1 && iZapis.BlocksWritten == 0 && iZapis.BlocksSkipped == iZapis.sImage[0].Size / 16u);
+  NFC_TEST_CHECK(ShimCardStats.Writes == 0);
+  return NFC_TEST_RESULT();
+}
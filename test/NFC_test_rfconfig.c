@@ -0,0 +1,52 @@
+/* ==========================================
+    NFC_reader - RF profil čtečky (NFC_SetRFConfig): zápis příkazy RFConfiguration při inicializaci
+    i za běhu, výchozí omezený počet pokusů InListPassiveTarget a čtečka, která profil odmítne
+========================================== */
+#include "NFC_test.h"
+#include "shim_card.h"
+
+static pn532_t NFC;
+
+/**************************************************************************/
+/*!
+    @brief  Ověří, že se RF profil zapsal třemi příkazy RFConfiguration od indexu aFirst záznamu
+
+    @param  aFirst      Index prvního příkazu RFConfiguration v ShimCardLog
+    @param  aConfig      Očekávaný profil
+*/
+/**************************************************************************/
+static bool NFC_TestRFCommands(uint32_t aFirst, const TNFCRFConfig *aConfig)
+{
+  uint8_t iPole[] = {0x32, 0x01, aConfig->AutoRfca ? 0x02 : 0x00};
+  uint8_t iCasy[] = {0x32, 0x02, 0x00, aConfig->AtrTimeout, aConfig->RetryTimeout};
+  uint8_t iPokusy[] = {0x32, 0x05, aConfig->MaxRetriesAtr, aConfig->MaxRetriesPsl, aConfig->MaxRetriesPassive};
+  return aFirst + 3 <= SHIM_CARD_LOG && ShimCardLog[aFirst].Length == sizeof(iPole) && memcmp(ShimCardLog[aFirst].Data, iPole, sizeof(iPole)) == 0 &&
+         ShimCardLog[aFirst + 1].Length == sizeof(iCasy) && memcmp(ShimCardLog[aFirst + 1].Data, iCasy, sizeof(iCasy)) == 0 &&
+         ShimCardLog[aFirst + 2].Length == sizeof(iPokusy) && memcmp(ShimCardLog[aFirst + 2].Data, iPokusy, sizeof(iPokusy)) == 0;
+}
+
+int main(void)
+{
+  ShimCardInsert(SHIM_CARD_CLASSIC, (const uint8_t *)"\x04\x11\x22\x33", 4);
+
+  // Inicializace zapise vychozi profil - pokusy InListPassiveTarget jsou omezene, ostatni hodnoty jsou z PN532
+  TNFCRFConfig iVychozi = {.MaxRetriesPassive = 0x05, .MaxRetriesAtr = 0xFF, .MaxRetriesPsl = 0x01, .AtrTimeout = 0x0B, .RetryTimeout = 0x0A, .AutoRfca = true};
+  NFC_TEST_CHECK(NFC_Reader_Init(&NFC, 18, 19, 23, 5) == 0);
+  NFC_TEST_CHECK(ShimCardStats.Commands >= 3 && NFC_TestRFCommands(ShimCardStats.Commands - 3, &iVychozi));
+  TNFCStats iStats;
+  NFC_GetStats(&iStats);
+  NFC_TEST_CHECK(iStats.FirmwareVersion == 0x32010607 && iStats.BootToReadyUs > 0);
+
+  // Bez ctecky se profil jen ulozi, se cteckou se zapise hned
+  TNFCRFConfig iRychly = {.MaxRetriesPassive = 0x01, .MaxRetriesAtr = 0x02, .MaxRetriesPsl = 0x01, .AtrTimeout = 0x05, .RetryTimeout = 0x04, .AutoRfca = false};
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  NFC_TEST_CHECK(NFC_SetRFConfig(NULL, &iRychly) == 0 && ShimCardStats.Commands == 0);
+  NFC_TEST_CHECK(NFC_SetRFConfig(&NFC, &iRychly) == 0 && ShimCardStats.Commands == 3 && NFC_TestRFCommands(0, &iRychly));
+  NFC_TEST_CHECK(NFC_isCardReady(&NFC));
+
+  // Ctecka bez odpovedi na RFConfiguration - profil se nenastavi, inicializace skonci chybou 3
+  ShimCardScript((const uint8_t *)"\x32", 1, NULL, 0, SHIM_CARD_FOREVER);
+  NFC_TEST_CHECK(NFC_SetRFConfig(&NFC, &iVychozi) == 1);
+  NFC_TEST_CHECK(NFC_Reader_Init(&NFC, 18, 19, 23, 5) == 3);
+  return NFC_TEST_RESULT();
+}
@@ -0,0 +1,111 @@
+/* ==========================================
+    NFC_reader - snímek stavu karty pro ostatní úlohy (NFC_PublishCardInfo, NFC_GetCardInfoSnapshot):
+    publikace, odebrání karty, číslo publikace a konzistentní snímek při souběžném čtení
+========================================== */
+#include <pthread.h>
+#include "NFC_test.h"
+
+#define NFC_TEST_PUBLISHES 20000
+
+static pn532_t NFC;
+
+static volatile bool NFC_TestDone;
+static uint32_t NFC_TestTorn; // Snimky, ve kterych UID nesouhlasi s rozpoctem
+
+/**************************************************************************/
+/*!
+    @brief  Čtenář snímků - UID a rozpočet se publikují vždy spolu, snímek je nesmí míchat
+*/
+/**************************************************************************/
+static void *NFC_TestReader(void *aParam)
+{
+  (void)aParam;
+  TNFCCardSnapshot iSnimek;
+  while (!NFC_TestDone)
+  {
+    if (NFC_GetCardInfoSnapshot(&iSnimek) == 0 && iSnimek.sUid[3] != (uint8_t)iSnimek.sRecipeInfo.ActualBudget)
+      ++NFC_TestTorn;
+  }
+  return NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Souběžné publikace z úlohy čtečky a čtení snímků z jiné úlohy
+*/
+/**************************************************************************/
+static void NFC_TestConcurrent(void)
+{
+  TCardInfo iKarty[2];
+  for (size_t i = 0; i < 2; ++i)
+  {
+    NFC_TestRecipe(&iKarty[i], 4, 40, 0x100 + i * 0x55);
+    iKarty[i].TRecipeInfoLoaded = true;
+    iKarty[i].sUidLength = 4;
+    memset(iKarty[i].sUid, 0x10 * (i + 1), NFC_UID_MAXSIZE);
+    iKarty[i].sUid[3] = (uint8_t)iKarty[i].sRecipeInfo.ActualBudget;
+  }
+  uint32_t iEpocha = NFC_GetCardInfoEpoch();
+  pthread_t iVlakno;
+  pthread_create(&iVlakno, NULL, NFC_TestReader, NULL);
+  for (uint32_t i = 0; i < NFC_TEST_PUBLISHES; ++i)
+  {
+    NFC_PublishCardInfo(&iKarty[i % 2]);
+  }
+  NFC_TestDone = true;
+  pthread_join(iVlakno, NULL);
+  NFC_TEST_CHECK(NFC_TestTorn == 0);
+  NFC_TEST_CHECK(NFC_GetCardInfoEpoch() == iEpocha + NFC_TEST_PUBLISHES);
+  NFC_DeAllocTRecipeStepArray(&iKarty[0]);
+  NFC_DeAllocTRecipeStepArray(&iKarty[1]);
+}
+
+int main(void)
+{
+  static TNFCCardDump iKarta;
+  TCardInfo iZapis, iCteni;
+  TNFCCardSnapshot iSnimek;
+
+  // Zatim nic nepublikovano
+  NFC_TEST_CHECK(NFC_GetCardInfoEpoch() == 0 && NFC_GetCardInfoSnapshot(&iSnimek) == 1 && !iSnimek.Present);
+
+  // Nenactena karta se nepublikuje
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_PublishCardInfo(&iCteni) == 1 && NFC_GetCardInfoEpoch() == 0);
+
+  // Line nactena karta - hlavicka, UID a pocet kroku
+  NFC_TestCardDump(&iKarta, NFC_TAG_CLASSIC, "\x04\x11\x22\x33", 4);
+  NFC_TestRecipe(&iZapis, 30, 40, 1000);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iKarta) == 0);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  NFC_TEST_CHECK(NFC_PublishCardInfo(&iCteni) == 0 && NFC_GetCardInfoEpoch() == 1);
+  NFC_TEST_CHECK(NFC_GetCardInfoSnapshot(&iSnimek) == 0 && iSnimek.Present && iSnimek.Epoch == 1);
+  NFC_TEST_CHECK(iSnimek.sRecipeInfo.RecipeSteps == 30 && iSnimek.sRecipeInfo.ActualBudget == 1000);
+  NFC_TEST_CHECK(iSnimek.sUidLength == 4 && memcmp(iSnimek.sUid, "\x04\x11\x22\x33", 4) == 0);
+#if NFC_READER_SNAPSHOT_STEPS_EN
+  // Do snimku se dostanou jen nactene kroky
+  NFC_TEST_CHECK(!iSnimek.TRecipeStepLoaded && (iSnimek.sRecipeStepLoadedMask[2] & (1 << 5)) == 0);
+  TRecipeStep *iKrok;
+  NFC_TEST_CHECK(NFC_GetTRecipeStep(&NFC, &iCteni, 21, &iKrok) == 0);
+  NFC_TEST_CHECK(NFC_PublishCardInfo(&iCteni) == 0 && NFC_GetCardInfoSnapshot(&iSnimek) == 0);
+  NFC_TEST_CHECK((iSnimek.sRecipeStepLoadedMask[2] & (1 << 5)) && iSnimek.sRecipeStep[21].ProcessType == 40 + 21);
+  NFC_TEST_CHECK(NFC_LoadAllData(&NFC, &iCteni) == 0 && NFC_PublishCardInfo(&iCteni) == 0);
+  NFC_TEST_CHECK(NFC_GetCardInfoSnapshot(&iSnimek) == 0 && iSnimek.TRecipeStepLoaded && iSnimek.sRecipeStep[29].ProcessType == 40 + 29);
+#else
+  // Snimek bez kroku receptu zabira jen hlavicku
+  NFC_TEST_CHECK(sizeof(TNFCCardSnapshot) < 64);
+#endif
+  NFC_SessionClose();
+  NFC_EmulatorStop();
+
+  // Odebrana karta
+  uint32_t iEpocha = NFC_GetCardInfoEpoch();
+  NFC_TEST_CHECK(NFC_PublishCardInfo(NULL) == 0 && NFC_GetCardInfoEpoch() == iEpocha + 1);
+  NFC_TEST_CHECK(NFC_GetCardInfoSnapshot(&iSnimek) == 1 && !iSnimek.Present && iSnimek.Epoch == iEpocha + 1);
+
+  NFC_TestConcurrent();
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+  return NFC_TEST_RESULT();
+}
@@ -0,0 +1,126 @@
+/* ==========================================
+    NFC_reader - časová osa úseků a její export ve formátu Chrome trace JSON, úseky nad kapacitu
+    bufferu se zahodí a export zůstane platný
+========================================== */
+#include "NFC_test.h"
+
+static pn532_t NFC;
+
+/**************************************************************************/
+/*!
+    @brief  Export časové osy do řetězce
+
+    @param  aSpans      Pointer na časovou osu
+    @param  aText      Pointer, do kterého se uloží JSON (uvolní volající)
+
+    @returns Navratova hodnota NFC_SpansExportChrome
+*/
+/**************************************************************************/
+static uint8_t NFC_TestExport(TNFCSpans *aSpans, char **aText)
+{
+  size_t iDelka;
+  FILE *iSoubor = open_memstream(aText, &iDelka);
+  uint8_t iVysledek = NFC_SpansExportChrome(aSpans, iSoubor);
+  fclose(iSoubor);
+  return iVysledek;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Počet událostí v exportovaném JSON
+*/
+/**************************************************************************/
+static size_t NFC_TestEvents(const char *aText)
+{
+  size_t iPocet = 0;
+  for (const char *i = strstr(aText, "\"ph\":\"X\""); i != NULL; i = strstr(i + 1, "\"ph\":\"X\""))
+  {
+    ++iPocet;
+  }
+  return iPocet;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Známé úseky - běžící úsek se vynechá, ostatní se zapíšou v pořadí zahájení
+*/
+/**************************************************************************/
+static void NFC_TestKnownSpans(void)
+{
+  TNFCSpan iUseky[] = {{"NFC_LoadAllData", 0, 1500, 7}, {"retry", 200, UINT32_MAX, 7}, {"NFC_PrefetchTask", 1600, 250, 9}};
+  TNFCSpans iOsa = {.sSpan = iUseky, .Capacity = 3, .Count = 3};
+  char *iText = NULL;
+  NFC_TEST_CHECK(NFC_TestExport(&iOsa, &iText) == 0);
+  NFC_TEST_CHECK(iText != NULL && strcmp(iText, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                                                "{\"name\":\"NFC_LoadAllData\",\"cat\":\"nfc\",\"ph\":\"X\",\"ts\":0,\"dur\":1500,\"pid\":1,\"tid\":7},\n"
+                                                "{\"name\":\"NFC_PrefetchTask\",\"cat\":\"nfc\",\"ph\":\"X\",\"ts\":1600,\"dur\":250,\"pid\":1,\"tid\":9}\n"
+                                                "]}\n") == 0);
+  free(iText);
+
+  // Prazdna osa je platny JSON bez udalosti
+  iOsa.Count = 0;
+  NFC_TEST_CHECK(NFC_TestExport(&iOsa, &iText) == 0);
+  NFC_TEST_CHECK(iText != NULL && strcmp(iText, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n]}\n") == 0);
+  free(iText);
+
+  // Soubor jen pro cteni
+  FILE *iSoubor = fopen("/dev/null", "r");
+  iOsa.Count = 3;
+  NFC_TEST_CHECK(iSoubor != NULL && NFC_SpansExportChrome(&iOsa, iSoubor) == 1);
+  fclose(iSoubor);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Úseky líného načtení z emulované karty - vnořené úseky leží uvnitř úseku veřejné funkce,
+            s malým bufferem se zapíšou jen první úseky a za buffer se nezapisuje
+*/
+/**************************************************************************/
+static void NFC_TestCardSpans(void)
+{
+  static TNFCCardDump iKarta;
+  TCardInfo iZapis, iCteni;
+  NFC_TestCardDump(&iKarta, NFC_TAG_CLASSIC, "\x04\x11\x22\x33", 4);
+  NFC_TestRecipe(&iZapis, 30, 40, 1000);
+  NFC_TEST_CHECK(NFC_EmulatorStart(&iKarta) == 0);
+  NFC_TEST_CHECK(NFC_WriteAllData(&NFC, &iZapis) == 0);
+
+  TNFCSpan iUseky[64];
+  TNFCSpans iOsa;
+  NFC_SpansStart(&iOsa, iUseky, 64);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  NFC_SpansStop();
+  NFC_TEST_CHECK(iOsa.Count >= 2 && iOsa.Count <= 64);
+  NFC_TEST_CHECK(strcmp(iUseky[0].Name, "NFC_LoadTRecipeInfoLazy") == 0 && strcmp(iUseky[1].Name, "NFC_SessionOpen") == 0);
+  for (size_t i = 1; i < iOsa.Count && i < 64; ++i)
+  {
+    NFC_TEST_CHECK(iUseky[i].Duration != UINT32_MAX && iUseky[i].Start >= iUseky[0].Start &&
+                   iUseky[i].Start + iUseky[i].Duration <= iUseky[0].Start + iUseky[0].Duration);
+  }
+  char *iText = NULL;
+  NFC_TEST_CHECK(NFC_TestExport(&iOsa, &iText) == 0);
+  NFC_TEST_CHECK(iText != NULL && NFC_TestEvents(iText) == iOsa.Count);
+  NFC_TEST_CHECK(iText != NULL && strstr(iText, "{\"name\":\"NFC_LoadTRecipeInfoLazy\",\"cat\":\"nfc\",\"ph\":\"X\",\"ts\":") != NULL);
+  free(iText);
+
+  // Maly buffer - dalsi useky se jen pocitaji, za kapacitu se nezapisuje
+  memset(iUseky, 0, sizeof(iUseky));
+  NFC_SpansStart(&iOsa, iUseky, 2);
+  NFC_TEST_CHECK(NFC_LoadTRecipeInfoLazy(&NFC, &iCteni) == 0);
+  NFC_SpansStop();
+  NFC_TEST_CHECK(iOsa.Count > 2 && iUseky[2].Name == NULL);
+  NFC_TEST_CHECK(NFC_TestExport(&iOsa, &iText) == 0);
+  NFC_TEST_CHECK(iText != NULL && NFC_TestEvents(iText) == 2 && strcmp(iText + strlen(iText) - 4, "\n]}\n") == 0);
+  free(iText);
+  NFC_EmulatorStop();
+  NFC_DeAllocTRecipeStepArray(&iCteni);
+  NFC_DeAllocTRecipeStepArray(&iZapis);
+}
+
+int main(void)
+{
+  NFC_TestKnownSpans();
+  NFC_TestCardSpans();
+  return NFC_TEST_RESULT();
+}
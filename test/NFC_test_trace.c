@@ -0,0 +1,62 @@
+/* ==========================================
+    NFC_reader - záznam provozu s kartou, uložení do souboru a přehrání bez karty
+========================================== */
+#include <stdlib.h>
+#include <unistd.h>
+#include "NFC_test.h"
+#include "NFC_reader_host.h"
+#include "shim_card.h"
+
+#define NFC_TEST_FRAMES 600
+
+int main(void)
+{
+  static TNFCTraceFrame iZaznam[NFC_TEST_FRAMES], iNacteno[NFC_TEST_FRAMES];
+  TNFCTrace iTrace;
+  pn532_t iNFC;
+  TCardInfo iZapis, iCteni;
+
+  ShimCardInsert(SHIM_CARD_CLASSIC, (const uint8_t *)"\x04\x11\x22\x33", 4);
+  NFC_TestRecipe(&iZapis, 30, 40, 500);
+  NFC_TEST_CHECK(NFC_WriteAllData(&iNFC, &iZapis) == 0);
+
+  NFC_TraceRecordStart(&iTrace, iZaznam, NFC_TEST_FRAMES);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadAllData(&iNFC, &iCteni) == 0);
+  NFC_TraceStop();
+  ShimCardRemove();
+  NFC_TEST_CHECK(iTrace.Count > 0 && iTrace.Dropped == 0);
+
+  // Zaznam projde ulozenim do souboru beze zmeny
+  char iSoubor[] = "/tmp/NFC_test_traceXXXXXX";
+  int iFd = mkstemp(iSoubor);
+  NFC_TEST_CHECK(iFd >= 0);
+  close(iFd);
+  size_t iPocet = 0;
+  NFC_TEST_CHECK(NFC_TraceSave(iSoubor, &iTrace) == 0);
+  NFC_TEST_CHECK(NFC_TraceLoad(iSoubor, iNacteno, NFC_TEST_FRAMES, &iPocet) == 0);
+  unlink(iSoubor);
+  NFC_TEST_CHECK(iPocet == iTrace.Count && memcmp(iNacteno, iZaznam, iPocet * sizeof(TNFCTraceFrame)) == 0);
+
+  // Prehrani bez karty vrati stejny recept
+  NFC_TraceReplayStart(&iTrace, iNacteno, iPocet, false);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadAllData(&iNFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iTrace.Mismatches == 0 && iTrace.Position == iPocet);
+  NFC_TraceStop();
+  NFC_TEST_CHECK(iCteni.sRecipeInfo.RecipeSteps == 30 && iCteni.sRecipeInfo.ActualBudget == 500);
+  NFC_TEST_CHECK(memcmp(iCteni.sRecipeStep, iZapis.sRecipeStep, 30 * sizeof(TRecipeStep)) == 0);
+
+  // Ramec navic (zaznam z jine verze knihovny) se pri prehravani preskoci
+  NFC_TEST_CHECK(iPocet > 2 && iPocet < NFC_TEST_FRAMES);
+  memmove(iNacteno + 3, iNacteno + 2, (iPocet - 2) * sizeof(TNFCTraceFrame));
+  iNacteno[2].Op = NFC_TRACE_CLASSIC_READ;
+  iNacteno[2].Arg = 63;
+  NFC_TraceReplayStart(&iTrace, iNacteno, iPocet + 1, false);
+  NFC_InitTCardInfo(&iCteni);
+  NFC_TEST_CHECK(NFC_LoadAllData(&iNFC, &iCteni) == 0);
+  NFC_TEST_CHECK(iTrace.Mismatches == 0 && iTrace.Skipped == 1);
+  NFC_TraceStop();
+  NFC_TEST_CHECK(memcmp(iCteni.sRecipeStep, iZapis.sRecipeStep, 30 * sizeof(TRecipeStep)) == 0);
+  return NFC_TEST_RESULT();
+}
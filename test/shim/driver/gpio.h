@@ -0,0 +1,52 @@
+#ifndef gpio_H
+#define gpio_H
+
+#include <stdint.h>
+
+typedef int gpio_num_t;
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_ERR_INVALID_STATE 0x103
+
+typedef enum
+{
+  GPIO_MODE_INPUT = 1
+} gpio_mode_t;
+
+typedef enum
+{
+  GPIO_PULLUP_DISABLE = 0,
+  GPIO_PULLUP_ENABLE = 1
+} gpio_pullup_t;
+
+typedef enum
+{
+  GPIO_PULLDOWN_DISABLE = 0
+} gpio_pulldown_t;
+
+typedef enum
+{
+  GPIO_INTR_DISABLE = 0,
+  GPIO_INTR_NEGEDGE = 2
+} gpio_int_type_t;
+
+typedef struct
+{
+  uint64_t pin_bit_mask;
+  gpio_mode_t mode;
+  gpio_pullup_t pull_up_en;
+  gpio_pulldown_t pull_down_en;
+  gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void *);
+
+esp_err_t gpio_config(const gpio_config_t *aConfig);
+esp_err_t gpio_install_isr_service(int aFlags);
+esp_err_t gpio_isr_handler_add(gpio_num_t aPin, gpio_isr_t aHandler, void *aArg);
+esp_err_t gpio_isr_handler_remove(gpio_num_t aPin);
+int gpio_get_level(gpio_num_t aPin);
+esp_err_t gpio_set_level(gpio_num_t aPin, uint32_t aLevel);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef esp_attr_H
+#define esp_attr_H
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif
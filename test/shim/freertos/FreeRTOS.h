@@ -0,0 +1,18 @@
+#ifndef FreeRTOS_H
+#define FreeRTOS_H
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(x) ((TickType_t)(x))
+#define pdPASS 1
+#define pdTRUE 1
+#define pdFALSE 0
+#define tskIDLE_PRIORITY 0
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef semphr_H
+#define semphr_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t aSemaphore, TickType_t aTicks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t aSemaphore);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t aSemaphore, BaseType_t *aWoken);
+#define portYIELD_FROM_ISR(x) ((void)(x))
+
+#endif
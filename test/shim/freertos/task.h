@@ -0,0 +1,14 @@
+#ifndef task_H
+#define task_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(TaskFunction_t aFunction, const char *aName, uint32_t aStack, void *aParam, UBaseType_t aPriority, TaskHandle_t *aHandle);
+void vTaskDelete(TaskHandle_t aTask);
+void vTaskDelay(TickType_t aTicks);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+#endif
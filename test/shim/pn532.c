@@ -0,0 +1,558 @@
+/* ==========================================
+    NFC_reader - náhrada ovladače pn532 pro testy na hostiteli
+    Příkaz se předá modelu PN532 jako rámec, model připraví rámec odpovědi a ovladač ho přečte stejně
+    jako po SPI. Funkce ovladače nad rámci odpovídají ovladači pn532 pro ESP-IDF.
+    Připravené odpovědi (ShimCardScript) dovolují testovat zpracování stavů a chybných odpovědí ovladačem knihovny.
+========================================== */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "pn532.h"
+#include "shim_card.h"
+
+#define SHIM_CARD_FRAME 64 // Nejdelsi ramec odpovedi modelu
+#define SHIM_CARD_WAIT_MAX 20 // Bez odpovedi se ceka nejvys 20 ms, aby testy bez karty netrvaly sekundy
+#define SHIM_UL_PAGES 135
+#define SHIM_STATUS_TIMEOUT 0x01 // Karta neodpovedela
+#define SHIM_STATUS_AUTH 0x14    // Chyba autentizace Mifare
+#define SHIM_CARD_SCRIPTS 4
+#define SHIM_UL_COUNTER_MAX 0xFFFFFF
+
+TShimCardStats ShimCardStats;
+TShimCardCommand ShimCardLog[SHIM_CARD_LOG];
+
+typedef struct
+{
+  uint8_t Prefix[SHIM_CARD_LOG_SIZE]; // Zacatek prikazu, na ktery se odpovi
+  uint8_t PrefixLength;
+  uint8_t Response[SHIM_CARD_FRAME - 9]; // Data odpovedi za kodem odpovedi
+  uint8_t ResponseLength;                // 0 - PN532 neodpovi
+  uint8_t Count;                         // Pocet zbyvajicich odpovedi, SHIM_CARD_FOREVER - bez omezeni
+  bool Execute;                          // Karta prikaz provede, ztrati se jen odpoved (ShimCardLoseResponse)
+} TShimCardScript;
+
+static struct
+{
+  bool Present;
+  uint8_t Type;
+  uint8_t Uid[10];
+  uint8_t UidLength;
+  uint8_t Memory[SHIM_CARD_MEMORY];
+  uint32_t Counter[SHIM_CARD_COUNTERS];
+  int AuthSector; // Autentizovany sektor Classic, -1 - zadny
+  uint8_t Response[SHIM_CARD_FRAME];
+  uint8_t ResponseLength;
+  TShimCardScript Scripts[SHIM_CARD_SCRIPTS];
+  bool Searching; // InListPassiveTarget bez karty - PN532 hleda do preruseni
+} ShimCard;
+
+/*!
+Zápis hostitele po SPI mimo příkazy ovladače (pn532_spi_write mezi stažením a uvolněním SS)
+*/
+static struct
+{
+  int Ss; // Pin SS z pn532_spi_init
+  bool Selected;
+  uint8_t Data[SHIM_CARD_FRAME];
+  uint8_t Length;
+} ShimSpi;
+
+/**************************************************************************/
+/*!
+    @brief  Přiložení karty - paměť se vynuluje, trailery sektorů Classic dostanou výchozí klíče FF..FF
+
+    @param  aType      SHIM_CARD_CLASSIC nebo SHIM_CARD_ULTRALIGHT
+    @param  aUid      UID karty
+    @param  aUidLength      Délka UID (4 nebo 7)
+*/
+/**************************************************************************/
+void ShimCardInsert(uint8_t aType, const uint8_t *aUid, uint8_t aUidLength)
+{
+  memset(&ShimCard, 0, sizeof(ShimCard));
+  memset(&ShimCardStats, 0, sizeof(ShimCardStats));
+  ShimCard.Type = aType;
+  memcpy(ShimCard.Uid, aUid, aUidLength);
+  ShimCard.UidLength = aUidLength;
+  ShimCard.AuthSector = -1;
+  if (aType == SHIM_CARD_CLASSIC)
+  {
+    for (size_t iTrailer = 3; iTrailer < SHIM_CARD_MEMORY / 16; iTrailer += 4)
+    {
+      memset(ShimCard.Memory + iTrailer * 16, 0xFF, 6);
+      memcpy(ShimCard.Memory + iTrailer * 16 + 6, "\xFF\x07\x80\x69", 4);
+      memset(ShimCard.Memory + iTrailer * 16 + 10, 0xFF, 6);
+    }
+  }
+  ShimCard.Present = true;
+}
+
+void ShimCardRemove(void)
+{
+  ShimCard.Present = false;
+}
+
+uint8_t *ShimCardMemory(void)
+{
+  return ShimCard.Memory;
+}
+
+uint32_t *ShimCardCounters(void)
+{
+  return ShimCard.Counter;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Připravená odpověď PN532 - příkaz začínající aPrefix model nezpracuje a vrátí aResponse.
+            Přiložení karty připravené odpovědi zruší.
+
+    @param  aPrefix      Začátek příkazu (kód příkazu a další byty, např. 40 01 30)
+    @param  aPrefixLength      Délka začátku příkazu
+    @param  aResponse      Data odpovědi za kódem odpovědi (u InDataExchange stav a data karty)
+    @param  aResponseLength      Délka odpovědi, 0 - PN532 neodpoví
+    @param  aCount      Počet příkazů, na které se takto odpoví (SHIM_CARD_FOREVER - všechny)
+*/
+/**************************************************************************/
+void ShimCardScript(const uint8_t *aPrefix, uint8_t aPrefixLength, const uint8_t *aResponse, uint8_t aResponseLength, uint8_t aCount)
+{
+  for (size_t i = 0; i < SHIM_CARD_SCRIPTS; ++i)
+  {
+    TShimCardScript *iScript = &ShimCard.Scripts[i];
+    if (iScript->Count != 0)
+      continue;
+    memcpy(iScript->Prefix, aPrefix, aPrefixLength);
+    iScript->PrefixLength = aPrefixLength;
+    memcpy(iScript->Response, aResponse, aResponseLength);
+    iScript->ResponseLength = aResponseLength;
+    iScript->Count = aCount;
+    iScript->Execute = false;
+    return;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ztracená odpověď - karta příkaz začínající aPrefix provede, ale PN532 neodpoví
+            (karta odtržena nebo chyba CRC odpovědi po provedení příkazu)
+
+    @param  aPrefix      Začátek příkazu
+    @param  aPrefixLength      Délka začátku příkazu
+    @param  aCount      Počet příkazů, jejichž odpověď se ztratí (SHIM_CARD_FOREVER - všechny)
+*/
+/**************************************************************************/
+void ShimCardLoseResponse(const uint8_t *aPrefix, uint8_t aPrefixLength, uint8_t aCount)
+{
+  for (size_t i = 0; i < SHIM_CARD_SCRIPTS; ++i)
+  {
+    if (ShimCard.Scripts[i].Count != 0)
+      continue;
+    ShimCardScript(aPrefix, aPrefixLength, NULL, 0, aCount);
+    ShimCard.Scripts[i].Execute = true;
+    return;
+  }
+}
+
+/*!
+Model PN532 - odpověď se složí do rámce 00 00 FF LEN LCS D5 kód data... DCS 00
+*/
+static void ShimCardRespond(uint8_t aCommand, const uint8_t *aData, uint8_t aLength)
+{
+  uint8_t *iRamec = ShimCard.Response;
+  iRamec[0] = 0x00;
+  iRamec[1] = 0x00;
+  iRamec[2] = 0xFF;
+  iRamec[3] = aLength + 2;
+  iRamec[4] = ~(aLength + 2) + 1;
+  iRamec[5] = 0xD5;
+  iRamec[6] = aCommand + 1;
+  memcpy(iRamec + 7, aData, aLength);
+  uint8_t iSoucet = 0xD5 + aCommand + 1;
+  for (uint8_t i = 0; i < aLength; ++i)
+  {
+    iSoucet += aData[i];
+  }
+  iRamec[7 + aLength] = ~iSoucet + 1;
+  iRamec[8 + aLength] = 0x00;
+  ShimCard.ResponseLength = aLength + 9;
+}
+
+static bool ShimCardSelect(const uint8_t *aCommand, uint8_t aLength, uint8_t *aData, uint8_t *aDataLength)
+{
+  ++ShimCardStats.Selects;
+  ShimCard.AuthSector = -1;
+  // Jen ISO14443A 106 kbps, se zadanym UID se aktivuje jen tato karta (UID 7 B s kaskadovym znakem 88)
+  if (!ShimCard.Present || aLength < 3 || aCommand[2] != PN532_MIFARE_ISO14443A)
+    return false;
+  if (aLength > 3)
+  {
+    const uint8_t *iUid = aCommand + 3;
+    uint8_t iDelka = aLength - 3;
+    if (iDelka == 8 && iUid[0] == 0x88)
+    {
+      ++iUid;
+      --iDelka;
+    }
+    if (iDelka != ShimCard.UidLength || memcmp(iUid, ShimCard.Uid, iDelka) != 0)
+      return false;
+  }
+  bool iClassic = ShimCard.Type == SHIM_CARD_CLASSIC;
+  uint8_t iHlavicka[] = {1, 1, 0x00, iClassic ? 0x04 : 0x44, iClassic ? 0x08 : 0x00, ShimCard.UidLength};
+  memcpy(aData, iHlavicka, sizeof(iHlavicka));
+  memcpy(aData + sizeof(iHlavicka), ShimCard.Uid, ShimCard.UidLength);
+  *aDataLength = sizeof(iHlavicka) + ShimCard.UidLength;
+  return true;
+}
+
+static uint8_t ShimCardClassic(const uint8_t *aCommand, uint8_t aLength, uint8_t *aData, uint8_t *aDataLength)
+{
+  if (aLength < 2 || aCommand[1] >= SHIM_CARD_MEMORY / 16)
+    return SHIM_STATUS_TIMEOUT;
+  uint8_t iBlok = aCommand[1];
+  uint8_t *iPamet = ShimCard.Memory + iBlok * 16;
+  switch (aCommand[0])
+  {
+  case 0x60:
+  case 0x61:
+  {
+    ++ShimCardStats.Auths;
+    // Klic A je v bytech 0..5 traileru, klic B v bytech 10..15, UID jsou posledni 4 B
+    const uint8_t *iKlic = ShimCard.Memory + ((iBlok / 4) * 4 + 3) * 16 + (aCommand[0] == 0x60 ? 0 : 10);
+    ShimCard.AuthSector = -1;
+    if (aLength != 12 || memcmp(aCommand + 2, iKlic, 6) != 0 || memcmp(aCommand + 8, ShimCard.Uid + ShimCard.UidLength - 4, 4) != 0)
+      return SHIM_STATUS_AUTH;
+    ShimCard.AuthSector = iBlok / 4;
+    return 0;
+  }
+  case 0x30:
+    if (ShimCard.AuthSector != iBlok / 4)
+      return SHIM_STATUS_TIMEOUT;
+    ++ShimCardStats.Reads;
+    memcpy(aData, iPamet, 16);
+    *aDataLength = 16;
+    return 0;
+  case 0xA0:
+    if (ShimCard.AuthSector != iBlok / 4 || aLength != 18 || iBlok == 0)
+      return SHIM_STATUS_TIMEOUT;
+    ++ShimCardStats.Writes;
+    memcpy(iPamet, aCommand + 2, 16);
+    return 0;
+  }
+  return SHIM_STATUS_TIMEOUT;
+}
+
+static uint8_t ShimCardUltralight(const uint8_t *aCommand, uint8_t aLength, uint8_t *aData, uint8_t *aDataLength)
+{
+  if (aLength < 1 || (aLength < 2 && aCommand[0] != 0x60) || (aLength >= 2 && aCommand[1] >= SHIM_UL_PAGES))
+    return SHIM_STATUS_TIMEOUT;
+  uint8_t iStrana = aLength >= 2 ? aCommand[1] : 0;
+  uint32_t *iCitac = &ShimCard.Counter[iStrana % SHIM_CARD_COUNTERS];
+  uint32_t iPridat = aLength >= 5 ? aCommand[2] | (aCommand[3] << 8) | ((uint32_t)aCommand[4] << 16) : 0;
+  switch (aCommand[0])
+  {
+  case 0x39:
+    // READ_CNT - 24bitovy citac LSB napred
+    if (iStrana >= SHIM_CARD_COUNTERS)
+      return SHIM_STATUS_TIMEOUT;
+    aData[0] = *iCitac & 0xFF;
+    aData[1] = (*iCitac >> 8) & 0xFF;
+    aData[2] = (*iCitac >> 16) & 0xFF;
+    *aDataLength = 3;
+    return 0;
+  case 0xA5:
+    // INCR_CNT - citac nepretece, karta odpovi jen ACK
+    if (iStrana >= SHIM_CARD_COUNTERS || aLength != 6)
+      return SHIM_STATUS_TIMEOUT;
+    if (iPridat > SHIM_UL_COUNTER_MAX - *iCitac)
+      return SHIM_STATUS_TIMEOUT;
+    ++ShimCardStats.Increments;
+    *iCitac += iPridat;
+    return 0;
+  case 0x60:
+    // GET_VERSION - Ultralight EV1 (typ 03), ktery ma citace
+    if (aLength != 1)
+      return SHIM_STATUS_TIMEOUT;
+    memcpy(aData, "\x00\x04\x03\x01\x01\x00\x0E\x03", 8);
+    *aDataLength = 8;
+    return 0;
+  case 0x30:
+    // READ vraci 4 stranky od zadane
+    ++ShimCardStats.Reads;
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+      memcpy(aData + i * 4, ShimCard.Memory + ((iStrana + i) % SHIM_UL_PAGES) * 4, 4);
+    }
+    *aDataLength = 16;
+    return 0;
+  case 0xA2:
+    if (aLength != 6 || iStrana < 4)
+      return SHIM_STATUS_TIMEOUT;
+    ++ShimCardStats.Writes;
+    memcpy(ShimCard.Memory + iStrana * 4, aCommand + 2, 4);
+    return 0;
+  }
+  return SHIM_STATUS_TIMEOUT;
+}
+
+static bool ShimCardScripted(const uint8_t *aCommand, uint8_t aLength, bool *aLose)
+{
+  for (size_t i = 0; i < SHIM_CARD_SCRIPTS; ++i)
+  {
+    TShimCardScript *iScript = &ShimCard.Scripts[i];
+    if (iScript->Count == 0 || aLength < iScript->PrefixLength || memcmp(aCommand, iScript->Prefix, iScript->PrefixLength) != 0)
+      continue;
+    if (iScript->Count != SHIM_CARD_FOREVER)
+      --iScript->Count;
+    ++ShimCardStats.Scripted;
+    if (iScript->Execute)
+    {
+      *aLose = true;
+      return false;
+    }
+    if (iScript->ResponseLength != 0)
+      ShimCardRespond(aCommand[0], iScript->Response, iScript->ResponseLength);
+    return true;
+  }
+  return false;
+}
+
+static void ShimCardCommand(const uint8_t *aCommand, uint8_t aLength)
+{
+  uint8_t iData[SHIM_CARD_FRAME - 9];
+  uint8_t iDelka = 0;
+  if (ShimCardStats.Commands < SHIM_CARD_LOG)
+  {
+    TShimCardCommand *iZaznam = &ShimCardLog[ShimCardStats.Commands];
+    iZaznam->Length = aLength;
+    memcpy(iZaznam->Data, aCommand, aLength < SHIM_CARD_LOG_SIZE ? aLength : SHIM_CARD_LOG_SIZE);
+  }
+  ++ShimCardStats.Commands;
+  ShimCard.ResponseLength = 0;
+  if (ShimCard.Searching)
+  {
+    ++ShimCardStats.Rejected;
+    return;
+  }
+  bool iZtratit = false;
+  if (ShimCardScripted(aCommand, aLength, &iZtratit))
+    return;
+  switch (aCommand[0])
+  {
+  case 0x02:
+    // PN532 v1.6
+    memcpy(iData, "\x32\x01\x06\x07", 4);
+    ShimCardRespond(aCommand[0], iData, 4);
+    break;
+  case 0x14:
+  case 0x32:
+    // SAMConfiguration, RFConfiguration
+    ShimCardRespond(aCommand[0], iData, 0);
+    break;
+  case 0x4A:
+    // Bez karty PN532 hleda dal a neodpovi
+    if (ShimCardSelect(aCommand, aLength, iData, &iDelka))
+      ShimCardRespond(aCommand[0], iData, iDelka);
+    else
+      ShimCard.Searching = true;
+    break;
+  case 0x40:
+    // b0 stav, dal odpoved karty
+    if (aLength < 3 || !ShimCard.Present)
+      iData[0] = SHIM_STATUS_TIMEOUT;
+    else if (ShimCard.Type == SHIM_CARD_CLASSIC)
+      iData[0] = ShimCardClassic(aCommand + 2, aLength - 2, iData + 1, &iDelka);
+    else
+      iData[0] = ShimCardUltralight(aCommand + 2, aLength - 2, iData + 1, &iDelka);
+    ShimCardRespond(aCommand[0], iData, iData[0] == 0 ? iDelka + 1 : 1);
+    break;
+  }
+  if (iZtratit)
+    ShimCard.ResponseLength = 0;
+}
+
+/*!
+Ovladač pn532 - příkaz, čekání na připravenou odpověď a čtení rámce
+*/
+void pn532_spi_init(pn532_t *obj, uint8_t clk, uint8_t miso, uint8_t mosi, uint8_t ss)
+{
+  obj->_clk = clk;
+  obj->_miso = miso;
+  obj->_mosi = mosi;
+  obj->_ss = ss;
+  obj->_inListedTag = 0;
+  ShimSpi.Ss = ss;
+}
+
+void pn532_begin(pn532_t *obj)
+{
+  (void)obj;
+}
+
+bool pn532_sendCommandCheckAck(pn532_t *obj, uint8_t *cmd, uint8_t cmdlen, uint16_t timeout)
+{
+  (void)obj;
+  (void)timeout;
+  if (cmdlen == 0)
+    return false;
+  ShimCardCommand(cmd, cmdlen);
+  return true;
+}
+
+bool pn532_waitready(pn532_t *obj, uint16_t timeout)
+{
+  (void)obj;
+  if (ShimCard.ResponseLength != 0)
+    return true;
+  uint16_t iCekani = timeout < SHIM_CARD_WAIT_MAX ? timeout : SHIM_CARD_WAIT_MAX;
+  struct timespec iCas = {0, iCekani * 1000000L};
+  while (nanosleep(&iCas, &iCas) != 0 && errno == EINTR)
+    ;
+  return false;
+}
+
+void pn532_readdata(pn532_t *obj, uint8_t *buff, uint8_t n)
+{
+  (void)obj;
+  // Za ramcem odpovedi ctecka posila nuly
+  uint8_t iDelka = n < ShimCard.ResponseLength ? n : ShimCard.ResponseLength;
+  memcpy(buff, ShimCard.Response, iDelka);
+  memset(buff + iDelka, 0, n - iDelka);
+  ShimCard.ResponseLength = 0;
+}
+
+void pn532_spi_write(pn532_t *obj, uint8_t c)
+{
+  (void)obj;
+  if (ShimSpi.Selected && ShimSpi.Length < sizeof(ShimSpi.Data))
+    ShimSpi.Data[ShimSpi.Length++] = c;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Změna SS - stažením začíná zápis hostitele, uvolněním se zápis předá PN532.
+            Zápis dat s rámcem ACK přeruší hledání karty.
+
+    @param  aPin      Pin GPIO
+    @param  aLevel      Úroveň výstupu
+*/
+/**************************************************************************/
+void ShimCardPin(int aPin, uint32_t aLevel)
+{
+  static const uint8_t Ack[] = {PN532_SPI_DATAWRITE, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+  if (aPin != ShimSpi.Ss)
+    return;
+  if (aLevel == 0)
+  {
+    ShimSpi.Selected = true;
+    ShimSpi.Length = 0;
+    return;
+  }
+  if (ShimSpi.Selected && ShimSpi.Length == sizeof(Ack) && memcmp(ShimSpi.Data, Ack, sizeof(Ack)) == 0)
+  {
+    ++ShimCardStats.Aborts;
+    ShimCard.Searching = false;
+    ShimCard.ResponseLength = 0;
+  }
+  ShimSpi.Selected = false;
+}
+
+/*!
+Ovladač pn532 - funkce nad rámci
+*/
+static bool ShimExchange(pn532_t *obj, uint8_t *aCommand, uint8_t aLength, uint8_t *aResponse, uint8_t aResponseLength, uint16_t aTimeout)
+{
+  if (!pn532_sendCommandCheckAck(obj, aCommand, aLength, aTimeout) || !pn532_waitready(obj, aTimeout))
+    return false;
+  pn532_readdata(obj, aResponse, aResponseLength);
+  return true;
+}
+
+bool pn532_SAMConfig(pn532_t *obj)
+{
+  uint8_t iPrikaz[] = {0x14, 0x01, 0x14, 0x01};
+  uint8_t iOdpoved[8];
+  return ShimExchange(obj, iPrikaz, sizeof(iPrikaz), iOdpoved, sizeof(iOdpoved), 1000) && iOdpoved[6] == 0x15;
+}
+
+uint32_t pn532_getFirmwareVersion(pn532_t *obj)
+{
+  uint8_t iPrikaz[] = {0x02};
+  uint8_t iOdpoved[12];
+  if (!ShimExchange(obj, iPrikaz, sizeof(iPrikaz), iOdpoved, sizeof(iOdpoved), 1000))
+    return 0;
+  return ((uint32_t)iOdpoved[7] << 24) | ((uint32_t)iOdpoved[8] << 16) | ((uint32_t)iOdpoved[9] << 8) | iOdpoved[10];
+}
+
+bool pn532_readPassiveTargetID(pn532_t *obj, uint8_t cardbaudrate, uint8_t *uid, uint8_t *uidLength, uint16_t timeout)
+{
+  uint8_t iPrikaz[] = {0x4A, 0x01, cardbaudrate};
+  uint8_t iOdpoved[24];
+  *uidLength = 0;
+  // b7 pocet karet, b8 cislo karty, b9..10 ATQA, b11 SAK, b12 delka UID, b13.. UID
+  if (!ShimExchange(obj, iPrikaz, sizeof(iPrikaz), iOdpoved, sizeof(iOdpoved), timeout) || iOdpoved[7] != 1)
+    return false;
+  obj->_inListedTag = iOdpoved[8];
+  *uidLength = iOdpoved[12];
+  memcpy(uid, iOdpoved + 13, iOdpoved[12]);
+  return true;
+}
+
+bool pn532_inDataExchange(pn532_t *obj, uint8_t *send, uint8_t sendLength, uint8_t *response, uint8_t *responseLength)
+{
+  uint8_t iPrikaz[SHIM_CARD_FRAME] = {0x40, obj->_inListedTag};
+  uint8_t iOdpoved[SHIM_CARD_FRAME];
+  if (sendLength > sizeof(iPrikaz) - 2)
+    return false;
+  memcpy(iPrikaz + 2, send, sendLength);
+  // b3 LEN, b7 stav, b8.. odpoved karty
+  if (!ShimExchange(obj, iPrikaz, sendLength + 2, iOdpoved, sizeof(iOdpoved), 1000) || (iOdpoved[7] & 0x3F) != 0)
+    return false;
+  uint8_t iDelka = iOdpoved[3] - 3;
+  if (iDelka > *responseLength)
+    iDelka = *responseLength;
+  memcpy(response, iOdpoved + 8, iDelka);
+  *responseLength = iDelka;
+  return true;
+}
+
+uint8_t pn532_mifareclassic_AuthenticateBlock(pn532_t *obj, uint8_t *uid, uint8_t uidLen, uint32_t blockNumber, uint8_t keyNumber, uint8_t *keyData)
+{
+  uint8_t iPrikaz[2 + 6 + 4] = {keyNumber ? 0x61 : 0x60, blockNumber};
+  uint8_t iDelka = 0;
+  memcpy(iPrikaz + 2, keyData, 6);
+  memcpy(iPrikaz + 8, uid + uidLen - 4, 4);
+  return pn532_inDataExchange(obj, iPrikaz, sizeof(iPrikaz), NULL, &iDelka);
+}
+
+uint8_t pn532_mifareclassic_ReadDataBlock(pn532_t *obj, uint8_t blockNumber, uint8_t *data)
+{
+  uint8_t iPrikaz[] = {0x30, blockNumber};
+  uint8_t iDelka = 16;
+  return pn532_inDataExchange(obj, iPrikaz, sizeof(iPrikaz), data, &iDelka) && iDelka == 16;
+}
+
+uint8_t pn532_mifareclassic_WriteDataBlock(pn532_t *obj, uint8_t blockNumber, uint8_t *data)
+{
+  uint8_t iPrikaz[2 + 16] = {0xA0, blockNumber};
+  uint8_t iDelka = 0;
+  memcpy(iPrikaz + 2, data, 16);
+  return pn532_inDataExchange(obj, iPrikaz, sizeof(iPrikaz), NULL, &iDelka);
+}
+
+uint8_t pn532_mifareultralight_ReadPage(pn532_t *obj, uint8_t page, uint8_t *buffer)
+{
+  // Ovladac vraci vsechny 4 stranky prectene prikazem READ
+  uint8_t iPrikaz[] = {0x30, page};
+  uint8_t iDelka = 16;
+  return pn532_inDataExchange(obj, iPrikaz, sizeof(iPrikaz), buffer, &iDelka) && iDelka == 16;
+}
+
+uint8_t pn532_mifareultralight_WritePage(pn532_t *obj, uint8_t page, uint8_t *data)
+{
+  uint8_t iPrikaz[2 + 4] = {0xA2, page};
+  uint8_t iDelka = 0;
+  memcpy(iPrikaz + 2, data, 4);
+  return pn532_inDataExchange(obj, iPrikaz, sizeof(iPrikaz), NULL, &iDelka);
+}
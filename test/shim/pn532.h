@@ -0,0 +1,37 @@
+/* ==========================================
+    NFC_reader - náhrada ovladače pn532 pro testy na hostiteli
+    Ovladač komunikuje s modelem PN532 a karty v paměti (shim_card.h), rámce příkazů a odpovědí
+    jsou stejné jako na SPI.
+========================================== */
+#ifndef pn532_H
+#define pn532_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PN532_MIFARE_ISO14443A 0x00
+#define PN532_SPI_DATAWRITE 0x01
+
+typedef struct
+{
+  uint8_t _clk, _miso, _mosi, _ss;
+  uint8_t _inListedTag;
+} pn532_t;
+
+void pn532_spi_init(pn532_t *obj, uint8_t clk, uint8_t miso, uint8_t mosi, uint8_t ss);
+void pn532_begin(pn532_t *obj);
+bool pn532_SAMConfig(pn532_t *obj);
+uint32_t pn532_getFirmwareVersion(pn532_t *obj);
+bool pn532_sendCommandCheckAck(pn532_t *obj, uint8_t *cmd, uint8_t cmdlen, uint16_t timeout);
+bool pn532_waitready(pn532_t *obj, uint16_t timeout);
+void pn532_readdata(pn532_t *obj, uint8_t *buff, uint8_t n);
+void pn532_spi_write(pn532_t *obj, uint8_t c);
+bool pn532_readPassiveTargetID(pn532_t *obj, uint8_t cardbaudrate, uint8_t *uid, uint8_t *uidLength, uint16_t timeout);
+bool pn532_inDataExchange(pn532_t *obj, uint8_t *send, uint8_t sendLength, uint8_t *response, uint8_t *responseLength);
+uint8_t pn532_mifareclassic_AuthenticateBlock(pn532_t *obj, uint8_t *uid, uint8_t uidLen, uint32_t blockNumber, uint8_t keyNumber, uint8_t *keyData);
+uint8_t pn532_mifareclassic_ReadDataBlock(pn532_t *obj, uint8_t blockNumber, uint8_t *data);
+uint8_t pn532_mifareclassic_WriteDataBlock(pn532_t *obj, uint8_t blockNumber, uint8_t *data);
+uint8_t pn532_mifareultralight_ReadPage(pn532_t *obj, uint8_t page, uint8_t *buffer);
+uint8_t pn532_mifareultralight_WritePage(pn532_t *obj, uint8_t page, uint8_t *data);
+
+#endif
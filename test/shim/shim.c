@@ -0,0 +1,179 @@
+/* ==========================================
+    NFC_reader - náhrada ESP-IDF a FreeRTOS pro testy na hostiteli
+    Úlohy jsou vlákna POSIX, semafory semafory POSIX, čas monotónní hodiny.
+========================================== */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "shim_card.h"
+
+/*!
+ESP-IDF
+*/
+int64_t esp_timer_get_time(void)
+{
+  struct timespec iCas;
+  clock_gettime(CLOCK_MONOTONIC, &iCas);
+  return iCas.tv_sec * 1000000LL + iCas.tv_nsec / 1000;
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+  return ESP_RST_POWERON;
+}
+
+esp_err_t gpio_config(const gpio_config_t *aConfig)
+{
+  (void)aConfig;
+  return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int aFlags)
+{
+  (void)aFlags;
+  return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t aPin, gpio_isr_t aHandler, void *aArg)
+{
+  (void)aPin;
+  (void)aHandler;
+  (void)aArg;
+  return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t aPin)
+{
+  (void)aPin;
+  return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t aPin)
+{
+  (void)aPin;
+  return 1;
+}
+
+esp_err_t gpio_set_level(gpio_num_t aPin, uint32_t aLevel)
+{
+  ShimCardPin(aPin, aLevel);
+  return ESP_OK;
+}
+
+/*!
+FreeRTOS - tick je 1 ms (portTICK_PERIOD_MS)
+*/
+typedef struct
+{
+  TaskFunction_t Function;
+  void *Param;
+} TShimTask;
+
+static void *ShimTaskRun(void *aTask)
+{
+  TShimTask iUloha = *(TShimTask *)aTask;
+  free(aTask);
+  iUloha.Function(iUloha.Param);
+  return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t aFunction, const char *aName, uint32_t aStack, void *aParam, UBaseType_t aPriority, TaskHandle_t *aHandle)
+{
+  (void)aName;
+  (void)aStack;
+  (void)aPriority;
+  TShimTask *iUloha = malloc(sizeof(TShimTask));
+  if (iUloha == NULL)
+    return pdFALSE;
+  iUloha->Function = aFunction;
+  iUloha->Param = aParam;
+  pthread_t iVlakno;
+  if (pthread_create(&iVlakno, NULL, ShimTaskRun, iUloha) != 0)
+  {
+    free(iUloha);
+    return pdFALSE;
+  }
+  pthread_detach(iVlakno);
+  if (aHandle != NULL)
+    *aHandle = (TaskHandle_t)iVlakno;
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t aTask)
+{
+  // Knihovna maze jen vlastni ulohu (NULL)
+  if (aTask == NULL)
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t aTicks)
+{
+  struct timespec iCas = {aTicks / 1000, (aTicks % 1000) * 1000000L};
+  while (nanosleep(&iCas, &iCas) != 0 && errno == EINTR)
+    ;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+  return (TaskHandle_t)pthread_self();
+}
+
+static SemaphoreHandle_t ShimSemaphoreCreate(unsigned aValue)
+{
+  sem_t *iSemafor = malloc(sizeof(sem_t));
+  if (iSemafor != NULL)
+    sem_init(iSemafor, 0, aValue);
+  return iSemafor;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+  return ShimSemaphoreCreate(0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t aSemaphore, TickType_t aTicks)
+{
+  if (aTicks == portMAX_DELAY)
+  {
+    while (sem_wait(aSemaphore) != 0)
+      if (errno != EINTR)
+        return pdFALSE;
+    return pdTRUE;
+  }
+  struct timespec iKonec;
+  clock_gettime(CLOCK_REALTIME, &iKonec);
+  iKonec.tv_sec += aTicks / 1000;
+  iKonec.tv_nsec += (aTicks % 1000) * 1000000L;
+  if (iKonec.tv_nsec >= 1000000000L)
+  {
+    ++iKonec.tv_sec;
+    iKonec.tv_nsec -= 1000000000L;
+  }
+  while (sem_timedwait(aSemaphore, &iKonec) != 0)
+    if (errno != EINTR)
+      return pdFALSE;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t aSemaphore)
+{
+  return sem_post(aSemaphore) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t aSemaphore, BaseType_t *aWoken)
+{
+  if (aWoken != NULL)
+    *aWoken = pdFALSE;
+  return xSemaphoreGive(aSemaphore);
+}
@@ -0,0 +1,53 @@
+/* ==========================================
+    NFC_reader - model PN532 s jednou kartou v paměti pro testy na hostiteli
+    Karta Mifare Classic 1K ověřuje klíče z trailerů sektorů, Ultralight se hlásí jako Ultralight EV1
+    s čítači a má paměť NTAG215.
+    Na vybrané příkazy může model místo karty vrátit připravenou odpověď (ShimCardScript).
+    Bez karty PN532 hledá dál a další příkazy odmítá, dokud ho hostitel nepřeruší rámcem ACK.
+========================================== */
+#ifndef shim_card_H
+#define shim_card_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SHIM_CARD_CLASSIC 1
+#define SHIM_CARD_ULTRALIGHT 2
+
+#define SHIM_CARD_MEMORY 1024 // Mifare Classic 1K, NTAG215 ma 135 stranek po 4 B
+#define SHIM_CARD_LOG 32       // Pocet zaznamenanych prikazu od vynulovani ShimCardStats
+#define SHIM_CARD_LOG_SIZE 24  // Zaznamenana delka prikazu
+#define SHIM_CARD_FOREVER 0xFF // Pripravena odpoved plati pro vsechny shodne prikazy
+#define SHIM_CARD_COUNTERS 3   // Citace Ultralight EV1
+
+typedef struct
+{
+  uint32_t Commands;   // Prikazy PN532
+  uint32_t Selects;    // InListPassiveTarget
+  uint32_t Auths;      // Autentizace Mifare Classic
+  uint32_t Reads;      // READ (blok Classic nebo 4 stranky Ultralight)
+  uint32_t Writes;     // WRITE Classic a Ultralight
+  uint32_t Increments; // INCR_CNT Ultralight
+  uint32_t Scripted;   // Prikazy zodpovezene pripravenou odpovedi
+  uint32_t Aborts;     // Ramce ACK od hostitele, ktere prerusily hledani karty
+  uint32_t Rejected;   // Prikazy odmitnute behem hledani karty
+} TShimCardStats;
+
+typedef struct
+{
+  uint8_t Length; // Delka prikazu (muze byt vetsi nez SHIM_CARD_LOG_SIZE)
+  uint8_t Data[SHIM_CARD_LOG_SIZE];
+} TShimCardCommand;
+
+extern TShimCardStats ShimCardStats;
+extern TShimCardCommand ShimCardLog[SHIM_CARD_LOG]; // Prikazy PN532 v poradi, index je ShimCardStats.Commands
+
+void ShimCardInsert(uint8_t aType, const uint8_t *aUid, uint8_t aUidLength);
+void ShimCardRemove(void);
+uint8_t *ShimCardMemory(void);
+uint32_t *ShimCardCounters(void);
+void ShimCardScript(const uint8_t *aPrefix, uint8_t aPrefixLength, const uint8_t *aResponse, uint8_t aResponseLength, uint8_t aCount);
+void ShimCardLoseResponse(const uint8_t *aPrefix, uint8_t aPrefixLength, uint8_t aCount);
+void ShimCardPin(int aPin, uint32_t aLevel); // Zmena vystupu GPIO (gpio_set_level) - SS ovladace pn532
+
+#endif